@@ -0,0 +1,242 @@
+// Copyright (C) Simone Di Gravio <email: altairjp@gmail.com> - All Rights Reserved
+
+#include "Commands/TwitchCommandBatch.h"
+#include "Net/TwitchIRCCapture.h"
+#include "Net/TwitchIRCUtf8.h"
+
+namespace
+{
+	// Fractional float arguments are sent as fixed point
+	const double FloatScale = 1000.0;
+
+	// Keeps the zigzag encoded fixed point within 62 bits, so the flag bit fits
+	const double MaxFixedPoint = 1.0e18;
+
+	uint64 ZigZagEncode(int64 _value)
+	{
+		return (static_cast<uint64>(_value) << 1) ^ static_cast<uint64>(_value >> 63);
+	}
+
+	int64 ZigZagDecode(uint64 _value)
+	{
+		return static_cast<int64>(_value >> 1) ^ -static_cast<int64>(_value & 1);
+	}
+
+	void WriteString(TArray<uint8>& _out_bytes, const FString& _string)
+	{
+		const FTCHARToUTF8 utf8_string(*_string);
+		TwitchIRCCapture::WriteVarint(_out_bytes, static_cast<uint64>(utf8_string.Length()));
+		_out_bytes.Append(reinterpret_cast<const uint8*>(utf8_string.Get()), utf8_string.Length());
+	}
+
+	bool ReadString(const uint8*& _inout_cursor, const uint8* _end, FString& _out_string)
+	{
+		uint64 length;
+		if (!TwitchIRCCapture::ReadVarint(_inout_cursor, _end, length) || length > static_cast<uint64>(_end - _inout_cursor))
+		{
+			return false;
+		}
+		// The decoded command is reused: its strings keep their allocations
+		TwitchIRCUtf8::DecodeInto(reinterpret_cast<const ANSICHAR*>(_inout_cursor), static_cast<int32>(length), _out_string);
+		_inout_cursor += length;
+		return true;
+	}
+}
+
+bool FTwitchCommandBatch::Add(const FTwitchBatchedCommand& _command, int32 _max_bytes)
+{
+	const int32 previous_size = data_.Num();
+
+	// Names are referenced by index. The index right after the last one means a new name follows
+	int32 command_ref = command_names_.IndexOfByKey(_command.command_name_);
+	const bool b_new_command = command_ref == INDEX_NONE;
+	if (b_new_command)
+	{
+		command_ref = command_names_.Num();
+	}
+	const bool b_new_user = !batch_users_.Contains(_command.user_handle_);
+
+	TwitchIRCCapture::WriteVarint(data_, (static_cast<uint64>(command_ref) << 2) | (b_new_user ? 2 : 0) | (_command.b_typed_ ? 1 : 0));
+	if (b_new_command)
+	{
+		WriteString(data_, _command.command_name_);
+	}
+
+	// Commands of the same users come in bursts: the differences between handles are small
+	TwitchIRCCapture::WriteVarint(data_, ZigZagEncode(static_cast<int64>(_command.user_handle_) - last_user_handle_));
+	if (b_new_user)
+	{
+		WriteString(data_, _command.username_);
+	}
+
+	if (_command.b_typed_)
+	{
+		const int32 num_args = FMath::Clamp(_command.args_.num_args_, 0, FTwitchCommandArgs::MaxArgs);
+		data_.Add(static_cast<uint8>(num_args));
+		for (int32 cycle_arg = 0; cycle_arg < num_args; ++cycle_arg)
+		{
+			// Int, Enum and Direction values are whole: the float is the same number
+			const int32 int_value = _command.args_.int_values_[cycle_arg];
+			const float float_value = _command.args_.float_values_[cycle_arg];
+			if (float_value == static_cast<float>(int_value))
+			{
+				TwitchIRCCapture::WriteVarint(data_, ZigZagEncode(int_value) << 1);
+			}
+			else
+			{
+				const double fixed_point = FMath::Clamp(FMath::FloorToDouble(float_value * FloatScale + 0.5), -MaxFixedPoint, MaxFixedPoint);
+				TwitchIRCCapture::WriteVarint(data_, (ZigZagEncode(static_cast<int64>(fixed_point)) << 1) | 1);
+			}
+		}
+	}
+	else
+	{
+		WriteString(data_, _command.options_);
+	}
+
+	if (data_.Num() > _max_bytes)
+	{
+		data_.SetNum(previous_size, false);
+		return false;
+	}
+
+	if (b_new_command)
+	{
+		command_names_.Add(_command.command_name_);
+	}
+	if (b_new_user)
+	{
+		batch_users_.Add(_command.user_handle_);
+	}
+	last_user_handle_ = _command.user_handle_;
+	++num_commands_;
+	return true;
+}
+
+bool FTwitchCommandBatch::ForEachCommand(TFunctionRef<void(const FTwitchBatchedCommand&)> _function) const
+{
+	TArray<FString, TInlineAllocator<16>> command_names;
+	TMap<int32, FString> usernames;
+	int64 last_user_handle = 0;
+
+	const uint8* cursor = data_.GetData();
+	const uint8* const end = cursor + data_.Num();
+
+	FTwitchBatchedCommand command;
+	for (int32 cycle_command = 0; cycle_command < num_commands_; ++cycle_command)
+	{
+		uint64 header;
+		if (!TwitchIRCCapture::ReadVarint(cursor, end, header))
+		{
+			return false;
+		}
+
+		const uint64 command_ref = header >> 2;
+		if (command_ref == static_cast<uint64>(command_names.Num()))
+		{
+			const int32 name_index = command_names.AddDefaulted();
+			if (!ReadString(cursor, end, command_names[name_index]))
+			{
+				return false;
+			}
+		}
+		else if (command_ref > static_cast<uint64>(command_names.Num()))
+		{
+			return false;
+		}
+		command.command_name_ = command_names[command_ref];
+
+		uint64 user_delta;
+		if (!TwitchIRCCapture::ReadVarint(cursor, end, user_delta))
+		{
+			return false;
+		}
+		last_user_handle += ZigZagDecode(user_delta);
+		command.user_handle_ = static_cast<int32>(last_user_handle);
+		if ((header & 2) != 0)
+		{
+			if (!ReadString(cursor, end, usernames.Add(command.user_handle_)))
+			{
+				return false;
+			}
+		}
+		const FString* username = usernames.Find(command.user_handle_);
+		if (username == nullptr)
+		{
+			return false;
+		}
+		command.username_ = *username;
+
+		command.b_typed_ = (header & 1) != 0;
+		command.args_ = FTwitchCommandArgs();
+		command.options_.Reset();
+		if (command.b_typed_)
+		{
+			if (cursor == end || *cursor > FTwitchCommandArgs::MaxArgs)
+			{
+				return false;
+			}
+			command.args_.num_args_ = *cursor++;
+			for (int32 cycle_arg = 0; cycle_arg < command.args_.num_args_; ++cycle_arg)
+			{
+				uint64 value;
+				if (!TwitchIRCCapture::ReadVarint(cursor, end, value))
+				{
+					return false;
+				}
+				const int64 number = ZigZagDecode(value >> 1);
+				if ((value & 1) != 0)
+				{
+					command.args_.float_values_[cycle_arg] = static_cast<float>(number / FloatScale);
+					command.args_.int_values_[cycle_arg] = static_cast<int32>(command.args_.float_values_[cycle_arg]);
+				}
+				else
+				{
+					command.args_.int_values_[cycle_arg] = static_cast<int32>(number);
+					command.args_.float_values_[cycle_arg] = static_cast<float>(number);
+				}
+			}
+		}
+		else if (!ReadString(cursor, end, command.options_))
+		{
+			return false;
+		}
+
+		_function(command);
+	}
+	return cursor == end;
+}
+
+void FTwitchCommandBatch::Reset()
+{
+	num_commands_ = 0;
+	data_.Reset();
+	command_names_.Reset();
+	batch_users_.Reset();
+	last_user_handle_ = 0;
+}
+
+bool FTwitchCommandBatch::NetSerialize(FArchive& _archive, UPackageMap* _package_map, bool& _b_out_success)
+{
+	uint32 num_commands = static_cast<uint32>(num_commands_);
+	uint32 num_bytes = static_cast<uint32>(data_.Num());
+	_archive.SerializeIntPacked(num_commands);
+	_archive.SerializeIntPacked(num_bytes);
+
+	if (_archive.IsLoading())
+	{
+		if (num_bytes > static_cast<uint32>(MaxReceivedBytes) || num_commands > num_bytes)
+		{
+			_archive.SetError();
+			_b_out_success = false;
+			return true;
+		}
+		Reset();
+		num_commands_ = static_cast<int32>(num_commands);
+		data_.SetNumUninitialized(num_bytes);
+	}
+	_archive.Serialize(data_.GetData(), num_bytes);
+
+	_b_out_success = !_archive.IsError();
+	return true;
+}
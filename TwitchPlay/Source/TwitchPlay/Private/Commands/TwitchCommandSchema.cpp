@@ -0,0 +1,306 @@
+// Copyright (C) Simone Di Gravio <email: altairjp@gmail.com> - All Rights Reserved
+
+#include "Commands/TwitchCommandSchema.h"
+
+namespace
+{
+	struct FDirectionName
+	{
+		const TCHAR* name_;
+
+		int32 length_;
+
+		ETwitchCommandDirection direction_;
+	};
+
+	// Lower case, the way players write them
+	const FDirectionName DirectionNames[] =
+	{
+		{ TEXT("up"), 2, ETwitchCommandDirection::Up }, { TEXT("u"), 1, ETwitchCommandDirection::Up },
+		{ TEXT("north"), 5, ETwitchCommandDirection::Up }, { TEXT("n"), 1, ETwitchCommandDirection::Up },
+		{ TEXT("down"), 4, ETwitchCommandDirection::Down }, { TEXT("d"), 1, ETwitchCommandDirection::Down },
+		{ TEXT("south"), 5, ETwitchCommandDirection::Down }, { TEXT("s"), 1, ETwitchCommandDirection::Down },
+		{ TEXT("left"), 4, ETwitchCommandDirection::Left }, { TEXT("l"), 1, ETwitchCommandDirection::Left },
+		{ TEXT("west"), 4, ETwitchCommandDirection::Left }, { TEXT("w"), 1, ETwitchCommandDirection::Left },
+		{ TEXT("right"), 5, ETwitchCommandDirection::Right }, { TEXT("r"), 1, ETwitchCommandDirection::Right },
+		{ TEXT("east"), 4, ETwitchCommandDirection::Right }, { TEXT("e"), 1, ETwitchCommandDirection::Right }
+	};
+
+	// Case insensitive comparison of a token against a lower case name
+	bool EqualsLowerCase(const TCHAR* _token, int32 _length, const TCHAR* _lower_case_name, int32 _name_length)
+	{
+		if (_length != _name_length)
+		{
+			return false;
+		}
+		for (int32 cycle_char = 0; cycle_char < _length; ++cycle_char)
+		{
+			if (FChar::ToLower(_token[cycle_char]) != _lower_case_name[cycle_char])
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	/**
+	 * Reads a decimal number: optional sign, digits, and for floats an optional fractional part.
+	 *
+	 * @return Whether the whole token is a number.
+	 */
+	bool ParseNumber(const TCHAR* _token, int32 _length, bool _b_allow_fraction, double& _out_value)
+	{
+		int32 index = 0;
+		const bool b_negative = _length > 0 && _token[0] == '-';
+		if (_length > 0 && (_token[0] == '-' || _token[0] == '+'))
+		{
+			++index;
+		}
+
+		double value = 0.0;
+		int32 num_digits = 0;
+		for (; index < _length && FChar::IsDigit(_token[index]); ++index, ++num_digits)
+		{
+			value = value * 10.0 + (_token[index] - '0');
+		}
+
+		if (_b_allow_fraction && index < _length && _token[index] == '.')
+		{
+			double scale = 0.1;
+			for (++index; index < _length && FChar::IsDigit(_token[index]); ++index, ++num_digits)
+			{
+				value += (_token[index] - '0') * scale;
+				scale *= 0.1;
+			}
+		}
+
+		_out_value = b_negative ? -value : value;
+		return num_digits > 0 && index == _length;
+	}
+}
+
+int32 UTwitchCommandArgsLibrary::GetCommandArgInt(const FTwitchCommandArgs& _args, int32 _index)
+{
+	return _args.GetInt(_index);
+}
+
+float UTwitchCommandArgsLibrary::GetCommandArgFloat(const FTwitchCommandArgs& _args, int32 _index)
+{
+	return _args.GetFloat(_index);
+}
+
+ETwitchCommandDirection UTwitchCommandArgsLibrary::GetCommandArgDirection(const FTwitchCommandArgs& _args, int32 _index)
+{
+	return static_cast<ETwitchCommandDirection>(FMath::Clamp(_args.GetInt(_index), 0, static_cast<int32>(ETwitchCommandDirection::Right)));
+}
+
+bool FTwitchCommandSchemaParser::Compile(const FTwitchCommandSchema& _schema, FString& _out_error)
+{
+	args_.Reset();
+	enum_chars_.Reset();
+	enum_values_.Reset();
+	num_required_args_ = 0;
+
+	if (_schema.args_.Num() > FTwitchCommandArgs::MaxArgs)
+	{
+		_out_error = FString::Printf(TEXT("A command can have at most %d arguments"), FTwitchCommandArgs::MaxArgs);
+		return false;
+	}
+	if (_schema.num_optional_args_ < 0 || _schema.num_optional_args_ > _schema.args_.Num())
+	{
+		_out_error = "The amount of optional arguments must be between 0 and the amount of arguments";
+		return false;
+	}
+
+	for (int32 cycle_arg = 0; cycle_arg < _schema.args_.Num(); ++cycle_arg)
+	{
+		const FTwitchCommandArgSpec& arg_spec = _schema.args_[cycle_arg];
+
+		FCompiledArg arg;
+		arg.type_ = arg_spec.type_;
+		arg.b_check_range_ = arg_spec.b_check_range_;
+		arg.min_value_ = arg_spec.min_value_;
+		arg.max_value_ = arg_spec.max_value_;
+		if (arg.b_check_range_ && arg.min_value_ > arg.max_value_)
+		{
+			_out_error = FString::Printf(TEXT("Argument %d has a minimum value greater than its maximum"), cycle_arg);
+			return false;
+		}
+
+		if (arg.type_ == ETwitchCommandArgType::Enum)
+		{
+			if (arg_spec.enum_values_.Num() == 0)
+			{
+				_out_error = FString::Printf(TEXT("Argument %d is an enum without values"), cycle_arg);
+				return false;
+			}
+
+			arg.first_enum_value_ = enum_values_.Num();
+			arg.num_enum_values_ = arg_spec.enum_values_.Num();
+			for (const FString& enum_value : arg_spec.enum_values_)
+			{
+				// Tokens are trimmed and split on ',', such values could never match
+				const FString trimmed_value = enum_value.TrimStartAndEnd();
+				if (trimmed_value.IsEmpty() || trimmed_value.Contains(TEXT(",")))
+				{
+					_out_error = FString::Printf(TEXT("Argument %d has an empty enum value, or one containing ','"), cycle_arg);
+					return false;
+				}
+
+				enum_values_.Emplace(enum_chars_.Num(), trimmed_value.Len());
+				for (int32 cycle_char = 0; cycle_char < trimmed_value.Len(); ++cycle_char)
+				{
+					enum_chars_.Add(FChar::ToLower(trimmed_value[cycle_char]));
+				}
+			}
+		}
+		args_.Add(arg);
+	}
+
+	num_required_args_ = args_.Num() - _schema.num_optional_args_;
+	return true;
+}
+
+bool FTwitchCommandSchemaParser::Parse(const TCHAR* _options, int32 _length, FTwitchCommandArgs& _out_args) const
+{
+	_out_args = FTwitchCommandArgs();
+
+	// "#  #" has no arguments, like no options at all
+	int32 start = 0;
+	const int32 end = _length;
+	while (start < end && FChar::IsWhitespace(_options[start]))
+	{
+		++start;
+	}
+
+	int32 num_args = 0;
+	while (start < end)
+	{
+		int32 token_end = start;
+		while (token_end < end && _options[token_end] != ',')
+		{
+			++token_end;
+		}
+
+		if (num_args == args_.Num())
+		{
+			return false; // More arguments than the schema has
+		}
+
+		// Spaces around the token are ignored
+		int32 token_start = start;
+		int32 token_last = token_end;
+		while (token_start < token_last && FChar::IsWhitespace(_options[token_start]))
+		{
+			++token_start;
+		}
+		while (token_last > token_start && FChar::IsWhitespace(_options[token_last - 1]))
+		{
+			--token_last;
+		}
+
+		if (!ParseArg(args_[num_args], _options + token_start, token_last - token_start, _out_args.int_values_[num_args], _out_args.float_values_[num_args]))
+		{
+			return false;
+		}
+		++num_args;
+
+		// A trailing ',' announces an argument that never comes
+		if (token_end == end - 1)
+		{
+			return false;
+		}
+		start = token_end + 1;
+	}
+
+	_out_args.num_args_ = num_args;
+	return num_args >= num_required_args_;
+}
+
+bool FTwitchCommandSchemaParser::ParseArg(const FCompiledArg& _arg, const TCHAR* _token, int32 _length, int32& _out_int, float& _out_float) const
+{
+	switch (_arg.type_)
+	{
+	case ETwitchCommandArgType::Int:
+	case ETwitchCommandArgType::Float:
+	{
+		double value;
+		if (!ParseNumber(_token, _length, _arg.type_ == ETwitchCommandArgType::Float, value))
+		{
+			return false;
+		}
+		if (_arg.b_check_range_ && (value < _arg.min_value_ || value > _arg.max_value_))
+		{
+			return false;
+		}
+		if (value < MIN_int32 || value > MAX_int32)
+		{
+			return false;
+		}
+		_out_int = static_cast<int32>(value);
+		_out_float = static_cast<float>(value);
+		return true;
+	}
+
+	case ETwitchCommandArgType::Enum:
+		for (int32 cycle_value = 0; cycle_value < _arg.num_enum_values_; ++cycle_value)
+		{
+			const TPair<int32, int32>& enum_value = enum_values_[_arg.first_enum_value_ + cycle_value];
+			if (EqualsLowerCase(_token, _length, enum_chars_.GetData() + enum_value.Key, enum_value.Value))
+			{
+				_out_int = cycle_value;
+				_out_float = static_cast<float>(cycle_value);
+				return true;
+			}
+		}
+		return false;
+
+	case ETwitchCommandArgType::Direction:
+		for (const FDirectionName& direction_name : DirectionNames)
+		{
+			if (EqualsLowerCase(_token, _length, direction_name.name_, direction_name.length_))
+			{
+				_out_int = static_cast<int32>(direction_name.direction_);
+				_out_float = static_cast<float>(_out_int);
+				return true;
+			}
+		}
+		return false;
+	}
+	return false;
+}
+
+bool FTwitchCommandSchemaParser::FindDelimited(const TCHAR* _text, int32 _length, const TCHAR* _delimiter, int32 _delimiter_length, int32& _out_start, int32& _out_length)
+{
+	if (_delimiter_length <= 0)
+	{
+		return false;
+	}
+
+	auto find_delimiter = [_text, _length, _delimiter, _delimiter_length](int32 _start_index)
+	{
+		for (int32 cycle_index = _start_index; cycle_index + _delimiter_length <= _length; ++cycle_index)
+		{
+			if (FMemory::Memcmp(_text + cycle_index, _delimiter, _delimiter_length * sizeof(TCHAR)) == 0)
+			{
+				return cycle_index;
+			}
+		}
+		return static_cast<int32>(INDEX_NONE);
+	};
+
+	const int32 open_index = find_delimiter(0);
+	if (open_index == INDEX_NONE)
+	{
+		return false;
+	}
+	const int32 close_index = find_delimiter(open_index + _delimiter_length);
+	if (close_index == INDEX_NONE)
+	{
+		return false;
+	}
+
+	_out_start = open_index + _delimiter_length;
+	_out_length = close_index - _out_start;
+	return true;
+}
@@ -0,0 +1,156 @@
+// Copyright (C) Simone Di Gravio <email: altairjp@gmail.com> - All Rights Reserved
+
+#include "Commands/TwitchCommandTable.h"
+
+void FTwitchCommandTable::Build(const TArray<FString>& _commands)
+{
+	nodes_.Reset();
+	edges_.Reset();
+	command_names_ = _commands;
+
+	// Sorting the commands (by character value) makes commands sharing a prefix contiguous,
+	// and the children of every node end up sorted by character
+	TArray<int32> sorted_commands;
+	sorted_commands.Reserve(command_names_.Num());
+	for (int32 cycle_command = 0; cycle_command < command_names_.Num(); cycle_command++)
+	{
+		if (!command_names_[cycle_command].IsEmpty())
+		{
+			sorted_commands.Add(cycle_command);
+		}
+	}
+	sorted_commands.Sort([this](int32 _a, int32 _b)
+	{
+		return command_names_[_a].Compare(command_names_[_b], ESearchCase::CaseSensitive) < 0;
+	});
+
+	// Root node. The empty command is never registered
+	FNode root;
+	root.first_edge_ = 0;
+	root.num_edges_ = 0;
+	root.command_index_ = INDEX_NONE;
+	nodes_.Add(root);
+
+	BuildNode(0, sorted_commands, 0, sorted_commands.Num(), 0);
+}
+
+void FTwitchCommandTable::BuildNode(int32 _node_index, const TArray<int32>& _sorted_commands, int32 _first, int32 _last, int32 _depth)
+{
+	// Sorted commands that end at this depth come first
+	int32 cycle_command = _first;
+	while (cycle_command < _last && command_names_[_sorted_commands[cycle_command]].Len() == _depth)
+	{
+		// Duplicated names keep the first registration
+		if (nodes_[_node_index].command_index_ == INDEX_NONE)
+		{
+			nodes_[_node_index].command_index_ = _sorted_commands[cycle_command];
+		}
+		cycle_command++;
+	}
+
+	// The remaining commands are grouped by their next character, one child per group
+	TArray<int32, TInlineAllocator<32>> group_starts;
+	for (int32 cycle_group = cycle_command; cycle_group < _last; cycle_group++)
+	{
+		if (cycle_group == cycle_command
+			|| command_names_[_sorted_commands[cycle_group]][_depth] != command_names_[_sorted_commands[cycle_group - 1]][_depth])
+		{
+			group_starts.Add(cycle_group);
+		}
+	}
+
+	// Edges of a node must be contiguous, so they are all added before recursing
+	const int32 first_edge = edges_.Num();
+	nodes_[_node_index].first_edge_ = first_edge;
+	nodes_[_node_index].num_edges_ = group_starts.Num();
+	edges_.AddUninitialized(group_starts.Num());
+
+	for (int32 cycle_group = 0; cycle_group < group_starts.Num(); cycle_group++)
+	{
+		FNode child;
+		child.first_edge_ = 0;
+		child.num_edges_ = 0;
+		child.command_index_ = INDEX_NONE;
+
+		FEdge& edge = edges_[first_edge + cycle_group];
+		edge.char_ = command_names_[_sorted_commands[group_starts[cycle_group]]][_depth];
+		edge.child_node_ = nodes_.Add(child);
+	}
+
+	for (int32 cycle_group = 0; cycle_group < group_starts.Num(); cycle_group++)
+	{
+		const int32 group_end = cycle_group + 1 < group_starts.Num() ? group_starts[cycle_group + 1] : _last;
+		BuildNode(edges_[first_edge + cycle_group].child_node_, _sorted_commands, group_starts[cycle_group], group_end, _depth + 1);
+	}
+}
+
+int32 FTwitchCommandTable::FindChild(int32 _node_index, TCHAR _char) const
+{
+	const FNode& node = nodes_[_node_index];
+
+	// Edges are sorted by character
+	int32 low = node.first_edge_;
+	int32 high = node.first_edge_ + node.num_edges_;
+	while (low < high)
+	{
+		const int32 middle = (low + high) / 2;
+		const TCHAR middle_char = edges_[middle].char_;
+		if (middle_char == _char)
+		{
+			return edges_[middle].child_node_;
+		}
+		if (middle_char < _char)
+		{
+			low = middle + 1;
+		}
+		else
+		{
+			high = middle;
+		}
+	}
+	return INDEX_NONE;
+}
+
+int32 FTwitchCommandTable::Match(const TCHAR* _message, int32 _message_length, const TCHAR* _delimiter, int32 _delimiter_length, int32& _out_end_index) const
+{
+	if (nodes_.Num() == 0 || nodes_[0].num_edges_ == 0 || _delimiter_length <= 0)
+	{
+		return INDEX_NONE;
+	}
+
+	const TCHAR delimiter_first = _delimiter[0];
+	auto is_delimiter_at = [&](int32 _index)
+	{
+		return _message[_index] == delimiter_first
+			&& _index + _delimiter_length <= _message_length
+			&& FMemory::Memcmp(_message + _index + 1, _delimiter + 1, (_delimiter_length - 1) * sizeof(TCHAR)) == 0;
+	};
+
+	// Only the first delimiter opens a command
+	int32 cursor = 0;
+	while (cursor < _message_length && !is_delimiter_at(cursor))
+	{
+		cursor++;
+	}
+	cursor += _delimiter_length;
+
+	// Walk the trie until the closing delimiter. Any character no registered command continues with rejects the message
+	int32 node_index = 0;
+	for (; cursor < _message_length; cursor++)
+	{
+		if (is_delimiter_at(cursor))
+		{
+			_out_end_index = cursor + _delimiter_length;
+			return nodes_[node_index].command_index_;
+		}
+
+		node_index = FindChild(node_index, _message[cursor]);
+		if (node_index == INDEX_NONE)
+		{
+			return INDEX_NONE;
+		}
+	}
+
+	// No closing delimiter
+	return INDEX_NONE;
+}
@@ -0,0 +1,238 @@
+// Copyright (C) Simone Di Gravio <email: altairjp@gmail.com> - All Rights Reserved
+
+#include "Commands/TwitchKeywordMatcher.h"
+
+FTwitchKeywordMatcher::FTwitchKeywordMatcher()
+{
+	FMemory::Memzero(ascii_classes_);
+}
+
+void FTwitchKeywordMatcher::Build(const TArray<FString>& _keywords, bool _b_case_sensitive, bool _b_whole_words)
+{
+	keywords_ = _keywords;
+	b_case_sensitive_ = _b_case_sensitive;
+	b_whole_words_ = _b_whole_words;
+	nodes_.Reset();
+	edges_.Reset();
+	root_next_.Reset();
+	other_classes_.Reset();
+	FMemory::Memzero(ascii_classes_);
+
+	// Every character of the keywords gets a class. Class 0 is left for all the others
+	int32 num_classes = 1;
+	auto add_char_class = [this, &num_classes](TCHAR _char)
+	{
+		int32 char_class = GetCharClass(_char);
+		if (char_class == 0)
+		{
+			char_class = num_classes++;
+			if (static_cast<uint32>(_char) < 128)
+			{
+				ascii_classes_[_char] = char_class;
+				if (!b_case_sensitive_)
+				{
+					ascii_classes_[FChar::ToUpper(_char)] = char_class;
+				}
+			}
+			else
+			{
+				other_classes_.Add(_char, char_class);
+			}
+		}
+		return char_class;
+	};
+
+	// Trie of the keywords. Children are gathered per node first, since the edges of a node must end up contiguous
+	TArray<TArray<FEdge>> children;
+	nodes_.AddDefaulted();
+	children.AddDefaulted();
+
+	for (int32 cycle_keyword = 0; cycle_keyword < keywords_.Num(); ++cycle_keyword)
+	{
+		const FString& keyword = keywords_[cycle_keyword];
+		if (keyword.IsEmpty())
+		{
+			continue;
+		}
+
+		int32 node_index = 0;
+		for (int32 cycle_char = 0; cycle_char < keyword.Len(); ++cycle_char)
+		{
+			const TCHAR keyword_char = b_case_sensitive_ ? keyword[cycle_char] : FChar::ToLower(keyword[cycle_char]);
+			const int32 char_class = add_char_class(keyword_char);
+
+			const FEdge* edge = children[node_index].FindByPredicate([char_class](const FEdge& _edge) { return _edge.char_class_ == char_class; });
+			if (edge != nullptr)
+			{
+				node_index = edge->child_node_;
+				continue;
+			}
+
+			FNode child;
+			child.depth_ = cycle_char + 1;
+			const int32 child_index = nodes_.Add(child);
+			children.AddDefaulted();
+			children[node_index].Add(FEdge{ char_class, child_index });
+			node_index = child_index;
+		}
+
+		// Duplicated keywords keep the first index
+		if (nodes_[node_index].keyword_index_ == INDEX_NONE)
+		{
+			nodes_[node_index].keyword_index_ = cycle_keyword;
+		}
+	}
+
+	// Flat edges, sorted by class for the binary search
+	for (int32 cycle_node = 0; cycle_node < nodes_.Num(); ++cycle_node)
+	{
+		TArray<FEdge>& node_children = children[cycle_node];
+		node_children.Sort([](const FEdge& _a, const FEdge& _b) { return _a.char_class_ < _b.char_class_; });
+		nodes_[cycle_node].first_edge_ = edges_.Num();
+		nodes_[cycle_node].num_edges_ = node_children.Num();
+		edges_.Append(node_children);
+	}
+
+	root_next_.SetNumZeroed(num_classes);
+	for (const FEdge& edge : children[0])
+	{
+		root_next_[edge.char_class_] = edge.child_node_;
+	}
+
+	// Failure and output links, breadth first so the links of shallower nodes are always ready
+	TArray<int32> queue;
+	queue.Reserve(nodes_.Num());
+	for (const FEdge& edge : children[0])
+	{
+		queue.Add(edge.child_node_);
+	}
+
+	for (int32 cycle_queue = 0; cycle_queue < queue.Num(); ++cycle_queue)
+	{
+		const int32 node_index = queue[cycle_queue];
+		const FNode& node = nodes_[node_index];
+
+		for (int32 cycle_edge = node.first_edge_; cycle_edge < node.first_edge_ + node.num_edges_; ++cycle_edge)
+		{
+			const FEdge& edge = edges_[cycle_edge];
+
+			// The longest suffix that can be extended with the same character
+			int32 fail_index = node.fail_;
+			int32 fail_child = INDEX_NONE;
+			while (fail_index != 0 && (fail_child = FindChild(fail_index, edge.char_class_)) == INDEX_NONE)
+			{
+				fail_index = nodes_[fail_index].fail_;
+			}
+			if (fail_index == 0)
+			{
+				fail_child = root_next_[edge.char_class_];
+			}
+
+			FNode& child = nodes_[edge.child_node_];
+			child.fail_ = fail_child;
+			child.output_link_ = nodes_[fail_child].keyword_index_ != INDEX_NONE ? fail_child : nodes_[fail_child].output_link_;
+			queue.Add(edge.child_node_);
+		}
+	}
+}
+
+int32 FTwitchKeywordMatcher::Scan(const TCHAR* _text, int32 _length, TArray<FTwitchKeywordHit>& _out_hits) const
+{
+	if (IsEmpty())
+	{
+		return 0;
+	}
+
+	const int32 first_hit = _out_hits.Num();
+	int32 node_index = 0;
+	for (int32 cycle_char = 0; cycle_char < _length; ++cycle_char)
+	{
+		const int32 char_class = GetCharClass(_text[cycle_char]);
+
+		// Most characters are read at the root and start no keyword
+		if (node_index == 0)
+		{
+			node_index = root_next_[char_class];
+			if (node_index == 0)
+			{
+				continue;
+			}
+		}
+		// No keyword contains the character, so no keyword can be matching across it
+		else if (char_class == 0)
+		{
+			node_index = 0;
+			continue;
+		}
+		else
+		{
+			int32 child_index;
+			while ((child_index = FindChild(node_index, char_class)) == INDEX_NONE && node_index != 0)
+			{
+				node_index = nodes_[node_index].fail_;
+			}
+			node_index = child_index != INDEX_NONE ? child_index : root_next_[char_class];
+		}
+
+		// Keywords ending here: the one of the node, then the ones of its suffixes
+		const int32 first_output = nodes_[node_index].keyword_index_ != INDEX_NONE ? node_index : nodes_[node_index].output_link_;
+		for (int32 output_index = first_output; output_index != INDEX_NONE; output_index = nodes_[output_index].output_link_)
+		{
+			const FNode& output = nodes_[output_index];
+			const int32 start = cycle_char + 1 - output.depth_;
+			if (b_whole_words_ && !IsWholeWord(_text, _length, start, cycle_char + 1))
+			{
+				continue;
+			}
+
+			FTwitchKeywordHit hit;
+			hit.keyword_index_ = output.keyword_index_;
+			hit.start_ = start;
+			hit.length_ = output.depth_;
+			_out_hits.Add(hit);
+		}
+	}
+	return _out_hits.Num() - first_hit;
+}
+
+int32 FTwitchKeywordMatcher::GetCharClass(TCHAR _char) const
+{
+	if (static_cast<uint32>(_char) < 128)
+	{
+		return ascii_classes_[_char];
+	}
+
+	const int32* char_class = other_classes_.Find(b_case_sensitive_ ? _char : FChar::ToLower(_char));
+	return char_class != nullptr ? *char_class : 0;
+}
+
+int32 FTwitchKeywordMatcher::FindChild(int32 _node_index, int32 _char_class) const
+{
+	const FNode& node = nodes_[_node_index];
+
+	int32 low = node.first_edge_;
+	int32 high = node.first_edge_ + node.num_edges_;
+	while (low < high)
+	{
+		const int32 middle = (low + high) / 2;
+		const int32 middle_class = edges_[middle].char_class_;
+		if (middle_class == _char_class)
+		{
+			return edges_[middle].child_node_;
+		}
+		if (middle_class < _char_class)
+		{
+			low = middle + 1;
+		}
+		else
+		{
+			high = middle;
+		}
+	}
+	return INDEX_NONE;
+}
+
+bool FTwitchKeywordMatcher::IsWholeWord(const TCHAR* _text, int32 _length, int32 _start, int32 _end)
+{
+	return (_start == 0 || !FChar::IsAlnum(_text[_start - 1])) && (_end == _length || !FChar::IsAlnum(_text[_end]));
+}
@@ -0,0 +1,240 @@
+// Copyright (C) Simone Di Gravio <email: altairjp@gmail.com> - All Rights Reserved
+
+#include "Commands/TwitchTrendTracker.h"
+#include "Net/TwitchIRCHash.h"
+#include "Hash/CityHash.h"
+
+FTwitchTrendTracker::FTwitchTrendTracker(int32 _max_entries, int32 _sketch_width, int32 _num_slices)
+	: width_mask_(FMath::RoundUpToPowerOfTwo(FMath::Max(_sketch_width, 64)) - 1)
+	, num_slices_(FMath::Max(_num_slices, 1))
+	, max_entries_(FMath::Max(_max_entries, 1))
+{
+	// The sketches are only allocated when the first key is counted
+}
+
+void FTwitchTrendTracker::SetWindow(float _window_seconds)
+{
+	const double slice_seconds = FMath::Max(_window_seconds, 1.0f) / num_slices_;
+	if (slice_seconds != slice_seconds_)
+	{
+		slice_seconds_ = slice_seconds;
+		Reset();
+	}
+}
+
+void FTwitchTrendTracker::Add(uint64 _key, double _now, TFunctionRef<FString()> _make_name)
+{
+	if (counters_.Num() == 0)
+	{
+		counters_.SetNumZeroed((num_slices_ + 1) * NumRows * (width_mask_ + 1));
+		top_entries_.Reserve(max_entries_);
+	}
+	Advance(_now);
+
+	const uint32 count = Increment(_key);
+
+	for (int32 cycle_entry = 0; cycle_entry < top_entries_.Num(); ++cycle_entry)
+	{
+		if (top_entries_[cycle_entry].key_ == _key)
+		{
+			top_entries_[cycle_entry].count_ = count;
+			if (cycle_entry == min_entry_)
+			{
+				UpdateMinEntry();
+			}
+			return;
+		}
+	}
+
+	if (top_entries_.Num() < max_entries_)
+	{
+		FTopEntry entry;
+		entry.key_ = _key;
+		entry.count_ = count;
+		entry.name_ = _make_name();
+		top_entries_.Add(MoveTemp(entry));
+		if (min_entry_ == INDEX_NONE || count < top_entries_[min_entry_].count_)
+		{
+			min_entry_ = top_entries_.Num() - 1;
+		}
+		return;
+	}
+
+	// Counts of the entries are only updated when their key is seen, and only grow until the window slides:
+	// the lowest one is refreshed before being replaced, so a key is never evicted by one seen less
+	while (count > top_entries_[min_entry_].count_)
+	{
+		FTopEntry& min_entry = top_entries_[min_entry_];
+		const uint32 min_count = Estimate(min_entry.key_);
+		if (min_count == min_entry.count_)
+		{
+			min_entry.key_ = _key;
+			min_entry.count_ = count;
+			min_entry.name_ = _make_name();
+			UpdateMinEntry();
+			return;
+		}
+		min_entry.count_ = min_count;
+		UpdateMinEntry();
+	}
+}
+
+void FTwitchTrendTracker::GetTop(double _now, int32 _max_entries, TArray<FTwitchTrendEntry>& _out_entries)
+{
+	Advance(_now);
+
+	TArray<int32, TInlineAllocator<64>> sorted_entries;
+	for (int32 cycle_entry = 0; cycle_entry < top_entries_.Num(); ++cycle_entry)
+	{
+		sorted_entries.Add(cycle_entry);
+	}
+	sorted_entries.Sort([this](int32 _a, int32 _b) { return top_entries_[_a].count_ > top_entries_[_b].count_; });
+
+	const int32 num_entries = FMath::Clamp(_max_entries, 0, sorted_entries.Num());
+	_out_entries.Reset(num_entries);
+	for (int32 cycle_entry = 0; cycle_entry < num_entries; ++cycle_entry)
+	{
+		const FTopEntry& top_entry = top_entries_[sorted_entries[cycle_entry]];
+
+		FTwitchTrendEntry entry;
+		entry.name_ = top_entry.name_;
+		entry.count_ = static_cast<int32>(FMath::Min<uint32>(top_entry.count_, MAX_int32));
+		_out_entries.Add(entry);
+	}
+}
+
+int32 FTwitchTrendTracker::GetCount(uint64 _key, double _now)
+{
+	Advance(_now);
+	return static_cast<int32>(FMath::Min<uint32>(Estimate(_key), MAX_int32));
+}
+
+void FTwitchTrendTracker::Reset()
+{
+	FMemory::Memzero(counters_.GetData(), counters_.Num() * sizeof(uint32));
+	top_entries_.Reset();
+	min_entry_ = INDEX_NONE;
+	current_slice_ = 0;
+	slice_end_time_ = -1.0;
+}
+
+uint64 FTwitchTrendTracker::HashName(const TCHAR* _name, int32 _length)
+{
+	return CityHash64(reinterpret_cast<const char*>(_name), _length * sizeof(TCHAR));
+}
+
+void FTwitchTrendTracker::Advance(double _now)
+{
+	if (counters_.Num() == 0)
+	{
+		return;
+	}
+	if (slice_end_time_ < 0.0)
+	{
+		slice_end_time_ = _now + slice_seconds_;
+		return;
+	}
+
+	const int32 slice_size = NumRows * (width_mask_ + 1);
+	uint32* const window_counters = counters_.GetData() + num_slices_ * slice_size;
+
+	// The oldest slice leaves the window and becomes the current one. After a whole window without keys everything is gone
+	int32 num_expired_slices = 0;
+	while (_now >= slice_end_time_ && num_expired_slices < num_slices_)
+	{
+		current_slice_ = (current_slice_ + 1) % num_slices_;
+		uint32* const slice_counters = counters_.GetData() + current_slice_ * slice_size;
+		for (int32 cycle_counter = 0; cycle_counter < slice_size; ++cycle_counter)
+		{
+			window_counters[cycle_counter] -= slice_counters[cycle_counter];
+		}
+		FMemory::Memzero(slice_counters, slice_size * sizeof(uint32));
+
+		slice_end_time_ += slice_seconds_;
+		++num_expired_slices;
+	}
+	if (_now >= slice_end_time_)
+	{
+		slice_end_time_ = _now + slice_seconds_;
+	}
+
+	if (num_expired_slices == 0)
+	{
+		return;
+	}
+
+	// Counts went down: the entries are refreshed, and the ones not seen in the window anymore are dropped
+	for (int32 cycle_entry = top_entries_.Num() - 1; cycle_entry >= 0; --cycle_entry)
+	{
+		top_entries_[cycle_entry].count_ = Estimate(top_entries_[cycle_entry].key_);
+		if (top_entries_[cycle_entry].count_ == 0)
+		{
+			top_entries_.RemoveAtSwap(cycle_entry, 1, false);
+		}
+	}
+	UpdateMinEntry();
+}
+
+uint32 FTwitchTrendTracker::Increment(uint64 _key)
+{
+	uint32 indices[NumRows];
+	GetCounterIndices(_key, indices);
+
+	const int32 row_size = width_mask_ + 1;
+	uint32* const slice_counters = counters_.GetData() + current_slice_ * NumRows * row_size;
+	uint32* const window_counters = counters_.GetData() + num_slices_ * NumRows * row_size;
+
+	uint32 count = MAX_uint32;
+	for (int32 cycle_row = 0; cycle_row < NumRows; ++cycle_row)
+	{
+		const int32 counter_index = cycle_row * row_size + indices[cycle_row];
+		++slice_counters[counter_index];
+		count = FMath::Min(count, ++window_counters[counter_index]);
+	}
+	return count;
+}
+
+uint32 FTwitchTrendTracker::Estimate(uint64 _key) const
+{
+	if (counters_.Num() == 0)
+	{
+		return 0;
+	}
+
+	uint32 indices[NumRows];
+	GetCounterIndices(_key, indices);
+
+	const int32 row_size = width_mask_ + 1;
+	const uint32* const window_counters = counters_.GetData() + num_slices_ * NumRows * row_size;
+
+	uint32 count = MAX_uint32;
+	for (int32 cycle_row = 0; cycle_row < NumRows; ++cycle_row)
+	{
+		count = FMath::Min(count, window_counters[cycle_row * row_size + indices[cycle_row]]);
+	}
+	return count;
+}
+
+void FTwitchTrendTracker::GetCounterIndices(uint64 _key, uint32 (&_out_indices)[NumRows]) const
+{
+	// Rows use h1 + row * h2, two halves of the same mixed hash
+	const uint64 hash = TwitchIRCHash::MixBits(_key);
+	const uint32 hash_low = static_cast<uint32>(hash);
+	const uint32 hash_high = static_cast<uint32>(hash >> 32) | 1;
+	for (int32 cycle_row = 0; cycle_row < NumRows; ++cycle_row)
+	{
+		_out_indices[cycle_row] = (hash_low + cycle_row * hash_high) & width_mask_;
+	}
+}
+
+void FTwitchTrendTracker::UpdateMinEntry()
+{
+	min_entry_ = INDEX_NONE;
+	for (int32 cycle_entry = 0; cycle_entry < top_entries_.Num(); ++cycle_entry)
+	{
+		if (min_entry_ == INDEX_NONE || top_entries_[cycle_entry].count_ < top_entries_[min_entry_].count_)
+		{
+			min_entry_ = cycle_entry;
+		}
+	}
+}
@@ -0,0 +1,156 @@
+// Copyright (C) Simone Di Gravio <email: altairjp@gmail.com> - All Rights Reserved
+
+#include "Commands/TwitchUserThrottle.h"
+#include "Net/TwitchIRCHash.h"
+#include "Hash/CityHash.h"
+
+namespace
+{
+	// Slots looked at before evicting. Keeps the worst case lookup bounded when the table is saturated by a raid
+	const int32 MaxProbes = 32;
+
+	// Command index of the duplicate suppression entry of a user
+	const int32 DuplicateEntry = -2;
+
+	uint64 MakeEntryKey(uint64 _user_key, int32 _command_index)
+	{
+		const uint64 key = TwitchIRCHash::MixBits(_user_key ^ (static_cast<uint64>(_command_index + 3) * 0x9e3779b97f4a7c15ull));
+		return key != 0 ? key : 1;
+	}
+}
+
+FTwitchUserThrottle::FTwitchUserThrottle(int32 _capacity)
+{
+	if (_capacity > 0)
+	{
+		SetCapacity(_capacity);
+	}
+}
+
+void FTwitchUserThrottle::SetCapacity(int32 _capacity)
+{
+	const int32 capacity = FMath::RoundUpToPowerOfTwo(FMath::Max(_capacity, MaxProbes));
+	if (capacity != entries_.Num())
+	{
+		entries_.Reset();
+		entries_.SetNum(capacity);
+	}
+}
+
+void FTwitchUserThrottle::SetRules(float _commands_per_window, float _window_seconds, float _duplicate_window_seconds)
+{
+	commands_per_window_ = FMath::Max(_commands_per_window, 0.0f);
+	const float window_seconds = FMath::Max(_window_seconds, 0.001f);
+	tokens_per_second_ = commands_per_window_ / window_seconds;
+	duplicate_window_ms_ = static_cast<uint32>(FMath::Max(_duplicate_window_seconds, 0.0f) * 1000.0f);
+
+	// An entry idle this long has a full bucket and no duplicate to suppress: dropping it loses nothing
+	entry_lifetime_ms_ = FMath::Max(static_cast<uint32>(window_seconds * 1000.0f), duplicate_window_ms_);
+}
+
+bool FTwitchUserThrottle::AllowCommand(uint64 _user_key, int32 _command_index, uint32 _message_hash, double _now)
+{
+	check(entries_.Num() > 0);
+
+	if (epoch_ < 0.0)
+	{
+		epoch_ = _now;
+	}
+	const uint32 now_ms = static_cast<uint32>((_now - epoch_) * 1000.0);
+
+	// The same message again from the same user. Spamming it keeps it suppressed
+	if (duplicate_window_ms_ > 0)
+	{
+		bool b_is_new;
+		FEntry& entry = FindOrClaim(MakeEntryKey(_user_key, DuplicateEntry), now_ms, b_is_new);
+		const bool b_is_duplicate = !b_is_new && entry.message_hash_ == _message_hash && now_ms - entry.last_used_ms_ < duplicate_window_ms_;
+		entry.message_hash_ = _message_hash;
+		entry.last_used_ms_ = now_ms;
+		if (b_is_duplicate)
+		{
+			return false;
+		}
+	}
+
+	// Token bucket per user and command, starting full
+	if (commands_per_window_ > 0.0f)
+	{
+		bool b_is_new;
+		FEntry& entry = FindOrClaim(MakeEntryKey(_user_key, _command_index), now_ms, b_is_new);
+		if (b_is_new)
+		{
+			entry.tokens_ = commands_per_window_;
+		}
+		else
+		{
+			entry.tokens_ = FMath::Min(commands_per_window_, entry.tokens_ + (now_ms - entry.last_used_ms_) * 0.001f * tokens_per_second_);
+		}
+		entry.last_used_ms_ = now_ms;
+
+		if (entry.tokens_ < 1.0f)
+		{
+			return false;
+		}
+		entry.tokens_ -= 1.0f;
+	}
+	return true;
+}
+
+void FTwitchUserThrottle::Reset()
+{
+	for (FEntry& entry : entries_)
+	{
+		entry = FEntry();
+	}
+	epoch_ = -1.0;
+}
+
+uint64 FTwitchUserThrottle::HashUser(const FString& _username)
+{
+	return CityHash64(reinterpret_cast<const char*>(*_username), _username.Len() * sizeof(TCHAR));
+}
+
+FTwitchUserThrottle::FEntry& FTwitchUserThrottle::FindOrClaim(uint64 _key, uint32 _now_ms, bool& _out_b_is_new)
+{
+	const uint32 mask = static_cast<uint32>(entries_.Num() - 1);
+	uint32 index = static_cast<uint32>(_key) & mask;
+
+	// Linear probing. Slots are never emptied, only reused, so a never used slot ends the sequence
+	int32 reusable_index = INDEX_NONE;
+	int32 oldest_index = INDEX_NONE;
+	for (int32 cycle_probe = 0; cycle_probe < MaxProbes; ++cycle_probe, index = (index + 1) & mask)
+	{
+		FEntry& entry = entries_[index];
+		const bool b_is_expired = _now_ms - entry.last_used_ms_ > entry_lifetime_ms_;
+
+		if (entry.key_ == _key)
+		{
+			_out_b_is_new = b_is_expired;
+			return entry;
+		}
+		if (entry.key_ == 0)
+		{
+			if (reusable_index == INDEX_NONE)
+			{
+				reusable_index = index;
+			}
+			break;
+		}
+		if (b_is_expired && reusable_index == INDEX_NONE)
+		{
+			reusable_index = index;
+		}
+		if (oldest_index == INDEX_NONE || entry.last_used_ms_ < entries_[oldest_index].last_used_ms_)
+		{
+			oldest_index = index;
+		}
+	}
+
+	// The whole probe sequence is in use: the least recently used entry goes
+	FEntry& entry = entries_[reusable_index != INDEX_NONE ? reusable_index : oldest_index];
+	entry = FEntry();
+	entry.key_ = _key;
+	entry.last_used_ms_ = _now_ms;
+	_out_b_is_new = true;
+	return entry;
+}
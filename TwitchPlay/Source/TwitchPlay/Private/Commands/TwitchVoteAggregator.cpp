@@ -0,0 +1,167 @@
+// Copyright (C) Simone Di Gravio <email: altairjp@gmail.com> - All Rights Reserved
+
+#include "Commands/TwitchVoteAggregator.h"
+
+FTwitchVoteAggregator::FTwitchVoteAggregator(int32 _max_tallies)
+	: max_tallies_(FMath::Max(_max_tallies, 1))
+{
+	// Keep the table at most half full so probe sequences stay short
+	slots_.SetNum(FMath::RoundUpToPowerOfTwo(max_tallies_ * 2));
+	used_slots_.Reserve(max_tallies_);
+}
+
+void FTwitchVoteAggregator::SetRules(ETwitchVotePolicy _policy, ETwitchVoteUserRule _user_rule)
+{
+	policy_ = _policy;
+	user_rule_ = _user_rule;
+}
+
+void FTwitchVoteAggregator::Vote(int32 _command_index, const TCHAR* _options, int32 _options_length, uint32 _user_key)
+{
+	// Users that already voted in this window
+	int32* previous_slot = nullptr;
+	if (user_rule_ != ETwitchVoteUserRule::MultipleVotes)
+	{
+		previous_slot = user_votes_.Find(_user_key);
+		if (previous_slot != nullptr && user_rule_ == ETwitchVoteUserRule::FirstVoteOnly)
+		{
+			ignored_votes_++;
+			return;
+		}
+	}
+
+	const int32 slot_index = FindOrAddSlot(_command_index, _options, FMath::Max(_options_length, 0));
+	if (slot_index == INDEX_NONE)
+	{
+		ignored_votes_++;
+		return;
+	}
+
+	// Moves the vote of the user, the total does not change
+	if (previous_slot != nullptr)
+	{
+		slots_[*previous_slot].votes_--;
+		*previous_slot = slot_index;
+	}
+	else
+	{
+		if (user_rule_ != ETwitchVoteUserRule::MultipleVotes)
+		{
+			user_votes_.Add(_user_key, slot_index);
+		}
+		total_votes_++;
+	}
+
+	slots_[slot_index].votes_++;
+	latest_slot_ = slot_index;
+}
+
+void FTwitchVoteAggregator::CloseWindow(TFunctionRef<const FString&(int32)> _command_names, float _window_duration, FTwitchVoteWindowResult& _out_result)
+{
+	_out_result = FTwitchVoteWindowResult();
+	_out_result.total_votes_ = total_votes_;
+	_out_result.ignored_votes_ = ignored_votes_;
+	_out_result.window_duration_ = _window_duration;
+
+	// Democracy: most votes, ties go to the earliest voted. Anarchy: latest vote
+	int32 winner_slot = INDEX_NONE;
+	if (policy_ == ETwitchVotePolicy::Anarchy)
+	{
+		winner_slot = latest_slot_;
+	}
+	else
+	{
+		for (const int32 slot_index : used_slots_)
+		{
+			const FTallySlot& slot = slots_[slot_index];
+			if (slot.votes_ > 0 && (winner_slot == INDEX_NONE || slot.votes_ > slots_[winner_slot].votes_))
+			{
+				winner_slot = slot_index;
+			}
+		}
+	}
+
+	// Most voted first. Slots emptied by users changing their vote are not reported
+	TArray<int32, TInlineAllocator<64>> reported_slots;
+	for (const int32 slot_index : used_slots_)
+	{
+		if (slots_[slot_index].votes_ > 0)
+		{
+			reported_slots.Add(slot_index);
+		}
+	}
+	reported_slots.StableSort([this](int32 _a, int32 _b)
+	{
+		return slots_[_a].votes_ > slots_[_b].votes_;
+	});
+
+	_out_result.tallies_.Reserve(reported_slots.Num());
+	for (const int32 slot_index : reported_slots)
+	{
+		const FTallySlot& slot = slots_[slot_index];
+		if (slot_index == winner_slot)
+		{
+			_out_result.winner_index_ = _out_result.tallies_.Num();
+		}
+
+		FTwitchVoteTally& tally = _out_result.tallies_[_out_result.tallies_.AddDefaulted()];
+		tally.command_ = _command_names(slot.command_index_);
+		tally.options_ = slot.options_;
+		tally.votes_ = slot.votes_;
+	}
+
+	ResetWindow();
+}
+
+void FTwitchVoteAggregator::ResetWindow()
+{
+	for (const int32 slot_index : used_slots_)
+	{
+		FTallySlot& slot = slots_[slot_index];
+		slot.command_index_ = INDEX_NONE;
+		slot.options_.Reset(); // Keeps the string memory for the next windows
+		slot.votes_ = 0;
+	}
+	used_slots_.Reset();
+	user_votes_.Reset();
+
+	total_votes_ = 0;
+	ignored_votes_ = 0;
+	latest_slot_ = INDEX_NONE;
+}
+
+int32 FTwitchVoteAggregator::FindOrAddSlot(int32 _command_index, const TCHAR* _options, int32 _options_length)
+{
+	const uint32 options_hash = FCrc::MemCrc32(_options, _options_length * sizeof(TCHAR));
+	const uint32 mask = slots_.Num() - 1;
+
+	uint32 slot_index = HashCombine(options_hash, static_cast<uint32>(_command_index)) & mask;
+	for (int32 cycle_probe = 0; cycle_probe < slots_.Num(); cycle_probe++)
+	{
+		FTallySlot& slot = slots_[slot_index];
+
+		if (slot.command_index_ == INDEX_NONE)
+		{
+			if (used_slots_.Num() >= max_tallies_)
+			{
+				return INDEX_NONE;
+			}
+
+			slot.command_index_ = _command_index;
+			slot.options_hash_ = options_hash;
+			slot.options_.Reset();
+			slot.options_.AppendChars(_options, _options_length);
+			used_slots_.Add(slot_index);
+			return slot_index;
+		}
+
+		if (slot.command_index_ == _command_index && slot.options_hash_ == options_hash && slot.options_.Len() == _options_length
+			&& FMemory::Memcmp(*slot.options_, _options, _options_length * sizeof(TCHAR)) == 0)
+		{
+			return slot_index;
+		}
+
+		slot_index = (slot_index + 1) & mask;
+	}
+	return INDEX_NONE;
+}
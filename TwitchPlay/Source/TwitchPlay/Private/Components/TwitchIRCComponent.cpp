@@ -1,253 +1,498 @@
-// Copyright (C) Simone Di Gravio <email: altairjp@gmail.com> - All Rights Reserved
-
-#define DEBUG_MSG(msg) GEngine->AddOnScreenDebugMessage( -1 , 6 , FColor::Red , msg )
-
-#include "Components/TwitchIRCComponent.h"
-#include <string>
-
-// Sets default values for this component's properties
-UTwitchIRCComponent::UTwitchIRCComponent()
-{
-	PrimaryComponentTick.bCanEverTick = true;
-}
-
-void UTwitchIRCComponent::SetUserInfo(FString _oauth, FString _username, FString _channel)
-{
-	this->oauth_token_ = _oauth;
-	this->username_ = _username;
-	this->channel_ = _channel;
-	this->b_has_run_user_setup_ = true;
-}
-
-bool UTwitchIRCComponent::SendIRCMessage(FString _message, bool _b_send_to, FString _channel)
-{
-	// Only operate on existing and connected sockets
-	if (connection_socket_ != nullptr && connection_socket_->GetConnectionState() == ESocketConnectionState::SCS_Connected)
-	{
-		// If the user specified a receiver format the message appropriately ("PRIVMSG")
-		if (_b_send_to)
-		{
-			_message = "PRIVMSG #" + _channel + " :" + _message;
-		}
-		_message += "\n"; // Using C style strlen needs a terminator character or it will crash
-		TCHAR* serialized_message = _message.GetCharArray().GetData();
-		int32 size = FCString::Strlen(serialized_message);
-		int32 out_sent;
-		return connection_socket_->Send((uint8*)TCHAR_TO_UTF8(serialized_message), size, out_sent);
-	}
-	else
-	{
-		return false;
-	}
-}
-
-bool UTwitchIRCComponent::Connect(FString& _out_error)
-{
-	ISocketSubsystem* sss = ISocketSubsystem::Get(PLATFORM_SOCKETSUBSYSTEM);
-	TSharedRef<FInternetAddr> connection_addr = sss->CreateInternetAddr();
-	ESocketErrors socket_error = sss->GetHostByName("irc.twitch.tv", *connection_addr); // Name resolution for Twitch IRC server
-
-	if (socket_error != SE_NO_ERROR)
-	{
-		_out_error = "Could not resolve hostname!";
-		return false; // if the host could not be resolved return false
-	}
-
-	// Set connection port
-	const int32 port = 6667; // Standard IRC port
-	connection_addr->SetPort(port);
-
-	FSocket* ret_socket = sss->CreateSocket(NAME_Stream, TEXT("TwitchPlay Socket"), false);
-
-	// Socket creation might fail on certain subsystems
-	if (ret_socket == nullptr)
-	{
-		_out_error = "Could not create socket!";
-		return false;
-	}
-
-	// Setting underlying connection parameters
-	int32 out_size;
-	ret_socket->SetReceiveBufferSize(2 * 1024 * 1024, out_size);
-	ret_socket->SetReuseAddr(true);
-
-	// Try connection
-	bool b_has_connected = ret_socket->Connect(*connection_addr);
-
-	// If we cannot connect destroy the socket and return
-	if (!b_has_connected)
-	{
-		ret_socket->Close();
-		sss->DestroySocket(ret_socket);
-
-		_out_error = "Connection to Twitch IRC failed!";
-		return false;
-	}
-
-	// If the connection was successful create a timer to start receiving data on the socket
-	else
-	{
-		// TODO: Maybe move to thread?
-		GetWorld()->GetTimerManager().SetTimer(this->receiving_timer_, this, &UTwitchIRCComponent::ReceiveData, 0.05f, true);
-		this->connection_socket_ = ret_socket;
-		return true;
-	}
-}
-
-bool UTwitchIRCComponent::AuthenticateTwitchIRC(FString& _out_error)
-{
-	// If we don't have connection return an error
-	if (connection_socket_ == nullptr)
-	{
-		_out_error = "Connection is not initialized. Call 'Connect' before authenticating";
-		return false;
-	}
-
-	// No point in trying to connect if user info was not setup
-	if (!b_has_run_user_setup_)
-	{
-		_out_error = "Can't authenticate. Setup user info first";
-		return false;
-	}
-
-	bool pass_ok = SendIRCMessage("PASS " + this->oauth_token_, false);
-	bool nick_ok = SendIRCMessage("NICK " + this->username_, false);
-
-	// Since the channel join might not be executed if the channel was not setup join_ok default value must be true
-	// for the method to return true if the two previous statements evaluate to true
-	bool join_ok = true;
-	if (this->channel_ != "")
-	{
-		join_ok = SendIRCMessage("JOIN #" + this->channel_, false);
-	}
-
-	bool b_success = pass_ok && nick_ok && join_ok;
-
-	if (!b_success)
-	{
-		_out_error = "Failed to send authentication message";
-		return false;
-	}
-
-	// TODO: Find a way to check for correct authentication
-	// Twitch returns a welcome message ("Welcome, GLHF") or error (:tmi.twitch.tv * NOTICE :Error logging) upon successful login
-	// Could use that in async to check for the connection
-	return (b_success);
-}
-
-void UTwitchIRCComponent::ReceiveData()
-{
-	// If the socket does not exist just return
-	if (connection_socket_ == nullptr)
-	{
-		return;
-	}
-
-	TArray<uint8> data;
-	uint32 data_size;
-	bool received = false;
-	if (connection_socket_->HasPendingData(data_size))
-	{
-		received = true;
-		data.SetNumUninitialized(data_size); // Make space for the data
-		int32 data_read;
-		connection_socket_->Recv(data.GetData(), data.Num(), data_read); // Receive the data. Hopefully the buffer is large enough
-	}
-
-	FString f_string_data = "";
-	if (received)
-	{
-		const std::string c_string_data(reinterpret_cast<const char*>(data.GetData()), data.Num()); // Conversion from uint8 to char
-		f_string_data = FString(c_string_data.c_str()); // Conversion from TCHAR to FString
-	}
-
-	if (f_string_data != "")
-	{
-		TArray<FString> usernames;
-		TArray<FString> parsed_messages = ParseMessage(f_string_data, usernames);
-
-		for (int32 cycle_index = 0; cycle_index < parsed_messages.Num(); cycle_index++)
-		{
-			OnMessageReceived.Broadcast(parsed_messages[cycle_index], usernames[cycle_index]); // Fires the message reception event
-		}
-	}
-}
-
-TArray<FString> UTwitchIRCComponent::ParseMessage(const FString _message, TArray<FString>& _out_sender_username, bool _b_filter_user_only)
-{
-	TArray<FString> ret_messages_content;
-
-	TArray<FString> message_lines;
-	_message.ParseIntoArrayLines(message_lines); // A single "message" from Twitch IRC could include multiple lines. Split them now
-
-	// Parse each line into its parts
-	// Each line from Twitch contains meta information and content
-	// Also need to check if the message is a PING sent from Twitch to check if the connection is alive
-	// This is in the form "PING :tmi.twitch.tv" to which we need to reply with "PONG :tmi.twitch.tv"
-	for (int32 cycle_line = 0; cycle_line < message_lines.Num(); cycle_line++)
-	{
-		// If we receive a PING immediately reply with a PONG and skip the line parsing
-		if (message_lines[cycle_line] == "PING :tmi.twitch.tv")
-		{
-			//DEBUG_MSG( "PING RECEIVED" );
-			this->SendIRCMessage("PONG :tmi.twitch.tv", false);
-			continue; // Skip line parsing
-		}
-
-		// Parsing line
-		// Basic message form is ":twitch_username!twitch_username@twitch_username.tmi.twitch.tv PRIVMSG #channel :message here"
-		// So we can split the message into two parts based off the ":" character: meta[0] and content[1..n]
-		// Also have to account for	possible ":" inside the content itself
-		TArray<FString> message_parts;
-		message_lines[cycle_line].ParseIntoArray(message_parts, TEXT(":"));
-
-		// Meta parsing
-		// Meta info is split by whitespaces
-		TArray<FString> meta;
-		message_parts[0].ParseIntoArrayWS(meta);
-
-		// Assume at this point the message is from a user, but just in case set it beforehand
-		// This is so that we can return an "empty" user if the message was of any other kind
-		// For example, messages from the server (like upon connection) don't have a username
-		FString sender_username = "";
-		if (meta[1] == "PRIVMSG") // Type of message should always be in position 1 (or at least I hope so)
-		{
-			// Username should be the first part before the first "!"
-			meta[0].Split("!", &sender_username, nullptr);
-		}
-
-		// If user only message filtering is enabled and no username was found for this message line, skip it
-		if (_b_filter_user_only && sender_username == "")
-		{
-			continue; // Skip line
-		}
-
-		// Some messages correspond to events sent by the server (JOIN etc.)
-		// In that case the message part is only one
-		if (message_parts.Num() > 1)
-		{
-			// Content of the message is composed by all parts of the message from message_parts[1] on
-			FString message_content = message_parts[1];
-			if (message_parts.Num() > 2)
-			{
-				for (int32 cycle_content = 2; cycle_content < message_parts.Num(); cycle_content++)
-				{
-					// Add back the ":" that was used as the splitter
-					message_content += ":" + message_parts[cycle_content];
-				}
-			}
-			ret_messages_content.Add(message_content);
-			_out_sender_username.Add(sender_username);
-		}
-	}
-	return ret_messages_content;
-}
-
-UTwitchIRCComponent::~UTwitchIRCComponent()
-{
-	if (connection_socket_ != nullptr)
-	{
-		connection_socket_->Close();
-		ISocketSubsystem::Get(PLATFORM_SOCKETSUBSYSTEM)->DestroySocket(connection_socket_);
-	}
+// Copyright (C) Simone Di Gravio <email: altairjp@gmail.com> - All Rights Reserved
+
+#define DEBUG_MSG(msg) GEngine->AddOnScreenDebugMessage( -1 , 6 , FColor::Red , msg )
+
+#include "Components/TwitchIRCComponent.h"
+#include "Net/TwitchIRCConnectionManager.h"
+#include "Testing/TwitchIRCLoadTest.h"
+#include "Stats/TwitchPlayStats.h"
+#include "Misc/Paths.h"
+
+// Sets default values for this component's properties
+UTwitchIRCComponent::UTwitchIRCComponent()
+{
+	PrimaryComponentTick.bCanEverTick = true;
+}
+
+void UTwitchIRCComponent::SetUserInfo(FString _oauth, FString _username, FString _channel)
+{
+	this->oauth_token_ = _oauth;
+	this->username_ = _username;
+	this->channel_ = _channel;
+	this->b_has_run_user_setup_ = true;
+}
+
+bool UTwitchIRCComponent::SendIRCMessage(FString _message, bool _b_send_to, FString _channel)
+{
+	// Messages can be queued as long as there is a connection, even while it is (re)connecting
+	if (connection_pool_ != nullptr)
+	{
+		// If the user specified a receiver format the message appropriately ("PRIVMSG")
+		if (_b_send_to)
+		{
+			_message = "PRIVMSG #" + _channel + " :" + _message;
+		}
+
+		// Only chat messages count against the Twitch message budget
+		const bool b_rate_limited = _message.StartsWith(TEXT("PRIVMSG "), ESearchCase::CaseSensitive);
+		return connection_pool_->Send(_message, b_rate_limited, _b_send_to ? _channel : FString());
+	}
+	else
+	{
+		return false;
+	}
+}
+
+bool UTwitchIRCComponent::Connect(FString& _out_error)
+{
+	Disconnect(); // In case of a previous connection
+
+	if (!ShouldIngestChat())
+	{
+		return true;
+	}
+
+	// Resolving, connecting and authenticating all happen on the connection threads
+	if (!AcquireConnectionPool())
+	{
+		_out_error = "Could not create the connection thread!";
+		return false;
+	}
+	return true;
+}
+
+bool UTwitchIRCComponent::AuthenticateTwitchIRC(FString& _out_error)
+{
+	// Nothing to authenticate, see Connect()
+	if (!ShouldIngestChat())
+	{
+		return true;
+	}
+
+	// If we don't have connection return an error
+	if (connection_pool_ == nullptr)
+	{
+		_out_error = "Connection is not initialized. Call 'Connect' before authenticating";
+		return false;
+	}
+
+	// No point in trying to connect if user info was not setup
+	if (!b_has_run_user_setup_)
+	{
+		_out_error = "Can't authenticate. Setup user info first";
+		return false;
+	}
+
+	// Connections are shared per account. Move to the right one if the user changed since Connect()
+	if (connection_pool_->GetAccount() != this->username_.ToLower())
+	{
+		ReleaseConnectionPool();
+		if (!AcquireConnectionPool())
+		{
+			_out_error = "Could not create the connection thread!";
+			return false;
+		}
+	}
+
+	// The connection thread sends the credentials once connected, and again after every reconnection
+	// Twitch returns a welcome message ("Welcome, GLHF") or error (:tmi.twitch.tv NOTICE * :Login authentication failed),
+	// reported through OnConnectionStateChanged
+	connection_pool_->Authenticate(this->oauth_token_, this->username_, this->b_request_tags_);
+	if (this->channel_ != "")
+	{
+		JoinChannel(this->channel_);
+	}
+	return true;
+}
+
+int32 UTwitchIRCComponent::JoinChannel(const FString _channel)
+{
+	const int32 channel_id = InternChannel(_channel);
+	if (channel_id != INDEX_NONE)
+	{
+		joined_channels_[channel_id] = true;
+		if (connection_pool_ != nullptr)
+		{
+			connection_pool_->AddListener(channel_names_[channel_id], this, channel_id);
+		}
+	}
+	return channel_id;
+}
+
+bool UTwitchIRCComponent::PartChannel(const FString _channel)
+{
+	const int32 channel_id = GetChannelId(_channel);
+	if (channel_id == INDEX_NONE || !joined_channels_[channel_id])
+	{
+		return false;
+	}
+
+	joined_channels_[channel_id] = false;
+	if (connection_pool_ != nullptr)
+	{
+		connection_pool_->RemoveListener(channel_names_[channel_id], this);
+	}
+	return true;
+}
+
+int32 UTwitchIRCComponent::AddChannelHandler(const FString _channel, const FChannelMessageReceived& _handler)
+{
+	const int32 channel_id = InternChannel(_channel);
+	if (channel_id != INDEX_NONE)
+	{
+		channel_handlers_[channel_id].Add(_handler);
+	}
+	return channel_id;
+}
+
+int32 UTwitchIRCComponent::RemoveChannelHandlers(const FString _channel, UObject* _object)
+{
+	const int32 channel_id = GetChannelId(_channel);
+	if (channel_id == INDEX_NONE)
+	{
+		return 0;
+	}
+	return channel_handlers_[channel_id].RemoveAll([_object](const FChannelMessageReceived& _handler) { return _handler.IsBoundToObject(_object); });
+}
+
+int32 UTwitchIRCComponent::GetChannelId(const FString _channel) const
+{
+	// Channel names only ever go through here when setting up, messages carry the ID
+	FString channel_name = _channel.StartsWith(TEXT("#")) ? _channel.RightChop(1) : _channel;
+	return channel_names_.IndexOfByPredicate([&channel_name](const FString& _name) { return _name.Equals(channel_name, ESearchCase::IgnoreCase); });
+}
+
+FString UTwitchIRCComponent::GetChannelName(int32 _channel_id) const
+{
+	return channel_names_.IsValidIndex(_channel_id) ? channel_names_[_channel_id] : FString();
+}
+
+int32 UTwitchIRCComponent::GetMessageChannelId() const
+{
+	return current_message_ != nullptr ? current_channel_id_ : INDEX_NONE;
+}
+
+int32 UTwitchIRCComponent::FindUserHandle(const FString _username)
+{
+	const FTwitchIRCConnectionManager* manager = FTwitchIRCConnectionManager::Get();
+	return manager != nullptr ? manager->GetUserRegistry().FindUser(_username) : INDEX_NONE;
+}
+
+FString UTwitchIRCComponent::GetUserName(int32 _user_handle)
+{
+	const FTwitchIRCConnectionManager* manager = FTwitchIRCConnectionManager::Get();
+	return manager != nullptr ? manager->GetUserRegistry().GetLogin(_user_handle) : FString();
+}
+
+FString UTwitchIRCComponent::GetUserDisplayName(int32 _user_handle)
+{
+	const FTwitchIRCConnectionManager* manager = FTwitchIRCConnectionManager::Get();
+	return manager != nullptr ? manager->GetUserRegistry().GetDisplayName(_user_handle) : FString();
+}
+
+int64 UTwitchIRCComponent::GetUserTwitchId(int32 _user_handle)
+{
+	const FTwitchIRCConnectionManager* manager = FTwitchIRCConnectionManager::Get();
+	return manager != nullptr ? manager->GetUserRegistry().GetTwitchId(_user_handle) : 0;
+}
+
+int32 UTwitchIRCComponent::InternChannel(const FString& _channel)
+{
+	int32 channel_id = GetChannelId(_channel);
+	if (channel_id == INDEX_NONE)
+	{
+		// Twitch channel names are lower case
+		FString channel_name = (_channel.StartsWith(TEXT("#")) ? _channel.RightChop(1) : _channel).ToLower();
+		if (channel_name.IsEmpty())
+		{
+			return INDEX_NONE;
+		}
+
+		channel_id = channel_names_.Add(MoveTemp(channel_name));
+		joined_channels_.Add(false);
+		channel_handlers_.AddDefaulted();
+	}
+	return channel_id;
+}
+
+bool UTwitchIRCComponent::AcquireConnectionPool()
+{
+	FTwitchIRCConnectionManager* manager = FTwitchIRCConnectionManager::Get();
+	if (manager == nullptr)
+	{
+		return false;
+	}
+
+	FTwitchIRCConnectionPool::FSettings settings;
+	settings.connection_settings_.host_ = server_host_;
+	settings.connection_settings_.port_ = server_port_;
+	settings.connection_settings_.messages_per_window_ = b_is_moderator_ ? 100 : 20;
+	settings.connection_settings_.b_auto_reconnect_ = b_auto_reconnect_;
+	settings.connection_settings_.reconnect_initial_delay_ = FMath::Max(reconnect_initial_delay_seconds_, 0.1f);
+	settings.connection_settings_.reconnect_max_delay_ = FMath::Max(reconnect_max_delay_seconds_, reconnect_initial_delay_seconds_);
+	settings.max_channels_per_connection_ = FMath::Max(max_channels_per_connection_, 1);
+	settings.max_connections_ = FMath::Max(max_connections_, 1);
+	settings.dispatch_budget_microseconds_ = FMath::Max(dispatch_budget_microseconds_, 0);
+	settings.connection_settings_.inbound_capacity_ = FMath::Max(inbound_queue_capacity_, 16);
+	settings.connection_settings_.overload_policy_ = overload_policy_;
+	settings.connection_settings_.overload_command_marker_ = overload_command_marker_;
+
+	auto resolve_path = [](const FString& _file) { return _file.IsEmpty() || !FPaths::IsRelative(_file) ? _file : FPaths::ConvertRelativePathToFull(FPaths::ProjectSavedDir(), _file); };
+	settings.capture_file_ = resolve_path(capture_file_);
+	settings.connection_settings_.replay_file_ = resolve_path(replay_file_);
+	settings.connection_settings_.replay_speed_ = FMath::Max(replay_speed_, 0.0f);
+
+	connection_pool_ = manager->Acquire(username_.ToLower(), settings, this);
+	if (connection_pool_ == nullptr)
+	{
+		return false;
+	}
+
+	// Channels joined before (or on a previous connection) are joined once authenticated
+	for (TConstSetBitIterator<> joined_channel(joined_channels_); joined_channel; ++joined_channel)
+	{
+		connection_pool_->AddListener(channel_names_[joined_channel.GetIndex()], this, joined_channel.GetIndex());
+	}
+	return true;
+}
+
+void UTwitchIRCComponent::ReleaseConnectionPool()
+{
+	// The pool is gone if the module shut down first
+	FTwitchIRCConnectionManager* manager = FTwitchIRCConnectionManager::Get();
+	if (connection_pool_ != nullptr && manager != nullptr)
+	{
+		manager->Release(connection_pool_, this);
+	}
+	connection_pool_ = nullptr;
+	message_frame_.Reset();
+	message_batch_.Reset();
+}
+
+void UTwitchIRCComponent::Disconnect()
+{
+	if (connection_pool_ != nullptr)
+	{
+		// The connections are closed once no component uses them anymore
+		ReleaseConnectionPool();
+
+		OnConnectionStateChanged.Broadcast(ETwitchConnectionState::Disconnected, FString());
+	}
+}
+
+ETwitchConnectionState UTwitchIRCComponent::GetConnectionState() const
+{
+	return connection_pool_ != nullptr ? connection_pool_->GetState() : ETwitchConnectionState::Disconnected;
+}
+
+void UTwitchIRCComponent::ReceiveData()
+{
+	// Every component sharing the connections gets its messages from here
+	FTwitchIRCConnectionManager* manager = FTwitchIRCConnectionManager::Get();
+	if (connection_pool_ != nullptr && manager != nullptr)
+	{
+		manager->Pump();
+	}
+}
+
+void UTwitchIRCComponent::DispatchMessage(const FTwitchIRCReceivedMessage& _message, int32 _channel_id)
+{
+	SCOPE_CYCLE_COUNTER(STAT_TwitchPlay_Dispatch);
+	const uint64 dispatch_start_cycles = FPlatformTime::Cycles64();
+
+	current_message_ = &_message; // Lets handlers read the message tags and channel
+	current_channel_id_ = _channel_id;
+
+#if TWITCHPLAY_WITH_LOAD_TESTING
+	if (FTwitchIRCLoadTest::IsRecording())
+	{
+		FTwitchIRCLoadTest::RecordDelivery(GetMessageTags(), ETwitchIRCLoadStage::MessageReceived);
+	}
+#endif
+
+	// The username is interned, handlers get a reference to the same string for every message of the user
+	const FString& username = _message.GetUsername();
+	OnMessageReceived.Broadcast(_message.content_, username, _message.user_handle_); // Fires the message reception event
+
+	// Then the handlers of the message channel only. Size is checked on every iteration since a handler might remove handlers
+	if (channel_handlers_.IsValidIndex(_channel_id))
+	{
+		for (int32 cycle_handler = 0; cycle_handler < channel_handlers_[_channel_id].Num(); ++cycle_handler)
+		{
+			const FChannelMessageReceived handler = channel_handlers_[_channel_id][cycle_handler];
+			handler.ExecuteIfBound(_message.content_, username, _message.user_handle_, _channel_id);
+		}
+	}
+	current_message_ = nullptr;
+	current_channel_id_ = INDEX_NONE;
+
+	// Batch listeners get the message at the end of the frame. The content is not copied: the pool keeps it until the batch is sent
+	if (OnMessagesReceivedBatch.IsBound() || OnMessagesReceivedSpan.IsBound())
+	{
+		message_frame_.contents_.Add(&_message.content_);
+		message_frame_.user_handles_.Add(_message.user_handle_);
+		message_frame_.channel_ids_.Add(_channel_id);
+		message_frame_.receive_cycles_.Add(_message.receive_cycles_);
+		message_frame_.usernames_.Add(_message.username_);
+	}
+
+	FTwitchPlayStats::RecordLatency(ETwitchPlayLatency::Dispatch, FPlatformTime::Cycles64() - dispatch_start_cycles);
+}
+
+void UTwitchIRCComponent::DispatchMessageBatch()
+{
+	const int32 num_messages = message_frame_.Num();
+	if (num_messages == 0)
+	{
+		return;
+	}
+
+	OnMessagesReceivedSpan.Broadcast(FTwitchMessageSpan(message_frame_));
+
+	// Blueprint needs its own copies. The strings of the previous batch are assigned over, so they keep their allocations
+	if (OnMessagesReceivedBatch.IsBound())
+	{
+		message_batch_.contents_.SetNum(num_messages, false);
+		for (int32 cycle_message = 0; cycle_message < num_messages; ++cycle_message)
+		{
+			message_batch_.contents_[cycle_message] = *message_frame_.contents_[cycle_message];
+		}
+		message_batch_.user_handles_ = message_frame_.user_handles_;
+		message_batch_.channel_ids_ = message_frame_.channel_ids_;
+
+		// Cycles are turned into world real time, which Blueprint can compare with its own clock
+		const UWorld* world = GetWorld();
+		const float now_seconds = world != nullptr ? world->GetRealTimeSeconds() : 0.0f;
+		const uint64 now_cycles = FPlatformTime::Cycles64();
+		const double seconds_per_cycle = FPlatformTime::GetSecondsPerCycle64();
+		message_batch_.receive_times_.SetNumUninitialized(num_messages, false);
+		for (int32 cycle_message = 0; cycle_message < num_messages; ++cycle_message)
+		{
+			const uint64 age_cycles = now_cycles - FMath::Min(message_frame_.receive_cycles_[cycle_message], now_cycles);
+			message_batch_.receive_times_[cycle_message] = now_seconds - static_cast<float>(age_cycles * seconds_per_cycle);
+		}
+
+		OnMessagesReceivedBatch.Broadcast(message_batch_);
+	}
+	message_frame_.Reset();
+}
+
+void UTwitchIRCComponent::DispatchStateChange(ETwitchConnectionState _new_state, const FString& _reason)
+{
+	OnConnectionStateChanged.Broadcast(_new_state, _reason);
+}
+
+void UTwitchIRCComponent::DispatchSendQueueReport(int32 _dropped_messages, int32 _delayed_messages, float _longest_delay_seconds)
+{
+	OnSendQueueReport.Broadcast(_dropped_messages, _delayed_messages, _longest_delay_seconds);
+}
+
+void UTwitchIRCComponent::DispatchInboundQueueReport(int32 _shed_messages, int32 _deferred_messages)
+{
+	OnInboundQueueReport.Broadcast(_shed_messages, _deferred_messages);
+}
+
+bool UTwitchIRCComponent::GetMessageTag(const FString _tag_name, FString& _out_value) const
+{
+	return GetMessageTags().GetValue(TCHAR_TO_UTF8(*_tag_name), _out_value);
+}
+
+uint64 UTwitchIRCComponent::GetMessageReceiveCycles() const
+{
+	return current_message_ != nullptr ? current_message_->receive_cycles_ : 0;
+}
+
+FTwitchIRCTags UTwitchIRCComponent::GetMessageTags() const
+{
+	if (current_message_ == nullptr)
+	{
+		return FTwitchIRCTags();
+	}
+	return FTwitchIRCTags(current_message_->raw_tags_);
+}
+
+TArray<FString> UTwitchIRCComponent::ParseMessage(const FString _message, TArray<FString>& _out_sender_username, bool _b_filter_user_only, TArray<FString>* _out_channels)
+{
+	SCOPE_CYCLE_COUNTER(STAT_TwitchPlay_Parse);
+
+	TArray<FString> ret_messages_content;
+
+	// The tokenizer works on the UTF-8 bytes as they came from the socket
+	const FTCHARToUTF8 utf8_message(*_message);
+	const ANSICHAR* cursor = utf8_message.Get();
+	const ANSICHAR* const end = cursor + utf8_message.Length();
+
+	// A single "message" from Twitch IRC could include multiple lines. Parse each one into its parts
+	// Each line from Twitch contains meta information and content
+	// Basic message form is ":twitch_username!twitch_username@twitch_username.tmi.twitch.tv PRIVMSG #channel :message here"
+	FTwitchIRCLine line;
+	while (cursor < end)
+	{
+		const ANSICHAR* line_end = cursor;
+		while (line_end < end && *line_end != '\r' && *line_end != '\n')
+		{
+			++line_end;
+		}
+
+		const bool b_parsed = line.Parse(cursor, line_end - cursor);
+		cursor = line_end + 1;
+
+		if (!b_parsed)
+		{
+			continue; // Empty line
+		}
+		FTwitchPlayStats::Add(ETwitchPlayCounter::LinesParsed, 1);
+
+		// Also need to check if the message is a PING sent from Twitch to check if the connection is alive
+		// This is in the form "PING :tmi.twitch.tv" to which we need to reply with "PONG :tmi.twitch.tv"
+		// The connection thread already answers the PINGs it receives, this is for text parsed from elsewhere
+		if (line.command_.Equals("PING"))
+		{
+			this->SendIRCMessage("PONG :" + line.trailing_.ToString(), false);
+			continue; // Skip line parsing
+		}
+
+		// Messages from the server (like upon connection) don't have a username
+		// If user only message filtering is enabled skip them
+		const bool b_user_message = line.IsUserMessage();
+		if (_b_filter_user_only && !b_user_message)
+		{
+			continue; // Skip line
+		}
+
+		// Some messages correspond to events sent by the server (JOIN etc.) and have no content
+		if (line.b_has_trailing_)
+		{
+			ret_messages_content.Add(line.trailing_.ToString());
+			_out_sender_username.Add(b_user_message ? line.nick_.ToString() : FString());
+
+			// The first parameter of chat lines is the "#channel" the message was sent to
+			if (_out_channels != nullptr)
+			{
+				const FTwitchIRCStringView channel = line.GetParam(0);
+				_out_channels->Add(!channel.IsEmpty() && channel[0] == '#' ? channel.Mid(1).ToString() : FString());
+			}
+		}
+	}
+	return ret_messages_content;
+}
+
+void UTwitchIRCComponent::TickComponent(float _delta_time, ELevelTick _tick_type, FActorComponentTickFunction* _this_tick_function)
+{
+	Super::TickComponent(_delta_time, _tick_type, _this_tick_function);
+
+	ReceiveData();
+}
+
+void UTwitchIRCComponent::EndPlay(const EEndPlayReason::Type _end_play_reason)
+{
+	Disconnect();
+
+	Super::EndPlay(_end_play_reason);
+}
+
+UTwitchIRCComponent::~UTwitchIRCComponent()
+{
+	// The connections close their sockets once no component uses them anymore
+	ReleaseConnectionPool();
 }
\ No newline at end of file
@@ -1,155 +1,701 @@
-// Copyright (C) Simone Di Gravio <email: altairjp@gmail.com> - All Rights Reserved
-
-#define DEBUG_MSG(msg) GEngine->AddOnScreenDebugMessage( -1 , 6 , FColor::Red , msg ) 
-
-#include "Components/TwitchPlayComponent.h"
-
-UTwitchPlayComponent::UTwitchPlayComponent()
-{
-	bound_events_ = TMap<FString, FOnCommandReceived>();
-
-	// This step is necessary because for some reason serialization of objects in the editor makes bound events semi-permanent
-	// That means that they remain bound even if the "AddDynamic" line is removed!
-	// The solution to "refresh" the state of things is to actually delete and recreate the object
-	// Waiting for a "fix"?
-	OnMessageReceived.RemoveAll(this);
-	OnMessageReceived.AddDynamic(this, &UTwitchPlayComponent::MessageReceivedHandler);
-}
-
-void UTwitchPlayComponent::SetupEncapsulationChars(const FString _command_char, const FString _options_char)
-{
-	this->command_encapsulation_char_ = _command_char;
-	this->options_encapsulation_char_ = _options_char;
-}
-
-bool UTwitchPlayComponent::RegisterCommand(const FString _command_name, const FOnCommandReceived& _callback_function, FString& _out_result)
-{
-	// No reason to register an empty command
-	if (_command_name == "")
-	{
-		_out_result = "Command type string is invalid";
-		return false;
-	}
-
-	// Pointer to the command in the event map, if present
-	// If the command is found I can use this to switch from the previous function and bind the new one
-	FOnCommandReceived* registered_command = bound_events_.Find(_command_name);
-
-	// If the command we want to register is already in the event map 
-	// copy the new delegate object info into it   
-	// For optimization purposes don't delete the entry in order to create a new one.
-	if (registered_command != nullptr)
-	{
-		*registered_command = _callback_function;
-		_out_result = _command_name + " command registered. It overwrote a previous registration of the same type";
-		return true;
-	}
-	// If the command is not registered yet create a new entry for it
-	// and copy the incoming delegate object info to the new delegate object
-	else
-	{
-		bound_events_.Add(_command_name, _callback_function);
-		_out_result = _command_name + " command registered";
-		return true;
-	}
-}
-
-bool UTwitchPlayComponent::UnregisterCommand(const FString _command_name, FString& _out_result)
-{
-	// No reason to unregister an empty command 
-	if (_command_name == "")
-	{
-		_out_result = "Command type string is invalid";
-		return false;
-	}
-
-	if (bound_events_.Remove(_command_name) == 0)
-	{
-		_out_result = "No command of this type was registered";
-		return false;
-	}
-	else
-	{
-		_out_result = _command_name + " unregistered";
-		return true;
-	}
-}
-
-void UTwitchPlayComponent::MessageReceivedHandler(const FString & _message, const FString & _username)
-{
-	FString command = GetCommandString(_message);
-
-	// No reason to search for the command in the event map, there isn't any
-	if (command == "")
-	{
-		return;
-	}
-
-	FOnCommandReceived* registered_command = bound_events_.Find(command);
-
-	// If the command was registered proceed with finding any command options
-	// Then fire the event
-	if (registered_command != nullptr)
-	{
-		TArray<FString> command_options = GetCommandOptionsStrings(_message);
-		registered_command->ExecuteIfBound(command, command_options, _username);
-	}
-}
-
-FString UTwitchPlayComponent::GetCommandString(const FString & _message) const
-{
-	// Only the first command is accepted
-	FString ret_command = GetDelimitedString(_message, command_encapsulation_char_);
-	return ret_command;
-}
-
-TArray<FString> UTwitchPlayComponent::GetCommandOptionsStrings(const FString & _message) const
-{
-	TArray<FString> ret_options = TArray<FString>();
-	FString options = GetDelimitedString(_message, options_encapsulation_char_);
-	options.ParseIntoArray(ret_options, TEXT(","));
-	return ret_options;
-}
-
-FString UTwitchPlayComponent::GetDelimitedString(const FString & _in_string, const FString & _delimiter) const
-{
-	FString ret_delimited_string = "";
-
-	// No delimited string can be found on an empty string
-	if (_in_string == "")
-	{
-		return "";
-	}
-
-	// Where does the delimiter start?
-	// Remember that the delimiter can be more than 1 character, so we need to add
-	// the delimiter length to find the actual start of the delimited string
-	int32 command_start_index = _in_string.Find(_delimiter);
-
-	// If the message did not contain any start delimiter no command can be found
-	// Also, if the start delimiter is at the end of the string no command can be found
-	if (command_start_index == INDEX_NONE || command_start_index + _delimiter.Len() == _in_string.Len())
-	{
-		return "";
-	}
-
-	// Search for the end of the command delimiter
-	// The starting position for the search is the index of the previous delimiter plus 
-	// the actual length of the delimiter (start search from at least one char ahead)
-	int32 command_end_index = _in_string.Find(_delimiter, ESearchCase::IgnoreCase, ESearchDir::FromStart, command_start_index + _delimiter.Len());
-
-	// If we did not find an end delimiter no encapsulated string can be found
-	if (command_end_index == INDEX_NONE)
-	{
-		return "";
-	}
-
-	// If we have the two delimiter positions get the string inbetween them
-	ret_delimited_string = _in_string.Mid(command_start_index + _delimiter.Len(), (command_end_index - (command_start_index + _delimiter.Len())));
-	return ret_delimited_string;
-}
-
-UTwitchPlayComponent::~UTwitchPlayComponent()
-{
-	// TODO: Maybe unbind everything from bound_events_?
-}
+// Copyright (C) Simone Di Gravio <email: altairjp@gmail.com> - All Rights Reserved
+
+#define DEBUG_MSG(msg) GEngine->AddOnScreenDebugMessage( -1 , 6 , FColor::Red , msg ) 
+
+#include "Components/TwitchPlayComponent.h"
+#include "Testing/TwitchIRCLoadTest.h"
+#include "Stats/TwitchPlayStats.h"
+#include "Misc/Crc.h"
+#include "Hash/CityHash.h"
+#include "GameFramework/Actor.h"
+#include "TwitchPlay.h"
+
+namespace
+{
+	// Commands waiting for a batch past which new ones are shed. About a second of a very busy chat
+	const int32 MaxPendingBatchCommands = 4096;
+
+	/**
+	 * Finds a range of code points in a string. Twitch counts code points, where a UTF-16 string has two chars
+	 * (a surrogate pair) for everything past the BMP, like most emoji.
+	 *
+	 * @param _string - The string.
+	 * @param _first_code_point - First code point of the range.
+	 * @param _last_code_point - Last code point of the range, included.
+	 * @param _out_start - Index of the first char of the range.
+	 * @param _out_length - Chars in the range.
+	 *
+	 * @return False if the range is empty or goes past the end of the string.
+	 */
+	bool FindCodePointRange(const FString& _string, int32 _first_code_point, int32 _last_code_point, int32& _out_start, int32& _out_length)
+	{
+		if (_first_code_point < 0 || _first_code_point > _last_code_point)
+		{
+			return false;
+		}
+
+		const TCHAR* const chars = *_string;
+		const int32 num_chars = _string.Len();
+		int32 code_point = 0;
+		for (int32 cycle_char = 0; cycle_char < num_chars; ++cycle_char, ++code_point)
+		{
+			if (code_point == _first_code_point)
+			{
+				_out_start = cycle_char;
+			}
+
+			const bool b_is_surrogate_pair = sizeof(TCHAR) == 2 && cycle_char + 1 < num_chars
+				&& chars[cycle_char] >= 0xD800 && chars[cycle_char] <= 0xDBFF
+				&& chars[cycle_char + 1] >= 0xDC00 && chars[cycle_char + 1] <= 0xDFFF;
+			if (b_is_surrogate_pair)
+			{
+				++cycle_char;
+			}
+
+			if (code_point == _last_code_point)
+			{
+				_out_length = cycle_char + 1 - _out_start;
+				return true;
+			}
+		}
+		return false;
+	}
+}
+
+UTwitchPlayComponent::UTwitchPlayComponent()
+{
+	bound_events_ = TMap<FString, FRegisteredCommand>();
+
+	// This step is necessary because for some reason serialization of objects in the editor makes bound events semi-permanent
+	// That means that they remain bound even if the "AddDynamic" line is removed!
+	// The solution to "refresh" the state of things is to actually delete and recreate the object
+	// Waiting for a "fix"?
+	OnMessageReceived.RemoveAll(this);
+	OnMessageReceived.AddDynamic(this, &UTwitchPlayComponent::MessageReceivedHandler);
+}
+
+void UTwitchPlayComponent::SetupEncapsulationChars(const FString _command_char, const FString _options_char)
+{
+	this->command_encapsulation_char_ = _command_char;
+	this->options_encapsulation_char_ = _options_char;
+}
+
+bool UTwitchPlayComponent::RegisterCommand(const FString _command_name, const FOnCommandReceived& _callback_function, FString& _out_result)
+{
+	FRegisteredCommand command;
+	command.event_ = _callback_function;
+	return AddCommand(_command_name, command, _out_result);
+}
+
+bool UTwitchPlayComponent::RegisterCommandWithSchema(const FString _command_name, const FTwitchCommandSchema& _schema, const FOnTypedCommandReceived& _callback_function, FString& _out_result)
+{
+	// Schemas are compiled once here, messages only run the compiled form
+	TSharedPtr<FTwitchCommandSchemaParser> schema = MakeShared<FTwitchCommandSchemaParser>();
+	FString schema_error;
+	if (!schema->Compile(_schema, schema_error))
+	{
+		_out_result = _command_name + " has an invalid schema: " + schema_error;
+		return false;
+	}
+
+	FRegisteredCommand command;
+	command.typed_event_ = _callback_function;
+	command.schema_ = schema;
+	return AddCommand(_command_name, command, _out_result);
+}
+
+bool UTwitchPlayComponent::AddCommand(const FString& _command_name, const FRegisteredCommand& _command, FString& _out_result)
+{
+	// No reason to register an empty command
+	if (_command_name == "")
+	{
+		_out_result = "Command type string is invalid";
+		return false;
+	}
+
+	// Pointer to the command in the event map, if present
+	// If the command is found I can use this to switch from the previous function and bind the new one
+	FRegisteredCommand* registered_command = bound_events_.Find(_command_name);
+
+	// If the command we want to register is already in the event map 
+	// copy the new delegate object info into it   
+	// For optimization purposes don't delete the entry in order to create a new one.
+	if (registered_command != nullptr)
+	{
+		*registered_command = _command;
+		CompileCommands();
+		_out_result = _command_name + " command registered. It overwrote a previous registration of the same type";
+		return true;
+	}
+	// If the command is not registered yet create a new entry for it
+	// and copy the incoming delegate object info to the new delegate object
+	else
+	{
+		bound_events_.Add(_command_name, _command);
+		CompileCommands();
+		_out_result = _command_name + " command registered";
+		return true;
+	}
+}
+
+bool UTwitchPlayComponent::UnregisterCommand(const FString _command_name, FString& _out_result)
+{
+	// No reason to unregister an empty command 
+	if (_command_name == "")
+	{
+		_out_result = "Command type string is invalid";
+		return false;
+	}
+
+	if (bound_events_.Remove(_command_name) == 0)
+	{
+		_out_result = "No command of this type was registered";
+		return false;
+	}
+	else
+	{
+		CompileCommands();
+		_out_result = _command_name + " unregistered";
+		return true;
+	}
+}
+
+void UTwitchPlayComponent::MessageReceivedHandler(const FString & _message, const FString & _username, int32 _user_handle)
+{
+	// Ignored users never get to the command table. Usernames from chat are already lower case
+	if (ignored_user_keys_.Num() > 0 && ignored_user_keys_.Contains(FTwitchUserThrottle::HashUser(_username)))
+	{
+		return;
+	}
+
+	const double now = b_track_trends_ ? FPlatformTime::Seconds() : 0.0;
+	if (b_track_trends_)
+	{
+		CountMessageTrends(_message, _user_handle, now);
+	}
+
+	// Keywords are looked for anywhere in the message, whether it has a command or not
+	if (!keyword_matcher_.IsEmpty() && OnKeywordsMatched.IsBound())
+	{
+		MatchKeywords(_message, _username, _user_handle);
+	}
+
+	// Single pass over the message: chat without a registered command is rejected
+	// as soon as the encapsulated text stops matching any registered command
+	int32 command_end_index;
+	int32 command_index;
+	{
+		SCOPE_CYCLE_COUNTER(STAT_TwitchPlay_MatchCommand);
+		command_index = command_table_.Match(*_message, _message.Len(), *command_encapsulation_char_, command_encapsulation_char_.Len(), command_end_index);
+	}
+
+	if (command_index == INDEX_NONE)
+	{
+		FTwitchPlayStats::Add(ETwitchPlayCounter::CommandsUnmatched, 1);
+		return;
+	}
+	FTwitchPlayStats::Add(ETwitchPlayCounter::CommandsMatched, 1);
+
+	// Options are found in place. Those of commands with a schema are parsed right away, without creating any string.
+	// Malformed commands are dropped before they count against the user rate or as votes
+	const FRegisteredCommand& registered_command = compiled_events_[command_index];
+	int32 options_start = 0;
+	int32 options_length = 0;
+	FTwitchCommandSchemaParser::FindDelimited(*_message, _message.Len(), *options_encapsulation_char_, options_encapsulation_char_.Len(), options_start, options_length);
+	FTwitchCommandArgs command_args;
+	if (registered_command.schema_.IsValid())
+	{
+		if (!registered_command.schema_->Parse(*_message + options_start, options_length, command_args))
+		{
+			FTwitchPlayStats::Add(ETwitchPlayCounter::CommandsMalformed, 1);
+			return;
+		}
+	}
+
+	// Spam is dropped before anything is copied or fired
+	if (b_throttle_users_ && !AllowUserCommand(command_index, _message, _user_handle))
+	{
+		FTwitchPlayStats::Add(ETwitchPlayCounter::CommandsSuppressed, 1);
+		return;
+	}
+
+	if (b_track_trends_)
+	{
+		CountCommandTrends(command_index, _message, now);
+	}
+
+	// Messages received by the connection threads carry their socket read time
+	const uint64 receive_cycles = GetMessageReceiveCycles();
+	if (receive_cycles != 0)
+	{
+		FTwitchPlayStats::RecordLatency(ETwitchPlayLatency::Command, FPlatformTime::Cycles64() - receive_cycles);
+	}
+
+#if TWITCHPLAY_WITH_LOAD_TESTING
+	if (FTwitchIRCLoadTest::IsRecording())
+	{
+		FTwitchIRCLoadTest::RecordDelivery(GetMessageTags(), ETwitchIRCLoadStage::CommandReceived);
+	}
+#endif
+
+	// In vote mode the command is only counted. Votes are reported once per window
+	if (b_vote_mode_enabled_)
+	{
+		vote_aggregator_.Vote(command_index, *_message + options_start, options_length, static_cast<uint32>(_user_handle));
+		return;
+	}
+
+	// In server authoritative multiplayer the command is fired by the next batch, on this machine as on the clients
+	if (IsReplicatingCommands())
+	{
+		QueueReplicatedCommand(command_index, command_args, _message, _username, _user_handle);
+		return;
+	}
+
+	// The command was registered: proceed with finding any command options, then fire the event
+	// Delegate and name are copied since the handler could register or unregister commands and rebuild the table
+	const FString command = command_table_.GetCommandName(command_index);
+	if (registered_command.schema_.IsValid())
+	{
+		const FOnTypedCommandReceived typed_command_event = registered_command.typed_event_;
+		typed_command_event.ExecuteIfBound(command, command_args, _username, _user_handle);
+		return;
+	}
+	const FOnCommandReceived command_event = registered_command.event_;
+
+	// Handlers get the options by reference: they are overwritten by the next command, handlers copy them to keep them
+	GetCommandOptionsStrings(_message, command_options_);
+	command_event.ExecuteIfBound(command, command_options_, _username, _user_handle);
+}
+
+void UTwitchPlayComponent::CompileCommands()
+{
+	TArray<FString> command_names;
+	command_names.Reserve(bound_events_.Num());
+	compiled_events_.Reset(bound_events_.Num());
+
+	for (const TPair<FString, FRegisteredCommand>& bound_event : bound_events_)
+	{
+		command_names.Add(bound_event.Key);
+		compiled_events_.Add(bound_event.Value);
+	}
+
+	command_table_.Build(command_names);
+	vote_aggregator_.ResetWindow();
+	user_throttle_.Reset();
+}
+
+bool UTwitchPlayComponent::AllowUserCommand(int32 _command_index, const FString& _message, int32 _user_handle)
+{
+	user_throttle_.SetCapacity(user_table_capacity_);
+	user_throttle_.SetRules(user_commands_per_window_, user_window_seconds_, duplicate_window_seconds_);
+
+	// The handle already survives renames when tags are requested
+	return user_throttle_.AllowCommand(static_cast<uint64>(_user_handle), _command_index, FCrc::StrCrc32(*_message), FPlatformTime::Seconds());
+}
+
+void UTwitchPlayComponent::IgnoreUser(const FString _username)
+{
+	const FString username = _username.ToLower();
+	if (!ignored_users_.Contains(username))
+	{
+		ignored_users_.Add(username);
+	}
+	ignored_user_keys_.Add(FTwitchUserThrottle::HashUser(username));
+}
+
+bool UTwitchPlayComponent::UnignoreUser(const FString _username)
+{
+	const FString username = _username.ToLower();
+	const int32 removed_users = ignored_users_.RemoveAll([&username](const FString& _ignored_user) { return _ignored_user.Equals(username, ESearchCase::IgnoreCase); });
+	ignored_user_keys_.Remove(FTwitchUserThrottle::HashUser(username));
+	return removed_users > 0;
+}
+
+void UTwitchPlayComponent::ResetUserThrottle()
+{
+	user_throttle_.Reset();
+}
+
+void UTwitchPlayComponent::SetKeywords(const TArray<FString>& _keywords, bool _b_case_sensitive, bool _b_whole_words)
+{
+	keywords_ = _keywords;
+	b_keywords_case_sensitive_ = _b_case_sensitive;
+	b_keywords_whole_words_ = _b_whole_words;
+	keyword_matcher_.Build(keywords_, b_keywords_case_sensitive_, b_keywords_whole_words_);
+}
+
+FString UTwitchPlayComponent::GetKeyword(int32 _keyword_index) const
+{
+	return _keyword_index >= 0 && _keyword_index < keyword_matcher_.Num() ? keyword_matcher_.GetKeyword(_keyword_index) : FString();
+}
+
+void UTwitchPlayComponent::MatchKeywords(const FString& _message, const FString& _username, int32 _user_handle)
+{
+	keyword_hits_.Reset();
+	{
+		SCOPE_CYCLE_COUNTER(STAT_TwitchPlay_MatchKeywords);
+		keyword_matcher_.Scan(*_message, _message.Len(), keyword_hits_);
+	}
+
+	if (keyword_hits_.Num() > 0)
+	{
+		FTwitchPlayStats::Add(ETwitchPlayCounter::KeywordHits, keyword_hits_.Num());
+		OnKeywordsMatched.Broadcast(_message, keyword_hits_, _username, _user_handle);
+	}
+}
+
+void UTwitchPlayComponent::GetTrending(ETwitchTrendCategory _category, int32 _max_entries, TArray<FTwitchTrendEntry>& _out_entries)
+{
+	GetTrendTracker(_category).GetTop(FPlatformTime::Seconds(), _max_entries, _out_entries);
+}
+
+void UTwitchPlayComponent::ResetTrends()
+{
+	for (FTwitchTrendTracker& trend_tracker : trend_trackers_)
+	{
+		trend_tracker.Reset();
+	}
+}
+
+FTwitchTrendTracker& UTwitchPlayComponent::GetTrendTracker(ETwitchTrendCategory _category)
+{
+	FTwitchTrendTracker& trend_tracker = trend_trackers_[FMath::Clamp(static_cast<int32>(_category), 0, static_cast<int32>(ARRAY_COUNT(trend_trackers_)) - 1)];
+	trend_tracker.SetWindow(trend_window_seconds_);
+	return trend_tracker;
+}
+
+void UTwitchPlayComponent::CountMessageTrends(const FString& _message, int32 _user_handle, double _now)
+{
+	if (_user_handle != INDEX_NONE)
+	{
+		GetTrendTracker(ETwitchTrendCategory::Users).Add(static_cast<uint64>(_user_handle), _now, [_user_handle]() { return GetUserDisplayName(_user_handle); });
+	}
+
+	// "emotes=25:0-4,12-16/1902:6-10": every emote ID, then the ranges of the message it takes
+	FTwitchIRCStringView emotes;
+	if (!GetMessageTags().FindRaw("emotes", emotes) || emotes.IsEmpty())
+	{
+		return;
+	}
+
+	FTwitchTrendTracker& emote_tracker = GetTrendTracker(ETwitchTrendCategory::Emotes);
+	int32 emote_start = 0;
+	while (emote_start < emotes.Len())
+	{
+		int32 emote_end = emotes.Find('/', emote_start);
+		if (emote_end == INDEX_NONE)
+		{
+			emote_end = emotes.Len();
+		}
+
+		const int32 colon_index = emotes.Find(':', emote_start);
+		if (colon_index != INDEX_NONE && colon_index < emote_end)
+		{
+			const FTwitchIRCStringView emote_id = emotes.Mid(emote_start, colon_index - emote_start);
+			const uint64 emote_key = CityHash64(emote_id.GetData(), emote_id.Len());
+
+			// Named after its first range, in code points
+			const FTwitchIRCStringView first_range = emotes.Mid(colon_index + 1, emote_end - colon_index - 1);
+			auto make_name = [&_message, &emote_id, &first_range]()
+			{
+				const int32 dash_index = first_range.Find('-');
+				const int32 comma_index = first_range.Find(',');
+				if (dash_index != INDEX_NONE)
+				{
+					const int32 first_code_point = FCString::Atoi(*first_range.Mid(0, dash_index).ToString());
+					const int32 last_code_point = FCString::Atoi(*first_range.Mid(dash_index + 1, comma_index != INDEX_NONE ? comma_index - dash_index - 1 : MAX_int32).ToString());
+					int32 name_start;
+					int32 name_length;
+					if (FindCodePointRange(_message, first_code_point, last_code_point, name_start, name_length))
+					{
+						return _message.Mid(name_start, name_length);
+					}
+				}
+				return emote_id.ToString();
+			};
+
+			// Every use of the emote counts
+			for (int32 cycle_char = colon_index; cycle_char < emote_end; ++cycle_char)
+			{
+				if (emotes[cycle_char] == ':' || emotes[cycle_char] == ',')
+				{
+					emote_tracker.Add(emote_key, _now, make_name);
+				}
+			}
+		}
+		emote_start = emote_end + 1;
+	}
+}
+
+void UTwitchPlayComponent::CountCommandTrends(int32 _command_index, const FString& _message, double _now)
+{
+	const FString& command_name = command_table_.GetCommandName(_command_index);
+	const uint64 command_key = FTwitchTrendTracker::HashName(*command_name, command_name.Len());
+	GetTrendTracker(ETwitchTrendCategory::Commands).Add(command_key, _now, [&command_name]() { return command_name; });
+
+	// Options are hashed in place. The name, as chat writes it, is only built for the top entries
+	int32 options_start = 0;
+	int32 options_length = 0;
+	if (FTwitchCommandSchemaParser::FindDelimited(*_message, _message.Len(), *options_encapsulation_char_, options_encapsulation_char_.Len(), options_start, options_length) && options_length > 0)
+	{
+		const uint64 options_key = command_key * 31 + FTwitchTrendTracker::HashName(*_message + options_start, options_length);
+		GetTrendTracker(ETwitchTrendCategory::CommandOptions).Add(options_key, _now, [&]()
+		{
+			return command_encapsulation_char_ + command_name + command_encapsulation_char_ + options_encapsulation_char_ + _message.Mid(options_start, options_length) + options_encapsulation_char_;
+		});
+	}
+}
+
+void UTwitchPlayComponent::RebuildIgnoredUsers()
+{
+	ignored_user_keys_.Reset();
+	for (const FString& ignored_user : ignored_users_)
+	{
+		ignored_user_keys_.Add(FTwitchUserThrottle::HashUser(ignored_user.ToLower()));
+	}
+}
+
+void UTwitchPlayComponent::BeginPlay()
+{
+	Super::BeginPlay();
+
+	RebuildIgnoredUsers();
+	keyword_matcher_.Build(keywords_, b_keywords_case_sensitive_, b_keywords_whole_words_);
+
+	// The batches are RPCs of this component
+	if (b_server_authoritative_)
+	{
+		SetIsReplicated(true);
+	}
+}
+
+bool UTwitchPlayComponent::ShouldIngestChat() const
+{
+	return !b_server_authoritative_ || GetNetMode() != NM_Client;
+}
+
+bool UTwitchPlayComponent::IsReplicatingCommands() const
+{
+	if (!b_server_authoritative_)
+	{
+		return false;
+	}
+	const ENetMode net_mode = GetNetMode();
+	return net_mode == NM_DedicatedServer || net_mode == NM_ListenServer;
+}
+
+void UTwitchPlayComponent::QueueReplicatedCommand(int32 _command_index, const FTwitchCommandArgs& _command_args, const FString& _message, const FString& _username, int32 _user_handle)
+{
+	if (pending_batch_commands_.Num() >= MaxPendingBatchCommands)
+	{
+		FTwitchPlayStats::Add(ETwitchPlayCounter::CommandsDropped, 1);
+		return;
+	}
+
+	FTwitchBatchedCommand& command = pending_batch_commands_[pending_batch_commands_.AddDefaulted()];
+	command.command_name_ = command_table_.GetCommandName(_command_index);
+	command.user_handle_ = _user_handle;
+	command.username_ = _username;
+	command.b_typed_ = compiled_events_[_command_index].schema_.IsValid();
+	if (command.b_typed_)
+	{
+		command.args_ = _command_args;
+	}
+	else
+	{
+		command.options_ = GetDelimitedString(_message, options_encapsulation_char_);
+	}
+}
+
+void UTwitchPlayComponent::SendCommandBatch()
+{
+	const double now = FPlatformTime::Seconds();
+	if (pending_batch_commands_.Num() == 0 || now < next_batch_time_)
+	{
+		return;
+	}
+	const AActor* owner = GetOwner();
+	next_batch_time_ = now + 1.0 / FMath::Max(owner != nullptr ? owner->NetUpdateFrequency : 1.0f, 1.0f);
+
+	command_batch_.Reset();
+	int32 num_batched_commands = 0;
+	while (num_batched_commands < pending_batch_commands_.Num() && command_batch_.Add(pending_batch_commands_[num_batched_commands], max_batch_bytes_))
+	{
+		++num_batched_commands;
+	}
+	// A single command bigger than a whole batch would block the others forever
+	if (num_batched_commands == 0)
+	{
+		FTwitchPlayStats::Add(ETwitchPlayCounter::CommandsDropped, 1);
+		pending_batch_commands_.RemoveAt(0, 1, false);
+		return;
+	}
+	pending_batch_commands_.RemoveAt(0, num_batched_commands, false);
+
+	last_batch_bytes_ = command_batch_.GetNumBytes();
+	FTwitchPlayStats::Add(ETwitchPlayCounter::CommandsReplicated, num_batched_commands);
+	FTwitchPlayStats::Add(ETwitchPlayCounter::BatchBytes, last_batch_bytes_);
+
+	MulticastCommandBatch(command_batch_);
+}
+
+void UTwitchPlayComponent::MulticastCommandBatch_Implementation(const FTwitchCommandBatch& _batch)
+{
+	if (!_batch.ForEachCommand([this](const FTwitchBatchedCommand& _command) { FireReplicatedCommand(_command); }))
+	{
+		UE_LOG(LogTwitchPlay, Warning, TEXT("Malformed command batch received, %d commands"), _batch.Num());
+	}
+}
+
+void UTwitchPlayComponent::FireReplicatedCommand(const FTwitchBatchedCommand& _command)
+{
+	const FRegisteredCommand* registered_command = bound_events_.Find(_command.command_name_);
+	if (registered_command == nullptr)
+	{
+		return;
+	}
+
+	// Delegates are copied since the handler could register or unregister commands
+	// A command registered differently than on the server (with or without a schema) can't be delivered
+	if (_command.b_typed_ && registered_command->schema_.IsValid())
+	{
+		const FOnTypedCommandReceived typed_command_event = registered_command->typed_event_;
+		typed_command_event.ExecuteIfBound(_command.command_name_, _command.args_, _command.username_, _command.user_handle_);
+	}
+	else if (!_command.b_typed_ && !registered_command->schema_.IsValid())
+	{
+		const FOnCommandReceived command_event = registered_command->event_;
+		TArray<FString> command_options;
+		_command.options_.ParseIntoArray(command_options, TEXT(","));
+		command_event.ExecuteIfBound(_command.command_name_, command_options, _command.username_, _command.user_handle_);
+	}
+}
+
+void UTwitchPlayComponent::MulticastVoteWindowClosed_Implementation(const FTwitchVoteWindowResult& _result)
+{
+	OnVoteWindowClosed.Broadcast(_result);
+}
+
+void UTwitchPlayComponent::CloseVoteWindow()
+{
+	// Outside vote mode there is no window. Clients of a server authoritative component count no votes:
+	// an empty result of theirs would read as a window nobody voted in, only the server results are fired there
+	if (!b_vote_mode_enabled_ || !ShouldIngestChat())
+	{
+		return;
+	}
+
+	const double now = FPlatformTime::Seconds();
+	const float window_duration = vote_window_start_time_ < 0.0 ? 0.0f : static_cast<float>(now - vote_window_start_time_);
+	vote_window_start_time_ = now;
+
+	FTwitchVoteWindowResult result;
+	vote_aggregator_.CloseWindow([this](int32 _command_index) -> const FString& { return command_table_.GetCommandName(_command_index); }, window_duration, result);
+	vote_aggregator_.SetRules(vote_policy_, vote_user_rule_); // Rule changes apply from the window starting now
+	if (IsReplicatingCommands())
+	{
+		MulticastVoteWindowClosed(result);
+		return;
+	}
+	OnVoteWindowClosed.Broadcast(result);
+}
+
+void UTwitchPlayComponent::TickComponent(float _delta_time, ELevelTick _tick_type, FActorComponentTickFunction* _this_tick_function)
+{
+	// Receives and dispatches the messages (and votes) of this frame
+	Super::TickComponent(_delta_time, _tick_type, _this_tick_function);
+
+	if (IsReplicatingCommands())
+	{
+		SendCommandBatch();
+	}
+
+	// Clients of a server authoritative component get the vote results from the server
+	if (!ShouldIngestChat())
+	{
+		return;
+	}
+
+	if (!b_vote_mode_enabled_)
+	{
+		// Votes of an interrupted window are discarded
+		if (vote_window_start_time_ >= 0.0)
+		{
+			vote_aggregator_.ResetWindow();
+			vote_window_start_time_ = -1.0;
+		}
+		return;
+	}
+
+	// The first window opens as soon as vote mode is enabled
+	const double now = FPlatformTime::Seconds();
+	if (vote_window_start_time_ < 0.0)
+	{
+		vote_window_start_time_ = now;
+		vote_aggregator_.SetRules(vote_policy_, vote_user_rule_);
+	}
+	else if (now - vote_window_start_time_ >= vote_window_seconds_)
+	{
+		CloseVoteWindow();
+	}
+}
+
+TArray<FString> UTwitchPlayComponent::GetCommandOptionsStrings(const FString & _message) const
+{
+	TArray<FString> ret_options = TArray<FString>();
+	GetCommandOptionsStrings(_message, ret_options);
+	return ret_options;
+}
+
+void UTwitchPlayComponent::GetCommandOptionsStrings(const FString & _message, TArray<FString>& _out_options) const
+{
+	int32 options_start;
+	int32 options_length;
+	if (!FTwitchCommandSchemaParser::FindDelimited(*_message, _message.Len(), *options_encapsulation_char_, options_encapsulation_char_.Len(), options_start, options_length))
+	{
+		_out_options.Reset();
+		return;
+	}
+
+	// Options are separated by commas, empty ones are skipped. Each is written over the string already at its index
+	const TCHAR* const options = *_message + options_start;
+	int32 num_options = 0;
+	int32 option_start = 0;
+	for (int32 cycle_char = 0; cycle_char <= options_length; ++cycle_char)
+	{
+		if (cycle_char < options_length && options[cycle_char] != TEXT(','))
+		{
+			continue;
+		}
+		if (cycle_char > option_start)
+		{
+			if (num_options == _out_options.Num())
+			{
+				_out_options.AddDefaulted();
+			}
+			FString& option = _out_options[num_options++];
+			option.Reset();
+			option.AppendChars(options + option_start, cycle_char - option_start);
+		}
+		option_start = cycle_char + 1;
+	}
+	_out_options.SetNum(num_options, false);
+}
+
+FString UTwitchPlayComponent::GetDelimitedString(const FString & _in_string, const FString & _delimiter) const
+{
+	// The same scanner as the schemas, so typed and untyped commands always agree on where the options are
+	int32 delimited_start;
+	int32 delimited_length;
+	if (!FTwitchCommandSchemaParser::FindDelimited(*_in_string, _in_string.Len(), *_delimiter, _delimiter.Len(), delimited_start, delimited_length))
+	{
+		return "";
+	}
+	return _in_string.Mid(delimited_start, delimited_length);
+}
+
+UTwitchPlayComponent::~UTwitchPlayComponent()
+{
+	// TODO: Maybe unbind everything from bound_events_?
+}
@@ -0,0 +1,202 @@
+// Copyright (C) Simone Di Gravio <email: altairjp@gmail.com> - All Rights Reserved
+
+#include "Net/TwitchIRCCapture.h"
+#include "Async/MappedFileHandle.h"
+#include "HAL/FileManager.h"
+#include "HAL/PlatformFilemanager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/ScopeLock.h"
+#include "Serialization/Archive.h"
+
+namespace
+{
+	// The buffer goes to the file once it grows past this size, or gets this old, so little is lost if the game crashes
+	const int32 FlushThresholdBytes = 256 * 1024;
+	const double FlushIntervalSeconds = 1.0;
+}
+
+void TwitchIRCCapture::WriteVarint(TArray<uint8>& _out_bytes, uint64 _value)
+{
+	while (_value >= 0x80)
+	{
+		_out_bytes.Add(static_cast<uint8>(_value | 0x80));
+		_value >>= 7;
+	}
+	_out_bytes.Add(static_cast<uint8>(_value));
+}
+
+bool TwitchIRCCapture::ReadVarint(const uint8*& _inout_cursor, const uint8* _end, uint64& _out_value)
+{
+	_out_value = 0;
+	for (int32 shift = 0; shift < 64 && _inout_cursor < _end; shift += 7)
+	{
+		const uint8 byte = *_inout_cursor++;
+		_out_value |= static_cast<uint64>(byte & 0x7F) << shift;
+		if ((byte & 0x80) == 0)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+FTwitchIRCCaptureWriter::FTwitchIRCCaptureWriter()
+{
+}
+
+FTwitchIRCCaptureWriter::~FTwitchIRCCaptureWriter()
+{
+	Flush();
+}
+
+bool FTwitchIRCCaptureWriter::Open(const FString& _file_path, FString& _out_error)
+{
+	FScopeLock lock(&lock_);
+
+	file_.Reset(IFileManager::Get().CreateFileWriter(*_file_path));
+	if (!file_.IsValid())
+	{
+		_out_error = FString::Printf(TEXT("Could not create the capture file %s"), *_file_path);
+		return false;
+	}
+
+	int64 start_ticks = FDateTime::UtcNow().GetTicks();
+	buffer_.Reset(FlushThresholdBytes + 64 * 1024);
+	buffer_.Append(reinterpret_cast<const uint8*>(TwitchIRCCapture::Magic), sizeof(TwitchIRCCapture::Magic));
+	buffer_.Append(reinterpret_cast<const uint8*>(&start_ticks), sizeof(start_ticks));
+	start_cycles_ = FPlatformTime::Cycles64();
+	last_flush_cycles_ = start_cycles_;
+	last_block_microseconds_ = 0;
+	return true;
+}
+
+void FTwitchIRCCaptureWriter::AppendBlock(uint64 _receive_cycles, int32 _num_lines, const TArray<uint8>& _encoded_lines)
+{
+	if (_num_lines == 0)
+	{
+		return;
+	}
+
+	FScopeLock lock(&lock_);
+	if (!file_.IsValid())
+	{
+		return;
+	}
+
+	const uint64 block_microseconds = _receive_cycles > start_cycles_ ? static_cast<uint64>(FPlatformTime::ToMilliseconds64(_receive_cycles - start_cycles_) * 1000.0) : 0;
+	const uint64 delta = block_microseconds > last_block_microseconds_ ? block_microseconds - last_block_microseconds_ : 0;
+	last_block_microseconds_ += delta;
+
+	TwitchIRCCapture::WriteVarint(buffer_, delta);
+	TwitchIRCCapture::WriteVarint(buffer_, static_cast<uint64>(_num_lines));
+	buffer_.Append(_encoded_lines);
+
+	if (buffer_.Num() >= FlushThresholdBytes || (_receive_cycles > last_flush_cycles_ && FPlatformTime::ToSeconds64(_receive_cycles - last_flush_cycles_) >= FlushIntervalSeconds))
+	{
+		FlushLocked();
+		last_flush_cycles_ = _receive_cycles;
+	}
+}
+
+void FTwitchIRCCaptureWriter::Flush()
+{
+	FScopeLock lock(&lock_);
+	FlushLocked();
+}
+
+void FTwitchIRCCaptureWriter::FlushLocked()
+{
+	if (file_.IsValid() && buffer_.Num() > 0)
+	{
+		file_->Serialize(buffer_.GetData(), buffer_.Num());
+		file_->Flush();
+	}
+	buffer_.Reset();
+}
+
+FTwitchIRCCaptureReader::FTwitchIRCCaptureReader()
+{
+}
+
+FTwitchIRCCaptureReader::~FTwitchIRCCaptureReader()
+{
+	// The region must be unmapped before its file is closed
+	mapped_region_.Reset();
+	mapped_file_.Reset();
+}
+
+bool FTwitchIRCCaptureReader::Open(const FString& _file_path, FString& _out_error)
+{
+	mapped_region_.Reset();
+	mapped_file_.Reset();
+	loaded_file_.Empty();
+
+	const uint8* data = nullptr;
+	int64 size = 0;
+
+	mapped_file_.Reset(FPlatformFileManager::Get().GetPlatformFile().OpenMapped(*_file_path));
+	if (mapped_file_.IsValid() && mapped_file_->GetFileSize() > 0)
+	{
+		mapped_region_.Reset(mapped_file_->MapRegion(0, mapped_file_->GetFileSize()));
+	}
+	if (mapped_region_.IsValid())
+	{
+		data = mapped_region_->GetMappedPtr();
+		size = mapped_region_->GetMappedSize();
+	}
+	else if (FFileHelper::LoadFileToArray(loaded_file_, *_file_path, FILEREAD_Silent))
+	{
+		data = loaded_file_.GetData();
+		size = loaded_file_.Num();
+	}
+	else
+	{
+		_out_error = FString::Printf(TEXT("Could not read the capture file %s"), *_file_path);
+		return false;
+	}
+
+	if (size < TwitchIRCCapture::HeaderSize || FMemory::Memcmp(data, TwitchIRCCapture::Magic, sizeof(TwitchIRCCapture::Magic)) != 0)
+	{
+		_out_error = FString::Printf(TEXT("%s is not a TwitchPlay capture"), *_file_path);
+		return false;
+	}
+
+	int64 start_ticks;
+	FMemory::Memcpy(&start_ticks, data + sizeof(TwitchIRCCapture::Magic), sizeof(start_ticks));
+	start_time_ = FDateTime(start_ticks);
+
+	cursor_ = data + TwitchIRCCapture::HeaderSize;
+	end_ = data + size;
+	block_microseconds_ = 0;
+	block_lines_left_ = 0;
+	return true;
+}
+
+bool FTwitchIRCCaptureReader::NextLine(double& _out_time, const ANSICHAR*& _out_line, int32& _out_length)
+{
+	while (block_lines_left_ == 0)
+	{
+		uint64 delta;
+		if (cursor_ >= end_ || !TwitchIRCCapture::ReadVarint(cursor_, end_, delta) || !TwitchIRCCapture::ReadVarint(cursor_, end_, block_lines_left_))
+		{
+			cursor_ = end_;
+			return false;
+		}
+		block_microseconds_ += delta;
+	}
+
+	uint64 length;
+	if (!TwitchIRCCapture::ReadVarint(cursor_, end_, length) || length > static_cast<uint64>(end_ - cursor_))
+	{
+		cursor_ = end_;
+		block_lines_left_ = 0;
+		return false;
+	}
+
+	--block_lines_left_;
+	_out_time = block_microseconds_ / 1000000.0;
+	_out_line = reinterpret_cast<const ANSICHAR*>(cursor_);
+	_out_length = static_cast<int32>(length);
+	cursor_ += length;
+	return true;
+}
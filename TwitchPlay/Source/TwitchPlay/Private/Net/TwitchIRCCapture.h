@@ -0,0 +1,146 @@
+// Copyright (C) Simone Di Gravio <email: altairjp@gmail.com> - All Rights Reserved
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/CriticalSection.h"
+#include "Templates/UniquePtr.h"
+
+class FArchive;
+class IMappedFileHandle;
+class IMappedFileRegion;
+
+/**
+ * Chat capture files: the lines received from the server with the time they were read from the socket,
+ * to replay a stream deterministically without a socket (see FTwitchIRCCaptureReader).
+ *
+ * Layout, little endian, varints are unsigned LEB128:
+ * - Header: the 8 bytes "TPCAP001", then the UTC start time of the capture as int64 FDateTime ticks.
+ * - Blocks, one per socket read: varint microseconds since the previous block, varint amount of lines,
+ *   then every line as a varint length followed by its bytes, without terminator.
+ */
+namespace TwitchIRCCapture
+{
+	const ANSICHAR Magic[8] = { 'T', 'P', 'C', 'A', 'P', '0', '0', '1' };
+
+	const int32 HeaderSize = 16;
+
+	// Appends an unsigned LEB128 varint
+	void WriteVarint(TArray<uint8>& _out_bytes, uint64 _value);
+
+	// Reads an unsigned LEB128 varint, advancing _inout_cursor. Returns false if the data ends first
+	bool ReadVarint(const uint8*& _inout_cursor, const uint8* _end, uint64& _out_value);
+}
+
+/**
+ * Appends the lines received by connections to a capture file.
+ * Shared by every connection of a pool: each connection encodes the lines of a read into a block on its own thread,
+ * and only the append takes the lock. Writes go to the file in large chunks.
+ */
+class FTwitchIRCCaptureWriter
+{
+public:
+
+	FTwitchIRCCaptureWriter();
+
+	// Flushes and closes the file
+	~FTwitchIRCCaptureWriter();
+
+	/**
+	 * Creates the file (and its directories) and writes the header. Replaces any existing file.
+	 *
+	 * @param _file_path - Full path of the capture.
+	 * @param _out_error - Why the file could not be created.
+	 *
+	 * @return Whether the file is open.
+	 */
+	bool Open(const FString& _file_path, FString& _out_error);
+
+	/**
+	 * Appends the lines of a socket read. Any thread.
+	 *
+	 * @param _receive_cycles - When the lines were read (FPlatformTime::Cycles64).
+	 * @param _num_lines - Amount of lines in _encoded_lines.
+	 * @param _encoded_lines - The lines, each one as a varint length followed by its bytes.
+	 */
+	void AppendBlock(uint64 _receive_cycles, int32 _num_lines, const TArray<uint8>& _encoded_lines);
+
+	// Writes everything buffered to the file. Any thread
+	void Flush();
+
+private:
+
+	// Writes the buffer to the file. Must hold lock_
+	void FlushLocked();
+
+	FCriticalSection lock_;
+
+	TUniquePtr<FArchive> file_;
+
+	TArray<uint8> buffer_;
+
+	uint64 start_cycles_ = 0;
+
+	uint64 last_flush_cycles_ = 0;
+
+	// Time of the last block, in microseconds since the start. Blocks appended out of order by different threads are clamped
+	uint64 last_block_microseconds_ = 0;
+};
+
+/**
+ * Reads a capture file, memory mapped when the platform allows it so multi hour captures are never loaded whole.
+ * Lines are read in order with their receive time. Single thread.
+ */
+class FTwitchIRCCaptureReader
+{
+public:
+
+	FTwitchIRCCaptureReader();
+
+	~FTwitchIRCCaptureReader();
+
+	/**
+	 * Maps the file and checks its header.
+	 *
+	 * @param _file_path - Full path of the capture.
+	 * @param _out_error - Why the file could not be read.
+	 *
+	 * @return Whether lines can be read.
+	 */
+	bool Open(const FString& _file_path, FString& _out_error);
+
+	/**
+	 * Reads the next line. A truncated last block (like a capture cut short by a crash) ends the capture.
+	 *
+	 * @param _out_time - Seconds between the start of the capture and the read of the line.
+	 * @param _out_line - Start of the line. Valid as long as the reader.
+	 * @param _out_length - Length of the line in bytes.
+	 *
+	 * @return False once every line was read.
+	 */
+	bool NextLine(double& _out_time, const ANSICHAR*& _out_line, int32& _out_length);
+
+	// UTC time the capture started at
+	FDateTime GetStartTime() const { return start_time_; }
+
+private:
+
+	TUniquePtr<IMappedFileHandle> mapped_file_;
+
+	TUniquePtr<IMappedFileRegion> mapped_region_;
+
+	// Used when the platform can't map files
+	TArray<uint8> loaded_file_;
+
+	const uint8* cursor_ = nullptr;
+
+	const uint8* end_ = nullptr;
+
+	FDateTime start_time_;
+
+	// Time of the current block, in microseconds since the start
+	uint64 block_microseconds_ = 0;
+
+	// Lines left in the current block
+	uint64 block_lines_left_ = 0;
+};
@@ -0,0 +1,666 @@
+// Copyright (C) Simone Di Gravio <email: altairjp@gmail.com> - All Rights Reserved
+
+#include "Net/TwitchIRCConnection.h"
+#include "Net/TwitchIRCLine.h"
+#include "Net/TwitchIRCCapture.h"
+#include "Net/TwitchIRCUserRegistry.h"
+#include "Net/TwitchIRCUtf8.h"
+#include "HAL/RunnableThread.h"
+#include "HAL/PlatformProcess.h"
+#include "Misc/ScopeLock.h"
+#include "Sockets.h"
+#include "SocketSubsystem.h"
+#include "IPAddress.h"
+#include "Stats/TwitchPlayStats.h"
+
+namespace
+{
+	// How long the thread blocks waiting for data before checking the send queue (and whether it was asked to stop)
+	// This is the worst case latency of a queued line
+	const double WaitTimeoutMs = 10.0;
+
+	// Seconds to wait for the socket to connect, and for the server welcome after sending the credentials
+	const double ConnectTimeout = 10.0;
+	const double AuthenticationTimeout = 10.0;
+
+	// Sleep while there is nothing to do (waiting to reconnect, or for new credentials)
+	const float IdleSleepSeconds = 0.05f;
+}
+
+FTwitchIRCConnection::FTwitchIRCConnection(const FSettings& _settings)
+	: settings_(_settings)
+	, backoff_random_(static_cast<int32>(FPlatformTime::Cycles()))
+{
+	state_.Set(static_cast<int32>(ETwitchConnectionState::Disconnected));
+	if (settings_.rate_limiter_.IsValid())
+	{
+		GetSendQueue().SetRateLimiter(settings_.rate_limiter_.ToSharedRef());
+	}
+	else
+	{
+		GetSendQueue().SetRateLimit(settings_.messages_per_window_, 30.0);
+	}
+
+	// Replays have no server to flood, their channels are all joined at once
+	if (!IsReplay())
+	{
+		session_.SetJoinLimiter(settings_.join_limiter_.IsValid() ? settings_.join_limiter_.ToSharedRef() : FTwitchIRCSession::MakeJoinLimiter());
+	}
+
+	const FTCHARToUTF8 command_marker(*settings_.overload_command_marker_);
+	command_marker_.Append(command_marker.Get(), command_marker.Length());
+}
+
+FTwitchIRCConnection::~FTwitchIRCConnection()
+{
+	Shutdown();
+}
+
+bool FTwitchIRCConnection::Start()
+{
+	if (thread_ != nullptr)
+	{
+		return true;
+	}
+
+	thread_ = FRunnableThread::Create(this, TEXT("TwitchIRCConnection"), 0, TPri_Normal);
+	return thread_ != nullptr;
+}
+
+void FTwitchIRCConnection::Shutdown()
+{
+	if (thread_ != nullptr)
+	{
+		// Kill(true) calls Stop() and then waits for Run() to return
+		thread_->Kill(true);
+		delete thread_;
+		thread_ = nullptr;
+	}
+
+	CloseSocket();
+}
+
+void FTwitchIRCConnection::Authenticate(const FString& _oauth, const FString& _username, bool _b_request_tags)
+{
+	FScopeLock settings_lock(&settings_lock_);
+	oauth_token_ = _oauth;
+	username_ = _username;
+	b_request_tags_ = _b_request_tags;
+	b_has_credentials_ = true;
+	b_credentials_changed_ = true;
+}
+
+void FTwitchIRCConnection::JoinChannel(int32 _channel_id, const FString& _channel)
+{
+	check(_channel_id >= 0);
+
+	FScopeLock settings_lock(&settings_lock_);
+	if (channel_names_.Num() <= _channel_id)
+	{
+		channel_names_.SetNum(_channel_id + 1);
+		wanted_channels_.Add(false, _channel_id + 1 - wanted_channels_.Num());
+	}
+	channel_names_[_channel_id] = _channel.ToLower();
+	wanted_channels_[_channel_id] = true;
+	b_channels_changed_ = true;
+}
+
+void FTwitchIRCConnection::PartChannel(int32 _channel_id)
+{
+	FScopeLock settings_lock(&settings_lock_);
+	if (wanted_channels_.IsValidIndex(_channel_id))
+	{
+		wanted_channels_[_channel_id] = false;
+		b_channels_changed_ = true;
+	}
+}
+
+bool FTwitchIRCConnection::DequeueMessage(FTwitchIRCReceivedMessage& _out_message)
+{
+	FQueuedMessage queued_message;
+	if (!message_queue_.Dequeue(queued_message))
+	{
+		return false;
+	}
+	num_queued_messages_.Decrement();
+
+	// Replacing the reference releases the previous message. The content is decoded here, on the game thread, into the reused string
+	_out_message.storage_ = FTwitchIRCArenaReference(message_arena_, queued_message.block_);
+	TwitchIRCUtf8::DecodeInto(queued_message.data_, queued_message.content_length_, _out_message.content_);
+	_out_message.raw_tags_ = FTwitchIRCStringView(queued_message.data_ + queued_message.content_length_, queued_message.tags_length_);
+	_out_message.user_handle_ = queued_message.user_handle_;
+	_out_message.username_ = queued_message.username_;
+	_out_message.channel_id_ = queued_message.channel_id_;
+	_out_message.receive_cycles_ = queued_message.receive_cycles_;
+	return true;
+}
+
+int32 FTwitchIRCConnection::DiscardOldestMessages(int32 _max_messages)
+{
+	// Discarded messages are never decoded
+	int32 discarded_messages = 0;
+	FQueuedMessage queued_message;
+	while (num_queued_messages_.GetValue() > _max_messages && message_queue_.Dequeue(queued_message))
+	{
+		num_queued_messages_.Decrement();
+		message_arena_.Release(queued_message.block_);
+		++discarded_messages;
+	}
+	return discarded_messages;
+}
+
+bool FTwitchIRCConnection::DequeueStateChange(FTwitchIRCStateChange& _out_state_change)
+{
+	return state_changes_.Dequeue(_out_state_change);
+}
+
+uint32 FTwitchIRCConnection::Run()
+{
+	if (IsReplay())
+	{
+		RunReplay();
+		return 0;
+	}
+
+	BeginConnect();
+
+	while (!b_stop_requested_)
+	{
+		switch (GetState())
+		{
+		case ETwitchConnectionState::Resolving:
+			BeginConnect();
+			break;
+
+		case ETwitchConnectionState::Connecting:
+			UpdateConnecting();
+			break;
+
+		case ETwitchConnectionState::Connected:
+		case ETwitchConnectionState::Authenticating:
+		case ETwitchConnectionState::Joined:
+			UpdateSession();
+			break;
+
+		case ETwitchConnectionState::WaitingToReconnect:
+			if (FPlatformTime::Seconds() >= next_attempt_time_)
+			{
+				SetState(ETwitchConnectionState::Resolving);
+			}
+			else
+			{
+				FPlatformProcess::Sleep(IdleSleepSeconds);
+			}
+			break;
+
+		case ETwitchConnectionState::AuthenticationFailed:
+		{
+			// Only new credentials are worth another attempt
+			bool b_retry;
+			{
+				FScopeLock settings_lock(&settings_lock_);
+				b_retry = b_credentials_changed_;
+			}
+			if (b_retry)
+			{
+				reconnect_attempts_ = 0;
+				SetState(ETwitchConnectionState::Resolving);
+			}
+			else
+			{
+				FPlatformProcess::Sleep(IdleSleepSeconds);
+			}
+			break;
+		}
+
+		default:
+			FPlatformProcess::Sleep(IdleSleepSeconds);
+			break;
+		}
+	}
+
+	CloseSocket();
+	return 0;
+}
+
+void FTwitchIRCConnection::Stop()
+{
+	b_stop_requested_ = true;
+}
+
+void FTwitchIRCConnection::BeginConnect()
+{
+	SetState(ETwitchConnectionState::Resolving);
+
+	ISocketSubsystem* sss = ISocketSubsystem::Get(PLATFORM_SOCKETSUBSYSTEM);
+	TSharedRef<FInternetAddr> connection_addr = sss->CreateInternetAddr();
+
+	// Numeric addresses (like a local test server) don't need name resolution
+	bool b_is_ip = false;
+	connection_addr->SetIp(*settings_.host_, b_is_ip);
+	if (!b_is_ip && sss->GetHostByName(TCHAR_TO_ANSI(*settings_.host_), *connection_addr) != SE_NO_ERROR)
+	{
+		ScheduleReconnect("Could not resolve hostname!");
+		return;
+	}
+	connection_addr->SetPort(settings_.port_);
+
+	socket_ = sss->CreateSocket(NAME_Stream, TEXT("TwitchPlay Socket"), false);
+
+	// Socket creation might fail on certain subsystems
+	if (socket_ == nullptr)
+	{
+		ScheduleReconnect("Could not create socket!");
+		return;
+	}
+
+	// Setting underlying connection parameters
+	// The socket is non blocking, so neither connecting nor sending ever stalls this thread
+	int32 out_size;
+	socket_->SetReceiveBufferSize(2 * 1024 * 1024, out_size);
+	socket_->SetReuseAddr(true);
+	socket_->SetNonBlocking(true);
+
+	// A non blocking connect only fails right away for invalid addresses. Completion is checked in UpdateConnecting
+	if (!socket_->Connect(*connection_addr))
+	{
+		ScheduleReconnect("Connection to Twitch IRC failed!");
+		return;
+	}
+
+	state_deadline_ = FPlatformTime::Seconds() + ConnectTimeout;
+	SetState(ETwitchConnectionState::Connecting);
+}
+
+void FTwitchIRCConnection::UpdateConnecting()
+{
+	// A socket becomes writable once connected
+	socket_->Wait(ESocketWaitConditions::WaitForWrite, FTimespan::FromMilliseconds(WaitTimeoutMs));
+
+	const ESocketConnectionState socket_state = socket_->GetConnectionState();
+	if (socket_state == ESocketConnectionState::SCS_Connected)
+	{
+		// Nothing from the previous session must leak into this one
+		session_.Begin();
+		b_channels_changed_ = true; // Every channel is joined again
+		SetState(ETwitchConnectionState::Connected);
+	}
+	else if (socket_state == ESocketConnectionState::SCS_ConnectionError)
+	{
+		ScheduleReconnect("Connection to Twitch IRC failed!");
+	}
+	else if (FPlatformTime::Seconds() > state_deadline_)
+	{
+		ScheduleReconnect("Connection to Twitch IRC timed out!");
+	}
+}
+
+void FTwitchIRCConnection::UpdateSession()
+{
+	const ETwitchConnectionState state = GetState();
+
+	if (state == ETwitchConnectionState::Connected)
+	{
+		SendAuthentication();
+	}
+	else if (state == ETwitchConnectionState::Authenticating && FPlatformTime::Seconds() > state_deadline_)
+	{
+		ScheduleReconnect("Twitch IRC did not answer the authentication!");
+		return;
+	}
+	else if (state == ETwitchConnectionState::Joined)
+	{
+		SyncChannels();
+	}
+
+	// Block until the socket is readable instead of polling HasPendingData
+	if (socket_->Wait(ESocketWaitConditions::WaitForRead, FTimespan::FromMilliseconds(WaitTimeoutMs)) && !ReceiveLines())
+	{
+		ScheduleReconnect("Connection closed by the server");
+		return;
+	}
+
+	// Handling a line can close the socket (RECONNECT, failed authentication)
+	if (socket_ == nullptr)
+	{
+		return;
+	}
+
+	// The socket is non blocking: a send that would block is not an error, the rest goes out on the next flush
+	auto send_to_socket = [this](const uint8* _data, int32 _size, int32& _out_sent)
+	{
+		if (socket_->Send(_data, _size, _out_sent))
+		{
+			FTwitchPlayStats::Add(ETwitchPlayCounter::BytesOut, _out_sent);
+			return true;
+		}
+		_out_sent = 0;
+		return ISocketSubsystem::Get(PLATFORM_SOCKETSUBSYSTEM)->GetLastErrorCode() == SE_EWOULDBLOCK;
+	};
+
+	// Queued lines (chat) only go out once authenticated
+	if (!session_.Flush(FPlatformTime::Seconds(), send_to_socket))
+	{
+		ScheduleReconnect("Connection lost while sending");
+	}
+}
+
+bool FTwitchIRCConnection::ReceiveLines()
+{
+	SCOPE_CYCLE_COUNTER(STAT_TwitchPlay_Receive);
+
+	// Receive straight into the free space of the ring buffer
+	uint8* receive_region;
+	int32 receive_region_size;
+	session_.GetWritableRegion(receive_region, receive_region_size);
+
+	int32 data_read = 0;
+	if (!socket_->Recv(receive_region, receive_region_size, data_read))
+	{
+		// A readable stream socket that fails to Recv has been closed by the server (or errored)
+		return false;
+	}
+	receive_cycles_ = FPlatformTime::Cycles64();
+	FTwitchPlayStats::Add(ETwitchPlayCounter::BytesIn, data_read);
+
+	capture_lines_.Reset();
+	num_captured_lines_ = 0;
+	const int32 lines_parsed = session_.ReceiveBytes(nullptr, data_read, *this);
+	FTwitchPlayStats::Add(ETwitchPlayCounter::LinesParsed, lines_parsed);
+
+	if (num_captured_lines_ > 0)
+	{
+		settings_.capture_writer_->AppendBlock(receive_cycles_, num_captured_lines_, capture_lines_);
+	}
+	return true;
+}
+
+void FTwitchIRCConnection::RunReplay()
+{
+	FTwitchIRCCaptureReader reader;
+	FString error;
+	if (!reader.Open(settings_.replay_file_, error))
+	{
+		SetState(ETwitchConnectionState::Disconnected, error);
+		return;
+	}
+
+	// Captured lines go through the same handling as received ones: the captured welcome line completes the authentication,
+	// channel messages are matched to the joined channels. Sent lines are dropped
+	session_.Begin();
+	SetState(ETwitchConnectionState::Authenticating);
+	auto discard_sent = [](const uint8* _data, int32 _size, int32& _out_sent)
+	{
+		_out_sent = _size;
+		return true;
+	};
+
+	const double replay_start_time = FPlatformTime::Seconds();
+	const float speed = settings_.replay_speed_;
+
+	double line_time;
+	const ANSICHAR* line_data;
+	int32 line_length;
+	bool b_has_line = reader.NextLine(line_time, line_data, line_length);
+
+	while (!b_stop_requested_ && b_has_line && GetState() != ETwitchConnectionState::AuthenticationFailed)
+	{
+		if (GetState() == ETwitchConnectionState::Joined)
+		{
+			SyncChannels();
+		}
+
+		// Sleep until the next line is due, waking up regularly to handle joins and stop requests
+		const double elapsed = FPlatformTime::Seconds() - replay_start_time;
+		if (speed > 0.0f && line_time / speed > elapsed)
+		{
+			FPlatformProcess::Sleep(static_cast<float>(FMath::Min(line_time / speed - elapsed, WaitTimeoutMs / 1000.0)));
+		}
+		else
+		{
+			// Every line due is handled as a single read. Unpaced replays go by chunks, to check for stop requests
+			receive_cycles_ = FPlatformTime::Cycles64();
+			int32 lines_read = 0;
+			int32 lines_parsed = 0;
+			int64 bytes_read = 0;
+			do
+			{
+				bytes_read += line_length + 2;
+				if (session_.ReceiveLine(line_data, line_length, *this))
+				{
+					++lines_parsed;
+				}
+				++lines_read;
+				b_has_line = reader.NextLine(line_time, line_data, line_length);
+			}
+			while (b_has_line && (speed > 0.0f ? line_time / speed <= elapsed : lines_read < 1024));
+
+			FTwitchPlayStats::Add(ETwitchPlayCounter::BytesIn, bytes_read);
+			FTwitchPlayStats::Add(ETwitchPlayCounter::LinesParsed, lines_parsed);
+		}
+
+		session_.Flush(FPlatformTime::Seconds(), discard_sent);
+	}
+
+	if (!b_stop_requested_ && GetState() != ETwitchConnectionState::AuthenticationFailed)
+	{
+		SetState(ETwitchConnectionState::Disconnected, TEXT("Replay finished"));
+	}
+	while (!b_stop_requested_)
+	{
+		FPlatformProcess::Sleep(IdleSleepSeconds);
+	}
+}
+
+void FTwitchIRCConnection::OnLineReceived(const ANSICHAR* _line, int32 _length)
+{
+	// Lines are captured as received, before any handling. Replayed lines already come from a capture
+	if (settings_.capture_writer_.IsValid() && !IsReplay())
+	{
+		TwitchIRCCapture::WriteVarint(capture_lines_, static_cast<uint64>(_length));
+		capture_lines_.Append(reinterpret_cast<const uint8*>(_line), _length);
+		++num_captured_lines_;
+	}
+}
+
+void FTwitchIRCConnection::OnLineParsed(uint64 _parse_cycles)
+{
+	FTwitchPlayStats::RecordLatency(ETwitchPlayLatency::Parse, _parse_cycles);
+}
+
+void FTwitchIRCConnection::OnRegistered()
+{
+	reconnect_attempts_ = 0;
+	SetState(ETwitchConnectionState::Joined);
+	SyncChannels();
+}
+
+void FTwitchIRCConnection::OnLoginFailed(const FString& _reason)
+{
+	CloseSocket();
+	SetState(ETwitchConnectionState::AuthenticationFailed, _reason);
+}
+
+void FTwitchIRCConnection::OnReconnectRequested()
+{
+	// Connect again right away (replays have nothing to reconnect to)
+	// Starting the session over drops the rest of what was received on the old socket
+	if (!IsReplay())
+	{
+		ScheduleReconnect("Twitch IRC asked to reconnect", true);
+		session_.Begin();
+	}
+}
+
+void FTwitchIRCConnection::OnMessage(const FTwitchIRCLine& _line, int32 _channel_id)
+{
+	// Only user messages (PRIVMSG) have a sender, interned so the username is only allocated the first time a user talks
+	if (!AdmitMessage(_line))
+	{
+		shed_messages_.Increment();
+		return;
+	}
+
+	// Content and tags are copied side by side in the arena, as received. Nothing is allocated for them once the arena has warmed up
+	FQueuedMessage message;
+	message.content_length_ = _line.trailing_.Len();
+	message.tags_length_ = _line.tags_.Len();
+	ANSICHAR* data = message_arena_.Allocate(message.content_length_ + message.tags_length_, message.block_);
+	if (message.content_length_ > 0)
+	{
+		FMemory::Memcpy(data, _line.trailing_.GetData(), message.content_length_);
+	}
+	if (message.tags_length_ > 0)
+	{
+		FMemory::Memcpy(data + message.content_length_, _line.tags_.GetData(), message.tags_length_);
+	}
+	message.data_ = data;
+	if (_line.IsUserMessage() && settings_.user_registry_.IsValid())
+	{
+		message.user_handle_ = settings_.user_registry_->InternUser(_line.nick_, _line.GetTags(), message.username_);
+	}
+	message.channel_id_ = _channel_id;
+	message.receive_cycles_ = receive_cycles_;
+	num_queued_messages_.Increment();
+	message_queue_.Enqueue(message);
+}
+
+bool FTwitchIRCConnection::AdmitMessage(const FTwitchIRCLine& _line)
+{
+	const int32 capacity = FMath::Max(settings_.inbound_capacity_, 1);
+	const int32 queued_messages = num_queued_messages_.GetValue();
+	if (queued_messages < capacity)
+	{
+		sampling_credit_ = 0.0f;
+		return true;
+	}
+
+	// The game thread is not keeping up at all (or not ticking, like during a loading screen). Memory stays bounded
+	if (queued_messages >= capacity * 2)
+	{
+		return false;
+	}
+
+	// The few server messages always go through
+	if (!_line.IsUserMessage())
+	{
+		return true;
+	}
+
+	switch (settings_.overload_policy_)
+	{
+	case ETwitchOverloadPolicy::UniformSampling:
+		// The kept share shrinks as the queue grows, so it settles where the game thread keeps up
+		sampling_credit_ += static_cast<float>(capacity * 2 - queued_messages) / capacity;
+		if (sampling_credit_ >= 1.0f)
+		{
+			sampling_credit_ -= 1.0f;
+			return true;
+		}
+		return false;
+
+	case ETwitchOverloadPolicy::CommandsOnly:
+	{
+		const int32 marker_length = command_marker_.Num();
+		const int32 last_start = _line.trailing_.Len() - marker_length;
+		for (int32 cycle_start = 0; cycle_start <= last_start; ++cycle_start)
+		{
+			if (FMemory::Memcmp(_line.trailing_.GetData() + cycle_start, command_marker_.GetData(), marker_length) == 0)
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	default:
+		// DropOldest: the game thread sheds the oldest messages down to the capacity before dispatching
+		return true;
+	}
+}
+
+void FTwitchIRCConnection::SendAuthentication()
+{
+	FString oauth_token;
+	FString username;
+	bool b_request_tags;
+	{
+		FScopeLock settings_lock(&settings_lock_);
+		if (!b_has_credentials_)
+		{
+			return; // Stay connected until AuthenticateTwitchIRC provides them
+		}
+		oauth_token = oauth_token_;
+		username = username_;
+		b_request_tags = b_request_tags_;
+		b_credentials_changed_ = false;
+	}
+
+	session_.Register(oauth_token, username, b_request_tags);
+
+	state_deadline_ = FPlatformTime::Seconds() + AuthenticationTimeout;
+	SetState(ETwitchConnectionState::Authenticating);
+}
+
+void FTwitchIRCConnection::SyncChannels()
+{
+	if (!b_channels_changed_ && !b_has_pending_joins_)
+	{
+		return;
+	}
+	// Cleared before reading the channels, so a change made meanwhile is picked up on the next call
+	b_channels_changed_ = false;
+
+	// Channels past the join budget are tried again on every update until they are all joined
+	FScopeLock settings_lock(&settings_lock_);
+	b_has_pending_joins_ = !session_.SyncChannels(channel_names_, wanted_channels_, FPlatformTime::Seconds());
+}
+
+void FTwitchIRCConnection::ScheduleReconnect(const FString& _reason, bool _b_server_requested)
+{
+	CloseSocket();
+
+	if (!settings_.b_auto_reconnect_)
+	{
+		SetState(ETwitchConnectionState::Disconnected, _reason);
+		return;
+	}
+
+	// Exponential backoff with jitter, so many clients dropped together don't all come back at the same time
+	// A RECONNECT from the server is not a failure: come back quickly
+	double delay = settings_.reconnect_initial_delay_;
+	if (!_b_server_requested)
+	{
+		delay = FMath::Min(settings_.reconnect_max_delay_, settings_.reconnect_initial_delay_ * FMath::Pow(2.0f, FMath::Min(reconnect_attempts_, 16)));
+		reconnect_attempts_++;
+	}
+	delay = delay * 0.5 + backoff_random_.FRandRange(0.0f, delay * 0.5);
+
+	next_attempt_time_ = FPlatformTime::Seconds() + delay;
+	SetState(ETwitchConnectionState::WaitingToReconnect, _reason);
+}
+
+void FTwitchIRCConnection::CloseSocket()
+{
+	if (socket_ != nullptr)
+	{
+		socket_->Close();
+		ISocketSubsystem::Get(PLATFORM_SOCKETSUBSYSTEM)->DestroySocket(socket_);
+		socket_ = nullptr;
+	}
+}
+
+void FTwitchIRCConnection::SetState(ETwitchConnectionState _state, const FString& _reason)
+{
+	if (GetState() == _state && _reason.IsEmpty())
+	{
+		return;
+	}
+
+	state_.Set(static_cast<int32>(_state));
+
+	FTwitchIRCStateChange state_change;
+	state_change.state_ = _state;
+	state_change.reason_ = _reason;
+	state_changes_.Enqueue(MoveTemp(state_change));
+}
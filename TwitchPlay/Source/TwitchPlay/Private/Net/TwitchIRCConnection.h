@@ -0,0 +1,352 @@
+// Copyright (C) Simone Di Gravio <email: altairjp@gmail.com> - All Rights Reserved
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/Runnable.h"
+#include "HAL/ThreadSafeBool.h"
+#include "HAL/ThreadSafeCounter.h"
+#include "HAL/CriticalSection.h"
+#include "Containers/Queue.h"
+#include "Math/RandomStream.h"
+#include "Net/TwitchIRCConnectionState.h"
+#include "Net/TwitchIRCOverloadPolicy.h"
+#include "Net/TwitchIRCSession.h"
+#include "Net/TwitchIRCMessageArena.h"
+
+class FSocket;
+class FRunnableThread;
+class FTwitchIRCCaptureWriter;
+class FTwitchIRCUserRegistry;
+
+/**
+ * A chat message parsed by the connection thread, ready to be broadcast on the game thread.
+ * Its bytes live in the arena of the connection until the next message is dequeued into it: copy what needs to be kept.
+ */
+struct FTwitchIRCReceivedMessage
+{
+	// Content of the message. Decoded into a string reused from message to message, so it keeps its allocation
+	FString content_;
+
+	// Interned handle of who sent the message (see FTwitchIRCUserRegistry). INDEX_NONE for server messages
+	int32 user_handle_ = INDEX_NONE;
+
+	// Interned username of the sender, owned by the user registry. Null for server messages
+	const FString* username_ = nullptr;
+
+	// Raw IRCv3 tags of the line, in the arena. Kept undecoded, see FTwitchIRCTags. Empty unless tags were requested
+	FTwitchIRCStringView raw_tags_;
+
+	// Interned ID of the channel the message was sent to (see JoinChannel). INDEX_NONE for server messages
+	int32 channel_id_ = INDEX_NONE;
+
+	// When the line was read from the socket (FPlatformTime::Cycles64), to measure the latency of the stages after it
+	uint64 receive_cycles_ = 0;
+
+	// Keeps the arena memory of raw_tags_ alive
+	FTwitchIRCArenaReference storage_;
+
+	// Username of the sender. Empty for server messages
+	const FString& GetUsername() const
+	{
+		static const FString NoUsername;
+		return username_ != nullptr ? *username_ : NoUsername;
+	}
+};
+
+/**
+ * A connection state change, queued for the game thread.
+ */
+struct FTwitchIRCStateChange
+{
+	ETwitchConnectionState state_;
+
+	// Why the state changed, for failures. Empty otherwise
+	FString reason_;
+};
+
+/**
+ * Connection to a Twitch IRC server running entirely on its own thread.
+ * The thread resolves the server, connects, authenticates and joins the channels without ever blocking the game thread.
+ * The protocol itself is handled by a FTwitchIRCSession (TwitchPlayCore): the connection owns the socket and pumps it.
+ * Any number of channels can be joined on the same connection. Every message carries the interned ID of its channel.
+ * When the connection drops (or the server asks to RECONNECT) it waits with a jittered exponential backoff and
+ * starts over, authenticating and joining the same channels again.
+ *
+ * While connected it blocks until the socket becomes readable, parses the incoming lines and pushes the resulting
+ * messages into a single producer/single consumer lock-free queue that the game thread drains once per tick.
+ * The bytes of the queued messages live in an arena whose blocks go back to the connection thread once dispatched.
+ * The queue is bounded: past its capacity messages are shed as the overload policy says, before they are even built.
+ * The same thread writes the lines queued in the send queue, so the socket is only ever used by this thread.
+ */
+class FTwitchIRCConnection : public FRunnable, private ITwitchIRCSessionHandler
+{
+public:
+
+	struct FSettings
+	{
+		FString host_ = TEXT("irc.twitch.tv");
+
+		int32 port_ = 6667;
+
+		// Chat budget, see FTwitchIRCRateLimiter::SetRateLimit. Ignored if rate_limiter_ is set
+		int32 messages_per_window_ = 20;
+
+		// Chat budget shared with the other connections of the same account. Optional
+		TSharedPtr<FTwitchIRCRateLimiter, ESPMode::ThreadSafe> rate_limiter_;
+
+		// Join budget shared with the other connections of the same account, see FTwitchIRCSession::MakeJoinLimiter. Optional
+		TSharedPtr<FTwitchIRCRateLimiter, ESPMode::ThreadSafe> join_limiter_;
+
+		bool b_auto_reconnect_ = true;
+
+		// Delay before the first reconnection attempt. Doubles on every failed attempt
+		double reconnect_initial_delay_ = 1.0;
+
+		double reconnect_max_delay_ = 60.0;
+
+		// Every received line is appended to this capture, with its receive time. Optional, shared by the connections of a pool
+		TSharedPtr<FTwitchIRCCaptureWriter, ESPMode::ThreadSafe> capture_writer_;
+
+		// Capture replayed instead of connecting to the server. Empty to connect
+		FString replay_file_;
+
+		// Speed of the replay: 1 for real time, 2 for twice as fast... 0 for as fast as possible
+		float replay_speed_ = 1.0f;
+
+		// Interns the senders of the messages. Shared by every connection
+		TSharedPtr<FTwitchIRCUserRegistry, ESPMode::ThreadSafe> user_registry_;
+
+		// Messages waiting for the game thread past which the overload policy applies
+		int32 inbound_capacity_ = 10000;
+
+		ETwitchOverloadPolicy overload_policy_ = ETwitchOverloadPolicy::DropOldest;
+
+		// Messages kept by ETwitchOverloadPolicy::CommandsOnly contain this
+		FString overload_command_marker_ = TEXT("!");
+	};
+
+	explicit FTwitchIRCConnection(const FSettings& _settings);
+
+	// Stops the thread if it is still running
+	virtual ~FTwitchIRCConnection();
+
+	/**
+	 * Creates the connection thread, which starts connecting right away.
+	 *
+	 * @return Whether the thread was created.
+	 */
+	bool Start();
+
+	// Asks the thread to stop and waits for it to finish. The socket is closed. Safe to call multiple times.
+	void Shutdown();
+
+	/**
+	 * Provides the credentials. The thread authenticates as soon as the socket is connected, and again after every reconnection.
+	 * Can be called from any thread. New credentials also restart a connection whose authentication failed.
+	 *
+	 * @param _oauth - Oauth token.
+	 * @param _username - Username to login with.
+	 * @param _b_request_tags - Whether to request the IRCv3 tags and Twitch commands capabilities.
+	 */
+	void Authenticate(const FString& _oauth, const FString& _username, bool _b_request_tags);
+
+	/**
+	 * Joins a channel once authenticated. The channel is joined again after every reconnection.
+	 * Can be called from any thread.
+	 *
+	 * @param _channel_id - Interned ID of the channel, assigned by the caller. Messages of the channel carry it.
+	 * IDs index an array, so they should be small and dense.
+	 * @param _channel - Channel name, lower case and without '#'.
+	 */
+	void JoinChannel(int32 _channel_id, const FString& _channel);
+
+	/**
+	 * Leaves a channel previously joined with JoinChannel(). Can be called from any thread.
+	 *
+	 * @param _channel_id - Interned ID of the channel.
+	 */
+	void PartChannel(int32 _channel_id);
+
+	// Current state. Can be called from any thread
+	ETwitchConnectionState GetState() const { return static_cast<ETwitchConnectionState>(state_.GetValue()); }
+
+	// Lines to send. Can be filled from any thread, they are sent once the channels are joined
+	FTwitchIRCSendQueue& GetSendQueue() { return session_.GetSendQueue(); }
+
+	/**
+	 * Pops the oldest parsed message, releasing the memory of the message previously dequeued into _out_message.
+	 * Must only be called from a single consumer thread (the game thread).
+	 *
+	 * @param _out_message - The dequeued message. Reuse the same one to keep the allocation of its content.
+	 *
+	 * @return Whether a message was available.
+	 */
+	bool DequeueMessage(FTwitchIRCReceivedMessage& _out_message);
+
+	// Parsed messages waiting to be dequeued. Any thread
+	int32 GetNumQueuedMessages() const { return num_queued_messages_.GetValue(); }
+
+	/**
+	 * Discards the oldest messages until at most _max_messages are queued. Same threading rules as DequeueMessage().
+	 *
+	 * @return Amount of messages discarded.
+	 */
+	int32 DiscardOldestMessages(int32 _max_messages);
+
+	// Messages shed by the overload policy since the last call. Any thread
+	int32 ConsumeShedMessages() { return shed_messages_.Reset(); }
+
+	/**
+	 * Pops the oldest state change. Same threading rules as DequeueMessage().
+	 *
+	 * @param _out_state_change - The dequeued state change.
+	 *
+	 * @return Whether a state change was available.
+	 */
+	bool DequeueStateChange(FTwitchIRCStateChange& _out_state_change);
+
+	// FRunnable interface
+	virtual uint32 Run() override;
+	virtual void Stop() override;
+
+private:
+
+	friend struct FTwitchPlayTestAccess;
+
+	// A message waiting for the game thread. Its text is still undecoded UTF-8, in the arena
+	struct FQueuedMessage
+	{
+		// Content followed by the raw tags
+		const ANSICHAR* data_ = nullptr;
+
+		int32 content_length_ = 0;
+
+		int32 tags_length_ = 0;
+
+		FTwitchIRCMessageArena::FBlock* block_ = nullptr;
+
+		int32 user_handle_ = INDEX_NONE;
+
+		const FString* username_ = nullptr;
+
+		int32 channel_id_ = INDEX_NONE;
+
+		uint64 receive_cycles_ = 0;
+	};
+
+	// Resolves the server and starts a non blocking connect
+	void BeginConnect();
+
+	// Waits for the non blocking connect to complete
+	void UpdateConnecting();
+
+	// Receives, parses and sends while the socket is connected
+	void UpdateSession();
+
+	// Receives the available bytes and hands them to the session. Returns false if the connection was closed
+	bool ReceiveLines();
+
+	// Feeds the lines of settings_.replay_file_ to the session at their captured pace, instead of using a socket
+	void RunReplay();
+
+	bool IsReplay() const { return !settings_.replay_file_.IsEmpty(); }
+
+	// ITwitchIRCSessionHandler interface: captures the lines, follows the authentication and queues chat messages
+	virtual void OnLineReceived(const ANSICHAR* _line, int32 _length) override;
+	virtual void OnLineParsed(uint64 _parse_cycles) override;
+	virtual void OnRegistered() override;
+	virtual void OnLoginFailed(const FString& _reason) override;
+	virtual void OnReconnectRequested() override;
+	virtual void OnMessage(const FTwitchIRCLine& _line, int32 _channel_id) override;
+
+	// Whether a message line fits in the inbound queue, applying the overload policy when the queue is past its capacity
+	bool AdmitMessage(const FTwitchIRCLine& _line);
+
+	// Registers the session with the credentials
+	void SendAuthentication();
+
+	// Has the session join and leave channels if they changed
+	void SyncChannels();
+
+	// Closes the socket and, if enabled, schedules the next attempt with backoff
+	void ScheduleReconnect(const FString& _reason, bool _b_server_requested = false);
+
+	void CloseSocket();
+
+	void SetState(ETwitchConnectionState _state, const FString& _reason = FString());
+
+	const FSettings settings_;
+
+	FSocket* socket_ = nullptr;
+
+	FRunnableThread* thread_ = nullptr;
+
+	FThreadSafeBool b_stop_requested_;
+
+	// ETwitchConnectionState, readable from any thread
+	FThreadSafeCounter state_;
+
+	// Credentials and channels, written by any thread
+	FCriticalSection settings_lock_;
+
+	FString oauth_token_;
+
+	FString username_;
+
+	bool b_request_tags_ = false;
+
+	bool b_has_credentials_ = false;
+
+	// Set when new credentials arrive, so a failed authentication can be retried
+	bool b_credentials_changed_ = false;
+
+	// Channels requested by JoinChannel/PartChannel, indexed by channel ID. Names are empty for unused IDs
+	TArray<FString> channel_names_;
+
+	TBitArray<> wanted_channels_;
+
+	// Set when channels are joined or left, so the connection thread only takes the lock when there is something to do
+	FThreadSafeBool b_channels_changed_;
+
+	// Set while wanted channels wait for the join budget. Connection thread only
+	bool b_has_pending_joins_ = false;
+
+	// Connection thread timing
+	double state_deadline_ = 0.0;
+
+	double next_attempt_time_ = 0.0;
+
+	int32 reconnect_attempts_ = 0;
+
+	FRandomStream backoff_random_;
+
+	// Protocol state of the socket: framing, JOIN/PART, PINGs and the lines waiting to be written. Started over on every connection
+	FTwitchIRCSession session_;
+
+	// Bytes of the queued messages. Allocated by the connection thread, released by the game thread
+	FTwitchIRCMessageArena message_arena_;
+
+	// Parsed messages waiting to be broadcast. Produced by the connection thread, consumed by the game thread
+	TQueue<FQueuedMessage, EQueueMode::Spsc> message_queue_;
+
+	FThreadSafeCounter num_queued_messages_;
+
+	FThreadSafeCounter shed_messages_;
+
+	// UTF-8 settings_.overload_command_marker_
+	TArray<ANSICHAR> command_marker_;
+
+	// Share of a message earned by UniformSampling. A message is kept every time it reaches 1. Connection thread only
+	float sampling_credit_ = 0.0f;
+
+	// When the data being parsed was read from the socket. Connection thread only
+	uint64 receive_cycles_ = 0;
+
+	// Lines of the current read, encoded for the capture. Connection thread only
+	TArray<uint8> capture_lines_;
+
+	int32 num_captured_lines_ = 0;
+
+	TQueue<FTwitchIRCStateChange, EQueueMode::Spsc> state_changes_;
+};
@@ -0,0 +1,575 @@
+// Copyright (C) Simone Di Gravio <email: altairjp@gmail.com> - All Rights Reserved
+
+#include "Net/TwitchIRCConnectionManager.h"
+#include "Components/TwitchIRCComponent.h"
+#include "TwitchPlay.h"
+#include "Stats/TwitchPlayStats.h"
+
+FTwitchIRCConnectionManager* FTwitchIRCConnectionManager::instance_ = nullptr;
+
+FTwitchIRCConnectionPool::FTwitchIRCConnectionPool(const FString& _account, const FSettings& _settings, const TSharedRef<FTwitchIRCUserRegistry, ESPMode::ThreadSafe>& _user_registry)
+	: account_(_account)
+	, settings_(_settings)
+	, rate_limiter_(MakeShared<FTwitchIRCRateLimiter, ESPMode::ThreadSafe>())
+	, join_limiter_(FTwitchIRCSession::MakeJoinLimiter())
+	, user_registry_(_user_registry)
+{
+	rate_limiter_->SetRateLimit(settings_.connection_settings_.messages_per_window_, 30.0);
+
+	if (!settings_.capture_file_.IsEmpty())
+	{
+		FString error;
+		capture_writer_ = MakeShared<FTwitchIRCCaptureWriter, ESPMode::ThreadSafe>();
+		if (capture_writer_->Open(settings_.capture_file_, error))
+		{
+			UE_LOG(LogTwitchPlay, Log, TEXT("Capturing chat to %s"), *settings_.capture_file_);
+		}
+		else
+		{
+			UE_LOG(LogTwitchPlay, Warning, TEXT("%s"), *error);
+			capture_writer_.Reset();
+		}
+	}
+}
+
+FTwitchIRCConnectionPool::~FTwitchIRCConnectionPool()
+{
+	for (FShard& shard : shards_)
+	{
+		shard.connection_->Shutdown();
+	}
+}
+
+bool FTwitchIRCConnectionPool::Start()
+{
+	return shards_.Num() > 0 || AddShard() != INDEX_NONE;
+}
+
+bool FTwitchIRCConnectionPool::HasEndpoint(const FSettings& _settings) const
+{
+	return settings_.connection_settings_.port_ == _settings.connection_settings_.port_
+		&& settings_.connection_settings_.host_.Equals(_settings.connection_settings_.host_, ESearchCase::IgnoreCase)
+		&& settings_.connection_settings_.replay_file_ == _settings.connection_settings_.replay_file_;
+}
+
+ETwitchConnectionState FTwitchIRCConnectionPool::GetState() const
+{
+	return shards_.Num() > 0 ? shards_[0].connection_->GetState() : ETwitchConnectionState::Disconnected;
+}
+
+void FTwitchIRCConnectionPool::Authenticate(const FString& _oauth, const FString& _username, bool _b_request_tags)
+{
+	oauth_token_ = _oauth;
+	username_ = _username;
+	b_request_tags_ = _b_request_tags;
+	b_has_credentials_ = true;
+
+	for (FShard& shard : shards_)
+	{
+		shard.connection_->Authenticate(oauth_token_, username_, b_request_tags_);
+	}
+}
+
+bool FTwitchIRCConnectionPool::Send(const FString& _line, bool _b_rate_limited, const FString& _channel)
+{
+	if (shards_.Num() == 0)
+	{
+		return false;
+	}
+
+	// Chat lines go out on the connection that joined the channel
+	int32 shard_index = 0;
+	if (!_channel.IsEmpty())
+	{
+		const int32* channel_id = channel_ids_.Find(_channel.ToLower());
+		if (channel_id != nullptr)
+		{
+			shard_index = channels_[*channel_id].shard_;
+		}
+	}
+	return shards_[shard_index].connection_->GetSendQueue().Enqueue(_line, _b_rate_limited);
+}
+
+void FTwitchIRCConnectionPool::AddSubscriber(UTwitchIRCComponent* _component)
+{
+	FSubscriber subscriber;
+	subscriber.component_ = _component;
+	subscriber.b_needs_state_ = GetState() != ETwitchConnectionState::Disconnected;
+	subscribers_.Add(subscriber);
+	num_subscribers_++;
+}
+
+void FTwitchIRCConnectionPool::RemoveSubscriber(UTwitchIRCComponent* _component)
+{
+	for (int32 cycle_subscriber = 0; cycle_subscriber < subscribers_.Num(); ++cycle_subscriber)
+	{
+		if (subscribers_[cycle_subscriber].component_ == _component)
+		{
+			subscribers_[cycle_subscriber].component_ = nullptr;
+			num_subscribers_--;
+		}
+	}
+
+	for (int32 cycle_channel = 0; cycle_channel < channels_.Num(); ++cycle_channel)
+	{
+		RemoveChannelListener(cycle_channel, _component);
+	}
+
+	b_needs_compaction_ = true;
+	if (!b_is_dispatching_)
+	{
+		Compact();
+	}
+}
+
+void FTwitchIRCConnectionPool::AddListener(const FString& _channel, UTwitchIRCComponent* _component, int32 _component_channel_id)
+{
+	int32 channel_id;
+	const int32* found_channel_id = channel_ids_.Find(_channel);
+	if (found_channel_id != nullptr)
+	{
+		channel_id = *found_channel_id;
+	}
+	else
+	{
+		// The shard of a channel never changes, so routing stays a pair of array lookups
+		const int32 shard_index = ChooseShard();
+		if (shard_index == INDEX_NONE)
+		{
+			return;
+		}
+
+		FShard& shard = shards_[shard_index];
+		channel_id = channels_.AddDefaulted();
+		channels_[channel_id].name_ = _channel;
+		channels_[channel_id].shard_ = shard_index;
+		channels_[channel_id].shard_channel_id_ = shard.pool_channels_.Add(channel_id);
+		channel_ids_.Add(_channel, channel_id);
+	}
+
+	FChannel& channel = channels_[channel_id];
+	for (const FListener& listener : channel.listeners_)
+	{
+		if (listener.component_ == _component)
+		{
+			return;
+		}
+	}
+
+	// The first listener joins the channel
+	const bool b_was_listened = channel.listeners_.ContainsByPredicate([](const FListener& _listener) { return _listener.component_ != nullptr; });
+	FListener listener;
+	listener.component_ = _component;
+	listener.component_channel_id_ = _component_channel_id;
+	channel.listeners_.Add(listener);
+
+	if (!b_was_listened)
+	{
+		shards_[channel.shard_].connection_->JoinChannel(channel.shard_channel_id_, channel.name_);
+	}
+}
+
+void FTwitchIRCConnectionPool::RemoveListener(const FString& _channel, UTwitchIRCComponent* _component)
+{
+	const int32* channel_id = channel_ids_.Find(_channel);
+	if (channel_id != nullptr && RemoveChannelListener(*channel_id, _component))
+	{
+		b_needs_compaction_ = true;
+		if (!b_is_dispatching_)
+		{
+			Compact();
+		}
+	}
+}
+
+bool FTwitchIRCConnectionPool::RemoveChannelListener(int32 _channel_id, UTwitchIRCComponent* _component)
+{
+	FChannel& channel = channels_[_channel_id];
+	bool b_removed = false;
+	bool b_is_listened = false;
+	for (FListener& listener : channel.listeners_)
+	{
+		if (listener.component_ == _component)
+		{
+			listener.component_ = nullptr;
+			b_removed = true;
+		}
+		b_is_listened |= listener.component_ != nullptr;
+	}
+
+	// The last listener leaves the channel
+	if (b_removed && !b_is_listened)
+	{
+		shards_[channel.shard_].connection_->PartChannel(channel.shard_channel_id_);
+	}
+	return b_removed;
+}
+
+void FTwitchIRCConnectionPool::Dispatch()
+{
+	// Handlers can subscribe, unsubscribe, join and leave while messages are being dispatched
+	// Arrays are walked by index, and removed entries are nulled and compacted afterwards
+	b_is_dispatching_ = true;
+
+	// Components only follow the state of the primary shard
+	if (shards_.Num() > 0)
+	{
+		const ETwitchConnectionState state = GetState();
+		for (int32 cycle_subscriber = 0; cycle_subscriber < subscribers_.Num(); ++cycle_subscriber)
+		{
+			if (subscribers_[cycle_subscriber].b_needs_state_ && subscribers_[cycle_subscriber].component_ != nullptr)
+			{
+				subscribers_[cycle_subscriber].b_needs_state_ = false;
+				subscribers_[cycle_subscriber].component_->DispatchStateChange(state, FString());
+			}
+		}
+
+		FTwitchIRCStateChange state_change;
+		while (shards_[0].connection_->DequeueStateChange(state_change))
+		{
+			for (int32 cycle_subscriber = 0; cycle_subscriber < subscribers_.Num(); ++cycle_subscriber)
+			{
+				if (subscribers_[cycle_subscriber].component_ != nullptr)
+				{
+					subscribers_[cycle_subscriber].b_needs_state_ = false;
+					subscribers_[cycle_subscriber].component_->DispatchStateChange(state_change.state_, state_change.reason_);
+				}
+			}
+		}
+	}
+
+	int32 total_dropped = 0;
+	int32 total_delayed = 0;
+	double longest_delay = 0.0;
+
+	// Past the deadline the remaining messages wait for the next frame. At least one message is dispatched per frame, so the backlog always moves
+	const uint64 dispatch_start_cycles = FPlatformTime::Cycles64();
+	const uint64 deadline_cycles = settings_.dispatch_budget_microseconds_ > 0
+		? dispatch_start_cycles + static_cast<uint64>(settings_.dispatch_budget_microseconds_ / (FPlatformTime::GetSecondsPerCycle64() * 1000000.0))
+		: MAX_uint64;
+	bool b_is_over_budget = false;
+	int32 shed_messages = 0;
+	int32 deferred_messages = 0;
+
+	int32 dispatched_messages = 0;
+	const int32 num_shards = shards_.Num();
+	for (int32 cycle_dispatched_shard = 0; cycle_dispatched_shard < num_shards; ++cycle_dispatched_shard)
+	{
+		const int32 cycle_shard = (first_dispatched_shard_ + cycle_dispatched_shard) % num_shards;
+		FTwitchIRCConnection& connection = *shards_[cycle_shard].connection_;
+
+		shed_messages += connection.ConsumeShedMessages();
+		if (settings_.connection_settings_.overload_policy_ == ETwitchOverloadPolicy::DropOldest)
+		{
+			shed_messages += connection.DiscardOldestMessages(FMath::Max(settings_.connection_settings_.inbound_capacity_, 1));
+		}
+
+		// Secondary shards only report their failures to the log
+		if (cycle_shard > 0)
+		{
+			FTwitchIRCStateChange state_change;
+			while (connection.DequeueStateChange(state_change))
+			{
+				if (!state_change.reason_.IsEmpty())
+				{
+					UE_LOG(LogTwitchPlay, Warning, TEXT("TwitchPlay connection %d of %s: %s"), cycle_shard, *account_, *state_change.reason_);
+				}
+			}
+		}
+
+		while (true)
+		{
+			if (dispatched_messages > 0 && FPlatformTime::Cycles64() >= deadline_cycles)
+			{
+				b_is_over_budget = true;
+				break;
+			}
+
+			// Every message of the frame gets its own slot, so the batch events can point to its content
+			if (dispatched_messages == frame_messages_.Num())
+			{
+				frame_messages_.Add(new FTwitchIRCReceivedMessage());
+			}
+			FTwitchIRCReceivedMessage& message = frame_messages_[dispatched_messages];
+			if (!connection.DequeueMessage(message))
+			{
+				break;
+			}
+
+			FTwitchPlayStats::RecordLatency(ETwitchPlayLatency::Queue, FPlatformTime::Cycles64() - message.receive_cycles_);
+			++dispatched_messages;
+
+			// Channel messages go to the listeners of their channel, in O(1)
+			if (shards_[cycle_shard].pool_channels_.IsValidIndex(message.channel_id_))
+			{
+				const int32 channel_id = shards_[cycle_shard].pool_channels_[message.channel_id_];
+				for (int32 cycle_listener = 0; cycle_listener < channels_[channel_id].listeners_.Num(); ++cycle_listener)
+				{
+					const FListener listener = channels_[channel_id].listeners_[cycle_listener];
+					if (listener.component_ != nullptr)
+					{
+						listener.component_->DispatchMessage(message, listener.component_channel_id_);
+					}
+				}
+			}
+			// Server messages of the primary shard go to everyone, like they did with a connection per component
+			else if (cycle_shard == 0)
+			{
+				for (int32 cycle_subscriber = 0; cycle_subscriber < subscribers_.Num(); ++cycle_subscriber)
+				{
+					UTwitchIRCComponent* component = subscribers_[cycle_subscriber].component_;
+					if (component != nullptr)
+					{
+						component->DispatchMessage(message, INDEX_NONE);
+					}
+				}
+			}
+		}
+
+		int32 dropped;
+		int32 delayed;
+		double delay;
+		connection.GetSendQueue().ConsumeReport(dropped, delayed, delay);
+		total_dropped += dropped;
+		total_delayed += delayed;
+		longest_delay = FMath::Max(longest_delay, delay);
+
+		if (b_is_over_budget)
+		{
+			deferred_messages += connection.GetNumQueuedMessages();
+		}
+	}
+	if (num_shards > 0)
+	{
+		first_dispatched_shard_ = (first_dispatched_shard_ + 1) % num_shards;
+	}
+
+	// Then the messages of the frame all at once, to the components listening to batches. They view the contents in frame_messages_
+	if (dispatched_messages > 0)
+	{
+		for (int32 cycle_subscriber = 0; cycle_subscriber < subscribers_.Num(); ++cycle_subscriber)
+		{
+			if (subscribers_[cycle_subscriber].component_ != nullptr)
+			{
+				subscribers_[cycle_subscriber].component_->DispatchMessageBatch();
+			}
+		}
+	}
+
+	// The arena blocks go back to their connections. Listeners had to copy what they keep
+	for (int32 cycle_message = 0; cycle_message < dispatched_messages; ++cycle_message)
+	{
+		frame_messages_[cycle_message].storage_.Reset();
+		frame_messages_[cycle_message].raw_tags_ = FTwitchIRCStringView();
+	}
+	FTwitchPlayStats::Add(ETwitchPlayCounter::MessagesDispatched, dispatched_messages);
+	FTwitchPlayStats::Add(ETwitchPlayCounter::MessagesShed, shed_messages);
+	FTwitchPlayStats::Add(ETwitchPlayCounter::MessagesDeferred, deferred_messages);
+
+	if (shed_messages > 0 || deferred_messages > 0)
+	{
+		for (int32 cycle_subscriber = 0; cycle_subscriber < subscribers_.Num(); ++cycle_subscriber)
+		{
+			if (subscribers_[cycle_subscriber].component_ != nullptr)
+			{
+				subscribers_[cycle_subscriber].component_->DispatchInboundQueueReport(shed_messages, deferred_messages);
+			}
+		}
+	}
+
+	if (total_dropped > 0 || total_delayed > 0)
+	{
+		for (int32 cycle_subscriber = 0; cycle_subscriber < subscribers_.Num(); ++cycle_subscriber)
+		{
+			if (subscribers_[cycle_subscriber].component_ != nullptr)
+			{
+				subscribers_[cycle_subscriber].component_->DispatchSendQueueReport(total_dropped, total_delayed, static_cast<float>(longest_delay));
+			}
+		}
+	}
+
+	b_is_dispatching_ = false;
+	Compact();
+}
+
+void FTwitchIRCConnectionPool::AddQueueDepths(int32& _inout_queued_messages, int32& _inout_queued_lines) const
+{
+	for (const FShard& shard : shards_)
+	{
+		_inout_queued_messages += shard.connection_->GetNumQueuedMessages();
+		_inout_queued_lines += shard.connection_->GetSendQueue().GetNumQueuedLines();
+	}
+}
+
+void FTwitchIRCConnectionPool::DetachSubscribers()
+{
+	for (FSubscriber& subscriber : subscribers_)
+	{
+		if (subscriber.component_ != nullptr)
+		{
+			subscriber.component_->connection_pool_ = nullptr;
+		}
+	}
+	subscribers_.Reset();
+	num_subscribers_ = 0;
+}
+
+int32 FTwitchIRCConnectionPool::AddShard()
+{
+	FTwitchIRCConnection::FSettings connection_settings = settings_.connection_settings_;
+	connection_settings.rate_limiter_ = rate_limiter_;
+	connection_settings.join_limiter_ = join_limiter_;
+	connection_settings.capture_writer_ = capture_writer_;
+	connection_settings.user_registry_ = user_registry_;
+
+	FShard shard;
+	shard.connection_ = MakeUnique<FTwitchIRCConnection>(connection_settings);
+	if (!shard.connection_->Start())
+	{
+		return INDEX_NONE;
+	}
+	if (b_has_credentials_)
+	{
+		shard.connection_->Authenticate(oauth_token_, username_, b_request_tags_);
+	}
+	return shards_.Add(MoveTemp(shard));
+}
+
+int32 FTwitchIRCConnectionPool::ChooseShard()
+{
+	int32 least_loaded_shard = INDEX_NONE;
+	for (int32 cycle_shard = 0; cycle_shard < shards_.Num(); ++cycle_shard)
+	{
+		if (least_loaded_shard == INDEX_NONE || shards_[cycle_shard].pool_channels_.Num() < shards_[least_loaded_shard].pool_channels_.Num())
+		{
+			least_loaded_shard = cycle_shard;
+		}
+	}
+
+	// Open a new shard only once every shard is full. A replay is a single stream, every shard would replay it again
+	const int32 max_connections = settings_.connection_settings_.replay_file_.IsEmpty() ? FMath::Max(settings_.max_connections_, 1) : 1;
+	const bool b_is_full = least_loaded_shard == INDEX_NONE || shards_[least_loaded_shard].pool_channels_.Num() >= settings_.max_channels_per_connection_;
+	if (b_is_full && shards_.Num() < max_connections)
+	{
+		const int32 new_shard = AddShard();
+		if (new_shard != INDEX_NONE)
+		{
+			return new_shard;
+		}
+	}
+	return least_loaded_shard;
+}
+
+void FTwitchIRCConnectionPool::Compact()
+{
+	if (!b_needs_compaction_)
+	{
+		return;
+	}
+	b_needs_compaction_ = false;
+
+	subscribers_.RemoveAll([](const FSubscriber& _subscriber) { return _subscriber.component_ == nullptr; });
+	for (FChannel& channel : channels_)
+	{
+		channel.listeners_.RemoveAll([](const FListener& _listener) { return _listener.component_ == nullptr; });
+	}
+}
+
+void FTwitchIRCConnectionManager::Startup()
+{
+	check(instance_ == nullptr);
+	instance_ = new FTwitchIRCConnectionManager();
+}
+
+void FTwitchIRCConnectionManager::Shutdown()
+{
+	delete instance_;
+	instance_ = nullptr;
+}
+
+FTwitchIRCConnectionManager::FTwitchIRCConnectionManager()
+	: user_registry_(MakeShared<FTwitchIRCUserRegistry, ESPMode::ThreadSafe>())
+{
+}
+
+FTwitchIRCConnectionManager::~FTwitchIRCConnectionManager()
+{
+	// Components still connected (destroyed after the module) must not release pools that are gone
+	for (TUniquePtr<FTwitchIRCConnectionPool>& pool : pools_)
+	{
+		pool->DetachSubscribers();
+	}
+}
+
+FTwitchIRCConnectionPool* FTwitchIRCConnectionManager::Acquire(const FString& _account, const FTwitchIRCConnectionPool::FSettings& _settings, UTwitchIRCComponent* _component)
+{
+	FTwitchIRCConnectionPool* pool = nullptr;
+	for (TUniquePtr<FTwitchIRCConnectionPool>& existing_pool : pools_)
+	{
+		if (existing_pool->GetAccount() == _account && existing_pool->HasEndpoint(_settings))
+		{
+			pool = existing_pool.Get();
+			break;
+		}
+	}
+
+	if (pool == nullptr)
+	{
+		TUniquePtr<FTwitchIRCConnectionPool> new_pool = MakeUnique<FTwitchIRCConnectionPool>(_account, _settings, user_registry_);
+		if (!new_pool->Start())
+		{
+			return nullptr;
+		}
+		pool = new_pool.Get();
+		pools_.Add(MoveTemp(new_pool));
+	}
+
+	pool->AddSubscriber(_component);
+	return pool;
+}
+
+void FTwitchIRCConnectionManager::Release(FTwitchIRCConnectionPool* _pool, UTwitchIRCComponent* _component)
+{
+	_pool->RemoveSubscriber(_component);
+	if (!b_is_pumping_)
+	{
+		DestroyUnusedPools();
+	}
+}
+
+void FTwitchIRCConnectionManager::Pump()
+{
+	if (b_is_pumping_ || last_pump_frame_ == GFrameCounter)
+	{
+		return;
+	}
+	last_pump_frame_ = GFrameCounter;
+
+	// Pools are walked by index: a handler connecting a component can add one
+	SCOPE_CYCLE_COUNTER(STAT_TwitchPlay_Pump);
+
+	// Depths are taken before dispatching, to show how much piled up since the previous frame
+	int32 queued_messages = 0;
+	int32 queued_lines = 0;
+	for (const TUniquePtr<FTwitchIRCConnectionPool>& pool : pools_)
+	{
+		pool->AddQueueDepths(queued_messages, queued_lines);
+	}
+	FTwitchPlayStats::SetQueueDepths(queued_messages, queued_lines);
+
+	b_is_pumping_ = true;
+	for (int32 cycle_pool = 0; cycle_pool < pools_.Num(); ++cycle_pool)
+	{
+		pools_[cycle_pool]->Dispatch();
+	}
+	b_is_pumping_ = false;
+
+	FTwitchPlayStats::PublishFrameStats();
+
+	DestroyUnusedPools();
+}
+
+void FTwitchIRCConnectionManager::DestroyUnusedPools()
+{
+	pools_.RemoveAll([](const TUniquePtr<FTwitchIRCConnectionPool>& _pool) { return _pool->NumSubscribers() == 0; });
+}
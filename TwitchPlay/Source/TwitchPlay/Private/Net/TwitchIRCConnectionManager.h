@@ -0,0 +1,266 @@
+// Copyright (C) Simone Di Gravio <email: altairjp@gmail.com> - All Rights Reserved
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Templates/UniquePtr.h"
+#include "Containers/IndirectArray.h"
+#include "Net/TwitchIRCConnection.h"
+#include "Net/TwitchIRCRateLimiter.h"
+#include "Net/TwitchIRCCapture.h"
+#include "Net/TwitchIRCUserRegistry.h"
+
+class UTwitchIRCComponent;
+
+/**
+ * Connections of a single account, shared by every component logged in with it.
+ * Channels are spread across up to max_connections_ connections (shards), each running on its own thread,
+ * so very large amounts of channels don't all go through one socket. Every line is received and parsed
+ * once by its shard, then handed to the components listening to its channel.
+ * All shards share the chat budget of the account. Game thread only.
+ */
+class FTwitchIRCConnectionPool
+{
+public:
+
+	struct FSettings
+	{
+		// Settings of every shard
+		FTwitchIRCConnection::FSettings connection_settings_;
+
+		// A new shard is opened once every shard holds this many channels
+		int32 max_channels_per_connection_ = 50;
+
+		// Past this many shards channels go to the least loaded one. Replays always use a single shard
+		int32 max_connections_ = 4;
+
+		// Full path of a capture of every received line (see FTwitchIRCCaptureWriter). Empty to not capture
+		FString capture_file_;
+
+		// Time Dispatch() can spend handing messages to the components each frame. The rest wait for the next frame. 0 for no limit
+		int32 dispatch_budget_microseconds_ = 0;
+	};
+
+	/**
+	 * @param _account - Lower case username the pool logs in with.
+	 * @param _settings - Settings of the pool.
+	 * @param _user_registry - Interns the senders of the messages of every shard.
+	 */
+	FTwitchIRCConnectionPool(const FString& _account, const FSettings& _settings, const TSharedRef<FTwitchIRCUserRegistry, ESPMode::ThreadSafe>& _user_registry);
+
+	// Stops every shard
+	~FTwitchIRCConnectionPool();
+
+	// Starts the primary shard. Returns false if its thread could not be created
+	bool Start();
+
+	// Account (lower case username) the pool logs in with. Empty for a pool that was connected before having credentials
+	const FString& GetAccount() const { return account_; }
+
+	// Whether the pool connects to the server (or replays the capture) of these settings
+	bool HasEndpoint(const FSettings& _settings) const;
+
+	// State of the primary shard, the one every component is told about
+	ETwitchConnectionState GetState() const;
+
+	// Authenticates every shard, current and future
+	void Authenticate(const FString& _oauth, const FString& _username, bool _b_request_tags);
+
+	/**
+	 * Queues a line on the shard that joined the channel, or on the primary shard.
+	 *
+	 * @param _line - The line, without terminator.
+	 * @param _b_rate_limited - Whether the line counts against the chat budget.
+	 * @param _channel - Channel the line is meant for (lower case, without '#'). Can be empty.
+	 *
+	 * @return Whether the line was queued.
+	 */
+	bool Send(const FString& _line, bool _b_rate_limited, const FString& _channel);
+
+	void AddSubscriber(UTwitchIRCComponent* _component);
+
+	// Also removes every channel listener of the component
+	void RemoveSubscriber(UTwitchIRCComponent* _component);
+
+	int32 NumSubscribers() const { return num_subscribers_; }
+
+	/**
+	 * Routes the messages of a channel to a component. The first listener of a channel joins it.
+	 *
+	 * @param _channel - Channel name, lower case and without '#'.
+	 * @param _component - The listening component.
+	 * @param _component_channel_id - ID of the channel inside the component, passed back with every message.
+	 */
+	void AddListener(const FString& _channel, UTwitchIRCComponent* _component, int32 _component_channel_id);
+
+	// Stops routing the messages of a channel to a component. The last listener of a channel leaves it
+	void RemoveListener(const FString& _channel, UTwitchIRCComponent* _component);
+
+	// Hands the messages, state changes and send and inbound queue reports of every shard to the subscribed components.
+	// Messages are dispatched until the budget of the frame runs out, the backlog is carried to the next frames
+	void Dispatch();
+
+	// Adds the messages waiting for Dispatch() and the lines waiting to be sent, of every shard
+	void AddQueueDepths(int32& _inout_queued_messages, int32& _inout_queued_lines) const;
+
+	// Tells every subscribed component that the pool is gone. Used when the module shuts down with components still connected
+	void DetachSubscribers();
+
+private:
+
+	friend struct FTwitchPlayTestAccess;
+
+	struct FShard
+	{
+		TUniquePtr<FTwitchIRCConnection> connection_;
+
+		// Pool channel ID of each channel ID of the shard
+		TArray<int32> pool_channels_;
+	};
+
+	struct FListener
+	{
+		// Null once removed while dispatching
+		UTwitchIRCComponent* component_ = nullptr;
+
+		int32 component_channel_id_ = INDEX_NONE;
+	};
+
+	struct FChannel
+	{
+		FString name_;
+
+		int32 shard_ = INDEX_NONE;
+
+		// ID of the channel inside its shard
+		int32 shard_channel_id_ = INDEX_NONE;
+
+		TArray<FListener> listeners_;
+	};
+
+	struct FSubscriber
+	{
+		// Null once removed while dispatching
+		UTwitchIRCComponent* component_ = nullptr;
+
+		// Subscribers joining a running pool are told its current state on the next dispatch
+		bool b_needs_state_ = false;
+	};
+
+	// Creates and starts a shard, authenticating it if credentials are known. Returns its index, INDEX_NONE on failure
+	int32 AddShard();
+
+	// Shard a new channel should be joined on
+	int32 ChooseShard();
+
+	// Nulls the listener of a component on a channel, leaving the channel if it was the last one. Returns whether it was listening
+	bool RemoveChannelListener(int32 _channel_id, UTwitchIRCComponent* _component);
+
+	// Drops the entries removed while dispatching
+	void Compact();
+
+	const FString account_;
+
+	const FSettings settings_;
+
+	// Shared by every shard: the chat budget is per account
+	TSharedRef<FTwitchIRCRateLimiter, ESPMode::ThreadSafe> rate_limiter_;
+
+	// Shared by every shard too: the join budget is per account, and every reconnection joins all the channels of a shard again
+	TSharedRef<FTwitchIRCRateLimiter, ESPMode::ThreadSafe> join_limiter_;
+
+	// Shared by every pool, so a user has the same handle whatever the account or channel
+	TSharedRef<FTwitchIRCUserRegistry, ESPMode::ThreadSafe> user_registry_;
+
+	// Shared by every shard, so the capture holds the lines of every channel in the order they arrived. Null if not capturing
+	TSharedPtr<FTwitchIRCCaptureWriter, ESPMode::ThreadSafe> capture_writer_;
+
+	// The first shard is the primary one
+	TArray<FShard> shards_;
+
+	// Channels ever joined, indexed by pool channel ID
+	TArray<FChannel> channels_;
+
+	TMap<FString, int32> channel_ids_;
+
+	TArray<FSubscriber> subscribers_;
+
+	int32 num_subscribers_ = 0;
+
+	// Credentials for shards opened later
+	FString oauth_token_;
+
+	FString username_;
+
+	bool b_request_tags_ = false;
+
+	bool b_has_credentials_ = false;
+
+	// Messages dispatched this frame, alive until the batch events fired. Reused from frame to frame so their contents keep their allocations.
+	// Indirect, so the contents don't move when more slots are added mid frame. Hold no arena memory between dispatches
+	TIndirectArray<FTwitchIRCReceivedMessage> frame_messages_;
+
+	// Shard whose messages are dispatched first. Rotated every frame, so a spent budget doesn't always starve the same shards
+	int32 first_dispatched_shard_ = 0;
+
+	// While dispatching, removed entries are only nulled so the arrays being walked don't shift
+	bool b_is_dispatching_ = false;
+
+	bool b_needs_compaction_ = false;
+};
+
+/**
+ * Owns the connection pools of every account, so components logged in with the same account
+ * share their sockets instead of each opening its own. Owned by the TwitchPlay module. Game thread only.
+ */
+class FTwitchIRCConnectionManager
+{
+public:
+
+	// Created and destroyed by the module
+	static void Startup();
+	static void Shutdown();
+
+	// The manager, or null if the module is not running
+	static FTwitchIRCConnectionManager* Get() { return instance_; }
+
+	/**
+	 * Subscribes a component to the pool of an account on a server, creating the pool if needed.
+	 *
+	 * @param _account - Lower case username. Can be empty until the credentials are known.
+	 * @param _settings - Server of the pool, and its settings if it has to be created. A running pool keeps its own.
+	 * @param _component - The subscribing component.
+	 *
+	 * @return The pool. Null if its connection thread could not be created.
+	 */
+	FTwitchIRCConnectionPool* Acquire(const FString& _account, const FTwitchIRCConnectionPool::FSettings& _settings, UTwitchIRCComponent* _component);
+
+	// Unsubscribes a component. Pools without subscribers are closed
+	void Release(FTwitchIRCConnectionPool* _pool, UTwitchIRCComponent* _component);
+
+	// Dispatches the messages of every pool. Called by every component tick, only the first call of each frame does anything
+	void Pump();
+
+	// Users of every pool. Handles stay valid until the module shuts down
+	const FTwitchIRCUserRegistry& GetUserRegistry() const { return *user_registry_; }
+
+private:
+
+	FTwitchIRCConnectionManager();
+
+	~FTwitchIRCConnectionManager();
+
+	// Closes the pools left without subscribers
+	void DestroyUnusedPools();
+
+	static FTwitchIRCConnectionManager* instance_;
+
+	TArray<TUniquePtr<FTwitchIRCConnectionPool>> pools_;
+
+	TSharedRef<FTwitchIRCUserRegistry, ESPMode::ThreadSafe> user_registry_;
+
+	uint64 last_pump_frame_ = MAX_uint64;
+
+	// Pools are only destroyed outside of Pump(), since a handler can disconnect its component
+	bool b_is_pumping_ = false;
+};
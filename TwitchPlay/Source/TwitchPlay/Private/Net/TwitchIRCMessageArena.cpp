@@ -0,0 +1,60 @@
+// Copyright (C) Simone Di Gravio <email: altairjp@gmail.com> - All Rights Reserved
+
+#include "Net/TwitchIRCMessageArena.h"
+
+FTwitchIRCMessageArena::FBlock::FBlock(int32 _capacity)
+	: data_(new ANSICHAR[_capacity])
+	, capacity_(_capacity)
+{
+}
+
+FTwitchIRCMessageArena::FTwitchIRCMessageArena(int32 _block_size)
+	: block_size_(FMath::Max(_block_size, 1))
+{
+}
+
+ANSICHAR* FTwitchIRCMessageArena::Allocate(int32 _size, FBlock*& _out_block)
+{
+	_size = FMath::Max(_size, 0);
+	if (current_block_ == nullptr || current_block_->used_ + _size > current_block_->capacity_)
+	{
+		// The producer lets go of the full block. It is free already if the game thread released all its messages
+		if (current_block_ != nullptr && current_block_->references_.Decrement() == 0)
+		{
+			free_blocks_.Enqueue(current_block_);
+		}
+		current_block_ = AcquireBlock(_size);
+	}
+
+	ANSICHAR* data = current_block_->data_.Get() + current_block_->used_;
+	current_block_->used_ += _size;
+	current_block_->references_.Increment();
+	_out_block = current_block_;
+	return data;
+}
+
+void FTwitchIRCMessageArena::Release(FBlock* _block)
+{
+	if (_block != nullptr && _block->references_.Decrement() == 0)
+	{
+		// The producer let go of it already, so this was the last message of the block
+		free_blocks_.Enqueue(_block);
+	}
+}
+
+FTwitchIRCMessageArena::FBlock* FTwitchIRCMessageArena::AcquireBlock(int32 _size)
+{
+	// Every block holds at least block_size_ bytes, so only larger allocations can miss a released block
+	FBlock* block = nullptr;
+	if (_size <= block_size_ && free_blocks_.Dequeue(block))
+	{
+		block->used_ = 0;
+		block->references_.Set(1);
+		return block;
+	}
+
+	blocks_.Add(MakeUnique<FBlock>(FMath::Max(_size, block_size_)));
+	block = blocks_.Last().Get();
+	block->references_.Set(1);
+	return block;
+}
@@ -0,0 +1,132 @@
+// Copyright (C) Simone Di Gravio <email: altairjp@gmail.com> - All Rights Reserved
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/ThreadSafeCounter.h"
+#include "Containers/Queue.h"
+#include "Templates/UniquePtr.h"
+
+/**
+ * Linear storage for the bytes of received messages, shared by a connection thread (the producer) and the game thread.
+ * Bytes are appended to the current block with a bump pointer. Each allocation keeps a reference on its block,
+ * and once the game thread released every message of a full block the whole block goes back to the producer at once:
+ * blocks move back and forth between the two threads, so a busy connection stops using the general allocator
+ * once it has as many blocks as it keeps in flight.
+ * Memory of a message is only valid until its reference is released. Copy what needs to outlive the dispatch.
+ */
+class FTwitchIRCMessageArena
+{
+public:
+
+	struct FBlock
+	{
+		explicit FBlock(int32 _capacity);
+
+		TUniquePtr<ANSICHAR[]> data_;
+
+		int32 capacity_;
+
+		// Bytes used. Producer only
+		int32 used_ = 0;
+
+		// One per allocation not released yet, plus one while the producer is still appending to the block
+		FThreadSafeCounter references_;
+	};
+
+	/**
+	 * @param _block_size - Size of the blocks. Allocations larger than this get a block of their own,
+	 *                      which is then recycled like the others.
+	 */
+	explicit FTwitchIRCMessageArena(int32 _block_size = 64 * 1024);
+
+	/**
+	 * Gets memory for a message, taking a reference on its block. Producer thread only.
+	 *
+	 * @param _size - Amount of bytes.
+	 * @param _out_block - Block of the memory, to release once the message is no longer used.
+	 *
+	 * @return Start of the memory.
+	 */
+	ANSICHAR* Allocate(int32 _size, FBlock*& _out_block);
+
+	// Releases a reference taken by Allocate(). Consumer thread only
+	void Release(FBlock* _block);
+
+private:
+
+	// Gets a released block with room for _size bytes, or a new one. Producer only
+	FBlock* AcquireBlock(int32 _size);
+
+	const int32 block_size_;
+
+	// Block being appended to. Producer only
+	FBlock* current_block_ = nullptr;
+
+	// Blocks whose messages were all released, by whichever thread let go of them last. Consumed by the producer
+	TQueue<FBlock*, EQueueMode::Mpsc> free_blocks_;
+
+	// Every block ever allocated, freed with the arena. Producer only
+	TArray<TUniquePtr<FBlock>> blocks_;
+};
+
+/**
+ * Reference to the arena memory of a message, released when destroyed or reset. Not copyable.
+ */
+class FTwitchIRCArenaReference
+{
+public:
+
+	FTwitchIRCArenaReference() = default;
+
+	FTwitchIRCArenaReference(FTwitchIRCMessageArena& _arena, FTwitchIRCMessageArena::FBlock* _block)
+		: arena_(&_arena)
+		, block_(_block)
+	{
+	}
+
+	FTwitchIRCArenaReference(FTwitchIRCArenaReference&& _other)
+		: arena_(_other.arena_)
+		, block_(_other.block_)
+	{
+		_other.arena_ = nullptr;
+		_other.block_ = nullptr;
+	}
+
+	FTwitchIRCArenaReference& operator=(FTwitchIRCArenaReference&& _other)
+	{
+		if (this != &_other)
+		{
+			Reset();
+			arena_ = _other.arena_;
+			block_ = _other.block_;
+			_other.arena_ = nullptr;
+			_other.block_ = nullptr;
+		}
+		return *this;
+	}
+
+	FTwitchIRCArenaReference(const FTwitchIRCArenaReference&) = delete;
+	FTwitchIRCArenaReference& operator=(const FTwitchIRCArenaReference&) = delete;
+
+	~FTwitchIRCArenaReference()
+	{
+		Reset();
+	}
+
+	void Reset()
+	{
+		if (block_ != nullptr)
+		{
+			arena_->Release(block_);
+		}
+		arena_ = nullptr;
+		block_ = nullptr;
+	}
+
+private:
+
+	FTwitchIRCMessageArena* arena_ = nullptr;
+
+	FTwitchIRCMessageArena::FBlock* block_ = nullptr;
+};
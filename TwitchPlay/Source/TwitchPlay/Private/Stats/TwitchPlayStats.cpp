@@ -0,0 +1,268 @@
+// Copyright (C) Simone Di Gravio <email: altairjp@gmail.com> - All Rights Reserved
+
+#include "Stats/TwitchPlayStats.h"
+#include "TwitchPlay.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/DateTime.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+
+DEFINE_STAT(STAT_TwitchPlay_Receive);
+DEFINE_STAT(STAT_TwitchPlay_Parse);
+DEFINE_STAT(STAT_TwitchPlay_Pump);
+DEFINE_STAT(STAT_TwitchPlay_Dispatch);
+DEFINE_STAT(STAT_TwitchPlay_MatchCommand);
+DEFINE_STAT(STAT_TwitchPlay_MatchKeywords);
+DEFINE_STAT(STAT_TwitchPlay_BytesIn);
+DEFINE_STAT(STAT_TwitchPlay_BytesOut);
+DEFINE_STAT(STAT_TwitchPlay_LinesParsed);
+DEFINE_STAT(STAT_TwitchPlay_MessagesDispatched);
+DEFINE_STAT(STAT_TwitchPlay_CommandsMatched);
+DEFINE_STAT(STAT_TwitchPlay_CommandsUnmatched);
+DEFINE_STAT(STAT_TwitchPlay_CommandsSuppressed);
+DEFINE_STAT(STAT_TwitchPlay_CommandsMalformed);
+DEFINE_STAT(STAT_TwitchPlay_MessagesShed);
+DEFINE_STAT(STAT_TwitchPlay_MessagesDeferred);
+DEFINE_STAT(STAT_TwitchPlay_KeywordHits);
+DEFINE_STAT(STAT_TwitchPlay_CommandsReplicated);
+DEFINE_STAT(STAT_TwitchPlay_BatchBytes);
+DEFINE_STAT(STAT_TwitchPlay_CommandsDropped);
+DEFINE_STAT(STAT_TwitchPlay_InboundQueueDepth);
+DEFINE_STAT(STAT_TwitchPlay_SendQueueDepth);
+
+volatile int64 FTwitchPlayStats::counters_[static_cast<int32>(ETwitchPlayCounter::Num)] = {};
+int64 FTwitchPlayStats::published_counters_[static_cast<int32>(ETwitchPlayCounter::Num)] = {};
+FTwitchPlayStats::FHistogram FTwitchPlayStats::histograms_[static_cast<int32>(ETwitchPlayLatency::Num)] = {};
+int32 FTwitchPlayStats::inbound_queue_depth_ = 0;
+int32 FTwitchPlayStats::send_queue_depth_ = 0;
+
+namespace
+{
+	const TCHAR* const CounterNames[] = { TEXT("BytesIn"), TEXT("BytesOut"), TEXT("LinesParsed"), TEXT("MessagesDispatched"), TEXT("CommandsMatched"), TEXT("CommandsUnmatched"), TEXT("CommandsSuppressed"), TEXT("CommandsMalformed"), TEXT("MessagesShed"), TEXT("MessagesDeferred"), TEXT("KeywordHits"), TEXT("CommandsReplicated"), TEXT("BatchBytes"), TEXT("CommandsDropped") };
+	static_assert(ARRAY_COUNT(CounterNames) == static_cast<int32>(ETwitchPlayCounter::Num), "Every counter needs a name");
+
+	const TCHAR* const StageNames[] = { TEXT("Parse"), TEXT("Queue"), TEXT("Dispatch"), TEXT("Command") };
+	static_assert(ARRAY_COUNT(StageNames) == static_cast<int32>(ETwitchPlayLatency::Num), "Every stage needs a name");
+
+	int32 SaturateToInt32(int64 _value)
+	{
+		return static_cast<int32>(FMath::Min<int64>(_value, MAX_int32));
+	}
+
+	// Upper bound of a bucket in milliseconds
+	float GetBucketUpperBoundMs(int32 _bucket)
+	{
+		return static_cast<float>(static_cast<double>(1ull << _bucket) / 1000.0);
+	}
+
+	// Upper bound of the bucket holding the given fraction of the samples
+	float GetPercentileMs(const TArray<int32>& _bucket_counts, int64 _num_samples, double _percentile)
+	{
+		const int64 target = FMath::Max<int64>(1, static_cast<int64>(FMath::CeilToDouble(_percentile * _num_samples)));
+		int64 cumulated = 0;
+		for (int32 cycle_bucket = 0; cycle_bucket < _bucket_counts.Num(); ++cycle_bucket)
+		{
+			cumulated += _bucket_counts[cycle_bucket];
+			if (cumulated >= target)
+			{
+				return GetBucketUpperBoundMs(cycle_bucket);
+			}
+		}
+		return GetBucketUpperBoundMs(_bucket_counts.Num() - 1);
+	}
+
+	void DumpCommand(const TArray<FString>& _args)
+	{
+		FString file_path;
+		if (FTwitchPlayStats::DumpToCSV(FString::Join(_args, TEXT(" ")), file_path))
+		{
+			UE_LOG(LogTwitchPlay, Display, TEXT("Stats written to %s"), *file_path);
+		}
+		else
+		{
+			UE_LOG(LogTwitchPlay, Error, TEXT("Could not write the stats to %s"), *file_path);
+		}
+	}
+
+	FAutoConsoleCommand GDumpStatsCommand(
+		TEXT("TwitchPlay.Stats.Dump"),
+		TEXT("Writes the TwitchPlay counters and latency histograms to a CSV file. Args: [FilePath]"),
+		FConsoleCommandWithArgsDelegate::CreateStatic(&DumpCommand));
+
+	FAutoConsoleCommand GResetStatsCommand(
+		TEXT("TwitchPlay.Stats.Reset"),
+		TEXT("Clears the TwitchPlay counters and latency histograms."),
+		FConsoleCommandDelegate::CreateStatic(&FTwitchPlayStats::Reset));
+}
+
+void FTwitchPlayStats::RecordLatency(ETwitchPlayLatency _stage, uint64 _cycles)
+{
+	FHistogram& histogram = histograms_[static_cast<int32>(_stage)];
+
+	const double microseconds = FPlatformTime::ToMilliseconds64(_cycles) * 1000.0;
+	const int32 bucket = microseconds < 1.0 ? 0 : FMath::Min(static_cast<int32>(FMath::FloorLog2_64(static_cast<uint64>(microseconds))) + 1, NumBuckets - 1);
+
+	FPlatformAtomics::InterlockedIncrement(&histogram.buckets_[bucket]);
+	FPlatformAtomics::InterlockedAdd(&histogram.total_cycles_, static_cast<int64>(_cycles));
+
+	// Only contended when a new max is found
+	int64 max_cycles = FPlatformAtomics::AtomicRead(&histogram.max_cycles_);
+	while (static_cast<int64>(_cycles) > max_cycles)
+	{
+		const int64 previous = FPlatformAtomics::InterlockedCompareExchange(&histogram.max_cycles_, static_cast<int64>(_cycles), max_cycles);
+		if (previous == max_cycles)
+		{
+			break;
+		}
+		max_cycles = previous;
+	}
+}
+
+void FTwitchPlayStats::SetQueueDepths(int32 _inbound_messages, int32 _queued_lines)
+{
+	inbound_queue_depth_ = _inbound_messages;
+	send_queue_depth_ = _queued_lines;
+
+	SET_DWORD_STAT(STAT_TwitchPlay_InboundQueueDepth, _inbound_messages);
+	SET_DWORD_STAT(STAT_TwitchPlay_SendQueueDepth, _queued_lines);
+}
+
+void FTwitchPlayStats::PublishFrameStats()
+{
+	int64 deltas[static_cast<int32>(ETwitchPlayCounter::Num)];
+	for (int32 cycle_counter = 0; cycle_counter < static_cast<int32>(ETwitchPlayCounter::Num); ++cycle_counter)
+	{
+		const int64 total = FPlatformAtomics::AtomicRead(&counters_[cycle_counter]);
+		deltas[cycle_counter] = total - published_counters_[cycle_counter];
+		published_counters_[cycle_counter] = total;
+	}
+
+	INC_DWORD_STAT_BY(STAT_TwitchPlay_BytesIn, deltas[static_cast<int32>(ETwitchPlayCounter::BytesIn)]);
+	INC_DWORD_STAT_BY(STAT_TwitchPlay_BytesOut, deltas[static_cast<int32>(ETwitchPlayCounter::BytesOut)]);
+	INC_DWORD_STAT_BY(STAT_TwitchPlay_LinesParsed, deltas[static_cast<int32>(ETwitchPlayCounter::LinesParsed)]);
+	INC_DWORD_STAT_BY(STAT_TwitchPlay_MessagesDispatched, deltas[static_cast<int32>(ETwitchPlayCounter::MessagesDispatched)]);
+	INC_DWORD_STAT_BY(STAT_TwitchPlay_CommandsMatched, deltas[static_cast<int32>(ETwitchPlayCounter::CommandsMatched)]);
+	INC_DWORD_STAT_BY(STAT_TwitchPlay_CommandsUnmatched, deltas[static_cast<int32>(ETwitchPlayCounter::CommandsUnmatched)]);
+	INC_DWORD_STAT_BY(STAT_TwitchPlay_CommandsSuppressed, deltas[static_cast<int32>(ETwitchPlayCounter::CommandsSuppressed)]);
+	INC_DWORD_STAT_BY(STAT_TwitchPlay_CommandsMalformed, deltas[static_cast<int32>(ETwitchPlayCounter::CommandsMalformed)]);
+	INC_DWORD_STAT_BY(STAT_TwitchPlay_MessagesShed, deltas[static_cast<int32>(ETwitchPlayCounter::MessagesShed)]);
+	INC_DWORD_STAT_BY(STAT_TwitchPlay_MessagesDeferred, deltas[static_cast<int32>(ETwitchPlayCounter::MessagesDeferred)]);
+	INC_DWORD_STAT_BY(STAT_TwitchPlay_KeywordHits, deltas[static_cast<int32>(ETwitchPlayCounter::KeywordHits)]);
+	INC_DWORD_STAT_BY(STAT_TwitchPlay_CommandsReplicated, deltas[static_cast<int32>(ETwitchPlayCounter::CommandsReplicated)]);
+	INC_DWORD_STAT_BY(STAT_TwitchPlay_BatchBytes, deltas[static_cast<int32>(ETwitchPlayCounter::BatchBytes)]);
+	INC_DWORD_STAT_BY(STAT_TwitchPlay_CommandsDropped, deltas[static_cast<int32>(ETwitchPlayCounter::CommandsDropped)]);
+}
+
+FTwitchPlayCounters FTwitchPlayStats::GetCounters()
+{
+	FTwitchPlayCounters counters;
+	counters.bytes_in_ = SaturateToInt32(Get(ETwitchPlayCounter::BytesIn));
+	counters.bytes_out_ = SaturateToInt32(Get(ETwitchPlayCounter::BytesOut));
+	counters.lines_parsed_ = SaturateToInt32(Get(ETwitchPlayCounter::LinesParsed));
+	counters.messages_dispatched_ = SaturateToInt32(Get(ETwitchPlayCounter::MessagesDispatched));
+	counters.commands_matched_ = SaturateToInt32(Get(ETwitchPlayCounter::CommandsMatched));
+	counters.commands_unmatched_ = SaturateToInt32(Get(ETwitchPlayCounter::CommandsUnmatched));
+	counters.commands_suppressed_ = SaturateToInt32(Get(ETwitchPlayCounter::CommandsSuppressed));
+	counters.commands_malformed_ = SaturateToInt32(Get(ETwitchPlayCounter::CommandsMalformed));
+	counters.messages_shed_ = SaturateToInt32(Get(ETwitchPlayCounter::MessagesShed));
+	counters.messages_deferred_ = SaturateToInt32(Get(ETwitchPlayCounter::MessagesDeferred));
+	counters.keyword_hits_ = SaturateToInt32(Get(ETwitchPlayCounter::KeywordHits));
+	counters.commands_replicated_ = SaturateToInt32(Get(ETwitchPlayCounter::CommandsReplicated));
+	counters.batch_bytes_ = SaturateToInt32(Get(ETwitchPlayCounter::BatchBytes));
+	counters.commands_dropped_ = SaturateToInt32(Get(ETwitchPlayCounter::CommandsDropped));
+	counters.inbound_queue_depth_ = inbound_queue_depth_;
+	counters.send_queue_depth_ = send_queue_depth_;
+	return counters;
+}
+
+FTwitchPlayLatencyHistogram FTwitchPlayStats::GetHistogram(ETwitchPlayLatency _stage)
+{
+	const FHistogram& histogram = histograms_[static_cast<int32>(_stage)];
+
+	// Samples recorded while copying can make the buckets and the totals disagree slightly, which is fine for stats
+	FTwitchPlayLatencyHistogram ret_histogram;
+	ret_histogram.bucket_upper_bounds_ms_.Reserve(NumBuckets);
+	ret_histogram.bucket_counts_.Reserve(NumBuckets);
+	int64 num_samples = 0;
+	for (int32 cycle_bucket = 0; cycle_bucket < NumBuckets; ++cycle_bucket)
+	{
+		const int32 count = FPlatformAtomics::AtomicRead(&histogram.buckets_[cycle_bucket]);
+		ret_histogram.bucket_upper_bounds_ms_.Add(GetBucketUpperBoundMs(cycle_bucket));
+		ret_histogram.bucket_counts_.Add(count);
+		num_samples += count;
+	}
+
+	ret_histogram.num_samples_ = SaturateToInt32(num_samples);
+	if (num_samples > 0)
+	{
+		const int64 total_cycles = FPlatformAtomics::AtomicRead(&histogram.total_cycles_);
+		const int64 max_cycles = FPlatformAtomics::AtomicRead(&histogram.max_cycles_);
+		ret_histogram.average_ms_ = static_cast<float>(FPlatformTime::ToMilliseconds64(static_cast<uint64>(total_cycles)) / num_samples);
+		ret_histogram.p50_ms_ = GetPercentileMs(ret_histogram.bucket_counts_, num_samples, 0.5);
+		ret_histogram.p90_ms_ = GetPercentileMs(ret_histogram.bucket_counts_, num_samples, 0.9);
+		ret_histogram.p99_ms_ = GetPercentileMs(ret_histogram.bucket_counts_, num_samples, 0.99);
+		ret_histogram.max_ms_ = static_cast<float>(FPlatformTime::ToMilliseconds64(static_cast<uint64>(max_cycles)));
+	}
+	return ret_histogram;
+}
+
+void FTwitchPlayStats::Reset()
+{
+	for (int32 cycle_counter = 0; cycle_counter < static_cast<int32>(ETwitchPlayCounter::Num); ++cycle_counter)
+	{
+		FPlatformAtomics::InterlockedExchange(&counters_[cycle_counter], 0);
+		published_counters_[cycle_counter] = 0;
+	}
+
+	for (FHistogram& histogram : histograms_)
+	{
+		for (int32 cycle_bucket = 0; cycle_bucket < NumBuckets; ++cycle_bucket)
+		{
+			FPlatformAtomics::InterlockedExchange(&histogram.buckets_[cycle_bucket], 0);
+		}
+		FPlatformAtomics::InterlockedExchange(&histogram.total_cycles_, 0);
+		FPlatformAtomics::InterlockedExchange(&histogram.max_cycles_, 0);
+	}
+}
+
+bool FTwitchPlayStats::DumpToCSV(const FString& _file_path, FString& _out_file_path)
+{
+	if (_file_path.IsEmpty())
+	{
+		_out_file_path = FPaths::Combine(FPaths::ProfilingDir(), TEXT("TwitchPlay"), FString::Printf(TEXT("TwitchPlayStats-%s.csv"), *FDateTime::Now().ToString()));
+	}
+	else
+	{
+		_out_file_path = FPaths::IsRelative(_file_path) ? FPaths::Combine(FPaths::ProjectDir(), _file_path) : _file_path;
+	}
+	_out_file_path = FPaths::ConvertRelativePathToFull(_out_file_path);
+
+	// Counters first, then one row per stage with its percentiles and buckets
+	FString csv = TEXT("Counter,Value\n");
+	for (int32 cycle_counter = 0; cycle_counter < static_cast<int32>(ETwitchPlayCounter::Num); ++cycle_counter)
+	{
+		csv += FString::Printf(TEXT("%s,%lld\n"), CounterNames[cycle_counter], Get(static_cast<ETwitchPlayCounter>(cycle_counter)));
+	}
+	csv += FString::Printf(TEXT("InboundQueueDepth,%d\nSendQueueDepth,%d\n\n"), inbound_queue_depth_, send_queue_depth_);
+
+	csv += TEXT("Stage,Samples,AverageMs,P50Ms,P90Ms,P99Ms,MaxMs");
+	for (int32 cycle_bucket = 0; cycle_bucket < NumBuckets; ++cycle_bucket)
+	{
+		csv += FString::Printf(TEXT(",Under%gMs"), GetBucketUpperBoundMs(cycle_bucket));
+	}
+	csv += TEXT("\n");
+
+	for (int32 cycle_stage = 0; cycle_stage < static_cast<int32>(ETwitchPlayLatency::Num); ++cycle_stage)
+	{
+		const FTwitchPlayLatencyHistogram histogram = GetHistogram(static_cast<ETwitchPlayLatency>(cycle_stage));
+		csv += FString::Printf(TEXT("%s,%d,%.4f,%.4f,%.4f,%.4f,%.4f"), StageNames[cycle_stage], histogram.num_samples_,
+			histogram.average_ms_, histogram.p50_ms_, histogram.p90_ms_, histogram.p99_ms_, histogram.max_ms_);
+		for (int32 count : histogram.bucket_counts_)
+		{
+			csv += FString::Printf(TEXT(",%d"), count);
+		}
+		csv += TEXT("\n");
+	}
+
+	return FFileHelper::SaveStringToFile(csv, *_out_file_path);
+}
@@ -0,0 +1,132 @@
+// Copyright (C) Simone Di Gravio <email: altairjp@gmail.com> - All Rights Reserved
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Stats/Stats.h"
+#include "Stats/TwitchPlayStatsLibrary.h"
+
+DECLARE_STATS_GROUP(TEXT("TwitchPlay"), STATGROUP_TwitchPlay, STATCAT_Advanced);
+
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Receive (connection thread)"), STAT_TwitchPlay_Receive, STATGROUP_TwitchPlay, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Parse"), STAT_TwitchPlay_Parse, STATGROUP_TwitchPlay, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Pump"), STAT_TwitchPlay_Pump, STATGROUP_TwitchPlay, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Dispatch message"), STAT_TwitchPlay_Dispatch, STATGROUP_TwitchPlay, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Match command"), STAT_TwitchPlay_MatchCommand, STATGROUP_TwitchPlay, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Match keywords"), STAT_TwitchPlay_MatchKeywords, STATGROUP_TwitchPlay, );
+
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Bytes in"), STAT_TwitchPlay_BytesIn, STATGROUP_TwitchPlay, );
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Bytes out"), STAT_TwitchPlay_BytesOut, STATGROUP_TwitchPlay, );
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Lines parsed"), STAT_TwitchPlay_LinesParsed, STATGROUP_TwitchPlay, );
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Messages dispatched"), STAT_TwitchPlay_MessagesDispatched, STATGROUP_TwitchPlay, );
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Commands matched"), STAT_TwitchPlay_CommandsMatched, STATGROUP_TwitchPlay, );
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Commands unmatched"), STAT_TwitchPlay_CommandsUnmatched, STATGROUP_TwitchPlay, );
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Commands suppressed"), STAT_TwitchPlay_CommandsSuppressed, STATGROUP_TwitchPlay, );
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Commands malformed"), STAT_TwitchPlay_CommandsMalformed, STATGROUP_TwitchPlay, );
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Messages shed"), STAT_TwitchPlay_MessagesShed, STATGROUP_TwitchPlay, );
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Messages deferred"), STAT_TwitchPlay_MessagesDeferred, STATGROUP_TwitchPlay, );
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Keyword hits"), STAT_TwitchPlay_KeywordHits, STATGROUP_TwitchPlay, );
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Commands replicated"), STAT_TwitchPlay_CommandsReplicated, STATGROUP_TwitchPlay, );
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Batch bytes"), STAT_TwitchPlay_BatchBytes, STATGROUP_TwitchPlay, );
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Commands dropped"), STAT_TwitchPlay_CommandsDropped, STATGROUP_TwitchPlay, );
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Inbound queue depth"), STAT_TwitchPlay_InboundQueueDepth, STATGROUP_TwitchPlay, );
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Send queue depth"), STAT_TwitchPlay_SendQueueDepth, STATGROUP_TwitchPlay, );
+
+// Totals kept by FTwitchPlayStats
+enum class ETwitchPlayCounter : uint8
+{
+	BytesIn,
+	BytesOut,
+	LinesParsed,
+	MessagesDispatched,
+	CommandsMatched,
+	CommandsUnmatched,
+	CommandsSuppressed,
+	CommandsMalformed,
+	MessagesShed,
+	MessagesDeferred,
+	KeywordHits,
+	CommandsReplicated,
+	BatchBytes,
+	CommandsDropped,
+
+	Num
+};
+
+/**
+ * Counters and latency histograms of the message pipeline.
+ * Connection threads only bump atomics: the game thread turns the totals into per frame stats (see PublishFrameStats),
+ * so "stat TwitchPlay" shows them no matter which thread counted them.
+ * Recording is lock free and never allocates. Everything else is game thread only.
+ */
+class FTwitchPlayStats
+{
+public:
+
+	// Buckets of each histogram. Bucket 0 holds samples under 1 microsecond, bucket N samples under 2^N microseconds
+	static const int32 NumBuckets = 24;
+
+	// Adds to a total. Any thread
+	static void Add(ETwitchPlayCounter _counter, int64 _amount)
+	{
+		FPlatformAtomics::InterlockedAdd(&counters_[static_cast<int32>(_counter)], _amount);
+	}
+
+	static int64 Get(ETwitchPlayCounter _counter)
+	{
+		return FPlatformAtomics::AtomicRead(&counters_[static_cast<int32>(_counter)]);
+	}
+
+	/**
+	 * Records a sample in the histogram of a stage. Any thread.
+	 *
+	 * @param _stage - Pipeline stage measured.
+	 * @param _cycles - Duration, in FPlatformTime::Cycles64 units.
+	 */
+	static void RecordLatency(ETwitchPlayLatency _stage, uint64 _cycles);
+
+	// Sets the queue depths measured by the connection manager at the start of the frame
+	static void SetQueueDepths(int32 _inbound_messages, int32 _queued_lines);
+
+	// Turns what was counted since the previous call into the per frame stats. Called once per frame by the connection manager
+	static void PublishFrameStats();
+
+	static FTwitchPlayCounters GetCounters();
+
+	static FTwitchPlayLatencyHistogram GetHistogram(ETwitchPlayLatency _stage);
+
+	// Clears the totals and the histograms
+	static void Reset();
+
+	/**
+	 * Writes the counters and the histograms to a CSV file.
+	 *
+	 * @param _file_path - Absolute or relative to the project directory. If empty a timestamped file is written in Saved/Profiling/TwitchPlay.
+	 * @param _out_file_path - Full path of the written file.
+	 *
+	 * @return Whether the file was written.
+	 */
+	static bool DumpToCSV(const FString& _file_path, FString& _out_file_path);
+
+private:
+
+	struct FHistogram
+	{
+		int32 buckets_[NumBuckets];
+
+		int64 total_cycles_;
+
+		int64 max_cycles_;
+	};
+
+	static volatile int64 counters_[static_cast<int32>(ETwitchPlayCounter::Num)];
+
+	// Totals already published as per frame stats
+	static int64 published_counters_[static_cast<int32>(ETwitchPlayCounter::Num)];
+
+	static FHistogram histograms_[static_cast<int32>(ETwitchPlayLatency::Num)];
+
+	static int32 inbound_queue_depth_;
+
+	static int32 send_queue_depth_;
+};
@@ -0,0 +1,28 @@
+// Copyright (C) Simone Di Gravio <email: altairjp@gmail.com> - All Rights Reserved
+
+#include "Stats/TwitchPlayStatsLibrary.h"
+#include "Stats/TwitchPlayStats.h"
+
+FTwitchPlayCounters UTwitchPlayStatsLibrary::GetTwitchPlayCounters()
+{
+	return FTwitchPlayStats::GetCounters();
+}
+
+FTwitchPlayLatencyHistogram UTwitchPlayStatsLibrary::GetTwitchPlayLatencyHistogram(ETwitchPlayLatency _stage)
+{
+	if (_stage >= ETwitchPlayLatency::Num)
+	{
+		return FTwitchPlayLatencyHistogram();
+	}
+	return FTwitchPlayStats::GetHistogram(_stage);
+}
+
+void UTwitchPlayStatsLibrary::ResetTwitchPlayStats()
+{
+	FTwitchPlayStats::Reset();
+}
+
+bool UTwitchPlayStatsLibrary::DumpTwitchPlayStatsToCSV(const FString& _file_path, FString& _out_file_path)
+{
+	return FTwitchPlayStats::DumpToCSV(_file_path, _out_file_path);
+}
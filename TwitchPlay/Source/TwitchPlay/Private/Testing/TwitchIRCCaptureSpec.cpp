@@ -0,0 +1,168 @@
+// Copyright (C) Simone Di Gravio <email: altairjp@gmail.com> - All Rights Reserved
+
+#include "CoreMinimal.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+#include "Net/TwitchIRCCapture.h"
+#include "HAL/FileManager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+
+BEGIN_DEFINE_SPEC(FTwitchIRCCaptureSpec, "TwitchPlay.Capture", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+	FString capture_file_;
+
+	// Cycles the blocks are timed from. Taken right after the writer opened, so it trails the writer's own start by a few microseconds
+	uint64 start_cycles_ = 0;
+
+	// Lines encoded the way connections capture them: varint length, then the bytes
+	static TArray<uint8> EncodeLines(const TArray<FString>& _lines)
+	{
+		TArray<uint8> encoded_lines;
+		for (const FString& line : _lines)
+		{
+			const FTCHARToUTF8 utf8_line(*line);
+			TwitchIRCCapture::WriteVarint(encoded_lines, static_cast<uint64>(utf8_line.Length()));
+			encoded_lines.Append(reinterpret_cast<const uint8*>(utf8_line.Get()), utf8_line.Length());
+		}
+		return encoded_lines;
+	}
+
+	// Appends the lines as one block, read this many seconds after the capture started
+	void AppendBlock(FTwitchIRCCaptureWriter& _writer, double _seconds, const TArray<FString>& _lines)
+	{
+		const uint64 receive_cycles = start_cycles_ + static_cast<uint64>(_seconds / FPlatformTime::GetSecondsPerCycle64());
+		_writer.AppendBlock(receive_cycles, _lines.Num(), EncodeLines(_lines));
+	}
+
+	// Lines of a socket read, and when it happened in seconds since the capture started
+	struct FBlock
+	{
+		double seconds_;
+
+		TArray<FString> lines_;
+	};
+
+	// Writes a capture with these blocks
+	bool WriteCapture(const TArray<FBlock>& _blocks)
+	{
+		FTwitchIRCCaptureWriter writer;
+		FString error;
+		if (!writer.Open(capture_file_, error))
+		{
+			AddError(error);
+			return false;
+		}
+		start_cycles_ = FPlatformTime::Cycles64();
+		for (const FBlock& block : _blocks)
+		{
+			AppendBlock(writer, block.seconds_, block.lines_);
+		}
+		writer.Flush();
+		return true;
+	}
+
+	// Every line of the capture as "<seconds> <line>", separated by " | ". Times are rounded to the hundredth
+	FString ReadCapture(FTwitchIRCCaptureReader& _reader)
+	{
+		TArray<FString> lines;
+		double line_time;
+		const ANSICHAR* line_data;
+		int32 line_length;
+		while (lines.Num() < 100 && _reader.NextLine(line_time, line_data, line_length))
+		{
+			const FUTF8ToTCHAR line(line_data, line_length);
+			lines.Add(FString::Printf(TEXT("%.2f %s"), line_time, *FString(line.Length(), line.Get())));
+		}
+		TestFalse(TEXT("Ended for good"), _reader.NextLine(line_time, line_data, line_length));
+		return FString::Join(lines, TEXT(" | "));
+	}
+
+END_DEFINE_SPEC(FTwitchIRCCaptureSpec)
+
+void FTwitchIRCCaptureSpec::Define()
+{
+	BeforeEach([this]()
+	{
+		capture_file_ = FPaths::Combine(FPaths::AutomationTransientDir(), TEXT("TwitchPlayCaptureSpec.tpcap"));
+	});
+
+	AfterEach([this]()
+	{
+		IFileManager::Get().Delete(*capture_file_, false, false, true);
+	});
+
+	It("reads back the blocks written, with their timing", [this]()
+	{
+		const FDateTime before_capture = FDateTime::UtcNow();
+		if (!WriteCapture({ { 0.5, { TEXT("PING :tmi.twitch.tv"), TEXT(":tmi.twitch.tv 001 twitchplay :Welcome") } }, { 1.25, { TEXT("@badge-info= :viewer PRIVMSG #twitchplay :hello") } } }))
+		{
+			return;
+		}
+
+		FTwitchIRCCaptureReader reader;
+		FString error;
+		TestTrue(TEXT("Opened"), reader.Open(capture_file_, error));
+		TestTrue(TEXT("Start time"), reader.GetStartTime() >= before_capture && reader.GetStartTime() <= FDateTime::UtcNow());
+		TestEqual(TEXT("Lines"), ReadCapture(reader),
+			FString(TEXT("0.50 PING :tmi.twitch.tv | 0.50 :tmi.twitch.tv 001 twitchplay :Welcome | 1.25 @badge-info= :viewer PRIVMSG #twitchplay :hello")));
+	});
+
+	It("clamps blocks appended out of order to the time of the previous one", [this]()
+	{
+		// Connection threads can append a read after a later one
+		if (!WriteCapture({ { 2.0, { TEXT("first") } }, { 1.0, { TEXT("second") } }, { 3.0, { TEXT("third") } } }))
+		{
+			return;
+		}
+
+		FTwitchIRCCaptureReader reader;
+		FString error;
+		TestTrue(TEXT("Opened"), reader.Open(capture_file_, error));
+		TestEqual(TEXT("Lines"), ReadCapture(reader), FString(TEXT("2.00 first | 2.00 second | 3.00 third")));
+	});
+
+	It("rejects files without the capture header", [this]()
+	{
+		TArray<uint8> not_a_capture;
+		not_a_capture.Append(reinterpret_cast<const uint8*>("TPCAP999"), 8);
+		not_a_capture.AddZeroed(TwitchIRCCapture::HeaderSize);
+		FFileHelper::SaveArrayToFile(not_a_capture, *capture_file_);
+
+		FTwitchIRCCaptureReader reader;
+		FString error;
+		TestFalse(TEXT("Bad magic number"), reader.Open(capture_file_, error));
+		TestFalse(TEXT("Bad magic number reported"), error.IsEmpty());
+
+		// A valid magic number without the rest of the header
+		TArray<uint8> short_header;
+		short_header.Append(reinterpret_cast<const uint8*>(TwitchIRCCapture::Magic), sizeof(TwitchIRCCapture::Magic));
+		FFileHelper::SaveArrayToFile(short_header, *capture_file_);
+		error.Reset();
+		TestFalse(TEXT("Short header"), reader.Open(capture_file_, error));
+		TestFalse(TEXT("Short header reported"), error.IsEmpty());
+	});
+
+	It("ends the replay cleanly on a truncated last block", [this]()
+	{
+		if (!WriteCapture({ { 0.5, { TEXT("first"), TEXT("second") } }, { 1.0, { TEXT("third"), TEXT("cut short") } } }))
+		{
+			return;
+		}
+
+		// Like a capture cut by a crash, in the middle of the last line
+		TArray<uint8> capture;
+		TestTrue(TEXT("Loaded"), FFileHelper::LoadFileToArray(capture, *capture_file_));
+		capture.SetNum(capture.Num() - 3);
+		FFileHelper::SaveArrayToFile(capture, *capture_file_);
+
+		FTwitchIRCCaptureReader reader;
+		FString error;
+		TestTrue(TEXT("Opened"), reader.Open(capture_file_, error));
+		TestEqual(TEXT("Complete lines"), ReadCapture(reader), FString(TEXT("0.50 first | 0.50 second | 1.00 third")));
+	});
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS
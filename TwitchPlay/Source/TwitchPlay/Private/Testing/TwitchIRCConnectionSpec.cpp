@@ -0,0 +1,715 @@
+// Copyright (C) Simone Di Gravio <email: altairjp@gmail.com> - All Rights Reserved
+
+#include "CoreMinimal.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+#include "Testing/TwitchPlayTestUtils.h"
+#include "Testing/TwitchPlayTestReceiver.h"
+#include "Components/TwitchIRCComponent.h"
+#include "Net/TwitchIRCConnectionManager.h"
+#include "Net/TwitchIRCRateLimiter.h"
+#include "Net/TwitchIRCSendQueue.h"
+#include "Net/TwitchIRCSession.h"
+#include "Net/TwitchIRCUserRegistry.h"
+#include "Net/TwitchIRCLine.h"
+
+namespace
+{
+	// Ignores what a session receives
+	class FTwitchIRCNullSessionHandler : public ITwitchIRCSessionHandler
+	{
+	public:
+
+		virtual void OnMessage(const FTwitchIRCLine& _line, int32 _channel_id) override
+		{
+		}
+	};
+}
+
+BEGIN_DEFINE_SPEC(FTwitchIRCConnectionSpec, "TwitchPlay.Connection", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+	// What the fake socket received
+	TArray<uint8> sent_bytes_;
+
+	// Calls to the fake socket
+	int32 num_sends_ = 0;
+
+	// Bytes the fake socket accepts before it would block
+	int32 socket_room_ = MAX_int32;
+
+	bool Flush(FTwitchIRCSendQueue& _queue, double _now, bool _b_send_queued_lines = true)
+	{
+		return _queue.Flush(_now, [this](const uint8* _data, int32 _size, int32& _out_sent)
+		{
+			++num_sends_;
+			_out_sent = FMath::Min(_size, socket_room_);
+			socket_room_ -= _out_sent;
+			sent_bytes_.Append(_data, _out_sent);
+			return true;
+		}, _b_send_queued_lines);
+	}
+
+	FString GetSentText() const
+	{
+		FString text;
+		for (const uint8 byte : sent_bytes_)
+		{
+			text.AppendChar(static_cast<TCHAR>(byte));
+		}
+		return text;
+	}
+
+	// Registers a session as if the server welcomed it
+	void RegisterSession(FTwitchIRCSession& _session)
+	{
+		FTwitchIRCNullSessionHandler handler;
+		const ANSICHAR* welcome = ":tmi.twitch.tv 001 twitchplay :Welcome, GLHF!";
+		_session.ReceiveLine(welcome, FCStringAnsi::Strlen(welcome), handler);
+	}
+
+	// Syncs the channels of a session and sends its lines. Returns the amount of channels in the JOIN lines sent
+	int32 SyncAndCountJoins(FTwitchIRCSession& _session, const TArray<FString>& _channel_names, double _now, bool& _out_b_joined_all)
+	{
+		TBitArray<> wanted_channels(true, _channel_names.Num());
+		_out_b_joined_all = _session.SyncChannels(_channel_names, wanted_channels, _now);
+
+		sent_bytes_.Reset();
+		Flush(_session.GetSendQueue(), _now);
+		int32 joined_channels = 0;
+		for (const uint8 byte : sent_bytes_)
+		{
+			joined_channels += byte == '#' ? 1 : 0;
+		}
+		return joined_channels;
+	}
+
+	// Interns the sender of a line with these raw tags (without the '@')
+	static int32 InternUser(FTwitchIRCUserRegistry& _registry, const ANSICHAR* _login, const ANSICHAR* _raw_tags, const FString*& _out_login)
+	{
+		const FTwitchIRCTags tags(FTwitchIRCStringView(_raw_tags, FCStringAnsi::Strlen(_raw_tags)));
+		return _registry.InternUser(FTwitchIRCStringView(_login, FCStringAnsi::Strlen(_login)), tags, _out_login);
+	}
+
+	// Pool of idle shards, one channel each, and the component listening to every channel
+	TUniquePtr<FTwitchIRCConnectionPool> pool_;
+
+	TArray<FTwitchIRCConnection*> shards_;
+
+	UTwitchIRCComponent* component_ = nullptr;
+
+	UTwitchPlayTestReceiver* receiver_ = nullptr;
+
+	void MakeComponent()
+	{
+		component_ = NewObject<UTwitchIRCComponent>();
+		component_->AddToRoot();
+		receiver_ = NewObject<UTwitchPlayTestReceiver>();
+		receiver_->AddToRoot();
+		component_->OnMessageReceived.AddDynamic(receiver_, &UTwitchPlayTestReceiver::OnMessage);
+		component_->OnInboundQueueReport.AddDynamic(receiver_, &UTwitchPlayTestReceiver::OnInboundQueueReport);
+	}
+
+	void ReleaseComponent()
+	{
+		// The pool goes first, it points to the component
+		pool_.Reset();
+		shards_.Reset();
+		component_->RemoveFromRoot();
+		component_ = nullptr;
+		receiver_->RemoveFromRoot();
+		receiver_ = nullptr;
+	}
+
+	void MakePool(ETwitchOverloadPolicy _policy, int32 _inbound_capacity, int32 _dispatch_budget_microseconds = 0, int32 _num_shards = 1)
+	{
+		FTwitchIRCConnectionPool::FSettings settings;
+		settings.connection_settings_.overload_policy_ = _policy;
+		settings.connection_settings_.inbound_capacity_ = _inbound_capacity;
+		settings.dispatch_budget_microseconds_ = _dispatch_budget_microseconds;
+		settings.max_connections_ = _num_shards;
+		settings.max_channels_per_connection_ = 1;
+		pool_ = MakeUnique<FTwitchIRCConnectionPool>(TEXT("twitchplay"), settings, MakeShared<FTwitchIRCUserRegistry, ESPMode::ThreadSafe>());
+
+		for (int32 cycle_shard = 0; cycle_shard < _num_shards; ++cycle_shard)
+		{
+			shards_.Add(&FTwitchPlayTestAccess::AddIdleShard(*pool_));
+		}
+		pool_->AddSubscriber(component_);
+		for (int32 cycle_shard = 0; cycle_shard < _num_shards; ++cycle_shard)
+		{
+			pool_->AddListener(FString::Printf(TEXT("channel%d"), cycle_shard), component_, cycle_shard);
+		}
+	}
+
+	// Queues chat lines on the only channel of a shard
+	void ReceiveChat(int32 _shard, const TArray<FString>& _contents)
+	{
+		for (const FString& content : _contents)
+		{
+			FTwitchPlayTestAccess::ReceiveLine(*shards_[_shard], FString::Printf(TEXT(":viewer!viewer@viewer.tmi.twitch.tv PRIVMSG #channel%d :%s"), _shard, *content), 0);
+		}
+	}
+
+	// Chat lines "<prefix>0" to "<prefix><_num - 1>"
+	static TArray<FString> MakeContents(const TCHAR* _prefix, int32 _num)
+	{
+		TArray<FString> contents;
+		for (int32 cycle_content = 0; cycle_content < _num; ++cycle_content)
+		{
+			contents.Add(FString::Printf(TEXT("%s%d"), _prefix, cycle_content));
+		}
+		return contents;
+	}
+
+	// Contents received by the component so far, separated by spaces
+	FString GetReceived() const
+	{
+		return FString::Join(receiver_->messages_, TEXT(" "));
+	}
+
+	// One entry per OnMessagesReceivedSpan broadcast, see DescribeSpan()
+	TArray<FString> spans_;
+
+	// "<content>/<username>/<channel ID>" for each message of the span, separated by spaces. "server" stands for a null username
+	FString DescribeSpan(const FTwitchMessageSpan& _span)
+	{
+		TestEqual(TEXT("Span handles"), _span.user_handles_.Num(), _span.Num());
+		TestEqual(TEXT("Span channels"), _span.channel_ids_.Num(), _span.Num());
+		TestEqual(TEXT("Span receive cycles"), _span.receive_cycles_.Num(), _span.Num());
+		TestEqual(TEXT("Span usernames"), _span.usernames_.Num(), _span.Num());
+
+		TArray<FString> messages;
+		for (int32 cycle_message = 0; cycle_message < _span.Num(); ++cycle_message)
+		{
+			const FString* username = _span.usernames_[cycle_message];
+			TestTrue(TEXT("Null username iff no handle"), (username == nullptr) == (_span.user_handles_[cycle_message] == INDEX_NONE));
+			messages.Add(FString::Printf(TEXT("%s/%s/%d"), **_span.contents_[cycle_message], username != nullptr ? **username : TEXT("server"), _span.channel_ids_[cycle_message]));
+		}
+		return FString::Join(messages, TEXT(" "));
+	}
+
+	// "<content>/<user or server>/<channel ID>" for each message of the batch, separated by spaces
+	FString DescribeBatch(const FTwitchMessageBatch& _batch)
+	{
+		TestEqual(TEXT("Batch handles"), _batch.user_handles_.Num(), _batch.Num());
+		TestEqual(TEXT("Batch channels"), _batch.channel_ids_.Num(), _batch.Num());
+		TestEqual(TEXT("Batch receive times"), _batch.receive_times_.Num(), _batch.Num());
+
+		TArray<FString> messages;
+		for (int32 cycle_message = 0; cycle_message < _batch.Num(); ++cycle_message)
+		{
+			const TCHAR* sender = _batch.user_handles_[cycle_message] != INDEX_NONE ? TEXT("user") : TEXT("server");
+			messages.Add(FString::Printf(TEXT("%s/%s/%d"), *_batch.contents_[cycle_message], sender, _batch.channel_ids_[cycle_message]));
+		}
+		return FString::Join(messages, TEXT(" "));
+	}
+
+END_DEFINE_SPEC(FTwitchIRCConnectionSpec)
+
+void FTwitchIRCConnectionSpec::Define()
+{
+	BeforeEach([this]()
+	{
+		sent_bytes_.Reset();
+		num_sends_ = 0;
+		socket_room_ = MAX_int32;
+	});
+
+	Describe("FTwitchIRCRateLimiter", [this]()
+	{
+		It("allows half the budget at once, then refills", [this]()
+		{
+			FTwitchIRCRateLimiter rate_limiter;
+			rate_limiter.SetRateLimit(20, 30.0);
+
+			int32 burst = 0;
+			while (burst < 100 && rate_limiter.TryConsume(100.0))
+			{
+				++burst;
+			}
+			TestEqual(TEXT("Burst"), burst, 10);
+
+			// The other half refills over the window: a token every 3 seconds
+			TestFalse(TEXT("Not refilled yet"), rate_limiter.TryConsume(102.0));
+			TestTrue(TEXT("Refilled"), rate_limiter.TryConsume(103.1));
+			TestFalse(TEXT("Only one refilled"), rate_limiter.TryConsume(103.1));
+		});
+
+		It("never exceeds the budget in a window", [this]()
+		{
+			FTwitchIRCRateLimiter rate_limiter;
+			rate_limiter.SetRateLimit(20, 30.0);
+
+			int32 consumed = 0;
+			for (double now = 0.0; now < 30.0; now += 0.05)
+			{
+				consumed += rate_limiter.TryConsume(now) ? 1 : 0;
+			}
+			TestTrue(FString::Printf(TEXT("%d messages in 30 seconds"), consumed), consumed <= 20 && consumed >= 19);
+		});
+
+		It("caps the refill to the burst", [this]()
+		{
+			FTwitchIRCRateLimiter rate_limiter;
+			rate_limiter.SetRateLimit(20, 30.0);
+			rate_limiter.TryConsume(0.0);
+
+			int32 burst = 0;
+			while (burst < 100 && rate_limiter.TryConsume(1000.0))
+			{
+				++burst;
+			}
+			TestEqual(TEXT("Burst after a long idle time"), burst, 10);
+		});
+
+		It("keeps the spent tokens when the budget changes", [this]()
+		{
+			FTwitchIRCRateLimiter rate_limiter;
+			rate_limiter.SetRateLimit(20, 30.0);
+			while (rate_limiter.TryConsume(100.0))
+			{
+			}
+
+			rate_limiter.SetRateLimit(100, 30.0);
+			TestFalse(TEXT("No new burst"), rate_limiter.TryConsume(100.0));
+
+			// The new budget refills a token every 0.6 seconds
+			TestTrue(TEXT("Refilled at the new rate"), rate_limiter.TryConsume(100.7));
+		});
+
+		It("clamps the budget to two messages per window", [this]()
+		{
+			for (const int32 messages_per_window : { -5, 0, 1, 2 })
+			{
+				FTwitchIRCRateLimiter rate_limiter;
+				rate_limiter.SetRateLimit(messages_per_window, 30.0);
+				const FString budget = FString::Printf(TEXT("Budget %d: "), messages_per_window);
+
+				TestTrue(budget + TEXT("first message"), rate_limiter.TryConsume(0.0));
+				TestFalse(budget + TEXT("burst of one"), rate_limiter.TryConsume(0.0));
+				TestFalse(budget + TEXT("not refilled yet"), rate_limiter.TryConsume(29.0));
+				TestTrue(budget + TEXT("refilled over the window"), rate_limiter.TryConsume(30.1));
+			}
+		});
+	});
+
+	Describe("FTwitchIRCSendQueue", [this]()
+	{
+		It("coalesces the queued lines into a single send", [this]()
+		{
+			FTwitchIRCSendQueue queue;
+			queue.Enqueue(TEXT("JOIN #a"), false);
+			queue.Enqueue(TEXT("JOIN #b"), false);
+			queue.Enqueue(TEXT("PRIVMSG #a :hi"), true);
+			queue.EnqueuePriority("PONG :tmi", 9);
+
+			TestTrue(TEXT("Flushed"), Flush(queue, FPlatformTime::Seconds()));
+			TestEqual(TEXT("Sends"), num_sends_, 1);
+			TestEqual(TEXT("Priority line first, then in order"), GetSentText(), FString(TEXT("PONG :tmi\r\nJOIN #a\r\nJOIN #b\r\nPRIVMSG #a :hi\r\n")));
+			TestFalse(TEXT("Nothing left"), queue.HasPendingData());
+		});
+
+		It("resumes a partial send before anything else", [this]()
+		{
+			FTwitchIRCSendQueue queue;
+			queue.Enqueue(TEXT("PRIVMSG #a :one"), true);
+			socket_room_ = 5;
+			TestTrue(TEXT("A full socket is not an error"), Flush(queue, FPlatformTime::Seconds()));
+			TestTrue(TEXT("Tail pending"), queue.HasPendingData());
+
+			queue.Enqueue(TEXT("PRIVMSG #a :two"), true);
+			queue.EnqueuePriority("PONG :tmi", 9);
+			socket_room_ = MAX_int32;
+			TestTrue(TEXT("Flushed the tail"), Flush(queue, FPlatformTime::Seconds()));
+			TestTrue(TEXT("Flushed the rest"), Flush(queue, FPlatformTime::Seconds()));
+			TestEqual(TEXT("Lines never interleaved"), GetSentText(), FString(TEXT("PRIVMSG #a :one\r\nPONG :tmi\r\nPRIVMSG #a :two\r\n")));
+		});
+
+		It("holds chat lines past the budget, and what follows them", [this]()
+		{
+			FTwitchIRCSendQueue queue;
+			queue.SetRateLimit(2, 30.0); // A single message at once, the other one 30 seconds later
+			queue.Enqueue(TEXT("PRIVMSG #a :one"), true);
+			queue.Enqueue(TEXT("PRIVMSG #a :two"), true);
+			queue.Enqueue(TEXT("PART #a"), false);
+
+			const double now = FPlatformTime::Seconds();
+			TestTrue(TEXT("Flushed"), Flush(queue, now));
+			TestEqual(TEXT("First message only"), GetSentText(), FString(TEXT("PRIVMSG #a :one\r\n")));
+
+			// Priority lines are never delayed
+			queue.EnqueuePriority("PONG :tmi", 9);
+			TestTrue(TEXT("Flushed priority"), Flush(queue, now + 1.0));
+			TestEqual(TEXT("Priority line through"), GetSentText(), FString(TEXT("PRIVMSG #a :one\r\nPONG :tmi\r\n")));
+			TestTrue(TEXT("Held line pending"), queue.HasPendingData());
+
+			TestTrue(TEXT("Flushed later"), Flush(queue, now + 31.0));
+			TestEqual(TEXT("Rest in order"), GetSentText(), FString(TEXT("PRIVMSG #a :one\r\nPONG :tmi\r\nPRIVMSG #a :two\r\nPART #a\r\n")));
+
+			int32 dropped;
+			int32 delayed;
+			double longest_delay;
+			queue.ConsumeReport(dropped, delayed, longest_delay);
+			TestEqual(TEXT("Delayed lines"), delayed, 2);
+			TestTrue(TEXT("Longest delay"), longest_delay >= 30.0);
+		});
+
+		It("only sends priority lines when asked to", [this]()
+		{
+			FTwitchIRCSendQueue queue;
+			queue.Enqueue(TEXT("JOIN #a"), false);
+			queue.EnqueuePriority("PASS oauth:x", 12);
+			TestTrue(TEXT("Flushed"), Flush(queue, FPlatformTime::Seconds(), false));
+			TestEqual(TEXT("Priority line only"), GetSentText(), FString(TEXT("PASS oauth:x\r\n")));
+			TestEqual(TEXT("Queued line kept"), queue.GetNumQueuedLines(), 1);
+		});
+
+		It("drops lines past its capacity", [this]()
+		{
+			FTwitchIRCSendQueue queue(2);
+			TestTrue(TEXT("First"), queue.Enqueue(TEXT("a"), false));
+			TestTrue(TEXT("Second"), queue.Enqueue(TEXT("b"), false));
+			TestFalse(TEXT("Third"), queue.Enqueue(TEXT("c"), false));
+
+			int32 dropped;
+			int32 delayed;
+			double longest_delay;
+			queue.ConsumeReport(dropped, delayed, longest_delay);
+			TestEqual(TEXT("Dropped"), dropped, 1);
+		});
+
+		It("reports connection errors", [this]()
+		{
+			FTwitchIRCSendQueue queue;
+			queue.Enqueue(TEXT("JOIN #a"), false);
+			const bool b_flushed = queue.Flush(FPlatformTime::Seconds(), [](const uint8*, int32, int32& _out_sent)
+			{
+				_out_sent = 0;
+				return false;
+			});
+			TestFalse(TEXT("Failed"), b_flushed);
+		});
+	});
+
+	Describe("FTwitchIRCSession", [this]()
+	{
+		It("joins the channels within a join budget shared by the sessions of the account", [this]()
+		{
+			TArray<FString> channel_names;
+			for (int32 cycle_channel = 0; cycle_channel < 15; ++cycle_channel)
+			{
+				channel_names.Add(FString::Printf(TEXT("channel%d"), cycle_channel));
+			}
+			const TSharedRef<FTwitchIRCRateLimiter, ESPMode::ThreadSafe> join_limiter = FTwitchIRCSession::MakeJoinLimiter();
+			FTwitchIRCSession first_session;
+			FTwitchIRCSession second_session;
+			first_session.SetJoinLimiter(join_limiter);
+			second_session.SetJoinLimiter(join_limiter);
+			RegisterSession(first_session);
+			RegisterSession(second_session);
+
+			// Half the budget at once, then a channel per second
+			bool b_joined_all = true;
+			TestEqual(TEXT("First session, burst"), SyncAndCountJoins(first_session, channel_names, 100.0, b_joined_all), 10);
+			TestFalse(TEXT("First session waits"), b_joined_all);
+			TestEqual(TEXT("Second session, budget spent"), SyncAndCountJoins(second_session, channel_names, 100.0, b_joined_all), 0);
+			TestEqual(TEXT("Second session, refilled"), SyncAndCountJoins(second_session, channel_names, 105.1, b_joined_all), 5);
+			TestFalse(TEXT("Second session waits"), b_joined_all);
+
+			// Channels sent are not sent again, the others are
+			TestEqual(TEXT("First session, the rest"), SyncAndCountJoins(first_session, channel_names, 200.0, b_joined_all), 5);
+			TestTrue(TEXT("First session joined"), b_joined_all);
+			TestEqual(TEXT("Second session, what is left of the burst"), SyncAndCountJoins(second_session, channel_names, 200.0, b_joined_all), 5);
+			TestEqual(TEXT("Second session, the rest"), SyncAndCountJoins(second_session, channel_names, 205.1, b_joined_all), 5);
+			TestTrue(TEXT("Second session joined"), b_joined_all);
+			TestEqual(TEXT("Nothing left to join"), SyncAndCountJoins(second_session, channel_names, 300.0, b_joined_all), 0);
+
+			// A new connection joins everything again, within the budget
+			first_session.Begin();
+			RegisterSession(first_session);
+			TestEqual(TEXT("Joined again"), SyncAndCountJoins(first_session, channel_names, 400.0, b_joined_all), 10);
+			TestFalse(TEXT("Rejoin waits"), b_joined_all);
+		});
+
+		It("joins every channel at once without a join budget", [this]()
+		{
+			TArray<FString> channel_names;
+			for (int32 cycle_channel = 0; cycle_channel < 50; ++cycle_channel)
+			{
+				channel_names.Add(FString::Printf(TEXT("channel%d"), cycle_channel));
+			}
+			FTwitchIRCSession session;
+			RegisterSession(session);
+
+			bool b_joined_all = false;
+			TestEqual(TEXT("Joined"), SyncAndCountJoins(session, channel_names, 0.0, b_joined_all), 50);
+			TestTrue(TEXT("Nothing waits"), b_joined_all);
+		});
+	});
+
+	Describe("FTwitchIRCUserRegistry", [this]()
+	{
+		It("gives the same login the same handle", [this]()
+		{
+			FTwitchIRCUserRegistry registry;
+			const FString* first_login = nullptr;
+			const FString* second_login = nullptr;
+			const int32 user_handle = InternUser(registry, "viewer", "", first_login);
+			TestEqual(TEXT("Same handle"), InternUser(registry, "viewer", "", second_login), user_handle);
+			TestTrue(TEXT("Same interned login"), first_login != nullptr && first_login == second_login);
+			TestNotEqual(TEXT("Other login"), InternUser(registry, "other", "", second_login), user_handle);
+			TestEqual(TEXT("Users"), registry.Num(), 2);
+			TestEqual(TEXT("Login"), registry.GetLogin(user_handle), FString(TEXT("viewer")));
+			TestEqual(TEXT("Empty login"), InternUser(registry, "", "", second_login), static_cast<int32>(INDEX_NONE));
+		});
+
+		It("keeps the handle of a renamed user, found by user-id", [this]()
+		{
+			FTwitchIRCUserRegistry registry;
+			const FString* old_login = nullptr;
+			const FString* new_login = nullptr;
+			const int32 user_handle = InternUser(registry, "oldname", "display-name=OldName;user-id=42", old_login);
+			TestEqual(TEXT("Renamed"), InternUser(registry, "newname", "display-name=NewName;user-id=42", new_login), user_handle);
+
+			// Queued messages can still point to the old login
+			TestTrue(TEXT("Old login kept"), old_login != nullptr && *old_login == TEXT("oldname"));
+			TestTrue(TEXT("New login"), new_login != nullptr && *new_login == TEXT("newname"));
+			TestEqual(TEXT("Current login"), registry.GetLogin(user_handle), FString(TEXT("newname")));
+			TestEqual(TEXT("Display name"), registry.GetDisplayName(user_handle), FString(TEXT("NewName")));
+			TestEqual(TEXT("Twitch ID"), registry.GetTwitchId(user_handle), static_cast<int64>(42));
+			TestEqual(TEXT("Old login freed"), registry.FindUser(TEXT("oldname")), static_cast<int32>(INDEX_NONE));
+			TestEqual(TEXT("New login found"), registry.FindUser(TEXT("newname")), user_handle);
+			TestEqual(TEXT("Users"), registry.Num(), 1);
+		});
+
+		It("gives a login taken over by another account a handle of its own", [this]()
+		{
+			FTwitchIRCUserRegistry registry;
+			const FString* login = nullptr;
+			const int32 first_owner = InternUser(registry, "viewer", "user-id=42", login);
+			TestEqual(TEXT("Known user"), InternUser(registry, "viewer", "user-id=42", login), first_owner);
+
+			// The first owner renamed, but was not seen since: only the ID tells the accounts apart
+			const int32 second_owner = InternUser(registry, "viewer", "user-id=77", login);
+			TestNotEqual(TEXT("New account"), second_owner, first_owner);
+			TestEqual(TEXT("Second owner again"), InternUser(registry, "viewer", "user-id=77", login), second_owner);
+			TestEqual(TEXT("Login found for the second owner"), registry.FindUser(TEXT("viewer")), second_owner);
+			TestEqual(TEXT("Second owner ID"), registry.GetTwitchId(second_owner), static_cast<int64>(77));
+
+			TestEqual(TEXT("First owner under its new login"), InternUser(registry, "newviewer", "user-id=42", login), first_owner);
+			TestEqual(TEXT("First owner login"), registry.GetLogin(first_owner), FString(TEXT("newviewer")));
+			TestEqual(TEXT("Login still with the second owner"), registry.FindUser(TEXT("viewer")), second_owner);
+			TestEqual(TEXT("Users"), registry.Num(), 2);
+		});
+
+		It("finds users ignoring case", [this]()
+		{
+			FTwitchIRCUserRegistry registry;
+			const FString* login = nullptr;
+			const int32 user_handle = InternUser(registry, "viewer", "", login);
+			TestEqual(TEXT("Capitalized"), registry.FindUser(TEXT("Viewer")), user_handle);
+			TestEqual(TEXT("Upper case"), registry.FindUser(TEXT("VIEWER")), user_handle);
+			TestEqual(TEXT("Unknown"), registry.FindUser(TEXT("nobody")), static_cast<int32>(INDEX_NONE));
+		});
+	});
+
+	Describe("Overload", [this]()
+	{
+		BeforeEach([this]()
+		{
+			MakeComponent();
+		});
+
+		AfterEach([this]()
+		{
+			ReleaseComponent();
+		});
+
+		It("discards the oldest messages down to the capacity", [this]()
+		{
+			MakePool(ETwitchOverloadPolicy::DropOldest, 4);
+			ReceiveChat(0, MakeContents(TEXT("m"), 6));
+			TestEqual(TEXT("Queued past the capacity"), shards_[0]->GetNumQueuedMessages(), 6);
+
+			pool_->Dispatch();
+			TestEqual(TEXT("Dispatched"), GetReceived(), FString(TEXT("m2 m3 m4 m5")));
+			TestEqual(TEXT("Shed"), receiver_->shed_messages_, 2);
+			TestEqual(TEXT("Deferred"), receiver_->deferred_messages_, 0);
+			TestEqual(TEXT("Queue emptied"), shards_[0]->GetNumQueuedMessages(), 0);
+		});
+
+		It("discards without dispatching", [this]()
+		{
+			MakePool(ETwitchOverloadPolicy::DropOldest, 4);
+			ReceiveChat(0, MakeContents(TEXT("m"), 5));
+			TestEqual(TEXT("Discarded"), shards_[0]->DiscardOldestMessages(2), 3);
+			TestEqual(TEXT("Nothing to discard"), shards_[0]->DiscardOldestMessages(2), 0);
+			TestEqual(TEXT("Left"), shards_[0]->GetNumQueuedMessages(), 2);
+
+			pool_->Dispatch();
+			TestEqual(TEXT("Newest dispatched"), GetReceived(), FString(TEXT("m3 m4")));
+		});
+
+		It("rejects new messages past twice the capacity, whatever the policy", [this]()
+		{
+			MakePool(ETwitchOverloadPolicy::DropOldest, 4);
+			ReceiveChat(0, MakeContents(TEXT("m"), 12));
+			TestEqual(TEXT("Queued"), shards_[0]->GetNumQueuedMessages(), 8);
+
+			pool_->Dispatch();
+			TestEqual(TEXT("Dispatched"), GetReceived(), FString(TEXT("m4 m5 m6 m7")));
+			TestEqual(TEXT("Shed, rejected and discarded"), receiver_->shed_messages_, 8);
+		});
+
+		It("only lets commands in past the capacity with CommandsOnly", [this]()
+		{
+			MakePool(ETwitchOverloadPolicy::CommandsOnly, 2);
+			TArray<FString> contents = MakeContents(TEXT("chat"), 3);
+			contents.Add(TEXT("!jump!"));
+			contents.Add(TEXT("chat3"));
+			ReceiveChat(0, contents);
+			TestEqual(TEXT("Queued"), shards_[0]->GetNumQueuedMessages(), 3);
+
+			pool_->Dispatch();
+			TestEqual(TEXT("Dispatched"), GetReceived(), FString(TEXT("chat0 chat1 !jump!")));
+			TestEqual(TEXT("Shed"), receiver_->shed_messages_, 2);
+		});
+
+		It("dispatches everything without a budget", [this]()
+		{
+			MakePool(ETwitchOverloadPolicy::DropOldest, 100);
+			ReceiveChat(0, MakeContents(TEXT("m"), 50));
+			pool_->Dispatch();
+			TestEqual(TEXT("Dispatched"), receiver_->messages_.Num(), 50);
+			TestEqual(TEXT("Deferred"), receiver_->deferred_messages_, 0);
+		});
+
+		It("defers past the budget, but always dispatches one message", [this]()
+		{
+			// Every message costs ten times the budget of the frame
+			MakePool(ETwitchOverloadPolicy::DropOldest, 100, 10);
+			receiver_->message_cost_seconds_ = 0.0001;
+			ReceiveChat(0, MakeContents(TEXT("m"), 3));
+
+			pool_->Dispatch();
+			TestEqual(TEXT("First frame"), GetReceived(), FString(TEXT("m0")));
+			TestEqual(TEXT("Deferred"), receiver_->deferred_messages_, 2);
+			TestEqual(TEXT("Nothing shed"), receiver_->shed_messages_, 0);
+
+			pool_->Dispatch();
+			pool_->Dispatch();
+			TestEqual(TEXT("One per frame"), GetReceived(), FString(TEXT("m0 m1 m2")));
+			TestEqual(TEXT("Deferred in total"), receiver_->deferred_messages_, 3);
+
+			pool_->Dispatch();
+			TestEqual(TEXT("Nothing left"), receiver_->messages_.Num(), 3);
+		});
+
+		It("rotates the shard dispatched first", [this]()
+		{
+			MakePool(ETwitchOverloadPolicy::DropOldest, 100, 10, 2);
+			receiver_->message_cost_seconds_ = 0.0001;
+			ReceiveChat(0, MakeContents(TEXT("a"), 2));
+			ReceiveChat(1, MakeContents(TEXT("b"), 2));
+
+			for (int32 cycle_frame = 0; cycle_frame < 4; ++cycle_frame)
+			{
+				pool_->Dispatch();
+			}
+			TestEqual(TEXT("Shards take turns"), GetReceived(), FString(TEXT("a0 b0 a1 b1")));
+		});
+	});
+
+	Describe("Batch events", [this]()
+	{
+		BeforeEach([this]()
+		{
+			MakeComponent();
+			spans_.Reset();
+			component_->OnMessagesReceivedSpan.AddLambda([this](const FTwitchMessageSpan& _span)
+			{
+				spans_.Add(DescribeSpan(_span));
+			});
+		});
+
+		AfterEach([this]()
+		{
+			ReleaseComponent();
+		});
+
+		It("broadcasts every message of the frame once, in dispatch order", [this]()
+		{
+			component_->OnMessagesReceivedBatch.AddDynamic(receiver_, &UTwitchPlayTestReceiver::OnMessagesBatch);
+			MakePool(ETwitchOverloadPolicy::DropOldest, 100, 0, 2);
+			ReceiveChat(0, MakeContents(TEXT("a"), 2));
+			ReceiveChat(1, MakeContents(TEXT("b"), 1));
+
+			pool_->Dispatch();
+			TestEqual(TEXT("Dispatched"), GetReceived(), FString(TEXT("a0 a1 b0")));
+			TestEqual(TEXT("Span broadcasts"), spans_.Num(), 1);
+			if (spans_.Num() == 1)
+			{
+				TestEqual(TEXT("Span"), spans_[0], FString(TEXT("a0/viewer/0 a1/viewer/0 b0/viewer/1")));
+			}
+			TestEqual(TEXT("Batch broadcasts"), receiver_->batches_.Num(), 1);
+			if (receiver_->batches_.Num() == 1)
+			{
+				TestEqual(TEXT("Batch"), DescribeBatch(receiver_->batches_[0]), FString(TEXT("a0/user/0 a1/user/0 b0/user/1")));
+			}
+		});
+
+		It("gives server messages no handle and no username", [this]()
+		{
+			component_->OnMessagesReceivedBatch.AddDynamic(receiver_, &UTwitchPlayTestReceiver::OnMessagesBatch);
+			MakePool(ETwitchOverloadPolicy::DropOldest, 100);
+			FTwitchPlayTestAccess::ReceiveLine(*shards_[0], TEXT(":tmi.twitch.tv NOTICE * :hello"), INDEX_NONE);
+			ReceiveChat(0, MakeContents(TEXT("a"), 1));
+
+			pool_->Dispatch();
+			TestEqual(TEXT("Span broadcasts"), spans_.Num(), 1);
+			if (spans_.Num() == 1)
+			{
+				TestEqual(TEXT("Span"), spans_[0], FString(TEXT("hello/server/-1 a0/viewer/0")));
+			}
+			TestEqual(TEXT("Batch broadcasts"), receiver_->batches_.Num(), 1);
+			if (receiver_->batches_.Num() == 1)
+			{
+				TestEqual(TEXT("Batch"), DescribeBatch(receiver_->batches_[0]), FString(TEXT("hello/server/-1 a0/user/0")));
+			}
+		});
+
+		It("starts every frame with an empty batch", [this]()
+		{
+			component_->OnMessagesReceivedBatch.AddDynamic(receiver_, &UTwitchPlayTestReceiver::OnMessagesBatch);
+			MakePool(ETwitchOverloadPolicy::DropOldest, 100);
+			ReceiveChat(0, MakeContents(TEXT("a"), 3));
+			pool_->Dispatch();
+			ReceiveChat(0, MakeContents(TEXT("b"), 1));
+			pool_->Dispatch();
+			pool_->Dispatch();
+
+			TestEqual(TEXT("Spans"), FString::Join(spans_, TEXT(" | ")), FString(TEXT("a0/viewer/0 a1/viewer/0 a2/viewer/0 | b0/viewer/0")));
+			TestEqual(TEXT("Batch broadcasts, none for the empty frame"), receiver_->batches_.Num(), 2);
+			if (receiver_->batches_.Num() == 2)
+			{
+				TestEqual(TEXT("Second batch"), DescribeBatch(receiver_->batches_[1]), FString(TEXT("b0/user/0")));
+			}
+		});
+
+		It("fires the span without a Blueprint listener", [this]()
+		{
+			MakePool(ETwitchOverloadPolicy::DropOldest, 100);
+			ReceiveChat(0, MakeContents(TEXT("a"), 2));
+			pool_->Dispatch();
+			ReceiveChat(0, MakeContents(TEXT("b"), 1));
+			pool_->Dispatch();
+
+			TestEqual(TEXT("Spans"), FString::Join(spans_, TEXT(" | ")), FString(TEXT("a0/viewer/0 a1/viewer/0 | b0/viewer/0")));
+			TestEqual(TEXT("No batch"), receiver_->batches_.Num(), 0);
+		});
+	});
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS
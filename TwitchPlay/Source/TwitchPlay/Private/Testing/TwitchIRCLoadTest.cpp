@@ -0,0 +1,293 @@
+// Copyright (C) Simone Di Gravio <email: altairjp@gmail.com> - All Rights Reserved
+
+#include "Testing/TwitchIRCLoadTest.h"
+
+#if TWITCHPLAY_WITH_LOAD_TESTING
+
+#include "Net/TwitchIRCLine.h"
+#include "TwitchPlay.h"
+#include "Containers/Ticker.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+
+bool FTwitchIRCLoadTest::b_is_recording_ = false;
+
+namespace
+{
+	// Time left for the last lines to go through the pipeline before the report
+	const double ReportDelaySeconds = 2.0;
+
+	TUniquePtr<FTwitchIRCMockServer> GMockServer;
+
+	// Latency of every delivery, in cycles, per stage
+	TArray<uint64> GLatencySamples[static_cast<int32>(ETwitchIRCLoadStage::Num)];
+
+	double GLoadStartTime = 0.0;
+
+	double GLoadEndTime = -1.0;
+
+	FDelegateHandle GTickerHandle;
+
+	// Logs the report once the load is over
+	bool TickLoadTest(float _delta_time)
+	{
+		// The server thread starts the load a little after StartLoad, so the end is only taken once it stopped running
+		if (GMockServer.IsValid() && GMockServer->IsLoadRunning())
+		{
+			GLoadEndTime = -1.0;
+			return true;
+		}
+
+		const double now = FPlatformTime::Seconds();
+		if (GLoadEndTime < 0.0)
+		{
+			GLoadEndTime = now;
+		}
+		if (now - GLoadEndTime < ReportDelaySeconds)
+		{
+			return true;
+		}
+
+		FTwitchIRCLoadTest::LogReport();
+		FTwitchIRCLoadTest::StopRecording();
+		GTickerHandle.Reset();
+		return false;
+	}
+
+	FString JoinArgs(const TArray<FString>& _args)
+	{
+		return FString::Join(_args, TEXT(" "));
+	}
+
+	void StartMockServerCommand(const TArray<FString>& _args)
+	{
+		const FString args = JoinArgs(_args);
+
+		FTwitchIRCMockServer::FSettings settings;
+		FParse::Value(*args, TEXT("Port="), settings.port_);
+		FParse::Value(*args, TEXT("PingInterval="), settings.ping_interval_seconds_);
+		settings.b_reject_credentials_ = args.Contains(TEXT("RejectCredentials"));
+
+		FString error;
+		if (FTwitchIRCLoadTest::StartMockServer(settings, error))
+		{
+			UE_LOG(LogTwitchPlay, Display, TEXT("Mock server listening on 127.0.0.1:%d"), settings.port_);
+		}
+		else
+		{
+			UE_LOG(LogTwitchPlay, Error, TEXT("Mock server: %s"), *error);
+		}
+	}
+
+	void StartLoadCommand(const TArray<FString>& _args)
+	{
+		const FString args = JoinArgs(_args);
+
+		FTwitchIRCMockServer::FLoadSettings load_settings;
+		FParse::Value(*args, TEXT("Rate="), load_settings.lines_per_second_);
+		FParse::Value(*args, TEXT("Seconds="), load_settings.duration_seconds_);
+		FParse::Value(*args, TEXT("Channel="), load_settings.channel_);
+		FParse::Value(*args, TEXT("Users="), load_settings.num_users_);
+		FParse::Value(*args, TEXT("CommandRatio="), load_settings.command_ratio_);
+
+		FString commands = TEXT("up,down,left,right,a,b");
+		FParse::Value(*args, TEXT("Commands="), commands);
+		commands.ParseIntoArray(load_settings.commands_, TEXT(","));
+
+		FString replay_file;
+		if (FParse::Value(*args, TEXT("Replay="), replay_file))
+		{
+			if (FPaths::IsRelative(replay_file))
+			{
+				replay_file = FPaths::Combine(FPaths::ProjectDir(), replay_file);
+			}
+			if (!FFileHelper::LoadFileToStringArray(load_settings.replay_lines_, *replay_file))
+			{
+				UE_LOG(LogTwitchPlay, Error, TEXT("Load test: could not read %s"), *replay_file);
+				return;
+			}
+		}
+
+		FString error;
+		if (FTwitchIRCLoadTest::StartLoad(load_settings, error))
+		{
+			UE_LOG(LogTwitchPlay, Display, TEXT("Load test: %.0f lines/s for %.1f s on #%s"), load_settings.lines_per_second_, load_settings.duration_seconds_, *load_settings.channel_);
+		}
+		else
+		{
+			UE_LOG(LogTwitchPlay, Error, TEXT("Load test: %s"), *error);
+		}
+	}
+
+	FAutoConsoleCommand GStartMockServerCommand(
+		TEXT("TwitchPlay.MockServer.Start"),
+		TEXT("Starts the local mock Twitch chat server. Args: [Port=16667] [PingInterval=60] [RejectCredentials]"),
+		FConsoleCommandWithArgsDelegate::CreateStatic(&StartMockServerCommand));
+
+	FAutoConsoleCommand GStopMockServerCommand(
+		TEXT("TwitchPlay.MockServer.Stop"),
+		TEXT("Stops the local mock Twitch chat server."),
+		FConsoleCommandDelegate::CreateStatic(&FTwitchIRCLoadTest::StopMockServer));
+
+	FAutoConsoleCommand GReconnectMockServerCommand(
+		TEXT("TwitchPlay.MockServer.Reconnect"),
+		TEXT("Asks every client of the mock server to reconnect."),
+		FConsoleCommandDelegate::CreateLambda([]()
+		{
+			if (GMockServer.IsValid())
+			{
+				GMockServer->RequestReconnect();
+			}
+		}));
+
+	FAutoConsoleCommand GDropMockServerCommand(
+		TEXT("TwitchPlay.MockServer.Drop"),
+		TEXT("Drops every client of the mock server without warning."),
+		FConsoleCommandDelegate::CreateLambda([]()
+		{
+			if (GMockServer.IsValid())
+			{
+				GMockServer->DropClients();
+			}
+		}));
+
+	FAutoConsoleCommand GStartLoadCommand(
+		TEXT("TwitchPlay.LoadTest.Start"),
+		TEXT("Generates chat on the mock server and reports the latency. Args: [Rate=1000] [Seconds=10] [Channel=twitchplay] [Users=1000] [CommandRatio=0.5] [Commands=up,down] [Replay=File.txt]"),
+		FConsoleCommandWithArgsDelegate::CreateStatic(&StartLoadCommand));
+
+	FAutoConsoleCommand GStopLoadCommand(
+		TEXT("TwitchPlay.LoadTest.Stop"),
+		TEXT("Stops generating chat on the mock server."),
+		FConsoleCommandDelegate::CreateLambda([]()
+		{
+			if (GMockServer.IsValid())
+			{
+				GMockServer->StopLoad();
+			}
+		}));
+
+	FAutoConsoleCommand GReportLoadCommand(
+		TEXT("TwitchPlay.LoadTest.Report"),
+		TEXT("Logs the latency of the current (or last) load test."),
+		FConsoleCommandDelegate::CreateStatic(&FTwitchIRCLoadTest::LogReport));
+}
+
+void FTwitchIRCLoadTest::Shutdown()
+{
+	if (GTickerHandle.IsValid())
+	{
+		FTicker::GetCoreTicker().RemoveTicker(GTickerHandle);
+		GTickerHandle.Reset();
+	}
+	StopMockServer();
+	b_is_recording_ = false;
+}
+
+bool FTwitchIRCLoadTest::StartMockServer(const FTwitchIRCMockServer::FSettings& _settings, FString& _out_error)
+{
+	StopMockServer();
+
+	GMockServer = MakeUnique<FTwitchIRCMockServer>(_settings);
+	if (!GMockServer->Start(_out_error))
+	{
+		GMockServer.Reset();
+		return false;
+	}
+	return true;
+}
+
+void FTwitchIRCLoadTest::StopMockServer()
+{
+	if (GMockServer.IsValid())
+	{
+		GMockServer->Shutdown();
+		GMockServer.Reset();
+	}
+}
+
+FTwitchIRCMockServer* FTwitchIRCLoadTest::GetMockServer()
+{
+	return GMockServer.Get();
+}
+
+bool FTwitchIRCLoadTest::StartLoad(const FTwitchIRCMockServer::FLoadSettings& _load_settings, FString& _out_error)
+{
+	if (!GMockServer.IsValid() && !StartMockServer(FTwitchIRCMockServer::FSettings(), _out_error))
+	{
+		return false;
+	}
+
+	// Samples are reserved up front, so recording doesn't allocate in the middle of the measure
+	const int32 expected_samples = static_cast<int32>(_load_settings.lines_per_second_ * _load_settings.duration_seconds_) + 1;
+	for (TArray<uint64>& samples : GLatencySamples)
+	{
+		samples.Reset(expected_samples);
+	}
+
+	GMockServer->StartLoad(_load_settings);
+	GLoadStartTime = FPlatformTime::Seconds();
+	GLoadEndTime = -1.0;
+	b_is_recording_ = true;
+
+	if (!GTickerHandle.IsValid())
+	{
+		GTickerHandle = FTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateStatic(&TickLoadTest), 0.25f);
+	}
+	return true;
+}
+
+void FTwitchIRCLoadTest::RecordDelivery(const FTwitchIRCTags& _tags, ETwitchIRCLoadStage _stage)
+{
+	int64 sent_cycles;
+	if (_tags.GetInt64("twitchplay-sent", sent_cycles))
+	{
+		GLatencySamples[static_cast<int32>(_stage)].Add(FPlatformTime::Cycles64() - static_cast<uint64>(sent_cycles));
+	}
+}
+
+FTwitchIRCLoadTest::FLatencyReport FTwitchIRCLoadTest::ComputeReport(ETwitchIRCLoadStage _stage)
+{
+	FLatencyReport report;
+
+	TArray<uint64> samples = GLatencySamples[static_cast<int32>(_stage)];
+	report.num_samples_ = samples.Num();
+	if (samples.Num() == 0)
+	{
+		return report;
+	}
+	samples.Sort();
+
+	auto percentile_ms = [&samples](double _percentile)
+	{
+		const int32 index = FMath::Min(samples.Num() - 1, static_cast<int32>(_percentile * samples.Num()));
+		return FPlatformTime::ToMilliseconds64(samples[index]);
+	};
+	report.p50_ms_ = percentile_ms(0.5);
+	report.p90_ms_ = percentile_ms(0.9);
+	report.p99_ms_ = percentile_ms(0.99);
+	report.p999_ms_ = percentile_ms(0.999);
+	report.max_ms_ = FPlatformTime::ToMilliseconds64(samples.Last());
+	return report;
+}
+
+void FTwitchIRCLoadTest::LogReport()
+{
+	const int32 sent_lines = GMockServer.IsValid() ? GMockServer->GetSentLines() : 0;
+	const double duration = (GLoadEndTime < 0.0 ? FPlatformTime::Seconds() : GLoadEndTime) - GLoadStartTime;
+	UE_LOG(LogTwitchPlay, Display, TEXT("Load test: %d lines sent in %.2f s (%.0f lines/s)"), sent_lines, duration, duration > 0.0 ? sent_lines / duration : 0.0);
+
+	const TCHAR* const stage_names[] = { TEXT("OnMessageReceived"), TEXT("Command") };
+	for (int32 cycle_stage = 0; cycle_stage < static_cast<int32>(ETwitchIRCLoadStage::Num); ++cycle_stage)
+	{
+		const FLatencyReport report = ComputeReport(static_cast<ETwitchIRCLoadStage>(cycle_stage));
+		if (report.num_samples_ > 0)
+		{
+			UE_LOG(LogTwitchPlay, Display, TEXT("  %s: %d deliveries, latency p50 %.3f ms, p90 %.3f ms, p99 %.3f ms, p99.9 %.3f ms, max %.3f ms"),
+				stage_names[cycle_stage], report.num_samples_, report.p50_ms_, report.p90_ms_, report.p99_ms_, report.p999_ms_, report.max_ms_);
+		}
+	}
+}
+
+#endif // TWITCHPLAY_WITH_LOAD_TESTING
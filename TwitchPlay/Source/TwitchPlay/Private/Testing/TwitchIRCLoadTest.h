@@ -0,0 +1,93 @@
+// Copyright (C) Simone Di Gravio <email: altairjp@gmail.com> - All Rights Reserved
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Testing/TwitchIRCMockServer.h"
+
+#if TWITCHPLAY_WITH_LOAD_TESTING
+
+struct FTwitchIRCTags;
+
+// Points of the pipeline where the latency of generated chat is measured
+enum class ETwitchIRCLoadStage : uint8
+{
+	// Right before OnMessageReceived is broadcast
+	MessageReceived,
+	// Right before a command delegate is fired (or the command is counted as a vote)
+	CommandReceived,
+
+	Num
+};
+
+/**
+ * End to end load tests against the local mock server.
+ * The mock server writes a timestamp in every generated line, the components record how long each line took
+ * to reach them, and the latency percentiles are logged once the load is over.
+ *
+ * Console commands (development builds only):
+ * - TwitchPlay.MockServer.Start [Port=16667] [PingInterval=60] [RejectCredentials]
+ * - TwitchPlay.MockServer.Stop / Reconnect / Drop
+ * - TwitchPlay.LoadTest.Start [Rate=1000] [Seconds=10] [Channel=twitchplay] [Users=1000] [CommandRatio=0.5] [Commands=up,down] [Replay=File.txt]
+ * - TwitchPlay.LoadTest.Stop / Report
+ *
+ * Point the components at the server (server_host_ "127.0.0.1", server_port_ 16667) and join the load channel.
+ * Game thread only.
+ */
+class FTwitchIRCLoadTest
+{
+public:
+
+	struct FLatencyReport
+	{
+		int32 num_samples_ = 0;
+
+		double p50_ms_ = 0.0;
+
+		double p90_ms_ = 0.0;
+
+		double p99_ms_ = 0.0;
+
+		double p999_ms_ = 0.0;
+
+		double max_ms_ = 0.0;
+	};
+
+	// Stops the server and the load. Called by the module
+	static void Shutdown();
+
+	static bool StartMockServer(const FTwitchIRCMockServer::FSettings& _settings, FString& _out_error);
+
+	static void StopMockServer();
+
+	// The running mock server, if any
+	static FTwitchIRCMockServer* GetMockServer();
+
+	// Starts generating chat on the mock server (started with default settings if needed) and starts recording
+	static bool StartLoad(const FTwitchIRCMockServer::FLoadSettings& _load_settings, FString& _out_error);
+
+	// Whether deliveries are being recorded. Checked before paying for RecordDelivery
+	static bool IsRecording() { return b_is_recording_; }
+
+	// Stops recording. The samples are kept for ComputeReport
+	static void StopRecording() { b_is_recording_ = false; }
+
+	/**
+	 * Records how long a generated message took to reach a stage. Messages not generated by the mock server are ignored.
+	 *
+	 * @param _tags - Tags of the message.
+	 * @param _stage - Stage reached.
+	 */
+	static void RecordDelivery(const FTwitchIRCTags& _tags, ETwitchIRCLoadStage _stage);
+
+	static FLatencyReport ComputeReport(ETwitchIRCLoadStage _stage);
+
+	// Logs the rate and the latency percentiles of the current (or last) load
+	static void LogReport();
+
+private:
+
+	static bool b_is_recording_;
+};
+
+#endif // TWITCHPLAY_WITH_LOAD_TESTING
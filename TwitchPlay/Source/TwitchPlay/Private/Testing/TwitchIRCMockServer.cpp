@@ -0,0 +1,489 @@
+// Copyright (C) Simone Di Gravio <email: altairjp@gmail.com> - All Rights Reserved
+
+#include "Testing/TwitchIRCMockServer.h"
+
+#if TWITCHPLAY_WITH_LOAD_TESTING
+
+#include "Net/TwitchIRCLine.h"
+#include "HAL/RunnableThread.h"
+#include "HAL/PlatformProcess.h"
+#include "Sockets.h"
+#include "SocketSubsystem.h"
+#include "IPAddress.h"
+
+namespace
+{
+	// The server loop never blocks: it sleeps this long between iterations
+	const float LoopSleepSeconds = 0.0005f;
+
+	// Words of the synthetic chat
+	const TCHAR* const ChatWords[] =
+	{
+		TEXT("hello"), TEXT("LUL"), TEXT("Kappa"), TEXT("PogChamp"), TEXT("gg"), TEXT("what"), TEXT("is"), TEXT("this"),
+		TEXT("game"), TEXT("nice"), TEXT("play"), TEXT("go"), TEXT("left"), TEXT("right"), TEXT("no"), TEXT("way"),
+		TEXT("chat"), TEXT("streamer"), TEXT("wow"), TEXT("first"), TEXT("time"), TEXT("here"), TEXT("love"), TEXT("it")
+	};
+}
+
+FTwitchIRCMockServer::FTwitchIRCMockServer(const FSettings& _settings)
+	: settings_(_settings)
+	, random_(1337)
+{
+}
+
+FTwitchIRCMockServer::~FTwitchIRCMockServer()
+{
+	Shutdown();
+}
+
+bool FTwitchIRCMockServer::Start(FString& _out_error)
+{
+	if (thread_ != nullptr)
+	{
+		return true;
+	}
+
+	ISocketSubsystem* sss = ISocketSubsystem::Get(PLATFORM_SOCKETSUBSYSTEM);
+	TSharedRef<FInternetAddr> listen_addr = sss->CreateInternetAddr();
+	bool b_is_valid_ip = false;
+	listen_addr->SetIp(TEXT("127.0.0.1"), b_is_valid_ip);
+	listen_addr->SetPort(settings_.port_);
+
+	listen_socket_ = sss->CreateSocket(NAME_Stream, TEXT("TwitchPlay Mock Server"), false);
+	if (listen_socket_ == nullptr)
+	{
+		_out_error = "Could not create socket!";
+		return false;
+	}
+
+	listen_socket_->SetReuseAddr(true);
+	listen_socket_->SetNonBlocking(true);
+	if (!listen_socket_->Bind(*listen_addr) || !listen_socket_->Listen(16))
+	{
+		sss->DestroySocket(listen_socket_);
+		listen_socket_ = nullptr;
+
+		_out_error = FString::Printf(TEXT("Could not listen on port %d!"), settings_.port_);
+		return false;
+	}
+
+	thread_ = FRunnableThread::Create(this, TEXT("TwitchIRCMockServer"), 0, TPri_Normal);
+	if (thread_ == nullptr)
+	{
+		sss->DestroySocket(listen_socket_);
+		listen_socket_ = nullptr;
+
+		_out_error = "Could not create the server thread!";
+		return false;
+	}
+	return true;
+}
+
+void FTwitchIRCMockServer::Shutdown()
+{
+	if (thread_ != nullptr)
+	{
+		// Kill(true) calls Stop() and then waits for Run() to return
+		thread_->Kill(true);
+		delete thread_;
+		thread_ = nullptr;
+	}
+
+	for (TUniquePtr<FClient>& client : clients_)
+	{
+		CloseClient(*client);
+	}
+	clients_.Reset();
+
+	if (listen_socket_ != nullptr)
+	{
+		listen_socket_->Close();
+		ISocketSubsystem::Get(PLATFORM_SOCKETSUBSYSTEM)->DestroySocket(listen_socket_);
+		listen_socket_ = nullptr;
+	}
+}
+
+void FTwitchIRCMockServer::RequestReconnect()
+{
+	commands_.Enqueue(ECommand::Reconnect);
+}
+
+void FTwitchIRCMockServer::DropClients()
+{
+	commands_.Enqueue(ECommand::Drop);
+}
+
+void FTwitchIRCMockServer::StartLoad(const FLoadSettings& _load_settings)
+{
+	pending_loads_.Enqueue(_load_settings);
+}
+
+void FTwitchIRCMockServer::StopLoad()
+{
+	commands_.Enqueue(ECommand::StopLoad);
+}
+
+uint32 FTwitchIRCMockServer::Run()
+{
+	while (!b_stop_requested_)
+	{
+		ProcessCommands();
+		AcceptClients();
+
+		const double now = FPlatformTime::Seconds();
+		if (b_load_running_)
+		{
+			GenerateLoad(now);
+		}
+
+		for (int32 cycle_client = clients_.Num() - 1; cycle_client >= 0; --cycle_client)
+		{
+			FClient& client = *clients_[cycle_client];
+
+			// Twitch checks every client with a PING from time to time
+			if (settings_.ping_interval_seconds_ > 0.0f && client.b_registered_ && now >= client.next_ping_time_)
+			{
+				SendLine(client, TEXT("PING :tmi.twitch.tv"));
+				client.next_ping_time_ = now + settings_.ping_interval_seconds_;
+			}
+
+			if (!ReceiveFromClient(client) || !FlushClient(client))
+			{
+				CloseClient(client);
+				clients_.RemoveAt(cycle_client);
+			}
+		}
+
+		FPlatformProcess::Sleep(LoopSleepSeconds);
+	}
+	return 0;
+}
+
+void FTwitchIRCMockServer::Stop()
+{
+	b_stop_requested_ = true;
+}
+
+void FTwitchIRCMockServer::AcceptClients()
+{
+	bool b_has_pending_connection = false;
+	while (listen_socket_->HasPendingConnection(b_has_pending_connection) && b_has_pending_connection)
+	{
+		FSocket* client_socket = listen_socket_->Accept(TEXT("TwitchPlay Mock Client"));
+		if (client_socket == nullptr)
+		{
+			break;
+		}
+		client_socket->SetNonBlocking(true);
+
+		TUniquePtr<FClient> client = MakeUnique<FClient>();
+		client->socket_ = client_socket;
+		clients_.Add(MoveTemp(client));
+		num_clients_.Increment();
+	}
+}
+
+bool FTwitchIRCMockServer::ReceiveFromClient(FClient& _client)
+{
+	FTwitchIRCLine line;
+	while (true)
+	{
+		uint8* receive_region;
+		int32 receive_region_size;
+		_client.framer_.GetWritableRegion(receive_region, receive_region_size);
+
+		// A non blocking stream socket returns true with 0 bytes when there is nothing to read, false once closed
+		int32 data_read = 0;
+		if (!_client.socket_->Recv(receive_region, receive_region_size, data_read))
+		{
+			return false;
+		}
+		if (data_read <= 0)
+		{
+			return true;
+		}
+		_client.framer_.CommitWrite(data_read);
+
+		const ANSICHAR* line_data;
+		int32 line_length;
+		while (_client.framer_.PopLine(line_data, line_length))
+		{
+			if (line.Parse(line_data, line_length))
+			{
+				HandleLine(_client, line);
+			}
+		}
+	}
+}
+
+void FTwitchIRCMockServer::HandleLine(FClient& _client, const FTwitchIRCLine& _line)
+{
+	if (_line.command_.Equals("CAP"))
+	{
+		SendLine(_client, TEXT(":tmi.twitch.tv CAP * ACK :") + _line.trailing_.ToString());
+	}
+	else if (_line.command_.Equals("PASS"))
+	{
+		// Any token is accepted, unless every login is rejected
+	}
+	else if (_line.command_.Equals("NICK"))
+	{
+		if (settings_.b_reject_credentials_)
+		{
+			SendLine(_client, TEXT(":tmi.twitch.tv NOTICE * :Login authentication failed"));
+			_client.b_closing_ = true;
+			return;
+		}
+
+		_client.nick_ = _line.GetParam(0).ToString().ToLower();
+		_client.b_registered_ = true;
+		_client.next_ping_time_ = FPlatformTime::Seconds() + settings_.ping_interval_seconds_;
+
+		const FString& nick = _client.nick_;
+		SendLine(_client, FString::Printf(TEXT(":tmi.twitch.tv 001 %s :Welcome, GLHF!"), *nick));
+		SendLine(_client, FString::Printf(TEXT(":tmi.twitch.tv 002 %s :Your host is tmi.twitch.tv"), *nick));
+		SendLine(_client, FString::Printf(TEXT(":tmi.twitch.tv 003 %s :This server is rather new"), *nick));
+		SendLine(_client, FString::Printf(TEXT(":tmi.twitch.tv 004 %s :-"), *nick));
+		SendLine(_client, FString::Printf(TEXT(":tmi.twitch.tv 375 %s :-"), *nick));
+		SendLine(_client, FString::Printf(TEXT(":tmi.twitch.tv 372 %s :You are in a great big local test server."), *nick));
+		SendLine(_client, FString::Printf(TEXT(":tmi.twitch.tv 376 %s :>"), *nick));
+	}
+	else if (_line.command_.Equals("PING"))
+	{
+		SendLine(_client, TEXT(":tmi.twitch.tv PONG tmi.twitch.tv :") + _line.trailing_.ToString());
+	}
+	else if (!_client.b_registered_)
+	{
+		// Nothing else is accepted before logging in
+	}
+	else if (_line.command_.Equals("JOIN") || _line.command_.Equals("PART"))
+	{
+		const bool b_join = _line.command_.Equals("JOIN");
+		const FString& nick = _client.nick_;
+
+		TArray<FString> channels;
+		_line.GetParam(0).ToString().ToLower().ParseIntoArray(channels, TEXT(","));
+		for (const FString& channel : channels)
+		{
+			if (b_join)
+			{
+				_client.channels_.AddUnique(channel);
+				num_joins_.Increment();
+				SendLine(_client, FString::Printf(TEXT(":%s!%s@%s.tmi.twitch.tv JOIN %s"), *nick, *nick, *nick, *channel));
+				SendLine(_client, FString::Printf(TEXT(":%s.tmi.twitch.tv 353 %s = %s :%s"), *nick, *nick, *channel, *nick));
+				SendLine(_client, FString::Printf(TEXT(":%s.tmi.twitch.tv 366 %s %s :End of /NAMES list"), *nick, *nick, *channel));
+			}
+			else if (_client.channels_.Remove(channel) > 0)
+			{
+				SendLine(_client, FString::Printf(TEXT(":%s!%s@%s.tmi.twitch.tv PART %s"), *nick, *nick, *nick, *channel));
+			}
+		}
+	}
+	else if (_line.command_.Equals("PRIVMSG"))
+	{
+		// Chat is relayed to the other clients in the channel, like Twitch does
+		const FString channel = _line.GetParam(0).ToString().ToLower();
+		const FString relayed_line = FString::Printf(TEXT(":%s!%s@%s.tmi.twitch.tv PRIVMSG %s :%s"),
+			*_client.nick_, *_client.nick_, *_client.nick_, *channel, *_line.trailing_.ToString());
+		for (TUniquePtr<FClient>& other_client : clients_)
+		{
+			if (other_client.Get() != &_client && other_client->channels_.Contains(channel))
+			{
+				SendLine(*other_client, relayed_line);
+			}
+		}
+	}
+}
+
+bool FTwitchIRCMockServer::FlushClient(FClient& _client)
+{
+	while (_client.out_offset_ < _client.out_buffer_.Num())
+	{
+		int32 sent = 0;
+		if (!_client.socket_->Send(_client.out_buffer_.GetData() + _client.out_offset_, _client.out_buffer_.Num() - _client.out_offset_, sent))
+		{
+			if (ISocketSubsystem::Get(PLATFORM_SOCKETSUBSYSTEM)->GetLastErrorCode() != SE_EWOULDBLOCK)
+			{
+				return false;
+			}
+			break;
+		}
+		if (sent <= 0)
+		{
+			break;
+		}
+		_client.out_offset_ += sent;
+	}
+
+	if (_client.out_offset_ >= _client.out_buffer_.Num())
+	{
+		_client.out_buffer_.Reset();
+		_client.out_offset_ = 0;
+		return !_client.b_closing_;
+	}
+
+	// Keep the buffer from growing with bytes already sent
+	if (_client.out_offset_ > _client.out_buffer_.Num() / 2)
+	{
+		_client.out_buffer_.RemoveAt(0, _client.out_offset_, false);
+		_client.out_offset_ = 0;
+	}
+	return _client.out_buffer_.Num() - _client.out_offset_ <= settings_.max_client_buffer_bytes_;
+}
+
+void FTwitchIRCMockServer::ProcessCommands()
+{
+	ECommand command;
+	while (commands_.Dequeue(command))
+	{
+		switch (command)
+		{
+		case ECommand::Reconnect:
+			for (TUniquePtr<FClient>& client : clients_)
+			{
+				SendLine(*client, TEXT(":tmi.twitch.tv RECONNECT"));
+				client->b_closing_ = true;
+			}
+			break;
+
+		case ECommand::Drop:
+			for (TUniquePtr<FClient>& client : clients_)
+			{
+				CloseClient(*client);
+			}
+			clients_.Reset();
+			break;
+
+		case ECommand::StopLoad:
+			b_load_running_ = false;
+			break;
+		}
+	}
+
+	FLoadSettings load_settings;
+	while (pending_loads_.Dequeue(load_settings))
+	{
+		load_ = MoveTemp(load_settings);
+		load_channel_ = TEXT("#") + load_.channel_.ToLower();
+
+		load_users_.Reset(load_.num_users_);
+		for (int32 cycle_user = 0; cycle_user < FMath::Max(load_.num_users_, 1); ++cycle_user)
+		{
+			load_users_.Add(FString::Printf(TEXT("chatter%d"), cycle_user));
+		}
+
+		// Replayed lines are split once, before the load starts
+		replay_messages_.Reset(load_.replay_lines_.Num());
+		FTwitchIRCLine line;
+		for (const FString& replay_line : load_.replay_lines_)
+		{
+			if (replay_line.StartsWith(TEXT("@")) || replay_line.StartsWith(TEXT(":")))
+			{
+				const FTCHARToUTF8 utf8_line(*replay_line);
+				if (line.Parse(utf8_line.Get(), utf8_line.Length()) && line.IsUserMessage() && line.b_has_trailing_)
+				{
+					replay_messages_.Emplace(line.nick_.ToString(), line.trailing_.ToString());
+				}
+			}
+			else
+			{
+				FString username;
+				FString message;
+				if (replay_line.Split(TEXT(": "), &username, &message) && !username.Contains(TEXT(" ")))
+				{
+					replay_messages_.Emplace(username.ToLower(), message);
+				}
+				else if (!replay_line.IsEmpty())
+				{
+					replay_messages_.Emplace(load_users_[random_.RandHelper(load_users_.Num())], replay_line);
+				}
+			}
+		}
+
+		next_replay_line_ = 0;
+		sent_lines_.Reset();
+		load_start_time_ = FPlatformTime::Seconds();
+		b_load_running_ = true;
+	}
+}
+
+void FTwitchIRCMockServer::GenerateLoad(double _now)
+{
+	const double elapsed = _now - load_start_time_;
+	if (elapsed >= load_.duration_seconds_)
+	{
+		b_load_running_ = false;
+		return;
+	}
+
+	// Lines are paced against the start of the load, so a late iteration catches up instead of lowering the rate
+	const int32 target_lines = static_cast<int32>(elapsed * load_.lines_per_second_);
+	while (sent_lines_.GetValue() < target_lines)
+	{
+		if (replay_messages_.Num() > 0)
+		{
+			const TPair<FString, FString>& replay_message = replay_messages_[next_replay_line_];
+			next_replay_line_ = (next_replay_line_ + 1) % replay_messages_.Num();
+			SendChatLine(replay_message.Key, replay_message.Value);
+		}
+		else
+		{
+			const FString& username = load_users_[random_.RandHelper(load_users_.Num())];
+			if (load_.commands_.Num() > 0 && random_.FRand() < load_.command_ratio_)
+			{
+				SendChatLine(username, TEXT("!") + load_.commands_[random_.RandHelper(load_.commands_.Num())] + TEXT("!"));
+			}
+			else
+			{
+				FString message = ChatWords[random_.RandHelper(ARRAY_COUNT(ChatWords))];
+				const int32 num_words = random_.RandRange(2, 8);
+				for (int32 cycle_word = 1; cycle_word < num_words; ++cycle_word)
+				{
+					message += TEXT(" ");
+					message += ChatWords[random_.RandHelper(ARRAY_COUNT(ChatWords))];
+				}
+				SendChatLine(username, message);
+			}
+		}
+		sent_lines_.Increment();
+	}
+}
+
+void FTwitchIRCMockServer::SendChatLine(const FString& _username, const FString& _message)
+{
+	// The clients are flushed right after the lines of this iteration are generated, so this is the socket write time
+	const uint64 sent_cycles = FPlatformTime::Cycles64();
+	const FString line = FString::Printf(TEXT("@twitchplay-sent=%llu;user-id=%u :%s!%s@%s.tmi.twitch.tv PRIVMSG %s :%s\r\n"),
+		sent_cycles, GetTypeHash(_username), *_username, *_username, *_username, *load_channel_, *_message);
+
+	// Converted once, whatever the amount of clients
+	const FTCHARToUTF8 utf8_line(*line);
+	for (TUniquePtr<FClient>& client : clients_)
+	{
+		if (client->channels_.Contains(load_channel_))
+		{
+			client->out_buffer_.Append(reinterpret_cast<const uint8*>(utf8_line.Get()), utf8_line.Length());
+		}
+	}
+}
+
+void FTwitchIRCMockServer::SendLine(FClient& _client, const FString& _line)
+{
+	const FTCHARToUTF8 utf8_line(*_line);
+	_client.out_buffer_.Append(reinterpret_cast<const uint8*>(utf8_line.Get()), utf8_line.Length());
+	_client.out_buffer_.Add('\r');
+	_client.out_buffer_.Add('\n');
+}
+
+void FTwitchIRCMockServer::CloseClient(FClient& _client)
+{
+	if (_client.socket_ != nullptr)
+	{
+		_client.socket_->Close();
+		ISocketSubsystem::Get(PLATFORM_SOCKETSUBSYSTEM)->DestroySocket(_client.socket_);
+		_client.socket_ = nullptr;
+		num_clients_.Decrement();
+	}
+}
+
+#endif // TWITCHPLAY_WITH_LOAD_TESTING
@@ -0,0 +1,212 @@
+// Copyright (C) Simone Di Gravio <email: altairjp@gmail.com> - All Rights Reserved
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/Runnable.h"
+#include "HAL/ThreadSafeBool.h"
+#include "HAL/ThreadSafeCounter.h"
+#include "Containers/Queue.h"
+#include "Math/RandomStream.h"
+#include "Templates/UniquePtr.h"
+#include "Net/TwitchIRCLineFramer.h"
+
+// Mock server and load tests are development tools, compiled out of shipping builds
+#define TWITCHPLAY_WITH_LOAD_TESTING !UE_BUILD_SHIPPING
+
+#if TWITCHPLAY_WITH_LOAD_TESTING
+
+class FSocket;
+class FRunnableThread;
+struct FTwitchIRCLine;
+
+/**
+ * Local stand-in for the Twitch chat server, for testing and load testing without Twitch.
+ * Speaks enough of the TMI protocol for the plugin: CAP, PASS, NICK, JOIN, PART, PING/PONG and PRIVMSG,
+ * and can ask its clients to RECONNECT or drop them to exercise the reconnection.
+ *
+ * It can also generate chat at a fixed rate, synthetic or replayed from a file. Every generated line carries
+ * a "twitchplay-sent" tag with the time (FPlatformTime::Cycles64) it was written to the sockets,
+ * so the receiving end can measure the end to end latency (see FTwitchIRCLoadTest).
+ *
+ * Everything runs on the server thread. The public methods can be called from any thread.
+ */
+class FTwitchIRCMockServer : public FRunnable
+{
+public:
+
+	struct FSettings
+	{
+		int32 port_ = 16667;
+
+		// Answers every login with "Login authentication failed"
+		bool b_reject_credentials_ = false;
+
+		// Seconds between the PINGs sent to each client. 0 to never send any
+		float ping_interval_seconds_ = 60.0f;
+
+		// Clients not reading their data are dropped past this many buffered bytes, like a slow consumer on Twitch
+		int32 max_client_buffer_bytes_ = 64 * 1024 * 1024;
+	};
+
+	struct FLoadSettings
+	{
+		// Channel the chat is sent to, without '#'
+		FString channel_ = TEXT("twitchplay");
+
+		float lines_per_second_ = 1000.0f;
+
+		float duration_seconds_ = 10.0f;
+
+		// Amount of different synthetic chatters
+		int32 num_users_ = 1000;
+
+		// Synthetic messages are commands ("!command!") with this probability, chat text otherwise
+		float command_ratio_ = 0.5f;
+
+		// Commands of the synthetic messages, without delimiters
+		TArray<FString> commands_;
+
+		// Chat to replay instead of synthetic messages, in a loop. Raw IRC lines or "username: message" lines
+		TArray<FString> replay_lines_;
+	};
+
+	explicit FTwitchIRCMockServer(const FSettings& _settings);
+
+	// Stops the server if it is still running
+	virtual ~FTwitchIRCMockServer();
+
+	/**
+	 * Starts listening on 127.0.0.1 and starts the server thread.
+	 *
+	 * @param _out_error - Why the server could not start.
+	 *
+	 * @return Whether the server is running.
+	 */
+	bool Start(FString& _out_error);
+
+	// Disconnects every client and stops the thread. Safe to call multiple times
+	void Shutdown();
+
+	// Sends RECONNECT to every client, then disconnects them
+	void RequestReconnect();
+
+	// Disconnects every client without warning
+	void DropClients();
+
+	// Starts generating chat. Replaces any load already running
+	void StartLoad(const FLoadSettings& _load_settings);
+
+	void StopLoad();
+
+	// Whether chat is being generated
+	bool IsLoadRunning() const { return b_load_running_; }
+
+	// Lines generated by the current (or last) load
+	int32 GetSentLines() const { return sent_lines_.GetValue(); }
+
+	int32 GetNumClients() const { return num_clients_.GetValue(); }
+
+	// Channels joined by the clients since the server started, joins after a reconnection included
+	int32 GetNumJoins() const { return num_joins_.GetValue(); }
+
+	// FRunnable interface
+	virtual uint32 Run() override;
+	virtual void Stop() override;
+
+private:
+
+	struct FClient
+	{
+		FSocket* socket_ = nullptr;
+
+		FTwitchIRCLineFramer framer_;
+
+		// Bytes waiting to be written. Bytes before out_offset_ were already written
+		TArray<uint8> out_buffer_;
+
+		int32 out_offset_ = 0;
+
+		FString nick_;
+
+		bool b_registered_ = false;
+
+		// Joined channels, with '#'
+		TArray<FString> channels_;
+
+		double next_ping_time_ = 0.0;
+
+		// Set to disconnect the client once its buffer is written
+		bool b_closing_ = false;
+	};
+
+	enum class ECommand : uint8
+	{
+		Reconnect,
+		Drop,
+		StopLoad
+	};
+
+	void AcceptClients();
+
+	// Returns false if the client disconnected
+	bool ReceiveFromClient(FClient& _client);
+
+	void HandleLine(FClient& _client, const FTwitchIRCLine& _line);
+
+	// Returns false if the client disconnected or fell too far behind
+	bool FlushClient(FClient& _client);
+
+	void ProcessCommands();
+
+	void GenerateLoad(double _now);
+
+	// Writes one chat line to every client in the load channel
+	void SendChatLine(const FString& _username, const FString& _message);
+
+	void SendLine(FClient& _client, const FString& _line);
+
+	void CloseClient(FClient& _client);
+
+	const FSettings settings_;
+
+	FSocket* listen_socket_ = nullptr;
+
+	FRunnableThread* thread_ = nullptr;
+
+	FThreadSafeBool b_stop_requested_;
+
+	// Server thread only
+	TArray<TUniquePtr<FClient>> clients_;
+
+	FThreadSafeCounter num_clients_;
+
+	FThreadSafeCounter num_joins_;
+
+	TQueue<ECommand, EQueueMode::Mpsc> commands_;
+
+	TQueue<FLoadSettings, EQueueMode::Mpsc> pending_loads_;
+
+	// Current load. Server thread only
+	FLoadSettings load_;
+
+	FThreadSafeBool b_load_running_;
+
+	double load_start_time_ = 0.0;
+
+	FThreadSafeCounter sent_lines_;
+
+	int32 next_replay_line_ = 0;
+
+	// "#channel" of the current load, and the synthetic chatters
+	FString load_channel_;
+
+	TArray<FString> load_users_;
+
+	// Username and message of each replayed line
+	TArray<TPair<FString, FString>> replay_messages_;
+
+	FRandomStream random_;
+};
+
+#endif // TWITCHPLAY_WITH_LOAD_TESTING
@@ -0,0 +1,437 @@
+// Copyright (C) Simone Di Gravio <email: altairjp@gmail.com> - All Rights Reserved
+
+#include "CoreMinimal.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+#include "Testing/TwitchPlayTestUtils.h"
+#include "Components/TwitchIRCComponent.h"
+#include "Net/TwitchIRCLine.h"
+#include "Net/TwitchIRCLineFramer.h"
+#include "Net/TwitchIRCUtf8.h"
+#include "Net/TwitchIRCMessageArena.h"
+
+BEGIN_DEFINE_SPEC(FTwitchIRCParserSpec, "TwitchPlay.Parser", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+	FTwitchIRCLine line_;
+
+	UTwitchIRCComponent* component_ = nullptr;
+
+	bool ParseLine(const ANSICHAR* _line)
+	{
+		return line_.Parse(_line, FCStringAnsi::Strlen(_line));
+	}
+
+	void AppendString(FTwitchIRCLineFramer& _framer, const ANSICHAR* _data)
+	{
+		_framer.Append(reinterpret_cast<const uint8*>(_data), FCStringAnsi::Strlen(_data));
+	}
+
+	// Appends a code point as UTF-8, and what it should decode to
+	static void AppendCodePoint(uint32 _code_point, TArray<ANSICHAR>& _out_bytes, TArray<TCHAR>& _out_chars)
+	{
+		if (_code_point < 0x80)
+		{
+			_out_bytes.Add(static_cast<ANSICHAR>(_code_point));
+		}
+		else if (_code_point < 0x800)
+		{
+			_out_bytes.Add(static_cast<ANSICHAR>(0xC0 | (_code_point >> 6)));
+			_out_bytes.Add(static_cast<ANSICHAR>(0x80 | (_code_point & 0x3F)));
+		}
+		else if (_code_point < 0x10000)
+		{
+			_out_bytes.Add(static_cast<ANSICHAR>(0xE0 | (_code_point >> 12)));
+			_out_bytes.Add(static_cast<ANSICHAR>(0x80 | ((_code_point >> 6) & 0x3F)));
+			_out_bytes.Add(static_cast<ANSICHAR>(0x80 | (_code_point & 0x3F)));
+		}
+		else
+		{
+			_out_bytes.Add(static_cast<ANSICHAR>(0xF0 | (_code_point >> 18)));
+			_out_bytes.Add(static_cast<ANSICHAR>(0x80 | ((_code_point >> 12) & 0x3F)));
+			_out_bytes.Add(static_cast<ANSICHAR>(0x80 | ((_code_point >> 6) & 0x3F)));
+			_out_bytes.Add(static_cast<ANSICHAR>(0x80 | (_code_point & 0x3F)));
+		}
+
+		if (sizeof(TCHAR) == 2 && _code_point >= 0x10000)
+		{
+			_out_chars.Add(static_cast<TCHAR>(0xD800 + ((_code_point - 0x10000) >> 10)));
+			_out_chars.Add(static_cast<TCHAR>(0xDC00 + ((_code_point - 0x10000) & 0x3FF)));
+		}
+		else
+		{
+			_out_chars.Add(static_cast<TCHAR>(_code_point));
+		}
+	}
+
+	static FString Decode(const ANSICHAR* _bytes)
+	{
+		FString string;
+		TwitchIRCUtf8::DecodeInto(_bytes, FCStringAnsi::Strlen(_bytes), string);
+		return string;
+	}
+
+	// Pops every complete line
+	TArray<FString> PopLines(FTwitchIRCLineFramer& _framer)
+	{
+		TArray<FString> lines;
+		const ANSICHAR* line;
+		int32 length;
+		while (_framer.PopLine(line, length))
+		{
+			lines.Add(FTwitchIRCStringView(line, length).ToString());
+		}
+		return lines;
+	}
+
+END_DEFINE_SPEC(FTwitchIRCParserSpec)
+
+void FTwitchIRCParserSpec::Define()
+{
+	Describe("FTwitchIRCLine", [this]()
+	{
+		It("splits a chat line into its parts", [this]()
+		{
+			TestTrue(TEXT("Parsed"), ParseLine(":viewer!viewer@viewer.tmi.twitch.tv PRIVMSG #twitchplay :hello world"));
+			TestEqual(TEXT("Prefix"), line_.prefix_.ToString(), FString(TEXT("viewer!viewer@viewer.tmi.twitch.tv")));
+			TestEqual(TEXT("Nick"), line_.nick_.ToString(), FString(TEXT("viewer")));
+			TestEqual(TEXT("Command"), line_.command_.ToString(), FString(TEXT("PRIVMSG")));
+			TestEqual(TEXT("Params"), line_.num_params_, 1);
+			TestEqual(TEXT("Channel"), line_.GetParam(0).ToString(), FString(TEXT("#twitchplay")));
+			TestTrue(TEXT("Has trailing"), line_.b_has_trailing_);
+			TestEqual(TEXT("Content"), line_.trailing_.ToString(), FString(TEXT("hello world")));
+			TestTrue(TEXT("User message"), line_.IsUserMessage());
+		});
+
+		It("keeps the colons of the content", [this]()
+		{
+			TestTrue(TEXT("Parsed"), ParseLine(":viewer!viewer@viewer PRIVMSG #twitchplay :a:b::c:"));
+			TestEqual(TEXT("Content"), line_.trailing_.ToString(), FString(TEXT("a:b::c:")));
+		});
+
+		It("tells an empty content from no content", [this]()
+		{
+			TestTrue(TEXT("Parsed"), ParseLine("PRIVMSG #twitchplay :"));
+			TestTrue(TEXT("Empty trailing"), line_.b_has_trailing_ && line_.trailing_.IsEmpty());
+
+			TestTrue(TEXT("Parsed"), ParseLine(":viewer!viewer@viewer JOIN #twitchplay"));
+			TestFalse(TEXT("No trailing"), line_.b_has_trailing_);
+		});
+
+		It("parses lines with a single token", [this]()
+		{
+			TestTrue(TEXT("PING parsed"), ParseLine("PING"));
+			TestEqual(TEXT("Command"), line_.command_.ToString(), FString(TEXT("PING")));
+			TestEqual(TEXT("Params"), line_.num_params_, 0);
+			TestFalse(TEXT("No trailing"), line_.b_has_trailing_);
+			TestFalse(TEXT("Not a user message"), line_.IsUserMessage());
+		});
+
+		It("rejects lines without a command", [this]()
+		{
+			TestFalse(TEXT("Empty"), ParseLine(""));
+			TestFalse(TEXT("Spaces"), ParseLine("   "));
+			TestFalse(TEXT("Lone colon"), ParseLine(":"));
+			TestFalse(TEXT("Prefix only"), ParseLine(":viewer!viewer@viewer"));
+			TestFalse(TEXT("Lone at"), ParseLine("@"));
+			TestFalse(TEXT("Tags only"), ParseLine("@a=b"));
+		});
+
+		It("does not take a user message from a prefix without nick", [this]()
+		{
+			TestTrue(TEXT("Parsed"), ParseLine(":tmi.twitch.tv PRIVMSG #twitchplay :hello"));
+			TestFalse(TEXT("Not a user message"), line_.IsUserMessage());
+		});
+
+		It("tolerates repeated spaces", [this]()
+		{
+			TestTrue(TEXT("Parsed"), ParseLine("   PRIVMSG    #twitchplay    :spaced  out"));
+			TestEqual(TEXT("Channel"), line_.GetParam(0).ToString(), FString(TEXT("#twitchplay")));
+			TestEqual(TEXT("Content"), line_.trailing_.ToString(), FString(TEXT("spaced  out")));
+		});
+
+		It("drops the parameters past the protocol limit", [this]()
+		{
+			TestTrue(TEXT("Parsed"), ParseLine("CMD a b c d e f g h i j k l m n o p q r s t :trailing"));
+			TestEqual(TEXT("Params"), line_.num_params_, FTwitchIRCLine::MaxParams);
+			TestEqual(TEXT("Out of range param"), line_.GetParam(FTwitchIRCLine::MaxParams).ToString(), FString());
+			TestEqual(TEXT("Content"), line_.trailing_.ToString(), FString(TEXT("trailing")));
+		});
+
+		It("decodes the tags on request", [this]()
+		{
+			TestTrue(TEXT("Parsed"), ParseLine("@badges=moderator/1;display-name=Big\\sViewer;emotes=;bits=100;note=a\\:b\\\\c :viewer!viewer@viewer PRIVMSG #twitchplay :x"));
+			const FTwitchIRCTags tags = line_.GetTags();
+			TestEqual(TEXT("Tags"), tags.Num(), 5);
+
+			FString value;
+			TestTrue(TEXT("Found display-name"), tags.GetValue("display-name", value));
+			TestEqual(TEXT("Unescaped space"), value, FString(TEXT("Big Viewer")));
+			TestTrue(TEXT("Found note"), tags.GetValue("note", value));
+			TestEqual(TEXT("Unescaped semicolon and backslash"), value, FString(TEXT("a;b\\c")));
+			TestTrue(TEXT("Found empty emotes"), tags.GetValue("emotes", value));
+			TestTrue(TEXT("Empty emotes"), value.IsEmpty());
+			TestFalse(TEXT("Missing tag"), tags.GetValue("color", value));
+			TestFalse(TEXT("Keys are case sensitive"), tags.GetValue("Badges", value));
+
+			int64 bits = 0;
+			TestTrue(TEXT("Found bits"), tags.GetInt64("bits", bits));
+			TestTrue(TEXT("Bits"), bits == 100);
+			TestFalse(TEXT("Not an integer"), tags.GetInt64("badges", bits));
+		});
+
+		It("rejects integer tags past the int64 range", [this]()
+		{
+			TestTrue(TEXT("Parsed"), ParseLine("@max=9223372036854775807;over=9223372036854775808;long=1234567890123456789012345;zeros=0000000000000000000000042 :viewer!viewer@viewer PRIVMSG #twitchplay :x"));
+			const FTwitchIRCTags tags = line_.GetTags();
+
+			int64 value = 0;
+			TestTrue(TEXT("Largest value"), tags.GetInt64("max", value));
+			TestTrue(TEXT("Largest value read"), value == MAX_int64);
+			TestFalse(TEXT("One past the largest value"), tags.GetInt64("over", value));
+			TestFalse(TEXT("25 digits"), tags.GetInt64("long", value));
+			TestTrue(TEXT("Leading zeros"), tags.GetInt64("zeros", value));
+			TestTrue(TEXT("Leading zeros read"), value == 42);
+		});
+
+		It("tolerates malformed tags", [this]()
+		{
+			TestTrue(TEXT("Parsed"), ParseLine("@;;;=;;a :viewer!viewer@viewer PRIVMSG #twitchplay :x"));
+			FString value;
+			line_.GetTags().GetValue("a", value);
+			TestEqual(TEXT("Content"), line_.trailing_.ToString(), FString(TEXT("x")));
+		});
+	});
+
+	Describe("FTwitchIRCLineFramer", [this]()
+	{
+		It("emits only complete lines", [this]()
+		{
+			FTwitchIRCLineFramer framer(512);
+			AppendString(framer, "PING :tmi.twi");
+			TestEqual(TEXT("Partial line"), PopLines(framer).Num(), 0);
+
+			AppendString(framer, "tch.tv\r\nPRIVMSG #a :b\n\r\n\r\nPRIV");
+			const TArray<FString> lines = PopLines(framer);
+			TestEqual(TEXT("Complete lines"), lines.Num(), 2);
+			if (lines.Num() == 2)
+			{
+				TestEqual(TEXT("CRLF line"), lines[0], FString(TEXT("PING :tmi.twitch.tv")));
+				TestEqual(TEXT("LF line"), lines[1], FString(TEXT("PRIVMSG #a :b")));
+			}
+			TestEqual(TEXT("Held back bytes"), framer.GetBufferedBytes(), 4);
+		});
+
+		It("stitches lines wrapping around the ring", [this]()
+		{
+			FTwitchIRCLineFramer framer(512);
+			const FString filler = FString::ChrN(400, 'a');
+			AppendString(framer, TCHAR_TO_ANSI(*(filler + TEXT("\r\n"))));
+			PopLines(framer);
+
+			// The buffer restarts when empty: keep a partial line so the next one wraps
+			AppendString(framer, TCHAR_TO_ANSI(*(filler + TEXT("\r\n") + TEXT("xy"))));
+			PopLines(framer);
+			const FString wrapped = FString::ChrN(300, 'b');
+			AppendString(framer, TCHAR_TO_ANSI(*(wrapped + TEXT("\r\n"))));
+
+			const TArray<FString> lines = PopLines(framer);
+			TestEqual(TEXT("Lines"), lines.Num(), 1);
+			if (lines.Num() == 1)
+			{
+				TestEqual(TEXT("Wrapped line"), lines[0], TEXT("xy") + wrapped);
+			}
+		});
+
+		It("discards lines longer than the buffer", [this]()
+		{
+			FTwitchIRCLineFramer framer(512);
+			const FString long_line = FString::ChrN(512, 'x');
+			AppendString(framer, TCHAR_TO_ANSI(*long_line));
+			TestEqual(TEXT("No line"), PopLines(framer).Num(), 0);
+			TestEqual(TEXT("Discarded"), framer.GetDiscardedLines(), 1);
+
+			AppendString(framer, "rest of the long line\r\nnext\r\n");
+			const TArray<FString> lines = PopLines(framer);
+			TestEqual(TEXT("Lines"), lines.Num(), 1);
+			if (lines.Num() == 1)
+			{
+				TestEqual(TEXT("Line after the discarded one"), lines[0], FString(TEXT("next")));
+			}
+		});
+	});
+
+	Describe("TwitchIRCUtf8", [this]()
+	{
+		It("decodes every code point", [this]()
+		{
+			TArray<ANSICHAR> bytes;
+			TArray<TCHAR> expected_chars;
+			for (uint32 cycle_code_point = 0; cycle_code_point <= 0x10FFFF; ++cycle_code_point)
+			{
+				if (cycle_code_point < 0xD800 || cycle_code_point > 0xDFFF)
+				{
+					AppendCodePoint(cycle_code_point, bytes, expected_chars);
+				}
+			}
+
+			TArray<TCHAR> chars;
+			chars.SetNumUninitialized(bytes.Num());
+			const int32 num_chars = TwitchIRCUtf8::Decode(bytes.GetData(), bytes.Num(), chars.GetData());
+			TestEqual(TEXT("Chars"), num_chars, expected_chars.Num());
+			TestTrue(TEXT("Same chars"), num_chars == expected_chars.Num() && FMemory::Memcmp(chars.GetData(), expected_chars.GetData(), num_chars * sizeof(TCHAR)) == 0);
+		});
+
+		It("replaces malformed sequences", [this]()
+		{
+			const FString replacement(1, &TwitchIRCUtf8::ReplacementChar);
+			TestEqual(TEXT("Stray continuation"), Decode("a\x80" "b"), TEXT("a") + replacement + TEXT("b"));
+			TestEqual(TEXT("Overlong 2 bytes"), Decode("\xC0\xAF"), replacement + replacement);
+			TestEqual(TEXT("Overlong 3 bytes"), Decode("\xE0\x80\xAF"), replacement + replacement + replacement);
+			TestEqual(TEXT("Encoded surrogate"), Decode("\xED\xA0\x80"), replacement + replacement + replacement);
+			TestEqual(TEXT("Past U+10FFFF"), Decode("\xF4\x90\x80\x80"), replacement + replacement + replacement + replacement);
+			TestEqual(TEXT("Invalid lead"), Decode("\xF5\xFF"), replacement + replacement);
+			TestEqual(TEXT("Cut short"), Decode("\xE3\x81" "a"), replacement + TEXT("a"));
+			TestEqual(TEXT("Cut short at the end"), Decode("a\xF0\x9F\x98"), TEXT("a") + replacement);
+		});
+
+		It("keeps ASCII runs around other chars", [this]()
+		{
+			const FString ascii = TEXT("0123456789abcdefghijklmnopqrstuvwxyz!#:@");
+			const FString text = ascii + TEXT("\u00E9") + ascii + TEXT("\u3053") + ascii;
+			const FTCHARToUTF8 utf8_text(*text);
+			TestEqual(TEXT("Round trip"), Decode(utf8_text.Get()), text);
+			TestTrue(TEXT("ASCII"), TwitchIRCUtf8::IsAscii(TCHAR_TO_ANSI(*ascii), ascii.Len()));
+			TestFalse(TEXT("Not ASCII"), TwitchIRCUtf8::IsAscii(utf8_text.Get(), utf8_text.Length()));
+		});
+
+		It("reuses the string", [this]()
+		{
+			FString string = FString::ChrN(256, 'x');
+			const TCHAR* const allocation = *string;
+			TwitchIRCUtf8::DecodeInto("short", 5, string);
+			TestEqual(TEXT("Content"), string, FString(TEXT("short")));
+			TestTrue(TEXT("Same allocation"), *string == allocation);
+
+			TwitchIRCUtf8::DecodeInto("", 0, string);
+			TestTrue(TEXT("Empty"), string.IsEmpty());
+		});
+	});
+
+	Describe("FTwitchIRCMessageArena", [this]()
+	{
+		It("recycles blocks once every message is released", [this]()
+		{
+			FTwitchIRCMessageArena arena(64);
+			FTwitchIRCMessageArena::FBlock* first_block;
+			FTwitchIRCMessageArena::FBlock* second_block;
+			ANSICHAR* first = arena.Allocate(40, first_block);
+			ANSICHAR* second = arena.Allocate(20, second_block);
+			TestTrue(TEXT("Same block while it has room"), first_block == second_block && second == first + 40);
+
+			// Full: the next allocation moves to another block, the first one is still used by its messages
+			FTwitchIRCMessageArena::FBlock* third_block;
+			arena.Allocate(40, third_block);
+			TestTrue(TEXT("New block when full"), third_block != first_block);
+
+			arena.Release(first_block);
+			arena.Release(second_block);
+			FTwitchIRCMessageArena::FBlock* fourth_block;
+			ANSICHAR* fourth = arena.Allocate(40, fourth_block);
+			TestTrue(TEXT("Released block reused"), fourth_block == first_block && fourth == first);
+			arena.Release(third_block);
+			arena.Release(fourth_block);
+		});
+
+		It("gives larger allocations a block of their own", [this]()
+		{
+			FTwitchIRCMessageArena arena(64);
+			FTwitchIRCMessageArena::FBlock* block;
+			ANSICHAR* data = arena.Allocate(1000, block);
+			TestTrue(TEXT("Large block"), block->capacity_ >= 1000);
+			FMemory::Memset(data, 'a', 1000);
+			arena.Release(block);
+		});
+	});
+
+	Describe("ParseMessage", [this]()
+	{
+		BeforeEach([this]()
+		{
+			component_ = NewObject<UTwitchIRCComponent>();
+			component_->AddToRoot();
+		});
+
+		AfterEach([this]()
+		{
+			component_->RemoveFromRoot();
+			component_ = nullptr;
+		});
+
+		It("returns the content and sender of every line", [this]()
+		{
+			TArray<FString> usernames;
+			TArray<FString> channels;
+			const TArray<FString> contents = component_->ParseMessage(
+				TEXT(":a!a@a PRIVMSG #one :first\r\n:tmi.twitch.tv 001 twitchplay :Welcome\r\n:b!b@b PRIVMSG #two :second: with colon\r\n"),
+				usernames, false, &channels);
+
+			TestEqual(TEXT("Contents"), contents.Num(), 3);
+			TestEqual(TEXT("Usernames in sync"), usernames.Num(), contents.Num());
+			TestEqual(TEXT("Channels in sync"), channels.Num(), contents.Num());
+			if (contents.Num() == 3 && usernames.Num() == 3 && channels.Num() == 3)
+			{
+				TestEqual(TEXT("First content"), contents[0], FString(TEXT("first")));
+				TestEqual(TEXT("First sender"), usernames[0], FString(TEXT("a")));
+				TestEqual(TEXT("First channel"), channels[0], FString(TEXT("one")));
+				TestEqual(TEXT("Server sender"), usernames[1], FString());
+				TestEqual(TEXT("Server channel"), channels[1], FString());
+				TestEqual(TEXT("Last content"), contents[2], FString(TEXT("second: with colon")));
+			}
+		});
+
+		It("filters server messages", [this]()
+		{
+			TArray<FString> usernames;
+			const TArray<FString> contents = component_->ParseMessage(TEXT(":tmi.twitch.tv 001 twitchplay :Welcome\r\n:a!a@a PRIVMSG #one :hi"), usernames, true);
+			TestEqual(TEXT("Contents"), contents.Num(), 1);
+			TestEqual(TEXT("Usernames"), usernames.Num(), 1);
+		});
+
+		It("skips PINGs without a connection", [this]()
+		{
+			TArray<FString> usernames;
+			TestEqual(TEXT("Contents"), component_->ParseMessage(TEXT("PING :tmi.twitch.tv\r\n"), usernames).Num(), 0);
+		});
+
+		It("survives adversarial lines", [this]()
+		{
+			// Single token lines used to index past the end of the split line
+			const FTwitchPlayTestCorpus corpus = FTwitchPlayTestCorpus::Make(ETwitchPlayTestCorpus::Adversarial, 64);
+			int32 num_contents = 0;
+			for (const FString& line : corpus.lines_)
+			{
+				TArray<FString> usernames;
+				const TArray<FString> contents = component_->ParseMessage(line, usernames);
+				TestEqual(FString::Printf(TEXT("Usernames in sync for \"%s\""), *line.Left(64)), usernames.Num(), contents.Num());
+				num_contents += contents.Num();
+			}
+			TestEqual(TEXT("Same contents as the tokenizer"), num_contents, corpus.contents_.Num());
+		});
+
+		It("keeps non ASCII content", [this]()
+		{
+			const FString content = TEXT("\u3053\u3093\u306B\u3061\u306F !move!#\u5DE6#");
+			TArray<FString> usernames;
+			const TArray<FString> contents = component_->ParseMessage(TEXT(":a!a@a PRIVMSG #one :") + content, usernames);
+			TestEqual(TEXT("Contents"), contents.Num(), 1);
+			if (contents.Num() == 1)
+			{
+				TestEqual(TEXT("Content"), contents[0], content);
+			}
+		});
+	});
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS
@@ -0,0 +1,186 @@
+// Copyright (C) Simone Di Gravio <email: altairjp@gmail.com> - All Rights Reserved
+
+#include "CoreMinimal.h"
+#include "Misc/AutomationTest.h"
+#include "Testing/TwitchIRCMockServer.h"
+
+#if WITH_DEV_AUTOMATION_TESTS && TWITCHPLAY_WITH_LOAD_TESTING
+
+#include "Net/TwitchIRCConnection.h"
+
+namespace
+{
+	// Away from the default port of the mock server, so a server started from the console does not get in the way
+	const int32 ReconnectTestPort = 16668;
+
+	// Time each step of the test has before it fails
+	const double ReconnectStepTimeoutSeconds = 15.0;
+
+	const TCHAR* const ReconnectTestChannels[] = { TEXT("twitchplay"), TEXT("twitchplaytest") };
+
+	// Chat lines the first channel has to receive once joined again
+	const int32 ReconnectTestChatLines = 10;
+}
+
+/**
+ * Drives a connection to the mock server through a dropped connection, one step per frame:
+ * waits for the channels to be joined, drops the client, waits for the connection to notice and reconnect,
+ * then checks the channels were joined again and chat flows on them.
+ */
+class FTwitchIRCReconnectCommand : public IAutomationLatentCommand
+{
+public:
+
+	FTwitchIRCReconnectCommand(FAutomationTestBase* _test, TSharedPtr<FTwitchIRCMockServer> _server, TSharedPtr<FTwitchIRCConnection> _connection)
+		: test_(_test)
+		, server_(_server)
+		, connection_(_connection)
+		, step_start_time_(FPlatformTime::Seconds())
+	{
+	}
+
+	virtual bool Update() override
+	{
+		FTwitchIRCStateChange state_change;
+		while (connection_->DequeueStateChange(state_change))
+		{
+			b_lost_connection_ |= state_change.state_ == ETwitchConnectionState::WaitingToReconnect;
+		}
+
+		const int32 num_channels = ARRAY_COUNT(ReconnectTestChannels);
+		const bool b_joined = connection_->GetState() == ETwitchConnectionState::Joined;
+
+		switch (step_)
+		{
+		case EStep::WaitForJoin:
+			if (b_joined && server_->GetNumJoins() == num_channels)
+			{
+				test_->TestFalse(TEXT("Connected without losing the connection"), b_lost_connection_);
+				server_->DropClients();
+				NextStep(EStep::WaitForReconnect);
+			}
+			break;
+
+		case EStep::WaitForReconnect:
+			if (b_lost_connection_)
+			{
+				NextStep(EStep::WaitForRejoin);
+			}
+			break;
+
+		case EStep::WaitForRejoin:
+			if (b_joined && server_->GetNumJoins() >= num_channels * 2)
+			{
+				test_->TestEqual(TEXT("Every channel joined again, once"), server_->GetNumJoins(), num_channels * 2);
+				test_->TestEqual(TEXT("Clients"), server_->GetNumClients(), 1);
+
+				FTwitchIRCMockServer::FLoadSettings load_settings;
+				load_settings.channel_ = ReconnectTestChannels[0];
+				load_settings.lines_per_second_ = 100.0f;
+				load_settings.duration_seconds_ = 1.0f;
+				server_->StartLoad(load_settings);
+				NextStep(EStep::WaitForChat);
+			}
+			break;
+
+		case EStep::WaitForChat:
+		{
+			FTwitchIRCReceivedMessage message;
+			while (connection_->DequeueMessage(message))
+			{
+				test_->TestEqual(TEXT("Channel of the chat"), message.channel_id_, 0);
+				++received_lines_;
+			}
+			if (received_lines_ >= ReconnectTestChatLines)
+			{
+				return Finish();
+			}
+			break;
+		}
+		}
+
+		if (FPlatformTime::Seconds() - step_start_time_ > ReconnectStepTimeoutSeconds)
+		{
+			test_->AddError(FString::Printf(TEXT("Timed out at step %d, connection state %d, %d joins, %d chat lines"),
+				static_cast<int32>(step_), static_cast<int32>(connection_->GetState()), server_->GetNumJoins(), received_lines_));
+			return Finish();
+		}
+		return false;
+	}
+
+private:
+
+	enum class EStep : uint8
+	{
+		WaitForJoin,
+		WaitForReconnect,
+		WaitForRejoin,
+		WaitForChat
+	};
+
+	void NextStep(EStep _step)
+	{
+		step_ = _step;
+		step_start_time_ = FPlatformTime::Seconds();
+	}
+
+	bool Finish()
+	{
+		connection_->Shutdown();
+		server_->Shutdown();
+		return true;
+	}
+
+	FAutomationTestBase* test_;
+
+	TSharedPtr<FTwitchIRCMockServer> server_;
+
+	TSharedPtr<FTwitchIRCConnection> connection_;
+
+	EStep step_ = EStep::WaitForJoin;
+
+	double step_start_time_;
+
+	// Whether the connection went through WaitingToReconnect
+	bool b_lost_connection_ = false;
+
+	int32 received_lines_ = 0;
+};
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FTwitchIRCReconnectTest, "TwitchPlay.Connection.Reconnect", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FTwitchIRCReconnectTest::RunTest(const FString& _parameters)
+{
+	FTwitchIRCMockServer::FSettings server_settings;
+	server_settings.port_ = ReconnectTestPort;
+	TSharedPtr<FTwitchIRCMockServer> server = MakeShared<FTwitchIRCMockServer>(server_settings);
+
+	FString error;
+	if (!server->Start(error))
+	{
+		AddError(FString::Printf(TEXT("Mock server: %s"), *error));
+		return false;
+	}
+
+	FTwitchIRCConnection::FSettings connection_settings;
+	connection_settings.host_ = TEXT("127.0.0.1");
+	connection_settings.port_ = ReconnectTestPort;
+	connection_settings.reconnect_initial_delay_ = 0.1;
+	TSharedPtr<FTwitchIRCConnection> connection = MakeShared<FTwitchIRCConnection>(connection_settings);
+
+	connection->Authenticate(TEXT("oauth:test"), TEXT("twitchplaytest"), false);
+	for (int32 cycle_x = 0; cycle_x < ARRAY_COUNT(ReconnectTestChannels); ++cycle_x)
+	{
+		connection->JoinChannel(cycle_x, ReconnectTestChannels[cycle_x]);
+	}
+	if (!connection->Start())
+	{
+		AddError(TEXT("Could not start the connection thread"));
+		return false;
+	}
+
+	ADD_LATENT_AUTOMATION_COMMAND(FTwitchIRCReconnectCommand(this, server, connection));
+	return true;
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS && TWITCHPLAY_WITH_LOAD_TESTING
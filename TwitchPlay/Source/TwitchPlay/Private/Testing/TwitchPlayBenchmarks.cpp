@@ -0,0 +1,469 @@
+// Copyright (C) Simone Di Gravio <email: altairjp@gmail.com> - All Rights Reserved
+
+#include "CoreMinimal.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+#include "Testing/TwitchPlayTestUtils.h"
+#include "Testing/TwitchPlayTestReceiver.h"
+#include "Components/TwitchPlayComponent.h"
+#include "Commands/TwitchKeywordMatcher.h"
+#include "Net/TwitchIRCLine.h"
+#include "Net/TwitchIRCUtf8.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+
+namespace
+{
+	TAutoConsoleVariable<float> GBenchmarkThreshold(
+		TEXT("TwitchPlay.Benchmark.Threshold"),
+		0.25f,
+		TEXT("How much slower than the baseline (0.25 for 25%) a benchmark can run before it fails."));
+
+	TAutoConsoleVariable<int32> GBenchmarkUpdateBaseline(
+		TEXT("TwitchPlay.Benchmark.UpdateBaseline"),
+		0,
+		TEXT("1 to replace the baseline with the results of the next runs instead of comparing against it."));
+
+	TAutoConsoleVariable<FString> GBenchmarkCorpus(
+		TEXT("TwitchPlay.Benchmark.Corpus"),
+		TEXT(""),
+		TEXT("Capture (see TwitchPlay.Capture) to benchmark besides the generated corpora, like the recording of a real stream. Relative to the project."));
+
+	const int32 NumCorpusLines = 20000;
+
+	const int32 NumTimedPasses = 5;
+
+	// Allocations per line a benchmark can gain before it fails. Covers the rounding of the average
+	const double AllocationTolerance = 0.01;
+
+	struct FBenchmarkResult
+	{
+		double ns_per_line_ = 0.0;
+
+		double allocs_per_line_ = 0.0;
+	};
+
+	/**
+	 * Times a function over every line: one pass to warm the caches up, the best of NumTimedPasses,
+	 * then a pass counting the allocations.
+	 */
+	FBenchmarkResult Measure(int32 _num_lines, TFunctionRef<void(int32)> _function)
+	{
+		FBenchmarkResult result;
+		if (_num_lines == 0)
+		{
+			return result;
+		}
+
+		for (int32 cycle_line = 0; cycle_line < _num_lines; ++cycle_line)
+		{
+			_function(cycle_line);
+		}
+
+		uint64 best_cycles = MAX_uint64;
+		for (int32 cycle_pass = 0; cycle_pass < NumTimedPasses; ++cycle_pass)
+		{
+			const uint64 start_cycles = FPlatformTime::Cycles64();
+			for (int32 cycle_line = 0; cycle_line < _num_lines; ++cycle_line)
+			{
+				_function(cycle_line);
+			}
+			best_cycles = FMath::Min(best_cycles, FPlatformTime::Cycles64() - start_cycles);
+		}
+		result.ns_per_line_ = FPlatformTime::GetSecondsPerCycle64() * best_cycles * 1.0e9 / _num_lines;
+
+		// Counted separately: the proxy allocator would slow the timed passes down
+		FTwitchPlayAllocationCounter allocation_counter;
+		for (int32 cycle_line = 0; cycle_line < _num_lines; ++cycle_line)
+		{
+			_function(cycle_line);
+		}
+		result.allocs_per_line_ = static_cast<double>(allocation_counter.GetNumAllocations()) / _num_lines;
+		return result;
+	}
+
+	/**
+	 * Results of previous runs on this machine, in Saved/TwitchPlay/Benchmarks.csv ("name,ns_per_line,allocs_per_line").
+	 * Benchmarks without a baseline record one.
+	 */
+	class FBenchmarkBaseline
+	{
+	public:
+
+		FBenchmarkBaseline()
+		{
+			TArray<FString> lines;
+			FFileHelper::LoadFileToStringArray(lines, *GetFilePath());
+			for (const FString& line : lines)
+			{
+				TArray<FString> fields;
+				if (line.ParseIntoArray(fields, TEXT(",")) == 3)
+				{
+					FBenchmarkResult& result = results_.Add(fields[0]);
+					result.ns_per_line_ = FCString::Atod(*fields[1]);
+					result.allocs_per_line_ = FCString::Atod(*fields[2]);
+				}
+			}
+		}
+
+		~FBenchmarkBaseline()
+		{
+			if (!b_changed_)
+			{
+				return;
+			}
+
+			FString file;
+			for (const TPair<FString, FBenchmarkResult>& result : results_)
+			{
+				file += FString::Printf(TEXT("%s,%.3f,%.4f\n"), *result.Key, result.Value.ns_per_line_, result.Value.allocs_per_line_);
+			}
+			FFileHelper::SaveStringToFile(file, *GetFilePath());
+		}
+
+		/**
+		 * Logs a result and checks it against the baseline.
+		 *
+		 * @param _test - Test reporting the result.
+		 * @param _name - Name of the benchmark.
+		 * @param _result - What was measured.
+		 */
+		void Report(FAutomationTestBase& _test, const FString& _name, const FBenchmarkResult& _result)
+		{
+			_test.AddInfo(FString::Printf(TEXT("%s: %.1f ns/line, %.2f allocs/line, %.0f lines/s"),
+				*_name, _result.ns_per_line_, _result.allocs_per_line_, _result.ns_per_line_ > 0.0 ? 1.0e9 / _result.ns_per_line_ : 0.0));
+
+			const FBenchmarkResult* baseline = results_.Find(_name);
+			if (baseline == nullptr || GBenchmarkUpdateBaseline.GetValueOnGameThread() != 0)
+			{
+				results_.Add(_name, _result);
+				b_changed_ = true;
+				return;
+			}
+
+			const double max_ns_per_line = baseline->ns_per_line_ * (1.0 + GBenchmarkThreshold.GetValueOnGameThread());
+			if (_result.ns_per_line_ > max_ns_per_line)
+			{
+				_test.AddError(FString::Printf(TEXT("%s regressed: %.1f ns/line, the baseline is %.1f ns/line"), *_name, _result.ns_per_line_, baseline->ns_per_line_));
+			}
+			if (_result.allocs_per_line_ > baseline->allocs_per_line_ + AllocationTolerance)
+			{
+				_test.AddError(FString::Printf(TEXT("%s regressed: %.2f allocs/line, the baseline is %.2f allocs/line"), *_name, _result.allocs_per_line_, baseline->allocs_per_line_));
+			}
+		}
+
+	private:
+
+		static FString GetFilePath()
+		{
+			return FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("TwitchPlay"), TEXT("Benchmarks.csv"));
+		}
+
+		TMap<FString, FBenchmarkResult> results_;
+
+		bool b_changed_ = false;
+	};
+
+	// The generated corpora, plus the capture set in TwitchPlay.Benchmark.Corpus
+	TArray<FTwitchPlayTestCorpus> MakeCorpora(FAutomationTestBase& _test)
+	{
+		TArray<FTwitchPlayTestCorpus> corpora;
+		for (int32 cycle_type = 0; cycle_type < static_cast<int32>(ETwitchPlayTestCorpus::Num); ++cycle_type)
+		{
+			corpora.Add(FTwitchPlayTestCorpus::Make(static_cast<ETwitchPlayTestCorpus>(cycle_type), NumCorpusLines));
+		}
+
+		FString capture_file = GBenchmarkCorpus.GetValueOnGameThread();
+		if (!capture_file.IsEmpty())
+		{
+			if (FPaths::IsRelative(capture_file))
+			{
+				capture_file = FPaths::Combine(FPaths::ProjectDir(), capture_file);
+			}
+
+			FTwitchPlayTestCorpus capture;
+			if (FTwitchPlayTestCorpus::LoadCapture(capture_file, MAX_int32, capture))
+			{
+				corpora.Add(MoveTemp(capture));
+			}
+			else
+			{
+				_test.AddWarning(FString::Printf(TEXT("Could not read the capture %s"), *capture_file));
+			}
+		}
+		return corpora;
+	}
+
+	/**
+	 * ParseMessage as it was before the lines were tokenized in place: every line split into strings on ':' and spaces.
+	 * Kept as the reference the current parser is compared against. Lines with a single token are skipped
+	 * instead of reading past the end of the split line, and PINGs aren't answered.
+	 */
+	TArray<FString> LegacyParseMessage(const FString& _message, TArray<FString>& _out_sender_username)
+	{
+		TArray<FString> ret_messages_content;
+
+		TArray<FString> message_lines;
+		_message.ParseIntoArrayLines(message_lines);
+
+		for (int32 cycle_line = 0; cycle_line < message_lines.Num(); cycle_line++)
+		{
+			if (message_lines[cycle_line] == "PING :tmi.twitch.tv")
+			{
+				continue;
+			}
+
+			TArray<FString> message_parts;
+			message_lines[cycle_line].ParseIntoArray(message_parts, TEXT(":"));
+			if (message_parts.Num() == 0)
+			{
+				continue;
+			}
+
+			TArray<FString> meta;
+			message_parts[0].ParseIntoArrayWS(meta);
+
+			FString sender_username = "";
+			if (meta.Num() > 1 && meta[1] == "PRIVMSG")
+			{
+				meta[0].Split("!", &sender_username, nullptr);
+			}
+
+			if (message_parts.Num() > 1)
+			{
+				FString message_content = message_parts[1];
+				for (int32 cycle_content = 2; cycle_content < message_parts.Num(); cycle_content++)
+				{
+					message_content += ":" + message_parts[cycle_content];
+				}
+				ret_messages_content.Add(message_content);
+				_out_sender_username.Add(sender_username);
+			}
+		}
+		return ret_messages_content;
+	}
+
+	// Keywords of the keyword benchmark: a big emote set, like the ones of a channel with many extensions
+	TArray<FString> MakeBenchmarkKeywords(int32 _num_keywords)
+	{
+		TArray<FString> keywords = { TEXT("Kappa"), TEXT("Keepo"), TEXT("PogChamp"), TEXT("LUL"), TEXT("gg"), TEXT("hype") };
+		for (int32 cycle_keyword = keywords.Num(); cycle_keyword < _num_keywords; ++cycle_keyword)
+		{
+			keywords.Add(FString::Printf(TEXT("emote%dHype"), cycle_keyword));
+		}
+		return keywords;
+	}
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FTwitchPlayParserBenchmark, "TwitchPlay.Benchmarks.Parser", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::PerfFilter)
+
+bool FTwitchPlayParserBenchmark::RunTest(const FString& _parameters)
+{
+	UTwitchIRCComponent* component = NewObject<UTwitchIRCComponent>();
+	component->AddToRoot();
+	FBenchmarkBaseline baseline;
+
+	TArray<FString> usernames;
+	FTwitchIRCLine line;
+	for (const FTwitchPlayTestCorpus& corpus : MakeCorpora(*this))
+	{
+		const int32 num_lines = corpus.lines_.Num();
+
+		const FBenchmarkResult legacy_result = Measure(num_lines, [&](int32 _line_index)
+		{
+			usernames.Reset();
+			LegacyParseMessage(corpus.lines_[_line_index], usernames);
+		});
+		baseline.Report(*this, FString::Printf(TEXT("Parser.%s.Legacy"), *corpus.name_), legacy_result);
+
+		const FBenchmarkResult parse_result = Measure(num_lines, [&](int32 _line_index)
+		{
+			usernames.Reset();
+			component->ParseMessage(corpus.lines_[_line_index], usernames);
+		});
+		baseline.Report(*this, FString::Printf(TEXT("Parser.%s.ParseMessage"), *corpus.name_), parse_result);
+
+		// What the connection threads run on the received bytes, without any conversion
+		const FBenchmarkResult tokenizer_result = Measure(num_lines, [&](int32 _line_index)
+		{
+			const TArray<ANSICHAR>& utf8_line = corpus.utf8_lines_[_line_index];
+			line.Parse(utf8_line.GetData(), utf8_line.Num());
+		});
+		baseline.Report(*this, FString::Printf(TEXT("Parser.%s.Tokenizer"), *corpus.name_), tokenizer_result);
+
+		if (parse_result.ns_per_line_ > 0.0)
+		{
+			AddInfo(FString::Printf(TEXT("%s: ParseMessage is %.1fx the legacy parser"), *corpus.name_, legacy_result.ns_per_line_ / parse_result.ns_per_line_));
+		}
+	}
+
+	component->RemoveFromRoot();
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FTwitchPlayUtf8Benchmark, "TwitchPlay.Benchmarks.Utf8", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::PerfFilter)
+
+bool FTwitchPlayUtf8Benchmark::RunTest(const FString& _parameters)
+{
+	FBenchmarkBaseline baseline;
+
+	FString string;
+	for (const FTwitchPlayTestCorpus& corpus : MakeCorpora(*this))
+	{
+		const int32 num_lines = corpus.utf8_lines_.Num();
+
+		// The engine conversion: into the converter buffer, then copied into the string
+		const FBenchmarkResult engine_result = Measure(num_lines, [&](int32 _line_index)
+		{
+			const TArray<ANSICHAR>& utf8_line = corpus.utf8_lines_[_line_index];
+			const FUTF8ToTCHAR converted(utf8_line.GetData(), utf8_line.Num());
+			string = FString(converted.Length(), converted.Get());
+		});
+		baseline.Report(*this, FString::Printf(TEXT("Utf8.%s.Engine"), *corpus.name_), engine_result);
+
+		const FBenchmarkResult decoder_result = Measure(num_lines, [&](int32 _line_index)
+		{
+			const TArray<ANSICHAR>& utf8_line = corpus.utf8_lines_[_line_index];
+			TwitchIRCUtf8::DecodeInto(utf8_line.GetData(), utf8_line.Num(), string);
+		});
+		baseline.Report(*this, FString::Printf(TEXT("Utf8.%s.Decoder"), *corpus.name_), decoder_result);
+
+		if (decoder_result.ns_per_line_ > 0.0)
+		{
+			AddInfo(FString::Printf(TEXT("%s: the decoder is %.1fx the engine conversion"), *corpus.name_, engine_result.ns_per_line_ / decoder_result.ns_per_line_));
+		}
+	}
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FTwitchPlayCommandsBenchmark, "TwitchPlay.Benchmarks.Commands", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::PerfFilter)
+
+bool FTwitchPlayCommandsBenchmark::RunTest(const FString& _parameters)
+{
+	UTwitchPlayComponent* component = NewObject<UTwitchPlayComponent>();
+	component->AddToRoot();
+	UTwitchPlayTestReceiver* receiver = NewObject<UTwitchPlayTestReceiver>();
+	receiver->AddToRoot();
+	FBenchmarkBaseline baseline;
+
+	// The commands of the CommandHeavy corpus, "move" and "attack" with a schema
+	FOnCommandReceived command_event;
+	command_event.BindUFunction(receiver, TEXT("OnCommand"));
+	FOnTypedCommandReceived typed_command_event;
+	typed_command_event.BindUFunction(receiver, TEXT("OnTypedCommand"));
+
+	FTwitchCommandSchema move_schema;
+	move_schema.args_.AddDefaulted(2);
+	move_schema.args_[0].type_ = ETwitchCommandArgType::Direction;
+	move_schema.num_optional_args_ = 1;
+	FTwitchCommandSchema attack_schema;
+	attack_schema.args_.AddDefaulted(1);
+
+	FString result;
+	for (const FString& command_name : FTwitchPlayTestCorpus::GetCommandNames())
+	{
+		if (command_name == TEXT("move"))
+		{
+			component->RegisterCommandWithSchema(command_name, move_schema, typed_command_event, result);
+		}
+		else if (command_name == TEXT("attack"))
+		{
+			component->RegisterCommandWithSchema(command_name, attack_schema, typed_command_event, result);
+		}
+		else
+		{
+			component->RegisterCommand(command_name, command_event, result);
+		}
+	}
+
+	for (const FTwitchPlayTestCorpus& corpus : MakeCorpora(*this))
+	{
+		const int32 num_contents = corpus.contents_.Num();
+
+		const FBenchmarkResult delimited_result = Measure(num_contents, [&](int32 _content_index)
+		{
+			FTwitchPlayTestAccess::GetDelimitedString(*component, corpus.contents_[_content_index], component->command_encapsulation_char_);
+		});
+		baseline.Report(*this, FString::Printf(TEXT("Commands.%s.GetDelimitedString"), *corpus.name_), delimited_result);
+
+		const FBenchmarkResult options_result = Measure(num_contents, [&](int32 _content_index)
+		{
+			FTwitchPlayTestAccess::GetCommandOptionsStrings(*component, corpus.contents_[_content_index]);
+		});
+		baseline.Report(*this, FString::Printf(TEXT("Commands.%s.GetCommandOptionsStrings"), *corpus.name_), options_result);
+
+		// The same array for every message, like the dispatch does
+		TArray<FString> reused_options;
+		const FBenchmarkResult reused_options_result = Measure(num_contents, [&](int32 _content_index)
+		{
+			FTwitchPlayTestAccess::GetCommandOptionsStrings(*component, corpus.contents_[_content_index], reused_options);
+		});
+		baseline.Report(*this, FString::Printf(TEXT("Commands.%s.GetCommandOptionsStringsReused"), *corpus.name_), reused_options_result);
+
+		// Everything a message goes through on the game thread, up to the command event
+		receiver->Reset();
+		const FBenchmarkResult dispatch_result = Measure(num_contents, [&](int32 _content_index)
+		{
+			component->OnMessageReceived.Broadcast(corpus.contents_[_content_index], corpus.usernames_[_content_index], _content_index);
+		});
+		baseline.Report(*this, FString::Printf(TEXT("Commands.%s.Dispatch"), *corpus.name_), dispatch_result);
+		AddInfo(FString::Printf(TEXT("%s: %d commands fired, %d typed"), *corpus.name_, receiver->num_commands_, receiver->num_typed_commands_));
+	}
+
+	receiver->RemoveFromRoot();
+	component->RemoveFromRoot();
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FTwitchPlayKeywordsBenchmark, "TwitchPlay.Benchmarks.Keywords", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::PerfFilter)
+
+bool FTwitchPlayKeywordsBenchmark::RunTest(const FString& _parameters)
+{
+	FBenchmarkBaseline baseline;
+
+	const TArray<FString> keywords = MakeBenchmarkKeywords(1000);
+	FTwitchKeywordMatcher matcher;
+	matcher.Build(keywords, false, false);
+
+	TArray<FTwitchKeywordHit> hits;
+	for (const FTwitchPlayTestCorpus& corpus : MakeCorpora(*this))
+	{
+		const int32 num_contents = corpus.contents_.Num();
+
+		int32 num_matcher_hits = 0;
+		const FBenchmarkResult matcher_result = Measure(num_contents, [&](int32 _content_index)
+		{
+			const FString& content = corpus.contents_[_content_index];
+			hits.Reset();
+			num_matcher_hits += matcher.Scan(*content, content.Len(), hits);
+		});
+		baseline.Report(*this, FString::Printf(TEXT("Keywords.%s.Matcher"), *corpus.name_), matcher_result);
+
+		// What a Blueprint would do without the matcher: look for every keyword in every message
+		int32 num_naive_hits = 0;
+		const FBenchmarkResult naive_result = Measure(num_contents, [&](int32 _content_index)
+		{
+			const FString& content = corpus.contents_[_content_index];
+			for (const FString& keyword : keywords)
+			{
+				if (content.Contains(keyword, ESearchCase::IgnoreCase))
+				{
+					++num_naive_hits;
+				}
+			}
+		});
+		baseline.Report(*this, FString::Printf(TEXT("Keywords.%s.Naive"), *corpus.name_), naive_result);
+
+		if (matcher_result.ns_per_line_ > 0.0)
+		{
+			AddInfo(FString::Printf(TEXT("%s: the matcher is %.1fx the naive loop over %d keywords (%d and %d hits)"),
+				*corpus.name_, naive_result.ns_per_line_ / matcher_result.ns_per_line_, keywords.Num(), num_matcher_hits, num_naive_hits));
+		}
+	}
+	return true;
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS
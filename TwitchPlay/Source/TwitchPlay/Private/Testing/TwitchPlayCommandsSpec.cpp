@@ -0,0 +1,775 @@
+// Copyright (C) Simone Di Gravio <email: altairjp@gmail.com> - All Rights Reserved
+
+#include "CoreMinimal.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+#include "Testing/TwitchPlayTestUtils.h"
+#include "Testing/TwitchPlayTestReceiver.h"
+#include "Components/TwitchPlayComponent.h"
+#include "Commands/TwitchCommandBatch.h"
+#include "Commands/TwitchKeywordMatcher.h"
+#include "Commands/TwitchTrendTracker.h"
+#include "Net/TwitchIRCConnection.h"
+#include "Serialization/MemoryWriter.h"
+#include "Serialization/MemoryReader.h"
+
+BEGIN_DEFINE_SPEC(FTwitchPlayCommandsSpec, "TwitchPlay.Commands", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+	UTwitchPlayComponent* component_ = nullptr;
+
+	UTwitchPlayTestReceiver* receiver_ = nullptr;
+
+	// Registers "say" and "jump" without schema, "move" (direction, optional amount) and "attack" (1 to 5) with one
+	void RegisterCommands()
+	{
+		FOnCommandReceived command_event;
+		command_event.BindUFunction(receiver_, TEXT("OnCommand"));
+		FOnTypedCommandReceived typed_command_event;
+		typed_command_event.BindUFunction(receiver_, TEXT("OnTypedCommand"));
+
+		FString result;
+		TestTrue(TEXT("Registered say"), component_->RegisterCommand(TEXT("say"), command_event, result));
+		TestTrue(TEXT("Registered jump"), component_->RegisterCommand(TEXT("jump"), command_event, result));
+
+		FTwitchCommandSchema move_schema;
+		move_schema.args_.AddDefaulted(2);
+		move_schema.args_[0].type_ = ETwitchCommandArgType::Direction;
+		move_schema.num_optional_args_ = 1;
+		TestTrue(TEXT("Registered move"), component_->RegisterCommandWithSchema(TEXT("move"), move_schema, typed_command_event, result));
+
+		FTwitchCommandSchema attack_schema;
+		attack_schema.args_.AddDefaulted(1);
+		attack_schema.args_[0].b_check_range_ = true;
+		attack_schema.args_[0].min_value_ = 1.0f;
+		attack_schema.args_[0].max_value_ = 5.0f;
+		TestTrue(TEXT("Registered attack"), component_->RegisterCommandWithSchema(TEXT("attack"), attack_schema, typed_command_event, result));
+	}
+
+	void Receive(const FString& _message, const FString& _username = TEXT("viewer"), int32 _user_handle = 7)
+	{
+		component_->OnMessageReceived.Broadcast(_message, _username, _user_handle);
+	}
+
+	// Decodes a batch after sending it through NetSerialize
+	bool RoundTrip(FTwitchCommandBatch& _batch, TArray<FTwitchBatchedCommand>& _out_commands)
+	{
+		TArray<uint8> bytes;
+		FMemoryWriter writer(bytes);
+		bool b_success = false;
+		_batch.NetSerialize(writer, nullptr, b_success);
+
+		FTwitchCommandBatch received_batch;
+		FMemoryReader reader(bytes);
+		received_batch.NetSerialize(reader, nullptr, b_success);
+		if (!b_success)
+		{
+			return false;
+		}
+		return received_batch.ForEachCommand([&_out_commands](const FTwitchBatchedCommand& _command) { _out_commands.Add(_command); });
+	}
+
+	// Counts a key named "key<_key>" a few times
+	static void AddTrend(FTwitchTrendTracker& _tracker, uint64 _key, double _now, int32 _times = 1)
+	{
+		for (int32 cycle_time = 0; cycle_time < _times; ++cycle_time)
+		{
+			_tracker.Add(_key, _now, [_key]() { return FString::Printf(TEXT("key%llu"), _key); });
+		}
+	}
+
+	// Top entries as "name:count", most seen first
+	static FString GetTopTrends(FTwitchTrendTracker& _tracker, double _now)
+	{
+		TArray<FTwitchTrendEntry> entries;
+		_tracker.GetTop(_now, 100, entries);
+		FString top;
+		for (const FTwitchTrendEntry& entry : entries)
+		{
+			top += FString::Printf(TEXT("%s%s:%d"), top.IsEmpty() ? TEXT("") : TEXT(" "), *entry.name_, entry.count_);
+		}
+		return top;
+	}
+
+END_DEFINE_SPEC(FTwitchPlayCommandsSpec)
+
+void FTwitchPlayCommandsSpec::Define()
+{
+	BeforeEach([this]()
+	{
+		component_ = NewObject<UTwitchPlayComponent>();
+		component_->AddToRoot();
+		receiver_ = NewObject<UTwitchPlayTestReceiver>();
+		receiver_->AddToRoot();
+	});
+
+	AfterEach([this]()
+	{
+		component_->RemoveFromRoot();
+		component_ = nullptr;
+		receiver_->RemoveFromRoot();
+		receiver_ = nullptr;
+	});
+
+	Describe("GetDelimitedString", [this]()
+	{
+		It("returns the first encapsulated string", [this]()
+		{
+			TestEqual(TEXT("Single char"), FTwitchPlayTestAccess::GetDelimitedString(*component_, TEXT("go #left# now"), TEXT("#")), FString(TEXT("left")));
+			TestEqual(TEXT("First pair"), FTwitchPlayTestAccess::GetDelimitedString(*component_, TEXT("#a#b#c#"), TEXT("#")), FString(TEXT("a")));
+			TestEqual(TEXT("Multi char"), FTwitchPlayTestAccess::GetDelimitedString(*component_, TEXT("x<<y<<z"), TEXT("<<")), FString(TEXT("y")));
+			TestEqual(TEXT("Spaces kept"), FTwitchPlayTestAccess::GetDelimitedString(*component_, TEXT("! move !"), TEXT("!")), FString(TEXT(" move ")));
+		});
+
+		It("returns nothing without a closed pair", [this]()
+		{
+			TestEqual(TEXT("Empty string"), FTwitchPlayTestAccess::GetDelimitedString(*component_, TEXT(""), TEXT("#")), FString());
+			TestEqual(TEXT("No delimiter"), FTwitchPlayTestAccess::GetDelimitedString(*component_, TEXT("hello"), TEXT("#")), FString());
+			TestEqual(TEXT("Delimiter at the end"), FTwitchPlayTestAccess::GetDelimitedString(*component_, TEXT("hello#"), TEXT("#")), FString());
+			TestEqual(TEXT("Not closed"), FTwitchPlayTestAccess::GetDelimitedString(*component_, TEXT("#hello"), TEXT("#")), FString());
+			TestEqual(TEXT("Empty pair"), FTwitchPlayTestAccess::GetDelimitedString(*component_, TEXT("a##b"), TEXT("#")), FString());
+			TestEqual(TEXT("Overlapping multi char"), FTwitchPlayTestAccess::GetDelimitedString(*component_, TEXT("<<<"), TEXT("<<")), FString());
+			TestEqual(TEXT("Empty delimiter"), FTwitchPlayTestAccess::GetDelimitedString(*component_, TEXT("#a#"), TEXT("")), FString());
+		});
+
+		It("finds the same options as the schemas", [this]()
+		{
+			const TCHAR* const messages[] = { TEXT("!move!#left,3#"), TEXT("a##b"), TEXT("#a#b#c#"), TEXT("x<<y<<z"), TEXT("#open"), TEXT("") };
+			for (const TCHAR* message : messages)
+			{
+				const FString text = message;
+				int32 start = 0;
+				int32 length = 0;
+				const bool b_found = FTwitchCommandSchemaParser::FindDelimited(*text, text.Len(), *component_->options_encapsulation_char_, component_->options_encapsulation_char_.Len(), start, length);
+				TestEqual(FString::Printf(TEXT("Options of \"%s\""), message), FTwitchPlayTestAccess::GetDelimitedString(*component_, text, component_->options_encapsulation_char_), b_found ? text.Mid(start, length) : FString());
+			}
+		});
+	});
+
+	Describe("GetCommandOptionsStrings", [this]()
+	{
+		It("splits the options", [this]()
+		{
+			const TArray<FString> options = FTwitchPlayTestAccess::GetCommandOptionsStrings(*component_, TEXT("!move!#left,3#"));
+			TestEqual(TEXT("Options"), options.Num(), 2);
+			if (options.Num() == 2)
+			{
+				TestEqual(TEXT("First option"), options[0], FString(TEXT("left")));
+				TestEqual(TEXT("Second option"), options[1], FString(TEXT("3")));
+			}
+		});
+
+		It("returns no options for commands without any", [this]()
+		{
+			TestEqual(TEXT("No options"), FTwitchPlayTestAccess::GetCommandOptionsStrings(*component_, TEXT("!jump!")).Num(), 0);
+			TestEqual(TEXT("Only separators"), FTwitchPlayTestAccess::GetCommandOptionsStrings(*component_, TEXT("!jump!#,,,#")).Num(), 0);
+			TestEqual(TEXT("Not closed"), FTwitchPlayTestAccess::GetCommandOptionsStrings(*component_, TEXT("!jump!#a,b")).Num(), 0);
+		});
+
+		It("overwrites a reused array", [this]()
+		{
+			TArray<FString> options;
+			FTwitchPlayTestAccess::GetCommandOptionsStrings(*component_, TEXT("!move!#a long first option,b,c#"), options);
+			TestEqual(TEXT("First options"), options.Num(), 3);
+
+			FTwitchPlayTestAccess::GetCommandOptionsStrings(*component_, TEXT("!move!#,up,#"), options);
+			TestEqual(TEXT("Second options"), options.Num(), 1);
+			if (options.Num() == 1)
+			{
+				TestEqual(TEXT("Overwritten option"), options[0], FString(TEXT("up")));
+			}
+
+			FTwitchPlayTestAccess::GetCommandOptionsStrings(*component_, TEXT("!jump!"), options);
+			TestEqual(TEXT("Emptied"), options.Num(), 0);
+		});
+	});
+
+	Describe("Dispatch", [this]()
+	{
+		BeforeEach([this]()
+		{
+			RegisterCommands();
+		});
+
+		It("fires a registered command with its options", [this]()
+		{
+			Receive(TEXT("!say!#hello,world#"), TEXT("viewer"), 42);
+			TestEqual(TEXT("Commands"), receiver_->num_commands_, 1);
+			TestEqual(TEXT("Command"), receiver_->last_command_name_, FString(TEXT("say")));
+			TestEqual(TEXT("Options"), receiver_->last_options_.Num(), 2);
+			TestEqual(TEXT("Username"), receiver_->last_username_, FString(TEXT("viewer")));
+			TestEqual(TEXT("Handle"), receiver_->last_user_handle_, 42);
+		});
+
+		It("finds commands in the middle of chat", [this]()
+		{
+			Receive(TEXT("gg !jump! lol"));
+			TestEqual(TEXT("Commands"), receiver_->num_commands_, 1);
+			TestEqual(TEXT("Command"), receiver_->last_command_name_, FString(TEXT("jump")));
+		});
+
+		It("ignores chat without a registered command", [this]()
+		{
+			Receive(TEXT(""));
+			Receive(TEXT("hello chat"));
+			Receive(TEXT("!unknown!#1#"));
+			Receive(TEXT("!jum!"));
+			Receive(TEXT("!jumping!"));
+			Receive(TEXT("!jump"));
+			Receive(TEXT("!JUMP!"));
+			TestEqual(TEXT("Commands"), receiver_->num_commands_ + receiver_->num_typed_commands_, 0);
+		});
+
+		It("fires typed commands with their arguments", [this]()
+		{
+			Receive(TEXT("!move!#left,3#"));
+			TestEqual(TEXT("Typed commands"), receiver_->num_typed_commands_, 1);
+			TestEqual(TEXT("Arguments"), receiver_->last_args_.num_args_, 2);
+			TestEqual(TEXT("Direction"), receiver_->last_args_.GetInt(0), static_cast<int32>(ETwitchCommandDirection::Left));
+			TestEqual(TEXT("Amount"), receiver_->last_args_.GetInt(1), 3);
+
+			Receive(TEXT("!move!# up #"));
+			TestEqual(TEXT("Typed commands"), receiver_->num_typed_commands_, 2);
+			TestEqual(TEXT("Optional argument left out"), receiver_->last_args_.num_args_, 1);
+			TestEqual(TEXT("Direction"), receiver_->last_args_.GetInt(0), static_cast<int32>(ETwitchCommandDirection::Up));
+		});
+
+		It("drops typed commands not matching their schema", [this]()
+		{
+			Receive(TEXT("!move!#sideways,3#"));
+			Receive(TEXT("!move!"));
+			Receive(TEXT("!attack!#9#"));
+			Receive(TEXT("!attack!#two#"));
+			TestEqual(TEXT("Typed commands"), receiver_->num_typed_commands_, 0);
+
+			Receive(TEXT("!attack!#5#"));
+			TestEqual(TEXT("Typed commands"), receiver_->num_typed_commands_, 1);
+		});
+
+		It("stops firing unregistered commands", [this]()
+		{
+			FString result;
+			TestTrue(TEXT("Unregistered"), component_->UnregisterCommand(TEXT("jump"), result));
+			Receive(TEXT("!jump!"));
+			Receive(TEXT("!say!"));
+			TestEqual(TEXT("Commands"), receiver_->num_commands_, 1);
+		});
+
+		It("skips ignored users", [this]()
+		{
+			component_->IgnoreUser(TEXT("Spammer"));
+			Receive(TEXT("!jump!"), TEXT("spammer"), 3);
+			TestEqual(TEXT("Commands of the ignored user"), receiver_->num_commands_, 0);
+
+			component_->UnignoreUser(TEXT("spammer"));
+			Receive(TEXT("!jump!"), TEXT("spammer"), 3);
+			TestEqual(TEXT("Commands once unignored"), receiver_->num_commands_, 1);
+		});
+
+		It("throttles flooding users", [this]()
+		{
+			component_->b_throttle_users_ = true;
+			component_->user_commands_per_window_ = 2.0f;
+			component_->duplicate_window_seconds_ = 0.0f;
+			for (int32 cycle_message = 0; cycle_message < 5; ++cycle_message)
+			{
+				Receive(TEXT("!jump!"), TEXT("flooder"), 11);
+			}
+			TestEqual(TEXT("Commands of the flooder"), receiver_->num_commands_, 2);
+
+			Receive(TEXT("!jump!"), TEXT("viewer"), 12);
+			TestEqual(TEXT("Commands of someone else"), receiver_->num_commands_, 3);
+		});
+
+		It("survives the adversarial corpus", [this]()
+		{
+			const FTwitchPlayTestCorpus corpus = FTwitchPlayTestCorpus::Make(ETwitchPlayTestCorpus::Adversarial, 64);
+			for (int32 cycle_content = 0; cycle_content < corpus.contents_.Num(); ++cycle_content)
+			{
+				Receive(corpus.contents_[cycle_content], corpus.usernames_[cycle_content], cycle_content);
+			}
+			TestEqual(TEXT("Only well formed commands fired"), receiver_->num_typed_commands_, 0);
+		});
+	});
+
+	Describe("FTwitchVoteAggregator", [this]()
+	{
+		const TArray<FString> command_names = { TEXT("move"), TEXT("jump") };
+		auto get_command_name = [command_names](int32 _command_index) -> const FString& { return command_names[_command_index]; };
+
+		It("elects the most voted, ties going to the first voted", [this, get_command_name]()
+		{
+			FTwitchVoteAggregator aggregator;
+			aggregator.SetRules(ETwitchVotePolicy::Democracy, ETwitchVoteUserRule::MultipleVotes);
+			aggregator.Vote(1, FString(), 1);
+			aggregator.Vote(0, TEXT("left"), 2);
+			aggregator.Vote(0, TEXT("left"), 3);
+			aggregator.Vote(0, TEXT("right"), 4);
+			aggregator.Vote(1, FString(), 5);
+
+			FTwitchVoteWindowResult result;
+			aggregator.CloseWindow(get_command_name, 1.0f, result);
+			TestEqual(TEXT("Total votes"), result.total_votes_, 5);
+			TestEqual(TEXT("Tallies"), result.tallies_.Num(), 3);
+			if (result.tallies_.Num() == 3 && result.winner_index_ != INDEX_NONE)
+			{
+				TestEqual(TEXT("Tie goes to the first voted"), result.tallies_[result.winner_index_].command_, FString(TEXT("jump")));
+				TestEqual(TEXT("Most voted first"), result.tallies_[0].votes_, 2);
+				TestEqual(TEXT("Least voted last"), result.tallies_[2].options_, FString(TEXT("right")));
+			}
+		});
+
+		It("elects the latest vote in anarchy", [this, get_command_name]()
+		{
+			FTwitchVoteAggregator aggregator;
+			aggregator.SetRules(ETwitchVotePolicy::Anarchy, ETwitchVoteUserRule::MultipleVotes);
+			aggregator.Vote(0, TEXT("left"), 1);
+			aggregator.Vote(0, TEXT("left"), 2);
+			aggregator.Vote(1, FString(), 3);
+
+			FTwitchVoteWindowResult result;
+			aggregator.CloseWindow(get_command_name, 1.0f, result);
+			TestTrue(TEXT("Winner"), result.tallies_.IsValidIndex(result.winner_index_));
+			if (result.tallies_.IsValidIndex(result.winner_index_))
+			{
+				TestEqual(TEXT("Latest vote wins"), result.tallies_[result.winner_index_].command_, FString(TEXT("jump")));
+			}
+		});
+
+		It("keeps only the first vote of each user", [this, get_command_name]()
+		{
+			FTwitchVoteAggregator aggregator;
+			aggregator.SetRules(ETwitchVotePolicy::Democracy, ETwitchVoteUserRule::FirstVoteOnly);
+			aggregator.Vote(0, TEXT("left"), 1);
+			aggregator.Vote(1, FString(), 1);
+			aggregator.Vote(1, FString(), 1);
+
+			FTwitchVoteWindowResult result;
+			aggregator.CloseWindow(get_command_name, 1.0f, result);
+			TestEqual(TEXT("Total votes"), result.total_votes_, 1);
+			TestEqual(TEXT("Ignored votes"), result.ignored_votes_, 2);
+			TestEqual(TEXT("Tallies"), result.tallies_.Num(), 1);
+		});
+
+		It("moves the vote of a user to the latest one", [this, get_command_name]()
+		{
+			FTwitchVoteAggregator aggregator;
+			aggregator.SetRules(ETwitchVotePolicy::Democracy, ETwitchVoteUserRule::LastVoteCounts);
+			aggregator.Vote(0, TEXT("left"), 1);
+			aggregator.Vote(0, TEXT("left"), 2);
+			aggregator.Vote(1, FString(), 1);
+			aggregator.Vote(1, FString(), 2);
+
+			FTwitchVoteWindowResult result;
+			aggregator.CloseWindow(get_command_name, 1.0f, result);
+			TestEqual(TEXT("Total votes"), result.total_votes_, 2);
+			TestEqual(TEXT("Emptied tally not reported"), result.tallies_.Num(), 1);
+			if (result.tallies_.Num() == 1)
+			{
+				TestEqual(TEXT("Moved votes"), result.tallies_[0].votes_, 2);
+				TestEqual(TEXT("Winner"), result.winner_index_, 0);
+			}
+		});
+
+		It("compares options by their chars", [this, get_command_name]()
+		{
+			FTwitchVoteAggregator aggregator;
+			const FString message = TEXT("!move!#left#");
+			aggregator.Vote(0, *message + 7, 4, 1);
+			aggregator.Vote(0, TEXT("left"), 2);
+			aggregator.Vote(0, *message + 7, 3, 3);
+
+			FTwitchVoteWindowResult result;
+			aggregator.CloseWindow(get_command_name, 1.0f, result);
+			TestEqual(TEXT("Tallies"), result.tallies_.Num(), 2);
+			if (result.tallies_.Num() == 2)
+			{
+				TestEqual(TEXT("Same options from a span"), result.tallies_[0].votes_, 2);
+				TestEqual(TEXT("Options copied from the span"), result.tallies_[1].options_, FString(TEXT("lef")));
+			}
+		});
+
+		It("ignores new combinations past the capacity", [this, get_command_name]()
+		{
+			FTwitchVoteAggregator aggregator;
+			for (int32 cycle_vote = 0; cycle_vote < 300; ++cycle_vote)
+			{
+				aggregator.Vote(0, FString::FromInt(cycle_vote), cycle_vote);
+			}
+			aggregator.Vote(0, TEXT("0"), 1000); // Already tallied, still counted
+
+			FTwitchVoteWindowResult result;
+			aggregator.CloseWindow(get_command_name, 1.0f, result);
+			TestEqual(TEXT("Tallies"), result.tallies_.Num(), 256);
+			TestEqual(TEXT("Total votes"), result.total_votes_, 257);
+			TestEqual(TEXT("Ignored votes"), result.ignored_votes_, 44);
+		});
+
+		It("starts a clean window once closed", [this, get_command_name]()
+		{
+			FTwitchVoteAggregator aggregator;
+			aggregator.SetRules(ETwitchVotePolicy::Democracy, ETwitchVoteUserRule::FirstVoteOnly);
+			aggregator.Vote(0, TEXT("left"), 1);
+			aggregator.Vote(0, TEXT("right"), 1);
+
+			FTwitchVoteWindowResult result;
+			aggregator.CloseWindow(get_command_name, 1.0f, result);
+			aggregator.CloseWindow(get_command_name, 2.0f, result);
+			TestEqual(TEXT("No votes"), result.total_votes_, 0);
+			TestEqual(TEXT("No ignored votes"), result.ignored_votes_, 0);
+			TestEqual(TEXT("No tallies"), result.tallies_.Num(), 0);
+			TestEqual(TEXT("No winner"), result.winner_index_, static_cast<int32>(INDEX_NONE));
+			TestEqual(TEXT("Duration"), result.window_duration_, 2.0f);
+
+			// The user rule starts over too
+			aggregator.Vote(0, TEXT("right"), 1);
+			TestEqual(TEXT("User votes again"), aggregator.GetTotalVotes(), 1);
+		});
+	});
+
+	Describe("FTwitchKeywordMatcher", [this]()
+	{
+		It("finds every keyword in a single pass", [this]()
+		{
+			FTwitchKeywordMatcher matcher;
+			matcher.Build({ TEXT("Kappa"), TEXT("pog champ"), TEXT("he"), TEXT("hello") }, false, false);
+
+			TArray<FTwitchKeywordHit> hits;
+			const FString text = TEXT("KAPPA hello POG CHAMP");
+			TestEqual(TEXT("Hits"), matcher.Scan(*text, text.Len(), hits), 4);
+			if (hits.Num() == 4)
+			{
+				TestEqual(TEXT("Kappa"), hits[0].keyword_index_, 0);
+				TestEqual(TEXT("Overlapping he"), hits[1].keyword_index_, 2);
+				TestEqual(TEXT("Overlapping hello"), hits[2].keyword_index_, 3);
+				TestEqual(TEXT("Phrase start"), hits[3].start_, 12);
+				TestEqual(TEXT("Phrase length"), hits[3].length_, 9);
+			}
+		});
+
+		It("respects case and word boundaries", [this]()
+		{
+			FTwitchKeywordMatcher matcher;
+			matcher.Build({ TEXT("Kappa") }, true, true);
+
+			TArray<FTwitchKeywordHit> hits;
+			const FString text = TEXT("kappa KappaPride Kappa, Kappa");
+			TestEqual(TEXT("Hits"), matcher.Scan(*text, text.Len(), hits), 2);
+		});
+
+		It("finds nothing without keywords", [this]()
+		{
+			FTwitchKeywordMatcher matcher;
+			matcher.Build({ TEXT("") }, false, true);
+			TArray<FTwitchKeywordHit> hits;
+			TestTrue(TEXT("Empty"), matcher.IsEmpty());
+			TestEqual(TEXT("Hits"), matcher.Scan(TEXT("anything"), 8, hits), 0);
+		});
+	});
+
+	Describe("FTwitchTrendTracker", [this]()
+	{
+		It("never underestimates, and overestimates within the sketch bound", [this]()
+		{
+			const int32 sketch_width = 1024;
+			FTwitchTrendTracker tracker(32, sketch_width);
+			tracker.SetWindow(60.0f);
+
+			// 1000 keys seen 1 to 10 times
+			const int32 num_keys = 1000;
+			int32 total_count = 0;
+			for (int32 cycle_key = 0; cycle_key < num_keys; ++cycle_key)
+			{
+				AddTrend(tracker, cycle_key, 0.0, cycle_key % 10 + 1);
+				total_count += cycle_key % 10 + 1;
+			}
+
+			const double error_bound = 2.7 * total_count / sketch_width;
+			int32 num_under = 0;
+			int32 num_over_bound = 0;
+			for (int32 cycle_key = 0; cycle_key < num_keys; ++cycle_key)
+			{
+				const int32 error = tracker.GetCount(cycle_key, 0.0) - (cycle_key % 10 + 1);
+				num_under += error < 0 ? 1 : 0;
+				num_over_bound += error > error_bound ? 1 : 0;
+			}
+			TestEqual(TEXT("Underestimated keys"), num_under, 0);
+
+			// The bound holds for each key with a probability of 1 - e^-4 (4 rows)
+			TestTrue(FString::Printf(TEXT("Keys past the bound (%d)"), num_over_bound), num_over_bound <= num_keys / 50);
+		});
+
+		It("forgets the slices leaving the window", [this]()
+		{
+			// Slices of one second
+			FTwitchTrendTracker tracker(8, 1024, 4);
+			tracker.SetWindow(4.0f);
+
+			AddTrend(tracker, 1, 0.0, 3);
+			AddTrend(tracker, 1, 1.5, 2);
+			TestEqual(TEXT("Both slices in the window"), tracker.GetCount(1, 3.5), 5);
+			TestEqual(TEXT("First slice gone"), tracker.GetCount(1, 4.5), 2);
+			TestEqual(TEXT("Top entry refreshed"), GetTopTrends(tracker, 4.5), FString(TEXT("key1:2")));
+			TestEqual(TEXT("Second slice gone"), tracker.GetCount(1, 5.5), 0);
+			TestEqual(TEXT("Top entry dropped"), GetTopTrends(tracker, 5.5), FString());
+
+			AddTrend(tracker, 2, 100.0);
+			TestEqual(TEXT("Counting again after a long pause"), tracker.GetCount(2, 100.0), 1);
+			TestEqual(TEXT("Nothing left from before"), tracker.GetCount(1, 100.0), 0);
+		});
+
+		It("evicts the lowest top entry for a key seen more", [this]()
+		{
+			FTwitchTrendTracker tracker(2, 1024, 4);
+			tracker.SetWindow(4.0f);
+
+			AddTrend(tracker, 1, 0.0, 5);
+			AddTrend(tracker, 2, 0.0, 3);
+			AddTrend(tracker, 3, 0.0, 3);
+			TestEqual(TEXT("Not seen more than the lowest entry"), GetTopTrends(tracker, 0.0), FString(TEXT("key1:5 key2:3")));
+
+			AddTrend(tracker, 3, 0.0);
+			TestEqual(TEXT("Seen more than the lowest entry"), GetTopTrends(tracker, 0.0), FString(TEXT("key1:5 key3:4")));
+		});
+
+		It("refreshes the lowest top entry before evicting it", [this]()
+		{
+			FTwitchTrendTracker tracker(2, 1024, 4);
+			tracker.SetWindow(4.0f);
+
+			AddTrend(tracker, 1, 0.0, 5);
+			AddTrend(tracker, 1, 1.5);
+			AddTrend(tracker, 2, 1.5, 4);
+			TestEqual(TEXT("Top entries"), GetTopTrends(tracker, 1.5), FString(TEXT("key1:6 key2:4")));
+
+			// Most of key 1 left the window with the first slice: a key seen twice since takes its place
+			AddTrend(tracker, 3, 4.5, 2);
+			TestEqual(TEXT("Stale entry evicted"), GetTopTrends(tracker, 4.5), FString(TEXT("key2:4 key3:2")));
+		});
+
+		It("names emotes after their code point range", [this]()
+		{
+			component_->b_track_trends_ = true;
+
+			// The emoji before the emotes is past the BMP: one code point for Twitch, a surrogate pair in UTF-16
+			FString content;
+			if (sizeof(TCHAR) == 2)
+			{
+				content.AppendChar(static_cast<TCHAR>(0xD83D));
+				content.AppendChar(static_cast<TCHAR>(0xDE00));
+			}
+			else
+			{
+				content.AppendChar(static_cast<TCHAR>(0x1F600));
+			}
+			content += TEXT(" Kappa Kappa");
+
+			const ANSICHAR* const tags = "emotes=25:2-6,8-12";
+			FTwitchIRCReceivedMessage message;
+			message.content_ = content;
+			message.raw_tags_ = FTwitchIRCStringView(tags, FCStringAnsi::Strlen(tags));
+			FTwitchPlayTestAccess::DispatchMessage(*component_, message, INDEX_NONE);
+
+			TArray<FTwitchTrendEntry> entries;
+			component_->GetTrending(ETwitchTrendCategory::Emotes, 10, entries);
+			TestEqual(TEXT("Emotes"), entries.Num(), 1);
+			if (entries.Num() == 1)
+			{
+				TestEqual(TEXT("Name"), entries[0].name_, FString(TEXT("Kappa")));
+				TestEqual(TEXT("Uses"), entries[0].count_, 2);
+			}
+		});
+	});
+
+	Describe("FTwitchCommandBatch", [this]()
+	{
+		It("round trips commands", [this]()
+		{
+			FTwitchCommandBatch batch;
+			FTwitchBatchedCommand command;
+			command.command_name_ = TEXT("say");
+			command.user_handle_ = 100;
+			command.username_ = TEXT("viewer");
+			command.options_ = TEXT("hello,world");
+			TestTrue(TEXT("Added untyped"), batch.Add(command, 1024));
+
+			command.command_name_ = TEXT("move");
+			command.user_handle_ = 90;
+			command.username_ = TEXT("other_viewer");
+			command.b_typed_ = true;
+			command.args_.num_args_ = 2;
+			command.args_.int_values_[0] = 2;
+			command.args_.float_values_[0] = 2.0f;
+			command.args_.int_values_[1] = -1;
+			command.args_.float_values_[1] = -1.25f;
+			TestTrue(TEXT("Added typed"), batch.Add(command, 1024));
+
+			command.user_handle_ = 100;
+			command.username_ = TEXT("viewer");
+			TestTrue(TEXT("Added repeated"), batch.Add(command, 1024));
+
+			TArray<FTwitchBatchedCommand> commands;
+			TestTrue(TEXT("Decoded"), RoundTrip(batch, commands));
+			TestEqual(TEXT("Commands"), commands.Num(), 3);
+			if (commands.Num() == 3)
+			{
+				TestEqual(TEXT("Untyped name"), commands[0].command_name_, FString(TEXT("say")));
+				TestEqual(TEXT("Untyped options"), commands[0].options_, FString(TEXT("hello,world")));
+				TestFalse(TEXT("Untyped"), commands[0].b_typed_);
+				TestEqual(TEXT("Handle"), commands[1].user_handle_, 90);
+				TestEqual(TEXT("Username"), commands[1].username_, FString(TEXT("other_viewer")));
+				TestTrue(TEXT("Typed"), commands[1].b_typed_);
+				TestEqual(TEXT("Arguments"), commands[1].args_.num_args_, 2);
+				TestEqual(TEXT("Int argument"), commands[1].args_.GetInt(0), 2);
+				TestEqual(TEXT("Float argument"), commands[1].args_.GetFloat(1), -1.25f);
+				TestEqual(TEXT("Repeated username"), commands[2].username_, FString(TEXT("viewer")));
+				TestEqual(TEXT("Repeated name"), commands[2].command_name_, FString(TEXT("move")));
+			}
+		});
+
+		It("keeps under its budget", [this]()
+		{
+			FTwitchCommandBatch batch;
+			FTwitchBatchedCommand command;
+			command.command_name_ = TEXT("say");
+			command.user_handle_ = 1;
+			command.username_ = TEXT("viewer");
+			command.options_ = FString::ChrN(100, 'x');
+			TestTrue(TEXT("First fits"), batch.Add(command, 128));
+			TestFalse(TEXT("Second doesn't"), batch.Add(command, 128));
+			TestEqual(TEXT("Commands"), batch.Num(), 1);
+			TestTrue(TEXT("Size"), batch.GetNumBytes() <= 128);
+
+			TArray<FTwitchBatchedCommand> commands;
+			TestTrue(TEXT("Still decodes"), RoundTrip(batch, commands));
+			TestEqual(TEXT("Decoded commands"), commands.Num(), 1);
+		});
+
+		It("fills up to its budget and leaves the rest for the next batch", [this]()
+		{
+			// The biggest batch a component can be set to send
+			const int32 max_bytes = 16384;
+			FTwitchCommandBatch batch;
+			FTwitchBatchedCommand command;
+			command.command_name_ = TEXT("say");
+			command.options_ = FString::ChrN(200, 'x');
+
+			int32 num_added = 0;
+			while (num_added < 1000)
+			{
+				command.user_handle_ = num_added;
+				command.username_ = FString::Printf(TEXT("viewer_%d"), num_added);
+				if (!batch.Add(command, max_bytes))
+				{
+					break;
+				}
+				++num_added;
+			}
+			TestTrue(TEXT("Filled"), num_added > 0 && num_added < 1000);
+			TestEqual(TEXT("Commands"), batch.Num(), num_added);
+			TestTrue(TEXT("Within the budget"), batch.GetNumBytes() <= max_bytes);
+			TestTrue(TEXT("Nearly full"), batch.GetNumBytes() > max_bytes - 256);
+			TestTrue(TEXT("Under what clients accept"), batch.GetNumBytes() <= FTwitchCommandBatch::MaxReceivedBytes);
+
+			// The command that didn't fit left nothing behind
+			TArray<FTwitchBatchedCommand> commands;
+			TestTrue(TEXT("Decoded"), RoundTrip(batch, commands));
+			TestEqual(TEXT("Decoded commands"), commands.Num(), num_added);
+			if (commands.Num() > 0)
+			{
+				TestEqual(TEXT("Last username"), commands.Last().username_, FString::Printf(TEXT("viewer_%d"), num_added - 1));
+			}
+		});
+
+		It("accepts up to 64KB of commands", [this]()
+		{
+			TestEqual(TEXT("Cap"), FTwitchCommandBatch::MaxReceivedBytes, 64 * 1024);
+
+			for (const int32 num_bytes : { FTwitchCommandBatch::MaxReceivedBytes, FTwitchCommandBatch::MaxReceivedBytes + 1 })
+			{
+				TArray<uint8> bytes;
+				FMemoryWriter writer(bytes);
+				uint32 num_commands = 1;
+				uint32 num_written_bytes = static_cast<uint32>(num_bytes);
+				writer.SerializeIntPacked(num_commands);
+				writer.SerializeIntPacked(num_written_bytes);
+				TArray<uint8> data;
+				data.SetNumZeroed(num_bytes);
+				writer.Serialize(data.GetData(), num_bytes);
+
+				FTwitchCommandBatch batch;
+				FMemoryReader reader(bytes);
+				bool b_success = false;
+				batch.NetSerialize(reader, nullptr, b_success);
+				const bool b_should_succeed = num_bytes <= FTwitchCommandBatch::MaxReceivedBytes;
+				TestTrue(FString::Printf(TEXT("Batch of %d bytes received as expected"), num_bytes), b_success == b_should_succeed);
+				TestEqual(FString::Printf(TEXT("Batch of %d bytes kept"), num_bytes), batch.GetNumBytes(), b_should_succeed ? num_bytes : 0);
+			}
+		});
+
+		It("fails on truncated batches", [this]()
+		{
+			FTwitchCommandBatch batch;
+			FTwitchBatchedCommand command;
+			command.command_name_ = TEXT("say");
+			command.user_handle_ = 1;
+			command.username_ = TEXT("viewer");
+			command.options_ = TEXT("hello,world");
+			batch.Add(command, 1024);
+			batch.Add(command, 1024);
+
+			TArray<uint8> bytes;
+			FMemoryWriter writer(bytes);
+			bool b_success = false;
+			batch.NetSerialize(writer, nullptr, b_success);
+			bytes.SetNum(bytes.Num() - 4);
+
+			FTwitchCommandBatch received_batch;
+			FMemoryReader reader(bytes);
+			received_batch.NetSerialize(reader, nullptr, b_success);
+			TestFalse(TEXT("Truncated batch received"), b_success);
+		});
+
+		It("rejects malformed batches", [this]()
+		{
+			// Bigger than any batch sent
+			{
+				TArray<uint8> bytes;
+				FMemoryWriter writer(bytes);
+				uint32 num_commands = 1;
+				uint32 num_bytes = 1 << 20;
+				writer.SerializeIntPacked(num_commands);
+				writer.SerializeIntPacked(num_bytes);
+
+				FTwitchCommandBatch batch;
+				FMemoryReader reader(bytes);
+				bool b_success = true;
+				batch.NetSerialize(reader, nullptr, b_success);
+				TestFalse(TEXT("Oversized batch"), b_success);
+			}
+
+			// Truncated varints
+			{
+				TArray<uint8> bytes;
+				FMemoryWriter writer(bytes);
+				uint32 num_commands = 3;
+				uint32 num_bytes = 4;
+				writer.SerializeIntPacked(num_commands);
+				writer.SerializeIntPacked(num_bytes);
+				uint8 garbage[4] = { 0xFF, 0xFF, 0xFF, 0xFF };
+				writer.Serialize(garbage, 4);
+
+				FTwitchCommandBatch batch;
+				FMemoryReader reader(bytes);
+				bool b_success = false;
+				batch.NetSerialize(reader, nullptr, b_success);
+				int32 num_decoded = 0;
+				TestFalse(TEXT("Garbage decoded"), batch.ForEachCommand([&num_decoded](const FTwitchBatchedCommand&) { ++num_decoded; }));
+				TestEqual(TEXT("Commands reported"), num_decoded, 0);
+			}
+		});
+	});
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS
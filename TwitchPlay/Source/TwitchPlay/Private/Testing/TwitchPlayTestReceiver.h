@@ -0,0 +1,67 @@
+// Copyright (C) Simone Di Gravio <email: altairjp@gmail.com> - All Rights Reserved
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "UObject/Object.h"
+#include "Commands/TwitchCommandSchema.h"
+#include "Net/TwitchIRCMessageBatch.h"
+#include "TwitchPlayTestReceiver.generated.h"
+
+/**
+ * Receives the command and message events in the automation tests and benchmarks. Dynamic delegates can only be bound to UFUNCTIONs.
+ */
+UCLASS(Transient)
+class UTwitchPlayTestReceiver : public UObject
+{
+	GENERATED_BODY()
+
+public:
+
+	UFUNCTION()
+		void OnCommand(const FString& _command_name, const TArray<FString>& _command_options, const FString& _sender_username, int32 _sender_handle);
+
+	UFUNCTION()
+		void OnTypedCommand(const FString& _command_name, const FTwitchCommandArgs& _command_args, const FString& _sender_username, int32 _sender_handle);
+
+	UFUNCTION()
+		void OnMessage(const FString& _message, const FString& _username, int32 _user_handle);
+
+	UFUNCTION()
+		void OnMessagesBatch(const FTwitchMessageBatch& _batch);
+
+	UFUNCTION()
+		void OnInboundQueueReport(int32 _shed_messages, int32 _deferred_messages);
+
+	// Forgets the commands and messages received
+	void Reset();
+
+	int32 num_commands_ = 0;
+
+	int32 num_typed_commands_ = 0;
+
+	// Last command received, typed or not
+	FString last_command_name_;
+
+	TArray<FString> last_options_;
+
+	FTwitchCommandArgs last_args_;
+
+	FString last_username_;
+
+	int32 last_user_handle_ = INDEX_NONE;
+
+	// Contents of the messages received, in order
+	TArray<FString> messages_;
+
+	// Copies of the batches received, one per frame with messages
+	TArray<FTwitchMessageBatch> batches_;
+
+	// Time OnMessage() keeps the thread busy, to make dispatching slow
+	double message_cost_seconds_ = 0.0;
+
+	// Sums of the inbound queue reports
+	int32 shed_messages_ = 0;
+
+	int32 deferred_messages_ = 0;
+};
@@ -0,0 +1,396 @@
+// Copyright (C) Simone Di Gravio <email: altairjp@gmail.com> - All Rights Reserved
+
+#include "Testing/TwitchPlayTestUtils.h"
+#include "Testing/TwitchPlayTestReceiver.h"
+
+void UTwitchPlayTestReceiver::OnCommand(const FString& _command_name, const TArray<FString>& _command_options, const FString& _sender_username, int32 _sender_handle)
+{
+	++num_commands_;
+	last_command_name_ = _command_name;
+	last_options_ = _command_options;
+	last_username_ = _sender_username;
+	last_user_handle_ = _sender_handle;
+}
+
+void UTwitchPlayTestReceiver::OnTypedCommand(const FString& _command_name, const FTwitchCommandArgs& _command_args, const FString& _sender_username, int32 _sender_handle)
+{
+	++num_typed_commands_;
+	last_command_name_ = _command_name;
+	last_args_ = _command_args;
+	last_username_ = _sender_username;
+	last_user_handle_ = _sender_handle;
+}
+
+void UTwitchPlayTestReceiver::OnMessage(const FString& _message, const FString& _username, int32 _user_handle)
+{
+	messages_.Add(_message);
+	const double busy_end_time = FPlatformTime::Seconds() + message_cost_seconds_;
+	while (FPlatformTime::Seconds() < busy_end_time)
+	{
+	}
+}
+
+void UTwitchPlayTestReceiver::OnMessagesBatch(const FTwitchMessageBatch& _batch)
+{
+	batches_.Add(_batch);
+}
+
+void UTwitchPlayTestReceiver::OnInboundQueueReport(int32 _shed_messages, int32 _deferred_messages)
+{
+	shed_messages_ += _shed_messages;
+	deferred_messages_ += _deferred_messages;
+}
+
+void UTwitchPlayTestReceiver::Reset()
+{
+	num_commands_ = 0;
+	num_typed_commands_ = 0;
+	last_command_name_.Reset();
+	last_options_.Reset();
+	last_args_ = FTwitchCommandArgs();
+	last_username_.Reset();
+	last_user_handle_ = INDEX_NONE;
+	messages_.Reset();
+	batches_.Reset();
+	message_cost_seconds_ = 0.0;
+	shed_messages_ = 0;
+	deferred_messages_ = 0;
+}
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+#include "Components/TwitchPlayComponent.h"
+#include "Net/TwitchIRCConnectionManager.h"
+#include "Net/TwitchIRCLine.h"
+#include "Net/TwitchIRCCapture.h"
+#include "Math/RandomStream.h"
+#include "HAL/MemoryBase.h"
+#include "HAL/PlatformTLS.h"
+
+namespace
+{
+	const TCHAR* const Words[] =
+	{
+		TEXT("hello"), TEXT("chat"), TEXT("lol"), TEXT("gg"), TEXT("this"), TEXT("is"), TEXT("so"), TEXT("good"), TEXT("what"),
+		TEXT("a"), TEXT("play"), TEXT("wow"), TEXT("nice"), TEXT("the"), TEXT("boss"), TEXT("go"), TEXT("left"), TEXT("right"),
+		TEXT("pog"), TEXT("streamer"), TEXT("when"), TEXT("next"), TEXT("game"), TEXT("hype"), TEXT("no"), TEXT("way"), TEXT("!")
+	};
+
+	const TCHAR* const Commands[] =
+	{
+		TEXT("!move!#left,3#"), TEXT("!move!#up#"), TEXT("!move! #right, 2#"), TEXT("!move!#sideways,3#"), TEXT("!jump!"),
+		TEXT("!attack!#2#"), TEXT("!attack!#9#"), TEXT("!vote!#a#"), TEXT("!say!#hello,world#"), TEXT("gg !jump! lol"),
+		TEXT("!unknown!#1#"), TEXT("!mov!"), TEXT("!move!#down,1,extra#")
+	};
+
+	const int32 NumUsers = 64;
+
+	FString MakeUsername(int32 _user_index)
+	{
+		return FString::Printf(TEXT("viewer_%d"), _user_index);
+	}
+
+	FString MakeWords(FRandomStream& _random, int32 _min_words, int32 _max_words)
+	{
+		FString content;
+		const int32 num_words = _random.RandRange(_min_words, _max_words);
+		for (int32 cycle_word = 0; cycle_word < num_words; ++cycle_word)
+		{
+			if (cycle_word > 0)
+			{
+				content.AppendChar(' ');
+			}
+			content += Words[_random.RandRange(0, ARRAY_COUNT(Words) - 1)];
+		}
+		return content;
+	}
+
+	FString MakePrivmsg(const FString& _username, const FString& _content)
+	{
+		return FString::Printf(TEXT(":%s!%s@%s.tmi.twitch.tv PRIVMSG #twitchplay :%s"), *_username, *_username, *_username, *_content);
+	}
+
+	TArray<FString> MakeAdversarialLines()
+	{
+		TArray<FString> lines;
+		lines.Add(TEXT(""));
+		lines.Add(TEXT(" "));
+		lines.Add(TEXT("PING"));
+		lines.Add(TEXT("JOIN"));
+		lines.Add(TEXT(":"));
+		lines.Add(TEXT("::::::"));
+		lines.Add(TEXT("@"));
+		lines.Add(TEXT("@a=b"));
+		lines.Add(TEXT("@a=b;c=\\s\\:\\\\;d :nick!nick@nick PRIVMSG #twitchplay :escaped tags"));
+		lines.Add(TEXT("@;;;=;; :nick!nick@nick PRIVMSG #twitchplay :x"));
+		lines.Add(TEXT(": PRIVMSG #twitchplay :no prefix"));
+		lines.Add(TEXT("PRIVMSG"));
+		lines.Add(TEXT("PRIVMSG #twitchplay"));
+		lines.Add(TEXT("PRIVMSG #twitchplay :"));
+		lines.Add(TEXT(":nick!nick@nick PRIVMSG #twitchplay ::::"));
+		lines.Add(TEXT(":nick!nick@nick PRIVMSG #twitchplay :!move!#"));
+		lines.Add(TEXT(":nick!nick@nick PRIVMSG #twitchplay :!!!!!!!!!!!!!!!!"));
+		lines.Add(TEXT(":nick!nick@nick PRIVMSG #twitchplay :########"));
+		lines.Add(TEXT(":nick!nick@nick PRIVMSG #twitchplay :!move!#,,,,,,,,,,,,#"));
+		lines.Add(TEXT("CMD a b c d e f g h i j k l m n o p q r s t :too many parameters"));
+		lines.Add(TEXT("      PRIVMSG     #twitchplay     :spaced out"));
+		lines.Add(TEXT(":nick!nick@nick PRIVMSG #twitchplay :\u3053\u3093\u306B\u3061\u306F !move!#\u5DE6#"));
+
+		FString emoji = TEXT(":nick!nick@nick PRIVMSG #twitchplay :");
+		emoji.AppendChar(0xD83D);
+		emoji.AppendChar(0xDE00);
+		emoji += TEXT(" !jump! ");
+		emoji.AppendChar(0xD800); // Lone surrogate
+		lines.Add(emoji);
+
+		lines.Add(MakePrivmsg(TEXT("nick"), FString::ChrN(4000, '!')));
+		lines.Add(TEXT("@long=") + FString::ChrN(2000, 'x') + TEXT(" :nick!nick@nick PRIVMSG #twitchplay :long tag"));
+		return lines;
+	}
+
+	class FCountingMalloc : public FMalloc
+	{
+	public:
+
+		virtual void* Malloc(SIZE_T _count, uint32 _alignment) override
+		{
+			Count();
+			return inner_->Malloc(_count, _alignment);
+		}
+
+		virtual void* Realloc(void* _original, SIZE_T _count, uint32 _alignment) override
+		{
+			// Growing can move the block: it counts as an allocation
+			if (_count > 0)
+			{
+				Count();
+			}
+			return inner_->Realloc(_original, _count, _alignment);
+		}
+
+		virtual void Free(void* _original) override { inner_->Free(_original); }
+
+		virtual bool GetAllocationSize(void* _original, SIZE_T& _out_size) override { return inner_->GetAllocationSize(_original, _out_size); }
+
+		virtual SIZE_T QuantizeSize(SIZE_T _count, uint32 _alignment) override { return inner_->QuantizeSize(_count, _alignment); }
+
+		virtual void Trim() override { inner_->Trim(); }
+
+		virtual void SetupTLSCachesOnCurrentThread() override { inner_->SetupTLSCachesOnCurrentThread(); }
+
+		virtual void ClearAndDisableTLSCachesOnCurrentThread() override { inner_->ClearAndDisableTLSCachesOnCurrentThread(); }
+
+		virtual bool IsInternallyThreadSafe() const override { return inner_->IsInternallyThreadSafe(); }
+
+		virtual bool ValidateHeap() override { return inner_->ValidateHeap(); }
+
+		virtual const TCHAR* GetDescriptiveName() override { return inner_->GetDescriptiveName(); }
+
+		FMalloc* inner_ = nullptr;
+
+		uint32 counting_thread_id_ = 0;
+
+		// Only written by the counting thread
+		int64 num_allocations_ = 0;
+
+	private:
+
+		void Count()
+		{
+			if (FPlatformTLS::GetCurrentThreadId() == counting_thread_id_)
+			{
+				++num_allocations_;
+			}
+		}
+	};
+
+	// Never destroyed: other threads can still be inside it right after GMalloc is restored
+	FCountingMalloc& GetCountingMalloc()
+	{
+		static FCountingMalloc* counting_malloc = new FCountingMalloc();
+		return *counting_malloc;
+	}
+}
+
+FString FTwitchPlayTestAccess::GetDelimitedString(const UTwitchPlayComponent& _component, const FString& _in_string, const FString& _delimiter)
+{
+	return _component.GetDelimitedString(_in_string, _delimiter);
+}
+
+TArray<FString> FTwitchPlayTestAccess::GetCommandOptionsStrings(const UTwitchPlayComponent& _component, const FString& _message)
+{
+	return _component.GetCommandOptionsStrings(_message);
+}
+
+void FTwitchPlayTestAccess::GetCommandOptionsStrings(const UTwitchPlayComponent& _component, const FString& _message, TArray<FString>& _out_options)
+{
+	_component.GetCommandOptionsStrings(_message, _out_options);
+}
+
+FTwitchIRCConnection& FTwitchPlayTestAccess::AddIdleShard(FTwitchIRCConnectionPool& _pool)
+{
+	FTwitchIRCConnection::FSettings connection_settings = _pool.settings_.connection_settings_;
+	connection_settings.rate_limiter_ = _pool.rate_limiter_;
+	connection_settings.join_limiter_ = _pool.join_limiter_;
+	connection_settings.user_registry_ = _pool.user_registry_;
+
+	FTwitchIRCConnectionPool::FShard shard;
+	shard.connection_ = MakeUnique<FTwitchIRCConnection>(connection_settings);
+	FTwitchIRCConnection& connection = *shard.connection_;
+	_pool.shards_.Add(MoveTemp(shard));
+	return connection;
+}
+
+void FTwitchPlayTestAccess::ReceiveLine(FTwitchIRCConnection& _connection, const FString& _line, int32 _channel_id)
+{
+	const FTCHARToUTF8 utf8_line(*_line);
+	FTwitchIRCLine line;
+	if (line.Parse(utf8_line.Get(), utf8_line.Length()))
+	{
+		_connection.receive_cycles_ = FPlatformTime::Cycles64();
+		_connection.OnMessage(line, _channel_id);
+	}
+}
+
+void FTwitchPlayTestAccess::DispatchMessage(UTwitchIRCComponent& _component, const FTwitchIRCReceivedMessage& _message, int32 _channel_id)
+{
+	_component.DispatchMessage(_message, _channel_id);
+}
+
+FTwitchPlayTestCorpus FTwitchPlayTestCorpus::Make(ETwitchPlayTestCorpus _type, int32 _num_lines)
+{
+	FTwitchPlayTestCorpus corpus;
+	FRandomStream random(1234 + static_cast<int32>(_type));
+	corpus.lines_.Reserve(_num_lines);
+
+	switch (_type)
+	{
+	case ETwitchPlayTestCorpus::PlainChat:
+		corpus.name_ = TEXT("PlainChat");
+		for (int32 cycle_line = 0; cycle_line < _num_lines; ++cycle_line)
+		{
+			corpus.lines_.Add(MakePrivmsg(MakeUsername(random.RandRange(0, NumUsers - 1)), MakeWords(random, 3, 15)));
+		}
+		break;
+
+	case ETwitchPlayTestCorpus::TagHeavy:
+		corpus.name_ = TEXT("TagHeavy");
+		for (int32 cycle_line = 0; cycle_line < _num_lines; ++cycle_line)
+		{
+			const int32 user_index = random.RandRange(0, NumUsers - 1);
+			const FString username = MakeUsername(user_index);
+
+			// Half of the messages start with emotes, with their ranges in the tags
+			const bool b_has_emotes = random.RandRange(0, 1) == 1;
+			const FString content = (b_has_emotes ? TEXT("Kappa Keepo ") : TEXT("")) + MakeWords(random, 3, 15);
+			const FString tags = FString::Printf(
+				TEXT("@badge-info=subscriber/%d;badges=subscriber/12,bits/1000;color=#%06X;display-name=Viewer_%d;emotes=%s;first-msg=0;flags=;")
+				TEXT("id=%08x-1f2e-4d3c-8b7a-%012x;mod=0;returning-chatter=0;room-id=123456789;subscriber=1;tmi-sent-ts=%lld;turbo=0;user-id=%d;user-type="),
+				random.RandRange(1, 48), random.RandRange(0, 0xFFFFFF), user_index, b_has_emotes ? TEXT("25:0-4/1902:6-10") : TEXT(""),
+				random.RandRange(0, MAX_int32), cycle_line, 1600000000000ll + cycle_line * 37, 100000 + user_index);
+			corpus.lines_.Add(tags + TEXT(" ") + MakePrivmsg(username, content));
+		}
+		break;
+
+	case ETwitchPlayTestCorpus::CommandHeavy:
+		corpus.name_ = TEXT("CommandHeavy");
+		for (int32 cycle_line = 0; cycle_line < _num_lines; ++cycle_line)
+		{
+			// Some chatter between the commands
+			const FString content = random.RandRange(0, 4) == 0 ? MakeWords(random, 1, 6) : Commands[random.RandRange(0, ARRAY_COUNT(Commands) - 1)];
+			corpus.lines_.Add(MakePrivmsg(MakeUsername(random.RandRange(0, NumUsers - 1)), content));
+		}
+		break;
+
+	default:
+	{
+		corpus.name_ = TEXT("Adversarial");
+		const TArray<FString> adversarial_lines = MakeAdversarialLines();
+		for (int32 cycle_line = 0; cycle_line < _num_lines; ++cycle_line)
+		{
+			corpus.lines_.Add(adversarial_lines[cycle_line % adversarial_lines.Num()]);
+		}
+		break;
+	}
+	}
+
+	corpus.Tokenize();
+	return corpus;
+}
+
+bool FTwitchPlayTestCorpus::LoadCapture(const FString& _file_path, int32 _max_lines, FTwitchPlayTestCorpus& _out_corpus)
+{
+	FTwitchIRCCaptureReader reader;
+	FString error;
+	if (!reader.Open(_file_path, error))
+	{
+		return false;
+	}
+
+	_out_corpus = FTwitchPlayTestCorpus();
+	_out_corpus.name_ = TEXT("Capture");
+
+	double line_time;
+	const ANSICHAR* line_data;
+	int32 line_length;
+	while (_out_corpus.lines_.Num() < _max_lines && reader.NextLine(line_time, line_data, line_length))
+	{
+		_out_corpus.lines_.Add(FTwitchIRCStringView(line_data, line_length).ToString());
+	}
+
+	_out_corpus.Tokenize();
+	return _out_corpus.lines_.Num() > 0;
+}
+
+const TArray<FString>& FTwitchPlayTestCorpus::GetCommandNames()
+{
+	static const TArray<FString> CommandNames = { TEXT("move"), TEXT("jump"), TEXT("attack"), TEXT("vote"), TEXT("say") };
+	return CommandNames;
+}
+
+void FTwitchPlayTestCorpus::Tokenize()
+{
+	utf8_lines_.Reset(lines_.Num());
+	contents_.Reset();
+	usernames_.Reset();
+
+	FTwitchIRCLine line;
+	for (const FString& corpus_line : lines_)
+	{
+		const FTCHARToUTF8 utf8_line(*corpus_line);
+		const int32 line_index = utf8_lines_.AddDefaulted();
+		utf8_lines_[line_index].Append(utf8_line.Get(), utf8_line.Length());
+
+		if (line.Parse(utf8_line.Get(), utf8_line.Length()) && line.b_has_trailing_)
+		{
+			contents_.Add(line.trailing_.ToString());
+			usernames_.Add(line.IsUserMessage() ? line.nick_.ToString() : FString());
+		}
+	}
+}
+
+FTwitchPlayAllocationCounter::FTwitchPlayAllocationCounter()
+{
+	FCountingMalloc& counting_malloc = GetCountingMalloc();
+	check(GMalloc != &counting_malloc);
+
+	counting_malloc.inner_ = GMalloc;
+	counting_malloc.num_allocations_ = 0;
+	counting_malloc.counting_thread_id_ = FPlatformTLS::GetCurrentThreadId();
+	FPlatformMisc::MemoryBarrier();
+	GMalloc = &counting_malloc;
+}
+
+FTwitchPlayAllocationCounter::~FTwitchPlayAllocationCounter()
+{
+	FCountingMalloc& counting_malloc = GetCountingMalloc();
+	GMalloc = counting_malloc.inner_;
+	counting_malloc.counting_thread_id_ = 0;
+}
+
+int64 FTwitchPlayAllocationCounter::GetNumAllocations() const
+{
+	return GetCountingMalloc().num_allocations_;
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS
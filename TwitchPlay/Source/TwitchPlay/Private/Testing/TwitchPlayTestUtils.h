@@ -0,0 +1,128 @@
+// Copyright (C) Simone Di Gravio <email: altairjp@gmail.com> - All Rights Reserved
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+class UTwitchIRCComponent;
+class UTwitchPlayComponent;
+struct FTwitchIRCReceivedMessage;
+class FTwitchIRCConnection;
+class FTwitchIRCConnectionPool;
+
+/**
+ * Reaches the private helpers of the components from the automation tests and benchmarks.
+ */
+struct FTwitchPlayTestAccess
+{
+	static FString GetDelimitedString(const UTwitchPlayComponent& _component, const FString& _in_string, const FString& _delimiter);
+
+	static TArray<FString> GetCommandOptionsStrings(const UTwitchPlayComponent& _component, const FString& _message);
+
+	static void GetCommandOptionsStrings(const UTwitchPlayComponent& _component, const FString& _message, TArray<FString>& _out_options);
+
+	/**
+	 * Adds a shard to a pool without starting its connection thread: nothing is received but what ReceiveLine() queues.
+	 * Shards added this way come before any real one, so set max_connections_ to their amount to keep the pool off the network.
+	 *
+	 * @param _pool - The pool.
+	 *
+	 * @return The connection of the shard.
+	 */
+	static FTwitchIRCConnection& AddIdleShard(FTwitchIRCConnectionPool& _pool);
+
+	/**
+	 * Queues a line on a connection as its thread would, overload policy included.
+	 *
+	 * @param _connection - The connection, whose thread must not be running.
+	 * @param _line - Whole IRC line, without terminator.
+	 * @param _channel_id - ID of the channel inside the connection.
+	 */
+	static void ReceiveLine(FTwitchIRCConnection& _connection, const FString& _line, int32 _channel_id);
+
+	// Hands a message to a component as its connection pool does
+	static void DispatchMessage(UTwitchIRCComponent& _component, const FTwitchIRCReceivedMessage& _message, int32 _channel_id);
+};
+
+// Fixed chat corpora of the tests and benchmarks
+enum class ETwitchPlayTestCorpus : uint8
+{
+	// Chat lines without tags, a few words each
+	PlainChat,
+	// The same lines with the full set of tags Twitch sends (badges, color, emotes, ids...)
+	TagHeavy,
+	// Mostly commands, with and without options, some of them malformed
+	CommandHeavy,
+	// Lines made to break parsers: empty, single tokens, lone delimiters, very long, too many parameters, non ASCII
+	Adversarial,
+
+	Num
+};
+
+/**
+ * Chat lines, as received, with what the tokenizer makes of them.
+ */
+struct FTwitchPlayTestCorpus
+{
+	FString name_;
+
+	// Whole IRC lines, without terminator
+	TArray<FString> lines_;
+
+	// The same lines in UTF-8, as they come from the socket
+	TArray<TArray<ANSICHAR>> utf8_lines_;
+
+	// Content of every line with one, and its sender (empty for server messages)
+	TArray<FString> contents_;
+
+	TArray<FString> usernames_;
+
+	/**
+	 * Generates a corpus. The same type and amount of lines always give the same corpus.
+	 *
+	 * @param _type - What the lines look like.
+	 * @param _num_lines - Amount of lines.
+	 */
+	static FTwitchPlayTestCorpus Make(ETwitchPlayTestCorpus _type, int32 _num_lines);
+
+	/**
+	 * Reads a corpus from a capture (see FTwitchIRCCaptureWriter), like a recording of a real stream.
+	 *
+	 * @param _file_path - The capture.
+	 * @param _max_lines - Lines past this are not read.
+	 * @param _out_corpus - The corpus.
+	 *
+	 * @return Whether the capture could be read.
+	 */
+	static bool LoadCapture(const FString& _file_path, int32 _max_lines, FTwitchPlayTestCorpus& _out_corpus);
+
+	// Commands the CommandHeavy corpus uses, so tests and benchmarks register them
+	static const TArray<FString>& GetCommandNames();
+
+private:
+
+	// Fills utf8_lines_, contents_ and usernames_ from lines_
+	void Tokenize();
+};
+
+/**
+ * Counts the heap allocations made by the calling thread. GMalloc is wrapped while counting:
+ * every call still goes to the real allocator, other threads are not counted.
+ * Scopes can't be nested.
+ */
+class FTwitchPlayAllocationCounter
+{
+public:
+
+	FTwitchPlayAllocationCounter();
+
+	~FTwitchPlayAllocationCounter();
+
+	// Allocations (and reallocations) since the scope started
+	int64 GetNumAllocations() const;
+};
+
+#endif // WITH_DEV_AUTOMATION_TESTS
@@ -1,11 +1,22 @@
-// Copyright 1998-2015 Epic Games, Inc. All Rights Reserved.
-
-#include "TwitchPlay.h"
-
-void FTwitchPlayModule::StartupModule()
-{}
-
-void FTwitchPlayModule::ShutdownModule()
-{}
-
+// Copyright 1998-2015 Epic Games, Inc. All Rights Reserved.
+
+#include "TwitchPlay.h"
+#include "Net/TwitchIRCConnectionManager.h"
+#include "Testing/TwitchIRCLoadTest.h"
+
+DEFINE_LOG_CATEGORY(LogTwitchPlay);
+
+void FTwitchPlayModule::StartupModule()
+{
+	FTwitchIRCConnectionManager::Startup();
+}
+
+void FTwitchPlayModule::ShutdownModule()
+{
+#if TWITCHPLAY_WITH_LOAD_TESTING
+	FTwitchIRCLoadTest::Shutdown();
+#endif
+	FTwitchIRCConnectionManager::Shutdown();
+}
+
 IMPLEMENT_MODULE(FTwitchPlayModule, TwitchPlay)
\ No newline at end of file
@@ -0,0 +1,101 @@
+// Copyright (C) Simone Di Gravio <email: altairjp@gmail.com> - All Rights Reserved
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/NetSerialization.h"
+#include "Commands/TwitchCommandSchema.h"
+#include "TwitchCommandBatch.generated.h"
+
+/**
+ * A command as it travels in a batch, from the server to the clients.
+ */
+struct FTwitchBatchedCommand
+{
+	FString command_name_;
+
+	// Interned handle of the sender on the server. Clients have no user registry: they can compare handles, not resolve them
+	int32 user_handle_ = INDEX_NONE;
+
+	// Username of the sender, sent with the first command of the user in every batch so clients never need to resolve the handle
+	FString username_;
+
+	// Whether the command was registered with a schema: args_ are sent instead of options_
+	bool b_typed_ = false;
+
+	FTwitchCommandArgs args_;
+
+	// Options as written in chat, without the encapsulation chars
+	FString options_;
+};
+
+/**
+ * Commands matched by the server in a net update, replicated to the clients in a compact form.
+ * Entries are encoded as they are added, so the size of the batch is always known and kept under a budget:
+ * - varints everywhere, user handles as the difference from the previous entry;
+ * - command names and usernames are written once per batch, the next entries refer to them by index;
+ * - arguments are integers, or fixed point with 3 decimals for fractional floats.
+ * NetSerialize writes the encoded bytes as they are.
+ * Every batch stands on its own: nothing is remembered from one batch to the next (no delta compression across batches),
+ * so a client joining late decodes the very first batch it gets. A username is repeated in every batch its user appears in.
+ */
+USTRUCT()
+struct TWITCHPLAY_API FTwitchCommandBatch
+{
+	GENERATED_BODY()
+
+	// Batches received bigger than this are rejected before anything is allocated. Above any batch a component sends
+	static const int32 MaxReceivedBytes = 64 * 1024;
+
+	/**
+	 * Encodes a command at the end of the batch.
+	 *
+	 * @param _command - The command.
+	 * @param _max_bytes - Size the batch must not exceed.
+	 *
+	 * @return Whether the command fit. Nothing is added if it didn't.
+	 */
+	bool Add(const FTwitchBatchedCommand& _command, int32 _max_bytes);
+
+	/**
+	 * Decodes every command, in the order they were added.
+	 *
+	 * @param _function - Called for each command. The command is reused between calls.
+	 *
+	 * @return False if the data is malformed. Commands before the error were already reported.
+	 */
+	bool ForEachCommand(TFunctionRef<void(const FTwitchBatchedCommand&)> _function) const;
+
+	// Forgets the commands, keeping the allocations
+	void Reset();
+
+	int32 Num() const { return num_commands_; }
+
+	// Size of the encoded commands, what is sent besides a couple of bytes of header
+	int32 GetNumBytes() const { return data_.Num(); }
+
+	bool NetSerialize(FArchive& _archive, UPackageMap* _package_map, bool& _b_out_success);
+
+private:
+
+	int32 num_commands_ = 0;
+
+	TArray<uint8> data_;
+
+	// Encoding state, only used while adding. Command names already written, by their index in the batch
+	TArray<FString> command_names_;
+
+	// Users whose name was already written
+	TSet<int32> batch_users_;
+
+	int32 last_user_handle_ = 0;
+};
+
+template<>
+struct TStructOpsTypeTraits<FTwitchCommandBatch> : public TStructOpsTypeTraitsBase2<FTwitchCommandBatch>
+{
+	enum
+	{
+		WithNetSerializer = true
+	};
+};
@@ -0,0 +1,205 @@
+// Copyright (C) Simone Di Gravio <email: altairjp@gmail.com> - All Rights Reserved
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Kismet/BlueprintFunctionLibrary.h"
+#include "TwitchCommandSchema.generated.h"
+
+/**
+ * Type of a command argument.
+ */
+UENUM(BlueprintType)
+enum class ETwitchCommandArgType : uint8
+{
+	// Whole number, like "3" or "-12"
+	Int,
+	// Number with optional decimals, like "0.5" or "-2"
+	Float,
+	// One of the enum values of the argument (CASE INSENSITIVE). The value is its index
+	Enum,
+	// A direction (see ETwitchCommandDirection): "up", "u", "north", "n"... (CASE INSENSITIVE)
+	Direction
+};
+
+/**
+ * Value of Direction arguments.
+ */
+UENUM(BlueprintType)
+enum class ETwitchCommandDirection : uint8
+{
+	Up,
+	Down,
+	Left,
+	Right
+};
+
+/**
+ * Expected type (and accepted values) of a single command argument.
+ */
+USTRUCT(BlueprintType)
+struct TWITCHPLAY_API FTwitchCommandArgSpec
+{
+	GENERATED_BODY()
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Commands")
+		ETwitchCommandArgType type_ = ETwitchCommandArgType::Int;
+
+	// Whether Int and Float values outside [min_value_, max_value_] make the command malformed
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Commands")
+		bool b_check_range_ = false;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Commands")
+		float min_value_ = 0.0f;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Commands")
+		float max_value_ = 0.0f;
+
+	// Accepted values of Enum arguments (CASE INSENSITIVE)
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Commands")
+		TArray<FString> enum_values_;
+};
+
+/**
+ * Arguments expected by a command, written as its options ("!move!#left,3#").
+ * Commands whose options don't match are dropped before any event is fired.
+ */
+USTRUCT(BlueprintType)
+struct TWITCHPLAY_API FTwitchCommandSchema
+{
+	GENERATED_BODY()
+
+	// Arguments in the order they are written. At most FTwitchCommandArgs::MaxArgs
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Commands")
+		TArray<FTwitchCommandArgSpec> args_;
+
+	// Amount of trailing arguments that can be left out. Missing arguments read as 0
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Commands", meta = (ClampMin = "0"))
+		int32 num_optional_args_ = 0;
+};
+
+/**
+ * Typed arguments of a command registered with a schema.
+ * Values are kept in fixed arrays, so the struct is filled and handed to the delegate without allocating.
+ * Read them from Blueprint with UTwitchCommandArgsLibrary.
+ */
+USTRUCT(BlueprintType)
+struct TWITCHPLAY_API FTwitchCommandArgs
+{
+	GENERATED_BODY()
+
+	static const int32 MaxArgs = 8;
+
+	// Arguments written in the command. The schema ones past this were left out
+	UPROPERTY(BlueprintReadOnly, Category = "Commands")
+		int32 num_args_ = 0;
+
+	// Value of each argument: the number for Int (Float ones truncated), the index for Enum and Direction
+	int32 int_values_[MaxArgs] = {};
+
+	// Value of each argument as a float
+	float float_values_[MaxArgs] = {};
+
+	// Value of an argument. 0 for arguments left out or out of bounds
+	int32 GetInt(int32 _index) const { return _index >= 0 && _index < MaxArgs ? int_values_[_index] : 0; }
+
+	float GetFloat(int32 _index) const { return _index >= 0 && _index < MaxArgs ? float_values_[_index] : 0.0f; }
+};
+
+/**
+ * Reads FTwitchCommandArgs from Blueprint.
+ */
+UCLASS()
+class TWITCHPLAY_API UTwitchCommandArgsLibrary : public UBlueprintFunctionLibrary
+{
+	GENERATED_BODY()
+
+public:
+
+	// Value of an Int argument, or the index of an Enum value
+	UFUNCTION(BlueprintPure, Category = "Commands")
+		static int32 GetCommandArgInt(const FTwitchCommandArgs& _args, int32 _index);
+
+	// Value of a Float argument. Int arguments are converted
+	UFUNCTION(BlueprintPure, Category = "Commands")
+		static float GetCommandArgFloat(const FTwitchCommandArgs& _args, int32 _index);
+
+	// Value of a Direction argument
+	UFUNCTION(BlueprintPure, Category = "Commands")
+		static ETwitchCommandDirection GetCommandArgDirection(const FTwitchCommandArgs& _args, int32 _index);
+};
+
+/**
+ * A schema compiled for parsing the options of a command.
+ * Options are tokenized and converted in a single pass over the message, without creating any string.
+ */
+class TWITCHPLAY_API FTwitchCommandSchemaParser
+{
+public:
+
+	/**
+	 * Compiles a schema, replacing the previous one.
+	 *
+	 * @param _schema - The schema.
+	 * @param _out_error - What is wrong with the schema.
+	 *
+	 * @return Whether the schema is valid.
+	 */
+	bool Compile(const FTwitchCommandSchema& _schema, FString& _out_error);
+
+	/**
+	 * Parses options ("left,3", without the encapsulation chars) against the schema.
+	 * Options are separated by ',', spaces around them are ignored.
+	 *
+	 * @param _options - Start of the options.
+	 * @param _length - Length of the options. 0 if the command had none.
+	 * @param _out_args - The typed arguments.
+	 *
+	 * @return Whether the options match the schema.
+	 */
+	bool Parse(const TCHAR* _options, int32 _length, FTwitchCommandArgs& _out_args) const;
+
+	/**
+	 * Finds the first string encapsulated by a delimiter, like "a,b" in "!cmd! #a,b#". Does not allocate.
+	 *
+	 * @param _text - Text to search.
+	 * @param _length - Length of the text.
+	 * @param _delimiter - Encapsulation string.
+	 * @param _delimiter_length - Length of the encapsulation string.
+	 * @param _out_start - Index of the encapsulated string.
+	 * @param _out_length - Length of the encapsulated string. Can be 0.
+	 *
+	 * @return Whether an encapsulated string was found.
+	 */
+	static bool FindDelimited(const TCHAR* _text, int32 _length, const TCHAR* _delimiter, int32 _delimiter_length, int32& _out_start, int32& _out_length);
+
+private:
+
+	struct FCompiledArg
+	{
+		ETwitchCommandArgType type_ = ETwitchCommandArgType::Int;
+
+		bool b_check_range_ = false;
+
+		double min_value_ = 0.0;
+
+		double max_value_ = 0.0;
+
+		// Values of Enum arguments, in enum_values_
+		int32 first_enum_value_ = 0;
+
+		int32 num_enum_values_ = 0;
+	};
+
+	// Converts a single token. Returns false if it is not a valid value of the argument
+	bool ParseArg(const FCompiledArg& _arg, const TCHAR* _token, int32 _length, int32& _out_int, float& _out_float) const;
+
+	TArray<FCompiledArg> args_;
+
+	int32 num_required_args_ = 0;
+
+	// Lower case enum values of every argument, packed in enum_chars_ as (start, length)
+	TArray<TCHAR> enum_chars_;
+
+	TArray<TPair<int32, int32>> enum_values_;
+};
@@ -0,0 +1,78 @@
+// Copyright (C) Simone Di Gravio <email: altairjp@gmail.com> - All Rights Reserved
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * Immutable lookup structure for the registered chat commands.
+ * The command names are compiled into a flat trie, so a message can be matched in a single pass
+ * without allocating: the encapsulated command is walked character by character and the match fails
+ * as soon as no registered command starts with the characters read so far.
+ * Rebuild it with Build() whenever the registered commands change.
+ */
+class TWITCHPLAY_API FTwitchCommandTable
+{
+public:
+
+	/**
+	 * Compiles the commands into the trie, replacing the previous ones.
+	 * The index of each command in the array is what Match() returns.
+	 *
+	 * @param _commands - Command names (CASE SENSITIVE). Empty names are ignored.
+	 */
+	void Build(const TArray<FString>& _commands);
+
+	/**
+	 * Finds the registered command encapsulated in a message.
+	 * Only the first encapsulated string is considered, like "!command!" in "text !command! more text".
+	 *
+	 * @param _message - Message to search.
+	 * @param _message_length - Length of the message.
+	 * @param _delimiter - Command encapsulation string.
+	 * @param _delimiter_length - Length of the encapsulation string.
+	 * @param _out_end_index - Index right after the closing delimiter. Only set if a command was found.
+	 *
+	 * @return Index of the command, INDEX_NONE if no registered command was found.
+	 */
+	int32 Match(const TCHAR* _message, int32 _message_length, const TCHAR* _delimiter, int32 _delimiter_length, int32& _out_end_index) const;
+
+	// Name of a command. The index must come from Match()
+	const FString& GetCommandName(int32 _command_index) const { return command_names_[_command_index]; }
+
+	int32 Num() const { return command_names_.Num(); }
+
+private:
+
+	struct FNode
+	{
+		// Children of a node are stored contiguously in edges_
+		int32 first_edge_;
+
+		int32 num_edges_;
+
+		// Command ending at this node, or INDEX_NONE
+		int32 command_index_;
+	};
+
+	struct FEdge
+	{
+		TCHAR char_;
+
+		int32 child_node_;
+	};
+
+	/**
+	 * Builds the subtree for the commands in [_first, _last) of sorted_commands, which share their first _depth characters.
+	 */
+	void BuildNode(int32 _node_index, const TArray<int32>& _sorted_commands, int32 _first, int32 _last, int32 _depth);
+
+	// Gets the child of a node reached through a character, or INDEX_NONE
+	int32 FindChild(int32 _node_index, TCHAR _char) const;
+
+	TArray<FNode> nodes_;
+
+	TArray<FEdge> edges_;
+
+	TArray<FString> command_names_;
+};
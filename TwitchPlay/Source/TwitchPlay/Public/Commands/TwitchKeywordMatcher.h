@@ -0,0 +1,127 @@
+// Copyright (C) Simone Di Gravio <email: altairjp@gmail.com> - All Rights Reserved
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "TwitchKeywordMatcher.generated.h"
+
+/**
+ * A keyword found in a message.
+ */
+USTRUCT(BlueprintType)
+struct TWITCHPLAY_API FTwitchKeywordHit
+{
+	GENERATED_BODY()
+
+	// Index of the keyword in the registered ones
+	UPROPERTY(BlueprintReadOnly, Category = "Keywords")
+		int32 keyword_index_ = INDEX_NONE;
+
+	// Index of the first character of the hit in the message
+	UPROPERTY(BlueprintReadOnly, Category = "Keywords")
+		int32 start_ = 0;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Keywords")
+		int32 length_ = 0;
+};
+
+/**
+ * Immutable multi-pattern matcher for keywords, phrases and emote names (Aho-Corasick).
+ * The keywords are compiled into a flat trie with failure links, so a message is scanned once, character by character,
+ * whatever the amount of keywords, and every occurrence of every keyword is reported (overlapping ones included).
+ * Characters are mapped to a small alphabet of the ones appearing in the keywords: the scan stays at the root,
+ * one table lookup per character, until a character starting a keyword shows up. Scanning never allocates
+ * besides growing the output array.
+ * Rebuild it with Build() whenever the keywords change.
+ */
+class TWITCHPLAY_API FTwitchKeywordMatcher
+{
+public:
+
+	FTwitchKeywordMatcher();
+
+	/**
+	 * Compiles the keywords, replacing the previous ones.
+	 * The index of each keyword in the array is what the hits report. Duplicated keywords are reported with the first index.
+	 *
+	 * @param _keywords - Keywords. Empty ones are ignored.
+	 * @param _b_case_sensitive - Whether the case of the keywords must match.
+	 * @param _b_whole_words - Whether hits must not be preceded or followed by a letter or digit, so "Kappa" doesn't match in "KappaPride".
+	 */
+	void Build(const TArray<FString>& _keywords, bool _b_case_sensitive, bool _b_whole_words);
+
+	/**
+	 * Finds every keyword in a text.
+	 *
+	 * @param _text - Text to scan.
+	 * @param _length - Length of the text.
+	 * @param _out_hits - Hits are appended here, sorted by their end.
+	 *
+	 * @return Amount of hits found.
+	 */
+	int32 Scan(const TCHAR* _text, int32 _length, TArray<FTwitchKeywordHit>& _out_hits) const;
+
+	// A keyword, as it was registered
+	const FString& GetKeyword(int32 _keyword_index) const { return keywords_[_keyword_index]; }
+
+	int32 Num() const { return keywords_.Num(); }
+
+	// Whether there is nothing to find
+	bool IsEmpty() const { return nodes_.Num() <= 1; }
+
+private:
+
+	struct FNode
+	{
+		// Children of a node are stored contiguously in edges_, sorted by character class
+		int32 first_edge_ = 0;
+
+		int32 num_edges_ = 0;
+
+		// Node of the longest proper suffix of this node that is in the trie
+		int32 fail_ = 0;
+
+		// Nearest node along the failure links ending a keyword, or INDEX_NONE
+		int32 output_link_ = INDEX_NONE;
+
+		// Keyword ending at this node, or INDEX_NONE
+		int32 keyword_index_ = INDEX_NONE;
+
+		// Length of the keywords ending at this node
+		int32 depth_ = 0;
+	};
+
+	struct FEdge
+	{
+		int32 char_class_;
+
+		int32 child_node_;
+	};
+
+	// Class of a character. 0 for characters no keyword contains
+	int32 GetCharClass(TCHAR _char) const;
+
+	// Child of a node through a character class, INDEX_NONE if there is none
+	int32 FindChild(int32 _node_index, int32 _char_class) const;
+
+	// Whether a hit is a whole word of the text
+	static bool IsWholeWord(const TCHAR* _text, int32 _length, int32 _start, int32 _end);
+
+	TArray<FString> keywords_;
+
+	TArray<FNode> nodes_;
+
+	TArray<FEdge> edges_;
+
+	// Dense transitions of the root, indexed by character class. Characters starting no keyword stay at the root (0)
+	TArray<int32> root_next_;
+
+	// Classes of the ASCII characters. Both cases share the class when matching is case insensitive
+	int32 ascii_classes_[128];
+
+	TMap<TCHAR, int32> other_classes_;
+
+	bool b_case_sensitive_ = false;
+
+	bool b_whole_words_ = false;
+};
@@ -0,0 +1,138 @@
+// Copyright (C) Simone Di Gravio <email: altairjp@gmail.com> - All Rights Reserved
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "TwitchTrendTracker.generated.h"
+
+/**
+ * What a trend tracker counts.
+ */
+UENUM(BlueprintType)
+enum class ETwitchTrendCategory : uint8
+{
+	// Registered commands that went through the spam protection
+	Commands,
+	// Commands with their options, like "!move!#left#"
+	CommandOptions,
+	// Users sending messages
+	Users,
+	// Twitch emotes used in messages. Needs the tags (see b_request_tags_)
+	Emotes
+};
+
+/**
+ * Something counted by a trend tracker.
+ */
+USTRUCT(BlueprintType)
+struct TWITCHPLAY_API FTwitchTrendEntry
+{
+	GENERATED_BODY()
+
+	// Command, username or emote
+	UPROPERTY(BlueprintReadOnly, Category = "Trends")
+		FString name_;
+
+	// Times it was seen in the window. Estimated: it can be slightly higher than the real count, never lower
+	UPROPERTY(BlueprintReadOnly, Category = "Trends")
+		int32 count_ = 0;
+};
+
+/**
+ * Sliding window heavy hitters: what was seen the most in the last N seconds, with memory that doesn't grow with the
+ * amount of distinct keys. Counts are kept in count-min sketches, one per slice of the window plus their sum, so the
+ * slice leaving the window is subtracted in one go. The top entries are tracked as keys arrive, so they are read
+ * in O(K) without going through what was counted.
+ * Keys are hashes: names are only created for keys entering the top entries.
+ */
+class TWITCHPLAY_API FTwitchTrendTracker
+{
+public:
+
+	/**
+	 * @param _max_entries - Amount of top entries tracked.
+	 * @param _sketch_width - Counters per row of the sketches (4 rows). Rounded up to a power of two.
+	 *                        Counts are overestimated by about 2.7 * (counts in the window) / width at most.
+	 * @param _num_slices - Slices of the window. The window slides by one slice at a time.
+	 */
+	explicit FTwitchTrendTracker(int32 _max_entries = 32, int32 _sketch_width = 1024, int32 _num_slices = 12);
+
+	// Sets the length of the window. Changing it forgets everything counted
+	void SetWindow(float _window_seconds);
+
+	/**
+	 * Counts a key.
+	 *
+	 * @param _key - Hash of what is counted.
+	 * @param _now - Current time in seconds.
+	 * @param _make_name - Name of the key. Only called if the key enters the top entries.
+	 */
+	void Add(uint64 _key, double _now, TFunctionRef<FString()> _make_name);
+
+	/**
+	 * Gets the most seen keys of the window.
+	 *
+	 * @param _now - Current time in seconds.
+	 * @param _max_entries - Maximum amount of entries.
+	 * @param _out_entries - Entries, most seen first.
+	 */
+	void GetTop(double _now, int32 _max_entries, TArray<FTwitchTrendEntry>& _out_entries);
+
+	// Estimated times a key was seen in the window
+	int32 GetCount(uint64 _key, double _now);
+
+	// Forgets everything counted
+	void Reset();
+
+	// Hash of a string, to use as key
+	static uint64 HashName(const TCHAR* _name, int32 _length);
+
+private:
+
+	// Rows of every sketch. Each row is indexed by a different hash of the key
+	static const int32 NumRows = 4;
+
+	struct FTopEntry
+	{
+		uint64 key_;
+
+		uint32 count_;
+
+		FString name_;
+	};
+
+	// Slides the window up to _now, subtracting the slices that left it
+	void Advance(double _now);
+
+	// Counts a key in the current slice and the window. Returns its estimated count in the window
+	uint32 Increment(uint64 _key);
+
+	uint32 Estimate(uint64 _key) const;
+
+	// Index of the counter of a key in each row
+	void GetCounterIndices(uint64 _key, uint32 (&_out_indices)[NumRows]) const;
+
+	void UpdateMinEntry();
+
+	// Sketch of every slice, then the one of the window (their sum). Rows of width_mask_ + 1 counters
+	TArray<uint32> counters_;
+
+	uint32 width_mask_;
+
+	int32 num_slices_;
+
+	// Slice receiving the counts
+	int32 current_slice_ = 0;
+
+	double slice_seconds_ = 5.0;
+
+	// End of the current slice. Negative until the first key is counted
+	double slice_end_time_ = -1.0;
+
+	int32 max_entries_;
+
+	TArray<FTopEntry> top_entries_;
+
+	// Entry with the lowest count, the one replaced by a key seen more. INDEX_NONE if there are no entries
+	int32 min_entry_ = INDEX_NONE;
+};
@@ -0,0 +1,97 @@
+// Copyright (C) Simone Di Gravio <email: altairjp@gmail.com> - All Rights Reserved
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * Per user flood protection for chat commands: a rate limit per user and command, and suppression of a user
+ * repeating the same message. State lives in a fixed-capacity open addressing table keyed by hashed user and command,
+ * so memory never grows with the amount of chatters. Entries left idle long enough to be back to their initial state
+ * are reused, and when a probe sequence is full its oldest entry is evicted.
+ */
+class TWITCHPLAY_API FTwitchUserThrottle
+{
+public:
+
+	/**
+	 * @param _capacity - Amount of entries of the table. 0 to allocate it later with SetCapacity().
+	 */
+	explicit FTwitchUserThrottle(int32 _capacity = 0);
+
+	/**
+	 * Allocates the table, dropping every entry. Does nothing if the capacity doesn't change.
+	 *
+	 * @param _capacity - Amount of entries (24 bytes each). Rounded up to a power of two.
+	 *                    Every user takes one entry, plus one for each command they used recently.
+	 */
+	void SetCapacity(int32 _capacity);
+
+	/**
+	 * Sets the rules. Entries already tracked keep their state.
+	 *
+	 * @param _commands_per_window - Commands each user can send per command and window. 0 for no limit.
+	 * @param _window_seconds - Length of the window. Tokens refill continuously over it.
+	 * @param _duplicate_window_seconds - Seconds a message of a user is ignored if it repeats their previous one. 0 to allow duplicates.
+	 */
+	void SetRules(float _commands_per_window, float _window_seconds, float _duplicate_window_seconds);
+
+	/**
+	 * Checks a command against the rules, and counts it if it goes through. The table must be allocated.
+	 *
+	 * @param _user_key - Identifies the sender, like its user handle or HashUser().
+	 * @param _command_index - Index of the command (see FTwitchCommandTable).
+	 * @param _message_hash - Hash of the whole message, for duplicate suppression.
+	 * @param _now - Current time in seconds.
+	 *
+	 * @return Whether the command should be handled.
+	 */
+	bool AllowCommand(uint64 _user_key, int32 _command_index, uint32 _message_hash, double _now);
+
+	// Forgets every user
+	void Reset();
+
+	// Key of a username. User handles (see UTwitchIRCComponent::FindUserHandle) make better keys, since users can be renamed
+	static uint64 HashUser(const FString& _username);
+
+private:
+
+	struct FEntry
+	{
+		// Hash of user and command. 0 for slots never used
+		uint64 key_ = 0;
+
+		// Milliseconds since epoch_ the entry was last used
+		uint32 last_used_ms_ = 0;
+
+		// Last message of the user (duplicate entries only)
+		uint32 message_hash_ = 0;
+
+		// Commands left (rate entries only)
+		float tokens_ = 0.0f;
+	};
+
+	/**
+	 * Finds the entry of a key, claiming an expired one (or evicting the oldest one of the probe sequence) if needed.
+	 *
+	 * @param _key - Key of the entry. Never 0.
+	 * @param _now_ms - Current time, in milliseconds since epoch_.
+	 * @param _out_b_is_new - Whether the entry was just claimed and must be initialized.
+	 */
+	FEntry& FindOrClaim(uint64 _key, uint32 _now_ms, bool& _out_b_is_new);
+
+	// Power of two capacity, never resized while in use
+	TArray<FEntry> entries_;
+
+	// Time entries are stamped against, so they fit 32 bits
+	double epoch_ = -1.0;
+
+	float commands_per_window_ = 0.0f;
+
+	float tokens_per_second_ = 0.0f;
+
+	uint32 duplicate_window_ms_ = 0;
+
+	// Entries idle for longer are back to their initial state and can be reused
+	uint32 entry_lifetime_ms_ = 0;
+};
@@ -0,0 +1,171 @@
+// Copyright (C) Simone Di Gravio <email: altairjp@gmail.com> - All Rights Reserved
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "TwitchVoteAggregator.generated.h"
+
+/**
+ * How the winner of a vote window is chosen.
+ */
+UENUM(BlueprintType)
+enum class ETwitchVotePolicy : uint8
+{
+	// The most voted command (with its options) wins. Ties go to the one that was voted first
+	Democracy,
+	// The latest vote wins, like inputs in a classic Twitch Plays. Tallies are still reported
+	Anarchy
+};
+
+/**
+ * How multiple votes from the same user inside a window are handled.
+ */
+UENUM(BlueprintType)
+enum class ETwitchVoteUserRule : uint8
+{
+	// Every vote counts
+	MultipleVotes,
+	// Only the first vote of each user counts, the following ones are ignored
+	FirstVoteOnly,
+	// Each user has one vote, a new vote replaces the previous one
+	LastVoteCounts
+};
+
+/**
+ * Votes received by a command with a specific set of options.
+ */
+USTRUCT(BlueprintType)
+struct TWITCHPLAY_API FTwitchVoteTally
+{
+	GENERATED_BODY()
+
+	// Name of the voted command
+	UPROPERTY(BlueprintReadOnly, Category = "Votes")
+		FString command_;
+
+	// Options of the vote as they were written between the options encapsulation chars ("" if none)
+	UPROPERTY(BlueprintReadOnly, Category = "Votes")
+		FString options_;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Votes")
+		int32 votes_ = 0;
+};
+
+/**
+ * Outcome of a closed vote window.
+ */
+USTRUCT(BlueprintType)
+struct TWITCHPLAY_API FTwitchVoteWindowResult
+{
+	GENERATED_BODY()
+
+	// Every command/options combination that received votes, most voted first
+	UPROPERTY(BlueprintReadOnly, Category = "Votes")
+		TArray<FTwitchVoteTally> tallies_;
+
+	// Index of the winner inside tallies_. INDEX_NONE if nobody voted
+	UPROPERTY(BlueprintReadOnly, Category = "Votes")
+		int32 winner_index_ = INDEX_NONE;
+
+	// Votes counted in the window
+	UPROPERTY(BlueprintReadOnly, Category = "Votes")
+		int32 total_votes_ = 0;
+
+	// Votes discarded by the user rule, or because too many different option combinations were voted
+	UPROPERTY(BlueprintReadOnly, Category = "Votes")
+		int32 ignored_votes_ = 0;
+
+	// Real time length of the window in seconds
+	UPROPERTY(BlueprintReadOnly, Category = "Votes")
+		float window_duration_ = 0.0f;
+};
+
+/**
+ * Tallies command votes for a time window without calling any delegate per vote.
+ * Counters live in a fixed-capacity table keyed by command and options, which is reused by every window.
+ * Counting a vote only touches memory when a command/options combination is voted for the first time in a window.
+ */
+class TWITCHPLAY_API FTwitchVoteAggregator
+{
+public:
+
+	/**
+	 * @param _max_tallies - Maximum amount of distinct command/options combinations per window.
+	 */
+	explicit FTwitchVoteAggregator(int32 _max_tallies = 256);
+
+	// Rules of the votes to come. Meant to be set when a window opens: changing the user rule mid window mixes rules
+	void SetRules(ETwitchVotePolicy _policy, ETwitchVoteUserRule _user_rule);
+
+	/**
+	 * Counts a vote in the current window. The options are only copied the first time they are voted in a window.
+	 *
+	 * @param _command_index - Index of the voted command (see FTwitchCommandTable).
+	 * @param _options - Options of the vote, as written between the encapsulation chars. Not null terminated.
+	 * @param _options_length - Length of the options. 0 if none.
+	 * @param _user_key - Identifies the voter, for the user rule.
+	 */
+	void Vote(int32 _command_index, const TCHAR* _options, int32 _options_length, uint32 _user_key);
+
+	void Vote(int32 _command_index, const FString& _options, uint32 _user_key)
+	{
+		Vote(_command_index, *_options, _options.Len(), _user_key);
+	}
+
+	/**
+	 * Closes the current window and starts a new one.
+	 *
+	 * @param _command_names - Command names, indexed by command index.
+	 * @param _window_duration - Length of the window, reported in the result.
+	 * @param _out_result - Outcome of the window.
+	 */
+	void CloseWindow(TFunctionRef<const FString&(int32)> _command_names, float _window_duration, FTwitchVoteWindowResult& _out_result);
+
+	// Discards the votes of the current window
+	void ResetWindow();
+
+	int32 GetTotalVotes() const { return total_votes_; }
+
+	ETwitchVotePolicy GetPolicy() const { return policy_; }
+
+	ETwitchVoteUserRule GetUserRule() const { return user_rule_; }
+
+private:
+
+	struct FTallySlot
+	{
+		// INDEX_NONE for free slots
+		int32 command_index_ = INDEX_NONE;
+
+		uint32 options_hash_ = 0;
+
+		FString options_;
+
+		int32 votes_ = 0;
+	};
+
+	// Finds the slot of a command/options combination, claiming a free one if needed. INDEX_NONE if the table is full
+	int32 FindOrAddSlot(int32 _command_index, const TCHAR* _options, int32 _options_length);
+
+	// Open addressing table with a power of two capacity. Never resized, the options strings keep their memory between windows
+	TArray<FTallySlot> slots_;
+
+	int32 max_tallies_;
+
+	// Slots used in the current window, in order of first vote. Used for democracy tie breaking
+	TArray<int32> used_slots_;
+
+	// Slot voted by each user in the current window. Only used by the user rules
+	TMap<uint32, int32> user_votes_;
+
+	ETwitchVotePolicy policy_ = ETwitchVotePolicy::Democracy;
+
+	ETwitchVoteUserRule user_rule_ = ETwitchVoteUserRule::MultipleVotes;
+
+	int32 total_votes_ = 0;
+
+	int32 ignored_votes_ = 0;
+
+	// Latest voted slot, the anarchy winner
+	int32 latest_slot_ = INDEX_NONE;
+};
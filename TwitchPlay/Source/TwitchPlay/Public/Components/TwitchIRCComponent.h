@@ -1,126 +1,473 @@
-// Copyright (C) Simone Di Gravio <email: altairjp@gmail.com> - All Rights Reserved
-
-#pragma once
-
-#include "CoreMinimal.h"
-#include "CoreTypes.h"
-#include "Engine/World.h"
-#include "Runtime/Engine/Public/TimerManager.h"
-#include "Components/ActorComponent.h"
-#include "Networking.h"
-#include "TwitchIRCComponent.generated.h"
-
-/**
- * Declaration of delegate type for messages received from chat.
- * Delegate signature should receive two parameters:
- * _message (const FString&) - Message received.
- * _username (const FString&) - Username of who sent the message.
- */
-DECLARE_DYNAMIC_MULTICAST_DELEGATE_TwoParams(FMessageReceived, const FString&, _message, const FString&, _username);
-
-/**
- * Makes communication with Twitch IRC possible through UE4 sockets.
- * You can send and receive messages to/from channel chat.
- * Subscribe to OnMessageReceived to know when a message has harrived.
- * Remember to first Connect(), SetUserInfo() and then AuthenticateTwitchIRC() before trying to send messages.
- */
-UCLASS(ClassGroup = (TwitchAPI), meta = (BlueprintSpawnableComponent))
-class TWITCHPLAY_API UTwitchIRCComponent : public UActorComponent
-{
-	GENERATED_BODY()
-
-public:
-	// Event called each time a message is received
-	UPROPERTY(BlueprintAssignable, Category = "Message Events")
-		FMessageReceived OnMessageReceived;
-
-	// Authentication token. Need to get it from official Twitch API
-	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Setup")
-		FString oauth_token_;
-
-	// Username. Must be in lowercaps
-	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Setup")
-		FString username_;
-
-	// Channel to join upon successful connection	
-	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Setup")
-		FString channel_;
-
-private:
-	FSocket* connection_socket_;
-
-	// Timer that handles the method receiving data from the socket
-	FTimerHandle receiving_timer_;
-
-	// Since the user setup should be run at least once use this to check if SetUserInfo was called
-	// Used before trying to authenticate 
-	bool b_has_run_user_setup_ = false;
-
-
-public:
-
-	// Sets default values for this component's properties
-	UTwitchIRCComponent();
-
-	/** Sets up the user info for the connection.
-	 *
-	 * @param _oauth - Oauth token to use. Get one from official Twitch APIs.
-	 * @param _username - Username to login with. All low caps.
-	 * @param _channel - The channel to join upon connection.
-	 */
-	UFUNCTION(BlueprintCallable, Category = "Setup")
-		void SetUserInfo(const FString _oauth, const  FString _username, const FString _channel);
-
-	// Send a message on the connected socket
-	//
-	// @param _b_send_to - Whether this message should be sent to a specific channel/user
-	// @param _channel - The channel (or user) to send this message to
-	//
-	// @return Whether the message was sent correctly
-	UFUNCTION(BlueprintCallable, Category = "Messages")
-		bool SendIRCMessage(FString _message, UPARAM(DisplayName = "Send to channel") bool _b_send_to = true, FString _channel = "");
-
-	/**
-	 * Creates a socket and tries to connect to Twitch IRC server.
-	 * Does NOT authenticate the user.
-	 * TODO: It internally creates a timer to handle receiving of messages. Might move to a threaded solution later or.
-	 *
-	 * @param _out_error - The type of error that prevented the authentication.
-	 *
-	 * @return Whether the connection was created.
-	 */
-	UFUNCTION(BlueprintCallable, Category = "Setup")
-		bool Connect(FString& _out_error);
-
-	/**
-	 * Authenticates the connection to Twitch IRC servers.
-	 * Also joins the channel if any was specified inside the component.
-	 *
-	 * @param _out_error - The type of error that prevented the authentication.
-	 *
-	 * @return Whether authentication succedeed or not.
-	 */
-	UFUNCTION(BlueprintCallable, Category = "Setup")
-		bool AuthenticateTwitchIRC(FString& _out_error);
-
-	/**
-	 * Receives data from the socket.
-	 * This is supposed to be a method called by a timer or a threaded method.
-	 */
-	void ReceiveData();
-
-	/**
-	 * Parses the message received from Twitch IRC chat in order to only get the content of the message.
-	 * Since a single "message" could actually include multiple lines an array of strings is returned.
-	 *
-	 * @param _message - Message to parse
-	 * @param _out_sender_username - The username(s) of the message sender(s). In sync with the return array.
-	 * @param _b_filter_user_only - Filter only messages sent by the users? This avoids receiving server messages.
-	 *
-	 * @return Parsed messages.
-	 */
-	TArray<FString> ParseMessage(const FString _message, TArray<FString>& _out_sender_username, bool _b_filter_user_only = false);
-
-	// Handles closing the connection and freeing up the socket resources
-	virtual ~UTwitchIRCComponent();
-};
+// Copyright (C) Simone Di Gravio <email: altairjp@gmail.com> - All Rights Reserved
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "CoreTypes.h"
+#include "Engine/World.h"
+#include "Runtime/Engine/Public/TimerManager.h"
+#include "Components/ActorComponent.h"
+#include "Networking.h"
+#include "Net/TwitchIRCLine.h"
+#include "Net/TwitchIRCConnectionState.h"
+#include "Net/TwitchIRCOverloadPolicy.h"
+#include "Net/TwitchIRCMessageBatch.h"
+#include "TwitchIRCComponent.generated.h"
+
+class FTwitchIRCConnectionPool;
+struct FTwitchIRCReceivedMessage;
+
+/**
+ * Declaration of delegate type for messages received from chat.
+ * Delegate signature should receive three parameters:
+ * _message (const FString&) - Message received.
+ * _username (const FString&) - Username of who sent the message.
+ * _user_handle (int32) - Interned handle of who sent the message, stable for the whole session. INDEX_NONE for server messages. See GetUserName().
+ */
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_ThreeParams(FMessageReceived, const FString&, _message, const FString&, _username, int32, _user_handle);
+
+/**
+ * Declaration of delegate type for all the messages received in a frame.
+ * Delegate signature should receive one parameter:
+ * _batch (const FTwitchMessageBatch&) - The messages, as parallel arrays.
+ */
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FMessagesReceivedBatch, const FTwitchMessageBatch&, _batch);
+
+// Native counterpart of FMessagesReceivedBatch. The span views the messages without copying them
+DECLARE_MULTICAST_DELEGATE_OneParam(FMessagesReceivedSpan, const FTwitchMessageSpan& /* _messages */);
+
+/**
+ * Declaration of delegate type for messages received from a specific channel (see AddChannelHandler).
+ * Delegate signature should receive four parameters:
+ * _message (const FString&) - Message received.
+ * _username (const FString&) - Username of who sent the message.
+ * _user_handle (int32) - Interned handle of who sent the message. INDEX_NONE for server messages. See GetUserName().
+ * _channel_id (int32) - Interned ID of the channel. See GetChannelName().
+ */
+DECLARE_DYNAMIC_DELEGATE_FourParams(FChannelMessageReceived, const FString&, _message, const FString&, _username, int32, _user_handle, int32, _channel_id);
+
+/**
+ * Declaration of delegate type for problems with outgoing messages.
+ * Delegate signature should receive three parameters:
+ * _dropped_messages (int32) - Messages dropped because too many were queued.
+ * _delayed_messages (int32) - Messages held back to stay inside the Twitch chat budget.
+ * _longest_delay_seconds (float) - Longest time one of those messages waited.
+ */
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_ThreeParams(FSendQueueReport, int32, _dropped_messages, int32, _delayed_messages, float, _longest_delay_seconds);
+
+/**
+ * Declaration of delegate type for incoming messages the game thread could not keep up with.
+ * Delegate signature should receive two parameters:
+ * _shed_messages (int32) - Messages dropped by the overload policy since the last report.
+ * _deferred_messages (int32) - Messages left for the next frames because the dispatch budget of this frame ran out.
+ */
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_TwoParams(FInboundQueueReport, int32, _shed_messages, int32, _deferred_messages);
+
+/**
+ * Declaration of delegate type for connection state changes.
+ * Delegate signature should receive two parameters:
+ * _new_state (ETwitchConnectionState) - State the connection moved to.
+ * _reason (const FString&) - Why, for failures and disconnections. Empty otherwise.
+ */
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_TwoParams(FConnectionStateChanged, ETwitchConnectionState, _new_state, const FString&, _reason);
+
+/**
+ * Makes communication with Twitch IRC possible through UE4 sockets.
+ * You can send and receive messages to/from channel chat.
+ * Subscribe to OnMessageReceived to know when a message has harrived.
+ * Remember to first Connect(), SetUserInfo() and then AuthenticateTwitchIRC() before trying to send messages.
+ * Connecting and authenticating happen in the background: subscribe to OnConnectionStateChanged to follow them.
+ * Any number of channels can be joined on the same connection (see JoinChannel). Each channel gets an interned ID,
+ * and handlers can be added for a single channel (see AddChannelHandler).
+ * Senders are interned too: every message carries a user handle, a small integer that stays the same for the whole
+ * session (even across renames when tags are requested), so per user state can live in arrays indexed by handle.
+ * Dropped connections are re-established automatically (see b_auto_reconnect_).
+ * Components logged in with the same account share their connections: each line is received and parsed once,
+ * then handed to every component listening to its channel.
+ */
+UCLASS(ClassGroup = (TwitchAPI), meta = (BlueprintSpawnableComponent))
+class TWITCHPLAY_API UTwitchIRCComponent : public UActorComponent
+{
+	GENERATED_BODY()
+
+public:
+	// Event called each time a message is received, from any channel. See GetMessageChannelId()
+	UPROPERTY(BlueprintAssignable, Category = "Message Events")
+		FMessageReceived OnMessageReceived;
+
+	// Event called once per frame with every message received in it, when there was at least one.
+	// Cheaper than OnMessageReceived in busy channels: the whole frame crosses into Blueprint in one call
+	UPROPERTY(BlueprintAssignable, Category = "Message Events")
+		FMessagesReceivedBatch OnMessagesReceivedBatch;
+
+	// Native version of OnMessagesReceivedBatch, fired right before it. The messages are not copied for it, not even their contents
+	FMessagesReceivedSpan OnMessagesReceivedSpan;
+
+	// Event called when sent messages were dropped or delayed by the rate limiting
+	UPROPERTY(BlueprintAssignable, Category = "Message Events")
+		FSendQueueReport OnSendQueueReport;
+
+	// Event called when incoming messages were shed or deferred, so chat volume never stalls the frame
+	UPROPERTY(BlueprintAssignable, Category = "Message Events")
+		FInboundQueueReport OnInboundQueueReport;
+
+	// Event called each time the connection changes state
+	UPROPERTY(BlueprintAssignable, Category = "Connection")
+		FConnectionStateChanged OnConnectionStateChanged;
+
+	// Authentication token. Need to get it from official Twitch API
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Setup")
+		FString oauth_token_;
+
+	// Username. Must be in lowercaps
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Setup")
+		FString username_;
+
+	// Channel to join upon successful connection. More can be joined with JoinChannel()
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Setup")
+		FString channel_;
+
+	/**
+	 * Requests the IRCv3 tags and Twitch commands capabilities upon authentication.
+	 * Messages then carry tags like "user-id", "badges", "mod", "subscriber", "emotes" and "bits". See GetMessageTag().
+	 * Tags are only decoded when they are read.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Setup")
+		bool b_request_tags_ = false;
+
+	/**
+	 * Whether the account is a moderator (or the broadcaster) of the channel.
+	 * Raises the chat budget from 20 to 100 messages every 30 seconds. Read upon Connect().
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Setup")
+		bool b_is_moderator_ = false;
+
+	// Address of the chat server. Point it to a local server (see TwitchPlay.MockServer) to test without Twitch. Read upon Connect()
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Connection")
+		FString server_host_ = "irc.twitch.tv";
+
+	// Port of the chat server. Read upon Connect()
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Connection", meta = (ClampMin = "1", ClampMax = "65535"))
+		int32 server_port_ = 6667;
+
+	// Whether to connect again when the connection drops. Read upon Connect()
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Connection")
+		bool b_auto_reconnect_ = true;
+
+	// Seconds to wait before the first reconnection attempt. Doubles on every failed attempt, with some jitter
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Connection", meta = (ClampMin = "0.1"))
+		float reconnect_initial_delay_seconds_ = 1.0f;
+
+	// Upper bound of the delay between reconnection attempts
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Connection", meta = (ClampMin = "0.1"))
+		float reconnect_max_delay_seconds_ = 60.0f;
+
+	/**
+	 * Channels of the account are spread over several connections, each with its own socket and thread.
+	 * A new connection is opened once every connection holds this many channels.
+	 * Connection settings are read upon Connect(). Components sharing an account use the settings of the first one to connect.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Connection", meta = (ClampMin = "1"))
+		int32 max_channels_per_connection_ = 50;
+
+	// Maximum amount of connections for the account. Past this, channels go to the least loaded connection
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Connection", meta = (ClampMin = "1"))
+		int32 max_connections_ = 4;
+
+	/**
+	 * Captures every line received, with its timing, to this file (absolute or relative to the Saved directory).
+	 * The capture can be replayed later with replay_file_, to reproduce what happened on a stream. Empty to not capture.
+	 * Read upon Connect(). Components sharing an account use the capture of the first one to connect.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Capture")
+		FString capture_file_;
+
+	/**
+	 * Replays a capture (see capture_file_) instead of connecting to Twitch: its lines go through the same parsing and
+	 * dispatching as received ones, and sent messages are dropped. Absolute or relative to the Saved directory. Read upon Connect()
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Capture")
+		FString replay_file_;
+
+	// Speed of the replay: 1 for real time, 2 for twice as fast... 0 for as fast as possible
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Capture", meta = (ClampMin = "0"))
+		float replay_speed_ = 1.0f;
+
+	/**
+	 * Time in microseconds spent each frame handing received messages to the components (and their handlers).
+	 * Once it runs out the remaining messages wait for the next frame, so a raid can't hitch the game. 0 for no limit.
+	 * Read upon Connect(). Components sharing an account use the settings of the first one to connect.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Overload", meta = (ClampMin = "0"))
+		int32 dispatch_budget_microseconds_ = 2000;
+
+	// Messages each connection holds for the game thread before the overload policy applies. Read upon Connect()
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Overload", meta = (ClampMin = "16"))
+		int32 inbound_queue_capacity_ = 10000;
+
+	// What is kept when messages arrive faster than they are dispatched. Read upon Connect()
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Overload")
+		ETwitchOverloadPolicy overload_policy_ = ETwitchOverloadPolicy::DropOldest;
+
+	// Messages kept by the CommandsOnly policy contain this. Match it to the command encapsulation char. Read upon Connect()
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Overload")
+		FString overload_command_marker_ = "!";
+
+private:
+
+	// Connections of the account, shared with the other components using it. Messages and state changes are dispatched on tick
+	FTwitchIRCConnectionPool* connection_pool_ = nullptr;
+
+	// Message being broadcast by DispatchMessage. Only valid during OnMessageReceived
+	const FTwitchIRCReceivedMessage* current_message_ = nullptr;
+
+	// Channel ID of current_message_
+	int32 current_channel_id_ = INDEX_NONE;
+
+	// Messages of the frame for OnMessagesReceivedBatch and OnMessagesReceivedSpan. Only filled while one of them is bound
+	FTwitchMessageFrame message_frame_;
+
+	// Copy of message_frame_ for OnMessagesReceivedBatch, only made while it is bound. Kept between frames so its strings keep their allocations
+	FTwitchMessageBatch message_batch_;
+
+	// Interned channel names (lower case, without '#'). The index is the channel ID. IDs are never reused
+	TArray<FString> channel_names_;
+
+	// Channels that should be joined, indexed by channel ID. Joined again on every Connect()
+	TBitArray<> joined_channels_;
+
+	// Handlers of each channel, indexed by channel ID
+	TArray<TArray<FChannelMessageReceived>> channel_handlers_;
+
+	// Since the user setup should be run at least once use this to check if SetUserInfo was called
+	// Used before trying to authenticate 
+	bool b_has_run_user_setup_ = false;
+
+
+public:
+
+	// Sets default values for this component's properties
+	UTwitchIRCComponent();
+
+	/** Sets up the user info for the connection.
+	 *
+	 * @param _oauth - Oauth token to use. Get one from official Twitch APIs.
+	 * @param _username - Username to login with. All low caps.
+	 * @param _channel - The channel to join upon connection.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "Setup")
+		void SetUserInfo(const FString _oauth, const  FString _username, const FString _channel);
+
+	// Queues a message to be sent on the connection. It is not sent yet when this returns
+	// Messages are written later by the connection thread once the channel is joined, and kept while reconnecting
+	// Chat messages are held back as needed to respect the Twitch chat budget, possibly for several seconds
+	// See OnSendQueueReport to know about dropped or delayed messages
+	//
+	// @param _b_send_to - Whether this message should be sent to a specific channel/user
+	// @param _channel - The channel (or user) to send this message to
+	//
+	// @return Whether the message was queued. False without a connection, or if the send queue is full. Says nothing about it being sent
+	UFUNCTION(BlueprintCallable, Category = "Messages")
+		bool SendIRCMessage(FString _message, UPARAM(DisplayName = "Send to channel") bool _b_send_to = true, FString _channel = "");
+
+	/**
+	 * Joins a channel on the current connection, as soon as it is authenticated.
+	 * Joined channels are joined again after every reconnection and every Connect().
+	 *
+	 * @param _channel - Channel name, with or without '#' (CASE INSENSITIVE).
+	 *
+	 * @return Interned ID of the channel. INDEX_NONE if the name is empty.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "Channels")
+		int32 JoinChannel(const FString _channel);
+
+	/**
+	 * Leaves a channel. Its ID and handlers are kept, so it can be joined again.
+	 *
+	 * @param _channel - Channel name, with or without '#' (CASE INSENSITIVE).
+	 *
+	 * @return Whether the channel was joined.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "Channels")
+		bool PartChannel(const FString _channel);
+
+	/**
+	 * Adds a handler for the messages of a single channel. The channel does not need to be joined yet.
+	 * Messages are routed by channel ID, so handlers of other channels are never visited.
+	 *
+	 * @param _channel - Channel name, with or without '#' (CASE INSENSITIVE).
+	 * @param _handler - The function to fire for every message of the channel.
+	 *
+	 * @return Interned ID of the channel. INDEX_NONE if the name is empty.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "Channels")
+		int32 AddChannelHandler(const FString _channel, const FChannelMessageReceived& _handler);
+
+	/**
+	 * Removes every handler bound to an object from a channel.
+	 *
+	 * @param _channel - Channel name, with or without '#' (CASE INSENSITIVE).
+	 * @param _object - Object the handlers are bound to.
+	 *
+	 * @return Amount of handlers removed.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "Channels")
+		int32 RemoveChannelHandlers(const FString _channel, UObject* _object);
+
+	// Interned ID of a channel. INDEX_NONE if the channel was never joined or handled
+	UFUNCTION(BlueprintCallable, BlueprintPure, Category = "Channels")
+		int32 GetChannelId(const FString _channel) const;
+
+	// Name of an interned channel (lower case, without '#'). Empty for invalid IDs
+	UFUNCTION(BlueprintCallable, BlueprintPure, Category = "Channels")
+		FString GetChannelName(int32 _channel_id) const;
+
+	/**
+	 * Handle of a user, as passed to OnMessageReceived. Handles are shared by every component.
+	 *
+	 * @param _username - Login of the user (CASE INSENSITIVE).
+	 *
+	 * @return The handle. INDEX_NONE if the user never sent a message.
+	 */
+	UFUNCTION(BlueprintCallable, BlueprintPure, Category = "Users")
+		static int32 FindUserHandle(const FString _username);
+
+	// Login (lower case username) of a user. Empty for invalid handles, and on the clients of a server authoritative
+	// UTwitchPlayComponent: users are only interned where chat is received
+	UFUNCTION(BlueprintCallable, BlueprintPure, Category = "Users")
+		static FString GetUserName(int32 _user_handle);
+
+	// Display name of a user (with its capitalization, or localized). Same as the login unless tags were requested (see b_request_tags_)
+	UFUNCTION(BlueprintCallable, BlueprintPure, Category = "Users")
+		static FString GetUserDisplayName(int32 _user_handle);
+
+	// Twitch user ID of a user, for native code. 0 unless tags were requested (see b_request_tags_)
+	static int64 GetUserTwitchId(int32 _user_handle);
+
+	/**
+	 * Gets the channel ID of the message currently being received.
+	 * Only valid while handling OnMessageReceived. INDEX_NONE for server messages.
+	 */
+	UFUNCTION(BlueprintCallable, BlueprintPure, Category = "Messages")
+		int32 GetMessageChannelId() const;
+
+	/**
+	 * Gets an IRCv3 tag of the message currently being received.
+	 * Only valid while handling OnMessageReceived, and only if tags were requested (see b_request_tags_).
+	 *
+	 * @param _tag_name - Name of the tag, like "user-id" or "badges" (CASE SENSITIVE).
+	 * @param _out_value - Decoded value of the tag.
+	 *
+	 * @return Whether the tag was found.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "Messages")
+		bool GetMessageTag(const FString _tag_name, FString& _out_value) const;
+
+	/**
+	 * Gets the IRCv3 tags of the message currently being received, for native code.
+	 * Only valid while handling OnMessageReceived. Empty if tags were not requested.
+	 */
+	FTwitchIRCTags GetMessageTags() const;
+
+	/**
+	 * Gets when the message currently being received was read from the socket (FPlatformTime::Cycles64), for native code.
+	 * Only valid while handling OnMessageReceived. 0 otherwise.
+	 */
+	uint64 GetMessageReceiveCycles() const;
+
+	/**
+	 * Starts connecting to Twitch IRC server. Returns right away, the connection is made on its own thread.
+	 * Does NOT authenticate the user.
+	 * The same thread receives and parses messages. They are broadcast on the next tick.
+	 *
+	 * Components that don't ingest chat (see UTwitchPlayComponent::b_server_authoritative_) succeed without connecting.
+	 *
+	 * @param _out_error - The type of error that prevented the connection from starting.
+	 *
+	 * @return Whether the connection was started. See OnConnectionStateChanged for its progress.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "Setup")
+		bool Connect(FString& _out_error);
+
+	/**
+	 * Authenticates the connection to Twitch IRC servers, as soon as it is connected and after every reconnection.
+	 * Also joins the channel if any was specified inside the component.
+	 * If b_request_tags_ is set the tags and commands capabilities are requested first.
+	 * The outcome is reported by OnConnectionStateChanged (Joined or AuthenticationFailed).
+	 *
+	 * @param _out_error - The type of error that prevented the authentication.
+	 *
+	 * @return Whether the authentication was started.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "Setup")
+		bool AuthenticateTwitchIRC(FString& _out_error);
+
+	// Closes the connection and stops reconnecting. Queued messages are discarded
+	UFUNCTION(BlueprintCallable, Category = "Setup")
+		void Disconnect();
+
+	// Current state of the connection
+	UFUNCTION(BlueprintCallable, BlueprintPure, Category = "Connection")
+		ETwitchConnectionState GetConnectionState() const;
+
+	/**
+	 * Broadcasts the messages received since the last frame.
+	 * Called once per tick. Receiving and parsing already happened on the connection threads.
+	 * The first component ticking in a frame dispatches the messages of every component, so each message is handled once.
+	 * Also fires OnConnectionStateChanged for every state change, and OnSendQueueReport if outgoing messages were dropped or delayed.
+	 * Messages are dispatched within dispatch_budget_microseconds_: the rest wait for the next frames (see OnInboundQueueReport).
+	 */
+	void ReceiveData();
+
+	/**
+	 * Parses the message received from Twitch IRC chat in order to only get the content of the message.
+	 * Since a single "message" could actually include multiple lines an array of strings is returned.
+	 *
+	 * @param _message - Message to parse
+	 * @param _out_sender_username - The username(s) of the message sender(s). In sync with the return array.
+	 * @param _b_filter_user_only - Filter only messages sent by the users? This avoids receiving server messages.
+	 * @param _out_channels - If not null, gets the channel (without '#') of each message. Empty for server messages. In sync with the return array.
+	 *
+	 * @return Parsed messages.
+	 */
+	TArray<FString> ParseMessage(const FString _message, TArray<FString>& _out_sender_username, bool _b_filter_user_only = false, TArray<FString>* _out_channels = nullptr);
+
+	virtual void TickComponent(float _delta_time, ELevelTick _tick_type, FActorComponentTickFunction* _this_tick_function) override;
+
+	// Closes the connection. Messages still in flight are discarded
+	virtual void EndPlay(const EEndPlayReason::Type _end_play_reason) override;
+
+	// Handles closing the connection and freeing up the socket resources
+	virtual ~UTwitchIRCComponent();
+
+protected:
+
+	// Whether this component connects to chat. False when another machine ingests it, like the server in multiplayer
+	virtual bool ShouldIngestChat() const { return true; }
+
+private:
+
+	friend class FTwitchIRCConnectionPool;
+	friend struct FTwitchPlayTestAccess;
+
+	// Gets the ID of a channel, interning it if needed. INDEX_NONE if the name is empty
+	int32 InternChannel(const FString& _channel);
+
+	// Subscribes to the connections of username_ and listens to the joined channels
+	bool AcquireConnectionPool();
+
+	// Unsubscribes from the connections, if any
+	void ReleaseConnectionPool();
+
+	// Fires OnMessageReceived, then the handlers of the channel, and adds the message to the batch. Called by the connection pool
+	void DispatchMessage(const FTwitchIRCReceivedMessage& _message, int32 _channel_id);
+
+	// Fires OnMessagesReceivedSpan and OnMessagesReceivedBatch with the messages of the frame, if any. Called by the connection pool
+	void DispatchMessageBatch();
+
+	void DispatchStateChange(ETwitchConnectionState _new_state, const FString& _reason);
+
+	void DispatchSendQueueReport(int32 _dropped_messages, int32 _delayed_messages, float _longest_delay_seconds);
+
+	void DispatchInboundQueueReport(int32 _shed_messages, int32 _deferred_messages);
+};
@@ -1,145 +1,471 @@
-// Copyright (C) Simone Di Gravio <email: altairjp@gmail.com> - All Rights Reserved
-
-#pragma once
-
-#include "Components/TwitchIRCComponent.h"
-#include "TwitchPlayComponent.generated.h"
-
-/**
- * Declaration of delegate type for commands received from chat.
- * Delegate signature should receive three parameters:
- * _command_name (const FString&) - Name of the command received.
- * _command_options (const TArray<FString>&) - Additional array of options for the command being invoked.
- * _sender_username (const FString&) - Username of who triggered the command.
- */
-DECLARE_DYNAMIC_DELEGATE_ThreeParams(FOnCommandReceived, const FString&, _command_name, const TArray<FString>&, _command_options, const FString&, _sender_username);
-
-
-/**
- * Works the same as UTwitchIRCComponent, but enables to subscribe to events that are fired on specific chat commands.
- * You can still send and receive messages to/from channel chat.
- * Subscribe to OnMessageReceived to know when a message has harrived.
- * Subscribe to specific commands by registering with RegisterCommand() to receive events for that command.
- * Only one object/function per command can be subscribed. Might change in later versions of the API.
- * You can change the default characters for commands/options encapsulation via SetupEncasulationChars().
- * Remember to first Connect(), SetUserInfo() and then AuthenticateTwitchIRC() before trying to send messages.
- */
-UCLASS(ClassGroup = (TwitchAPI), meta = (BlueprintSpawnableComponent))
-class TWITCHPLAY_API UTwitchPlayComponent : public UTwitchIRCComponent
-{
-	GENERATED_BODY()
-
-public:
-
-	// Character to use for command encapsulation. Commands will be read in the form CHAR_Command_CHAR (no spaces or underscores!)
-	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Commands Setup")
-		FString command_encapsulation_char_ = "!";
-
-	/**
-	 * Character to use for command options encapsulation. Commands will be read in the form CHAR_Option1[,Option2,..]_CHAR (no spaces or underscores!)
-	 * Multiple options can be specified and will be split into an FString array upon parsing
-	 */
-	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Commands Setup")
-		FString options_encapsulation_char_ = "#";
-
-private:
-
-	/**
-	 * Map of the command events currently bound.
-	 * Each time a new command event is subscribed to, a new map entry is added.
-	 * For each command only one function will be bound.
-	 * NOTE: Only methods marked as UFUNCTION can be bound dinamically!
-	 *
-	 * TODO: Unbind all events on component destruction? I don't know if it would generate memory leaks if not done
-	 */
-	TMap<FString, FOnCommandReceived> bound_events_;
-
-public:
-
-	/**
-	 * Constructor subscribes to message reception.
-	 */
-	UTwitchPlayComponent();
-
-	/**
-	 * Setups the encapsulation characters to use for commands and options.
-	 *
-	 * @param _command_char - Character(s) to use to encapsulate commands.
-	 * @param _options_char - Character(s) to use to encapsulate command options.
-	 */
-	UFUNCTION(BlueprintCallable, Category = "Commands Setup")
-		void SetupEncapsulationChars(const FString _command_char, const FString _options_char);
-
-	/**
-	 * Registers a command to receive an event whenever that command is called via chat.
-	 * Only one function associated with a single object can be registered per command (as a delegate pointer!).
-	 * You actually need to create a delegate, bind it to a function and pass that in by reference.
-	 * If you try to register another function or another object with the same command the new function of that object will replace the previous one.
-	 * If you need to fire multiple events when a single command is received consider having just one event calling all the others.
-	 *
-	 * @param _command_name - The command to register (CASE SENSITIVE).
-	 * @param _callback_function - The function to fire when the event rises.
-	 * @param _out_result - Result of the operation.
-	 *
-	 * @return Whether the registration was successfully completed.
-	 */
-	UFUNCTION(BlueprintCallable, Category = "Commands Setup")
-		bool RegisterCommand(const FString _command_name, const FOnCommandReceived& _callback_function, FString& _out_result);
-
-	/**
-	* Unregisters a command to stop receiving events whenever that command is called via chat.
-	* Keep in mind that since each command can only be bound to a single function (and single object) unregistering that command will remove any function from any object.
-	*
-	* @param _command_name - The command to unregister (CASE SENSITIVE).
-	* @param _callback_function - The command to unregister.
-	* @param _out_result - Result of the operation.
-	*
-	* @return Whether the unregistration was successfully completed.
-	*/
-	UFUNCTION(BlueprintCallable, Category = "Commands Setup")
-		bool UnregisterCommand(const FString _command_name, FString& _out_result);
-
-	virtual ~UTwitchPlayComponent();
-
-private:
-
-	/**
-	 * Handler for when a message is received.
-	 * Should call the parsing method to search for commands/options and fire the corresponding event.
-	 *
-	 * @param _message - The message that was received.
-	 * @param _username - Username of who sent the chat message
-	 *
-	 * NOTE: Method must be marked as UFUNCTION in order to bind a dynamic delegate to it!
-	 */
-	UFUNCTION()
-		void MessageReceivedHandler(const FString& _message, const FString& _username);
-
-	/**
-	 * Parses the message and returns any command associated with the message.
-	 *
-	 * @param _message - The message to parse.
-	 *
-	 * @return The command found, if any. Returns "" if no command was found.
-	 */
-	FString GetCommandString(const FString& _message) const;
-
-	/**
-	* Parses the message and returns any command options associated with the message.
-	*
-	* @param _message - The message to parse.
-	*
-	* @return The array of options found, if any. Returns an empty array if no command option was found.
-	*/
-	TArray<FString> GetCommandOptionsStrings(const FString& _message) const;
-
-	/**
-	 * Gets the string delimited by the chosen delimiter string.
-	 *
-	 * @param _in_string - The string to search in.
-	 * @param _delimiter - The delimiter characters for the string.
-	 *
-	 * @return String delimited by the delimiters characters. Returns "" if no delimited string was found.
-	 */
-	FString GetDelimitedString(const FString& _in_string, const FString& _delimiter) const;
-};
+// Copyright (C) Simone Di Gravio <email: altairjp@gmail.com> - All Rights Reserved
+
+#pragma once
+
+#include "Components/TwitchIRCComponent.h"
+#include "Commands/TwitchCommandTable.h"
+#include "Commands/TwitchCommandSchema.h"
+#include "Commands/TwitchCommandBatch.h"
+#include "Commands/TwitchKeywordMatcher.h"
+#include "Commands/TwitchTrendTracker.h"
+#include "Commands/TwitchVoteAggregator.h"
+#include "Commands/TwitchUserThrottle.h"
+#include "TwitchPlayComponent.generated.h"
+
+/**
+ * Declaration of delegate type for commands received from chat.
+ * Delegate signature should receive four parameters:
+ * _command_name (const FString&) - Name of the command received.
+ * _command_options (const TArray<FString>&) - Additional array of options for the command being invoked.
+ * _sender_username (const FString&) - Username of who triggered the command.
+ * _sender_handle (int32) - Interned handle of who triggered the command, stable for the whole session. See GetUserName().
+ * With b_server_authoritative_ handles are those of the server: clients can compare them, only the server can resolve them.
+ */
+DECLARE_DYNAMIC_DELEGATE_FourParams(FOnCommandReceived, const FString&, _command_name, const TArray<FString>&, _command_options, const FString&, _sender_username, int32, _sender_handle);
+
+/**
+ * Declaration of delegate type for commands registered with a schema (see RegisterCommandWithSchema).
+ * Delegate signature should receive four parameters:
+ * _command_name (const FString&) - Name of the command received.
+ * _command_args (const FTwitchCommandArgs&) - Options of the command, already checked and converted as the schema says.
+ * _sender_username (const FString&) - Username of who triggered the command.
+ * _sender_handle (int32) - Interned handle of who triggered the command. See GetUserName(). Server handles with b_server_authoritative_.
+ */
+DECLARE_DYNAMIC_DELEGATE_FourParams(FOnTypedCommandReceived, const FString&, _command_name, const FTwitchCommandArgs&, _command_args, const FString&, _sender_username, int32, _sender_handle);
+
+/**
+ * Declaration of delegate type for closed vote windows.
+ * Delegate signature should receive one parameter:
+ * _result (const FTwitchVoteWindowResult&) - Tallies and winner of the window.
+ */
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FOnVoteWindowClosed, const FTwitchVoteWindowResult&, _result);
+
+/**
+ * Declaration of delegate type for messages containing registered keywords.
+ * Delegate signature should receive four parameters:
+ * _message (const FString&) - The message.
+ * _hits (const TArray<FTwitchKeywordHit>&) - Every keyword found, with its position in the message. See GetKeyword().
+ * _username (const FString&) - Username of who sent the message.
+ * _user_handle (int32) - Interned handle of who sent the message. See GetUserName().
+ */
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_FourParams(FOnKeywordsMatched, const FString&, _message, const TArray<FTwitchKeywordHit>&, _hits, const FString&, _username, int32, _user_handle);
+
+
+/**
+ * Works the same as UTwitchIRCComponent, but enables to subscribe to events that are fired on specific chat commands.
+ * You can still send and receive messages to/from channel chat.
+ * Subscribe to OnMessageReceived to know when a message has harrived.
+ * Subscribe to specific commands by registering with RegisterCommand() to receive events for that command.
+ * Register them with RegisterCommandWithSchema() instead to get their options checked and converted to numbers, enum values or directions.
+ * Only one object/function per command can be subscribed. Might change in later versions of the API.
+ * You can change the default characters for commands/options encapsulation via SetupEncasulationChars().
+ * Enable vote mode to tally registered commands over a time window instead of firing an event per command (see OnVoteWindowClosed).
+ * Set keywords (words, phrases, emote names) with SetKeywords() to be told through OnKeywordsMatched whenever chat contains them.
+ * Enable trend tracking to read the most used commands, options, emotes and the most active users of the last minute with GetTrending().
+ * In multiplayer enable b_server_authoritative_: only the server connects, and every machine fires the commands it replicates.
+ * Remember to first Connect(), SetUserInfo() and then AuthenticateTwitchIRC() before trying to send messages.
+ */
+UCLASS(ClassGroup = (TwitchAPI), meta = (BlueprintSpawnableComponent))
+class TWITCHPLAY_API UTwitchPlayComponent : public UTwitchIRCComponent
+{
+	GENERATED_BODY()
+
+public:
+
+	// Character to use for command encapsulation. Commands will be read in the form CHAR_Command_CHAR (no spaces or underscores!)
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Commands Setup")
+		FString command_encapsulation_char_ = "!";
+
+	/**
+	 * Character to use for command options encapsulation. Commands will be read in the form CHAR_Option1[,Option2,..]_CHAR (no spaces or underscores!)
+	 * Multiple options can be specified and will be split into an FString array upon parsing
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Commands Setup")
+		FString options_encapsulation_char_ = "#";
+
+	/**
+	 * When enabled registered commands are not fired one by one. They are counted as votes
+	 * and OnVoteWindowClosed is fired once at the end of every vote window.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Votes Setup")
+		bool b_vote_mode_enabled_ = false;
+
+	// Length of a vote window in seconds (real time)
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Votes Setup", meta = (ClampMin = "0.1"))
+		float vote_window_seconds_ = 5.0f;
+
+	// How the winner of a window is chosen. Changes apply from the next window
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Votes Setup")
+		ETwitchVotePolicy vote_policy_ = ETwitchVotePolicy::Democracy;
+
+	// How multiple votes of the same user inside a window are counted. Changes apply from the next window
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Votes Setup")
+		ETwitchVoteUserRule vote_user_rule_ = ETwitchVoteUserRule::MultipleVotes;
+
+	// Event called at the end of each vote window, with the tallies of the window
+	UPROPERTY(BlueprintAssignable, Category = "Vote Events")
+		FOnVoteWindowClosed OnVoteWindowClosed;
+
+	/**
+	 * Enables the per user flood protection: commands over the rate below, or repeating the previous message
+	 * of the same user, are dropped before any event is fired (or vote counted).
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Spam Protection")
+		bool b_throttle_users_ = false;
+
+	// Times each user can send the same command per window. 0 for no limit
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Spam Protection", meta = (ClampMin = "0"))
+		float user_commands_per_window_ = 3.0f;
+
+	// Length of the rate window in seconds. The allowance refills continuously over it
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Spam Protection", meta = (ClampMin = "0.1"))
+		float user_window_seconds_ = 10.0f;
+
+	// A command repeating the previous message of its user within this many seconds is dropped. 0 to allow duplicates
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Spam Protection", meta = (ClampMin = "0"))
+		float duplicate_window_seconds_ = 30.0f;
+
+	/**
+	 * Size of the table tracking the users (24 bytes per entry), allocated once. Each user takes one entry
+	 * plus one per command used recently. When it is full the least recently active users are forgotten first.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Spam Protection", meta = (ClampMin = "1024"))
+		int32 user_table_capacity_ = 131072;
+
+	// Users (CASE INSENSITIVE) whose messages never fire commands or votes. Change it at runtime with IgnoreUser()/UnignoreUser()
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Spam Protection")
+		TArray<FString> ignored_users_;
+
+	// Keywords, phrases or emote names looked for anywhere in every message. Change them at runtime with SetKeywords()
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Keywords")
+		TArray<FString> keywords_;
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Keywords")
+		bool b_keywords_case_sensitive_ = false;
+
+	// Whether keywords only match as whole words, so "Kappa" is not found in "KappaPride"
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Keywords")
+		bool b_keywords_whole_words_ = true;
+
+	// Event called for every message containing at least one keyword. Messages of ignored users are skipped
+	UPROPERTY(BlueprintAssignable, Category = "Keyword Events")
+		FOnKeywordsMatched OnKeywordsMatched;
+
+	/**
+	 * Counts commands, options, users and emotes over a sliding window, for GetTrending().
+	 * Memory is fixed (about 200KB per category, allocated on first use) however busy the chat is.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Trends")
+		bool b_track_trends_ = false;
+
+	// Length of the trend window in seconds (real time). It slides by a twelfth of its length. Changing it resets the trends
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Trends", meta = (ClampMin = "1"))
+		float trend_window_seconds_ = 60.0f;
+
+	/**
+	 * In multiplayer only the server connects to chat. The commands it matches (after the spam protection) are sent
+	 * to every machine in a compact batch each net update of the owner, and fired everywhere in the same order.
+	 * Clients must register the same commands. Vote results are replicated as well. Messages, keywords and trends
+	 * stay on the server. The component replicates, so its owner must replicate too. No effect in standalone games.
+	 * Commands carry the username of their sender, and its handle on the server. Handles are server scoped: clients can
+	 * use them as keys, but GetUserName() and the other user lookups know nothing about them there.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Multiplayer")
+		bool b_server_authoritative_ = false;
+
+	// Size a command batch can't exceed. Commands that don't fit wait for the next net update
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Multiplayer", meta = (ClampMin = "64", ClampMax = "16384"))
+		int32 max_batch_bytes_ = 1024;
+
+private:
+
+	friend struct FTwitchPlayTestAccess;
+
+	// A registered command: either an event receiving the options as strings, or a schema and an event receiving typed arguments
+	struct FRegisteredCommand
+	{
+		FOnCommandReceived event_;
+
+		FOnTypedCommandReceived typed_event_;
+
+		// Null for commands registered without a schema. Shared, so compiling the commands doesn't copy it
+		TSharedPtr<const FTwitchCommandSchemaParser> schema_;
+	};
+
+	/**
+	 * Map of the command events currently bound.
+	 * Each time a new command event is subscribed to, a new map entry is added.
+	 * For each command only one function will be bound.
+	 * NOTE: Only methods marked as UFUNCTION can be bound dinamically!
+	 *
+	 * TODO: Unbind all events on component destruction? I don't know if it would generate memory leaks if not done
+	 */
+	TMap<FString, FRegisteredCommand> bound_events_;
+
+	/**
+	 * Registered commands compiled for matching. Rebuilt by CompileCommands() whenever bound_events_ changes.
+	 * compiled_events_ is indexed by the command index returned from the table.
+	 */
+	FTwitchCommandTable command_table_;
+
+	TArray<FRegisteredCommand> compiled_events_;
+
+	// Counts the votes of the current window when vote mode is enabled
+	FTwitchVoteAggregator vote_aggregator_;
+
+	// Real time the current vote window started at. Negative if no window is open
+	double vote_window_start_time_ = -1.0;
+
+	// Rate and duplicate tracking of every user, when b_throttle_users_ is enabled. Allocated on first use
+	FTwitchUserThrottle user_throttle_;
+
+	// Keys of ignored_users_ (see FTwitchUserThrottle::HashUser), so ignored users cost a single lookup
+	TSet<uint64> ignored_user_keys_;
+
+	// keywords_ compiled for scanning. Rebuilt by SetKeywords()
+	FTwitchKeywordMatcher keyword_matcher_;
+
+	// Hits of the message being handled, kept to reuse the allocation
+	TArray<FTwitchKeywordHit> keyword_hits_;
+
+	// Options of the command being fired. Overwritten by the next command, so their strings keep their allocations
+	TArray<FString> command_options_;
+
+	// Indexed by ETwitchTrendCategory
+	FTwitchTrendTracker trend_trackers_[4];
+
+	// Commands matched by the server waiting for the next batch, when b_server_authoritative_ is set
+	TArray<FTwitchBatchedCommand> pending_batch_commands_;
+
+	// Reused for every batch sent
+	FTwitchCommandBatch command_batch_;
+
+	// Real time the next batch can be sent at
+	double next_batch_time_ = 0.0;
+
+	int32 last_batch_bytes_ = 0;
+
+public:
+
+	/**
+	 * Constructor subscribes to message reception.
+	 */
+	UTwitchPlayComponent();
+
+	/**
+	 * Setups the encapsulation characters to use for commands and options.
+	 *
+	 * @param _command_char - Character(s) to use to encapsulate commands.
+	 * @param _options_char - Character(s) to use to encapsulate command options.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "Commands Setup")
+		void SetupEncapsulationChars(const FString _command_char, const FString _options_char);
+
+	/**
+	 * Registers a command to receive an event whenever that command is called via chat.
+	 * Only one function associated with a single object can be registered per command (as a delegate pointer!).
+	 * You actually need to create a delegate, bind it to a function and pass that in by reference.
+	 * If you try to register another function or another object with the same command the new function of that object will replace the previous one.
+	 * If you need to fire multiple events when a single command is received consider having just one event calling all the others.
+	 *
+	 * @param _command_name - The command to register (CASE SENSITIVE).
+	 * @param _callback_function - The function to fire when the event rises.
+	 * @param _out_result - Result of the operation.
+	 *
+	 * @return Whether the registration was successfully completed.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "Commands Setup")
+		bool RegisterCommand(const FString _command_name, const FOnCommandReceived& _callback_function, FString& _out_result);
+
+	/**
+	 * Registers a command whose options are arguments of known types, like "!move!#left,3#".
+	 * Options are parsed once in native code and delivered already converted. Commands whose options don't match
+	 * the schema (wrong types, out of range values, too many or too few arguments) are dropped before any event is fired,
+	 * or vote counted. Same replacement rules as RegisterCommand().
+	 *
+	 * @param _command_name - The command to register (CASE SENSITIVE).
+	 * @param _schema - Arguments the command expects.
+	 * @param _callback_function - The function to fire when the event rises.
+	 * @param _out_result - Result of the operation, or what is wrong with the schema.
+	 *
+	 * @return Whether the registration was successfully completed.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "Commands Setup")
+		bool RegisterCommandWithSchema(const FString _command_name, const FTwitchCommandSchema& _schema, const FOnTypedCommandReceived& _callback_function, FString& _out_result);
+
+	/**
+	* Unregisters a command to stop receiving events whenever that command is called via chat.
+	* Keep in mind that since each command can only be bound to a single function (and single object) unregistering that command will remove any function from any object.
+	*
+	* @param _command_name - The command to unregister (CASE SENSITIVE).
+	* @param _callback_function - The command to unregister.
+	* @param _out_result - Result of the operation.
+	*
+	* @return Whether the unregistration was successfully completed.
+	*/
+	UFUNCTION(BlueprintCallable, Category = "Commands Setup")
+		bool UnregisterCommand(const FString _command_name, FString& _out_result);
+
+	/**
+	 * Closes the current vote window right away and fires OnVoteWindowClosed. A new window starts immediately.
+	 * Useful for turn based games that decide when to collect the votes.
+	 * Does nothing unless vote mode is enabled, and on the clients of a server authoritative component (see b_server_authoritative_):
+	 * there the results come from the windows closed by the server.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "Votes")
+		void CloseVoteWindow();
+
+	/**
+	 * Stops handling the commands of a user.
+	 *
+	 * @param _username - The user to ignore (CASE INSENSITIVE).
+	 */
+	UFUNCTION(BlueprintCallable, Category = "Spam Protection")
+		void IgnoreUser(const FString _username);
+
+	/**
+	 * Handles the commands of an ignored user again.
+	 *
+	 * @param _username - The user (CASE INSENSITIVE).
+	 *
+	 * @return Whether the user was ignored.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "Spam Protection")
+		bool UnignoreUser(const FString _username);
+
+	// Forgets the rates and last messages of every user
+	UFUNCTION(BlueprintCallable, Category = "Spam Protection")
+		void ResetUserThrottle();
+
+	/**
+	 * Replaces the keywords looked for in chat. They are compiled once here, so thousands of them
+	 * still cost a single pass over each message.
+	 *
+	 * @param _keywords - Keywords, phrases or emote names. Empty ones are ignored.
+	 * @param _b_case_sensitive - Whether the case of the keywords must match.
+	 * @param _b_whole_words - Whether keywords only match as whole words.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "Keywords")
+		void SetKeywords(const TArray<FString>& _keywords, bool _b_case_sensitive = false, bool _b_whole_words = true);
+
+	// A keyword, from the index of a hit. Empty for invalid indices
+	UFUNCTION(BlueprintPure, Category = "Keywords")
+		FString GetKeyword(int32 _keyword_index) const;
+
+	/**
+	 * Gets what was seen the most in the trend window. Cheap enough to call every frame: the top entries are kept
+	 * up to date as messages arrive. Needs b_track_trends_.
+	 *
+	 * @param _category - What to read.
+	 * @param _max_entries - Maximum amount of entries. At most 32 are tracked.
+	 * @param _out_entries - Entries, most seen first. Counts are estimates that can slightly exceed the real ones.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "Trends")
+		void GetTrending(ETwitchTrendCategory _category, int32 _max_entries, TArray<FTwitchTrendEntry>& _out_entries);
+
+	// Forgets the trends of every category
+	UFUNCTION(BlueprintCallable, Category = "Trends")
+		void ResetTrends();
+
+	// Size of the last command batch sent by the server, in bytes. See b_server_authoritative_
+	UFUNCTION(BlueprintCallable, BlueprintPure, Category = "Multiplayer")
+		int32 GetLastCommandBatchBytes() const { return last_batch_bytes_; }
+
+	// Builds the ignored users lookup and the keywords from what was set in the editor
+	virtual void BeginPlay() override;
+
+	// Closes vote windows when their time is up
+	virtual void TickComponent(float _delta_time, ELevelTick _tick_type, FActorComponentTickFunction* _this_tick_function) override;
+
+	virtual ~UTwitchPlayComponent();
+
+protected:
+
+	// Clients of a server authoritative component get the commands from the server
+	virtual bool ShouldIngestChat() const override;
+
+private:
+
+	// Fires the commands of a batch, on the server and on every client
+	UFUNCTION(NetMulticast, Reliable)
+		void MulticastCommandBatch(const FTwitchCommandBatch& _batch);
+
+	UFUNCTION(NetMulticast, Reliable)
+		void MulticastVoteWindowClosed(const FTwitchVoteWindowResult& _result);
+
+	// Whether matched commands go to the clients instead of being fired right away
+	bool IsReplicatingCommands() const;
+
+	// Queues a command that went through for the next batch
+	void QueueReplicatedCommand(int32 _command_index, const FTwitchCommandArgs& _command_args, const FString& _message, const FString& _username, int32 _user_handle);
+
+	// Sends the queued commands, as many as fit in max_batch_bytes_, once per net update of the owner
+	void SendCommandBatch();
+
+	// Fires the event of a command received in a batch, if it is registered on this machine
+	void FireReplicatedCommand(const FTwitchBatchedCommand& _command);
+
+	/**
+	 * Handler for when a message is received.
+	 * Should call the parsing method to search for commands/options and fire the corresponding event.
+	 *
+	 * @param _message - The message that was received.
+	 * @param _username - Username of who sent the chat message
+	 * @param _user_handle - Interned handle of who sent the chat message
+	 *
+	 * NOTE: Method must be marked as UFUNCTION in order to bind a dynamic delegate to it!
+	 */
+	UFUNCTION()
+		void MessageReceivedHandler(const FString& _message, const FString& _username, int32 _user_handle);
+
+	// Adds or replaces a command in bound_events_. Both registration functions end up here
+	bool AddCommand(const FString& _command_name, const FRegisteredCommand& _command, FString& _out_result);
+
+	// Rebuilds command_table_ and compiled_events_ from bound_events_
+	// Votes of the current window and the user rates are discarded, since command indices change
+	void CompileCommands();
+
+	// Whether a matched command passes the per user flood protection. Counts it if it does
+	bool AllowUserCommand(int32 _command_index, const FString& _message, int32 _user_handle);
+
+	void RebuildIgnoredUsers();
+
+	// Fires OnKeywordsMatched if the message contains any keyword
+	void MatchKeywords(const FString& _message, const FString& _username, int32 _user_handle);
+
+	// Tracker of a category, with the current window
+	FTwitchTrendTracker& GetTrendTracker(ETwitchTrendCategory _category);
+
+	// Counts the sender of a message and the emotes it contains (from the "emotes" tag)
+	void CountMessageTrends(const FString& _message, int32 _user_handle, double _now);
+
+	// Counts a command that went through, and its options
+	void CountCommandTrends(int32 _command_index, const FString& _message, double _now);
+
+	/**
+	* Parses the message and returns any command options associated with the message.
+	*
+	* @param _message - The message to parse.
+	*
+	* @return The array of options found, if any. Returns an empty array if no command option was found.
+	*/
+	TArray<FString> GetCommandOptionsStrings(const FString& _message) const;
+
+	/**
+	 * Parses the message into an array of command options, overwriting the strings already in it.
+	 *
+	 * @param _message - The message to parse.
+	 * @param _out_options - The options found, if any. Empty if no command option was found.
+	 */
+	void GetCommandOptionsStrings(const FString& _message, TArray<FString>& _out_options) const;
+
+	/**
+	 * Gets the string delimited by the chosen delimiter string. Same rules as FTwitchCommandSchemaParser::FindDelimited().
+	 *
+	 * @param _in_string - The string to search in.
+	 * @param _delimiter - The delimiter characters for the string.
+	 *
+	 * @return String delimited by the delimiters characters. Returns "" if no delimited string was found.
+	 */
+	FString GetDelimitedString(const FString& _in_string, const FString& _delimiter) const;
+};
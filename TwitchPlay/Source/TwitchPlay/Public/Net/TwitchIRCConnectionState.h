@@ -0,0 +1,32 @@
+// Copyright (C) Simone Di Gravio <email: altairjp@gmail.com> - All Rights Reserved
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "TwitchIRCConnectionState.generated.h"
+
+/**
+ * State of the connection to the Twitch IRC server.
+ * The connection moves through Resolving -> Connecting -> Connected -> Authenticating -> Joined on its own thread.
+ * If the connection drops it waits (WaitingToReconnect) and starts over from Resolving.
+ */
+UENUM(BlueprintType)
+enum class ETwitchConnectionState : uint8
+{
+	// Not connected and not trying to
+	Disconnected,
+	// Looking up the server address
+	Resolving,
+	// Waiting for the socket to connect
+	Connecting,
+	// Socket connected, waiting for the credentials (see AuthenticateTwitchIRC)
+	Connected,
+	// Credentials sent, waiting for the server welcome
+	Authenticating,
+	// Authenticated. Channels are joined and chat messages are sent
+	Joined,
+	// The connection failed or dropped, waiting before the next attempt
+	WaitingToReconnect,
+	// The server refused the credentials. No further attempt until new credentials are provided
+	AuthenticationFailed
+};
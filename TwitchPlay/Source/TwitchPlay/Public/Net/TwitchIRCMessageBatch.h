@@ -0,0 +1,105 @@
+// Copyright (C) Simone Di Gravio <email: altairjp@gmail.com> - All Rights Reserved
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "TwitchIRCMessageBatch.generated.h"
+
+/**
+ * Every message a component received in a frame, as parallel arrays: the same index is the same message.
+ * Delivered once per frame by OnMessagesReceivedBatch, in the order OnMessageReceived fired them.
+ * The contents are copies, only made while OnMessagesReceivedBatch is bound.
+ */
+USTRUCT(BlueprintType)
+struct TWITCHPLAY_API FTwitchMessageBatch
+{
+	GENERATED_BODY()
+
+	// Content of each message
+	UPROPERTY(BlueprintReadOnly, Category = "Message Batch")
+		TArray<FString> contents_;
+
+	// Interned handle of each sender. INDEX_NONE for server messages. See GetUserName()
+	UPROPERTY(BlueprintReadOnly, Category = "Message Batch")
+		TArray<int32> user_handles_;
+
+	// Interned ID of each channel. INDEX_NONE for server messages. See GetChannelName()
+	UPROPERTY(BlueprintReadOnly, Category = "Message Batch")
+		TArray<int32> channel_ids_;
+
+	// When each message was read from the socket, in world real time seconds (see GetRealTimeSeconds)
+	UPROPERTY(BlueprintReadOnly, Category = "Message Batch")
+		TArray<float> receive_times_;
+
+	int32 Num() const
+	{
+		return contents_.Num();
+	}
+
+	void Reset()
+	{
+		contents_.Reset();
+		user_handles_.Reset();
+		channel_ids_.Reset();
+		receive_times_.Reset();
+	}
+};
+
+/**
+ * Messages a component received in a frame, gathered for the batch events. Same layout as FTwitchMessageBatch,
+ * but contents and usernames point to strings owned by the connection pool, which keeps them until the batch events fired.
+ */
+struct FTwitchMessageFrame
+{
+	TArray<const FString*> contents_;
+	TArray<int32> user_handles_;
+	TArray<int32> channel_ids_;
+	TArray<uint64> receive_cycles_;
+	TArray<const FString*> usernames_;
+
+	int32 Num() const
+	{
+		return contents_.Num();
+	}
+
+	// Empties the arrays, keeping their allocations for the next frame
+	void Reset()
+	{
+		contents_.Reset();
+		user_handles_.Reset();
+		channel_ids_.Reset();
+		receive_cycles_.Reset();
+		usernames_.Reset();
+	}
+};
+
+/**
+ * Views over a FTwitchMessageFrame, for native listeners. Nothing is copied, not even the contents:
+ * the views and the strings they point to are only valid during the callback.
+ */
+struct FTwitchMessageSpan
+{
+	TArrayView<const FString* const> contents_;
+	TArrayView<const int32> user_handles_;
+	TArrayView<const int32> channel_ids_;
+	// When each message was read from the socket (FPlatformTime::Cycles64)
+	TArrayView<const uint64> receive_cycles_;
+	// Null for server messages
+	TArrayView<const FString* const> usernames_;
+
+	FTwitchMessageSpan() = default;
+
+	explicit FTwitchMessageSpan(const FTwitchMessageFrame& _frame)
+		: contents_(_frame.contents_.GetData(), _frame.contents_.Num())
+		, user_handles_(_frame.user_handles_.GetData(), _frame.user_handles_.Num())
+		, channel_ids_(_frame.channel_ids_.GetData(), _frame.channel_ids_.Num())
+		, receive_cycles_(_frame.receive_cycles_.GetData(), _frame.receive_cycles_.Num())
+		, usernames_(_frame.usernames_.GetData(), _frame.usernames_.Num())
+	{
+	}
+
+	int32 Num() const
+	{
+		return contents_.Num();
+	}
+};
@@ -0,0 +1,21 @@
+// Copyright (C) Simone Di Gravio <email: altairjp@gmail.com> - All Rights Reserved
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "TwitchIRCOverloadPolicy.generated.h"
+
+/**
+ * What a connection keeps once more messages arrive than the game thread dispatches, like during a raid.
+ * Past twice the capacity of the inbound queue new messages are always shed, whatever the policy.
+ */
+UENUM(BlueprintType)
+enum class ETwitchOverloadPolicy : uint8
+{
+	// The newest messages are kept: the oldest ones are shed down to the capacity before dispatching
+	DropOldest,
+	// An evenly spread share of the messages is kept, from all of them at the capacity to none at twice the capacity
+	UniformSampling,
+	// Only messages containing the command marker (see overload_command_marker_) are kept
+	CommandsOnly
+};
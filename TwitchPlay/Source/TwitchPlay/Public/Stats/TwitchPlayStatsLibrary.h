@@ -0,0 +1,171 @@
+// Copyright (C) Simone Di Gravio <email: altairjp@gmail.com> - All Rights Reserved
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Kismet/BlueprintFunctionLibrary.h"
+#include "TwitchPlayStatsLibrary.generated.h"
+
+/**
+ * Points of the message pipeline with a latency histogram.
+ */
+UENUM(BlueprintType)
+enum class ETwitchPlayLatency : uint8
+{
+	// Tokenizing one line, on the connection thread
+	Parse,
+	// From the socket read on the connection thread to the dispatch on the game thread
+	Queue,
+	// Broadcasting one message (OnMessageReceived and the channel handlers) on the game thread
+	Dispatch,
+	// From the socket read to the command delegate (or the vote being counted)
+	Command,
+
+	Num UMETA(Hidden)
+};
+
+/**
+ * Totals of the message pipeline since the stats were reset, for every connection.
+ * Values saturate at the largest int32.
+ */
+USTRUCT(BlueprintType)
+struct TWITCHPLAY_API FTwitchPlayCounters
+{
+	GENERATED_BODY()
+
+	// Bytes read from the sockets
+	UPROPERTY(BlueprintReadOnly, Category = "Stats")
+		int32 bytes_in_ = 0;
+
+	// Bytes written to the sockets
+	UPROPERTY(BlueprintReadOnly, Category = "Stats")
+		int32 bytes_out_ = 0;
+
+	// Complete lines tokenized
+	UPROPERTY(BlueprintReadOnly, Category = "Stats")
+		int32 lines_parsed_ = 0;
+
+	// Messages handed to the game thread
+	UPROPERTY(BlueprintReadOnly, Category = "Stats")
+		int32 messages_dispatched_ = 0;
+
+	// Messages containing a registered command
+	UPROPERTY(BlueprintReadOnly, Category = "Stats")
+		int32 commands_matched_ = 0;
+
+	// Messages received by a UTwitchPlayComponent without any registered command
+	UPROPERTY(BlueprintReadOnly, Category = "Stats")
+		int32 commands_unmatched_ = 0;
+
+	// Commands dropped by the per user flood protection
+	UPROPERTY(BlueprintReadOnly, Category = "Stats")
+		int32 commands_suppressed_ = 0;
+
+	// Commands dropped because their options did not match the schema of the command
+	UPROPERTY(BlueprintReadOnly, Category = "Stats")
+		int32 commands_malformed_ = 0;
+
+	// Messages shed by the overload policy of the inbound queues
+	UPROPERTY(BlueprintReadOnly, Category = "Stats")
+		int32 messages_shed_ = 0;
+
+	// Messages left for a later frame by the dispatch budget, once per frame they waited
+	UPROPERTY(BlueprintReadOnly, Category = "Stats")
+		int32 messages_deferred_ = 0;
+
+	// Keywords found in chat by UTwitchPlayComponent
+	UPROPERTY(BlueprintReadOnly, Category = "Stats")
+		int32 keyword_hits_ = 0;
+
+	// Commands the server sent to the clients in command batches (see b_server_authoritative_)
+	UPROPERTY(BlueprintReadOnly, Category = "Stats")
+		int32 commands_replicated_ = 0;
+
+	// Bytes of the command batches sent to the clients, headers excluded
+	UPROPERTY(BlueprintReadOnly, Category = "Stats")
+		int32 batch_bytes_ = 0;
+
+	// Commands the server could not replicate: the backlog of commands waiting for a batch was full, or a command was bigger than a whole batch
+	UPROPERTY(BlueprintReadOnly, Category = "Stats")
+		int32 commands_dropped_ = 0;
+
+	// Messages waiting for the game thread at the start of the last frame
+	UPROPERTY(BlueprintReadOnly, Category = "Stats")
+		int32 inbound_queue_depth_ = 0;
+
+	// Lines waiting to be sent at the start of the last frame
+	UPROPERTY(BlueprintReadOnly, Category = "Stats")
+		int32 send_queue_depth_ = 0;
+};
+
+/**
+ * Latency distribution of a pipeline stage. Buckets are powers of two in microseconds,
+ * so percentiles are upper bounds accurate to a factor of two.
+ */
+USTRUCT(BlueprintType)
+struct TWITCHPLAY_API FTwitchPlayLatencyHistogram
+{
+	GENERATED_BODY()
+
+	// Upper bound of each bucket in milliseconds. The last bucket also holds everything above it
+	UPROPERTY(BlueprintReadOnly, Category = "Stats")
+		TArray<float> bucket_upper_bounds_ms_;
+
+	// Samples of each bucket, in sync with bucket_upper_bounds_ms_
+	UPROPERTY(BlueprintReadOnly, Category = "Stats")
+		TArray<int32> bucket_counts_;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Stats")
+		int32 num_samples_ = 0;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Stats")
+		float average_ms_ = 0.0f;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Stats")
+		float p50_ms_ = 0.0f;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Stats")
+		float p90_ms_ = 0.0f;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Stats")
+		float p99_ms_ = 0.0f;
+
+	// Exact, not bucketed
+	UPROPERTY(BlueprintReadOnly, Category = "Stats")
+		float max_ms_ = 0.0f;
+};
+
+/**
+ * Counters and latency histograms of the message pipeline, to find out whether lag comes from the network,
+ * the parsing or the handlers. The same counters show live with "stat TwitchPlay".
+ */
+UCLASS()
+class TWITCHPLAY_API UTwitchPlayStatsLibrary : public UBlueprintFunctionLibrary
+{
+	GENERATED_BODY()
+
+public:
+
+	// Totals since the stats were reset
+	UFUNCTION(BlueprintCallable, BlueprintPure, Category = "TwitchPlay|Stats")
+		static FTwitchPlayCounters GetTwitchPlayCounters();
+
+	// Latency distribution of a stage since the stats were reset
+	UFUNCTION(BlueprintCallable, BlueprintPure, Category = "TwitchPlay|Stats")
+		static FTwitchPlayLatencyHistogram GetTwitchPlayLatencyHistogram(ETwitchPlayLatency _stage);
+
+	// Clears the counters (except the queue depths) and the histograms
+	UFUNCTION(BlueprintCallable, Category = "TwitchPlay|Stats")
+		static void ResetTwitchPlayStats();
+
+	/**
+	 * Writes the counters and the histograms to a CSV file. Also available as the TwitchPlay.Stats.Dump console command.
+	 *
+	 * @param _file_path - Absolute or relative to the project directory. If empty a timestamped file is written in Saved/Profiling/TwitchPlay.
+	 * @param _out_file_path - Full path of the written file.
+	 *
+	 * @return Whether the file was written.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "TwitchPlay|Stats")
+		static bool DumpTwitchPlayStatsToCSV(const FString& _file_path, FString& _out_file_path);
+};
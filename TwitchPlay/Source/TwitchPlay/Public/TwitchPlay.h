@@ -1,15 +1,17 @@
-// Copyright (C) Simone Di Gravio <email: altairjp@gmail.com> - All Rights Reserved
-
-#pragma once
-
-#include "Modules/ModuleManager.h"
-#include "Engine.h"
-
-class FTwitchPlayModule : public IModuleInterface
-{
-public:
-
-	/** IModuleInterface implementation */
-	virtual void StartupModule() override;
-	virtual void ShutdownModule() override;
+// Copyright (C) Simone Di Gravio <email: altairjp@gmail.com> - All Rights Reserved
+
+#pragma once
+
+#include "Modules/ModuleManager.h"
+#include "Engine.h"
+
+DECLARE_LOG_CATEGORY_EXTERN(LogTwitchPlay, Log, All);
+
+class FTwitchPlayModule : public IModuleInterface
+{
+public:
+
+	/** IModuleInterface implementation */
+	virtual void StartupModule() override;
+	virtual void ShutdownModule() override;
 };
\ No newline at end of file
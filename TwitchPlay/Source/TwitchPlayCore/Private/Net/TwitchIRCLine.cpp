@@ -0,0 +1,265 @@
+// Copyright (C) Simone Di Gravio <email: altairjp@gmail.com> - All Rights Reserved
+
+#include "Net/TwitchIRCLine.h"
+#include "Net/TwitchIRCUtf8.h"
+
+bool FTwitchIRCStringView::Equals(const ANSICHAR* _other) const
+{
+	// Compare up to our length, then make sure the other string ends there too
+	for (int32 cycle_char = 0; cycle_char < length_; cycle_char++)
+	{
+		if (_other[cycle_char] != data_[cycle_char])
+		{
+			return false;
+		}
+	}
+	return _other[length_] == '\0';
+}
+
+int32 FTwitchIRCStringView::Find(ANSICHAR _char, int32 _start_index) const
+{
+	for (int32 cycle_char = FMath::Max(_start_index, 0); cycle_char < length_; cycle_char++)
+	{
+		if (data_[cycle_char] == _char)
+		{
+			return cycle_char;
+		}
+	}
+	return INDEX_NONE;
+}
+
+FTwitchIRCStringView FTwitchIRCStringView::Mid(int32 _start, int32 _count) const
+{
+	const int32 start = FMath::Clamp(_start, 0, length_);
+	const int32 count = FMath::Clamp(_count, 0, length_ - start);
+	return FTwitchIRCStringView(data_ + start, count);
+}
+
+FString FTwitchIRCStringView::ToString() const
+{
+	FString string;
+	TwitchIRCUtf8::DecodeInto(data_, length_, string);
+	return string;
+}
+
+void FTwitchIRCStringView::ToString(FString& _out_string) const
+{
+	TwitchIRCUtf8::DecodeInto(data_, length_, _out_string);
+}
+
+int32 FTwitchIRCTags::Num() const
+{
+	BuildIndex();
+	return entries_.Num();
+}
+
+bool FTwitchIRCTags::FindRaw(const ANSICHAR* _key, FTwitchIRCStringView& _out_escaped_value) const
+{
+	BuildIndex();
+
+	for (const FTagEntry& entry : entries_)
+	{
+		if (raw_tags_.Mid(entry.key_start_, entry.key_length_).Equals(_key))
+		{
+			_out_escaped_value = raw_tags_.Mid(entry.value_start_, entry.value_length_);
+			return true;
+		}
+	}
+	return false;
+}
+
+bool FTwitchIRCTags::GetValue(const ANSICHAR* _key, FString& _out_value) const
+{
+	FTwitchIRCStringView escaped_value;
+	if (!FindRaw(_key, escaped_value))
+	{
+		return false;
+	}
+
+	// Most values (ids, numbers, colors) contain no escape sequence and can be converted directly
+	_out_value = escaped_value.Find('\\') == INDEX_NONE ? escaped_value.ToString() : Unescape(escaped_value);
+	return true;
+}
+
+bool FTwitchIRCTags::GetInt64(const ANSICHAR* _key, int64& _out_value) const
+{
+	FTwitchIRCStringView value;
+	if (!FindRaw(_key, value) || value.IsEmpty())
+	{
+		return false;
+	}
+
+	int64 result = 0;
+	for (int32 cycle_char = 0; cycle_char < value.Len(); cycle_char++)
+	{
+		const ANSICHAR digit = value[cycle_char];
+		if (digit < '0' || digit > '9')
+		{
+			return false;
+		}
+		// Values come from chat: one that doesn't fit is rejected instead of overflowing
+		if (result > (MAX_int64 - (digit - '0')) / 10)
+		{
+			return false;
+		}
+		result = result * 10 + (digit - '0');
+	}
+	_out_value = result;
+	return true;
+}
+
+FString FTwitchIRCTags::Unescape(const FTwitchIRCStringView& _escaped_value)
+{
+	TArray<ANSICHAR, TInlineAllocator<256>> unescaped;
+	unescaped.Reserve(_escaped_value.Len());
+
+	for (int32 cycle_char = 0; cycle_char < _escaped_value.Len(); cycle_char++)
+	{
+		ANSICHAR current = _escaped_value[cycle_char];
+		if (current == '\\')
+		{
+			// A lone backslash at the end of the value is dropped
+			if (++cycle_char == _escaped_value.Len())
+			{
+				break;
+			}
+
+			current = _escaped_value[cycle_char];
+			switch (current)
+			{
+			case ':': current = ';'; break;
+			case 's': current = ' '; break;
+			case 'r': current = '\r'; break;
+			case 'n': current = '\n'; break;
+			default: break; // "\\" and unknown sequences map to the escaped character itself
+			}
+		}
+		unescaped.Add(current);
+	}
+
+	return FTwitchIRCStringView(unescaped.GetData(), unescaped.Num()).ToString();
+}
+
+void FTwitchIRCTags::BuildIndex() const
+{
+	if (b_indexed_)
+	{
+		return;
+	}
+	b_indexed_ = true;
+
+	// Offsets are stored in 16 bits. IRCv3 limits the tags section to 8191 bytes anyway
+	const int32 length = FMath::Min(raw_tags_.Len(), static_cast<int32>(MAX_uint16));
+	const ANSICHAR* const data = raw_tags_.GetData();
+
+	// Single pass over "key=value;key2=value2". Tags without a value ("key") are allowed
+	int32 tag_start = 0;
+	int32 key_end = INDEX_NONE;
+	for (int32 cycle_char = 0; cycle_char <= length; cycle_char++)
+	{
+		if (cycle_char < length && data[cycle_char] != ';')
+		{
+			if (data[cycle_char] == '=' && key_end == INDEX_NONE)
+			{
+				key_end = cycle_char;
+			}
+			continue;
+		}
+
+		const int32 tag_end = cycle_char;
+		if (key_end == INDEX_NONE)
+		{
+			key_end = tag_end;
+		}
+
+		if (key_end > tag_start)
+		{
+			FTagEntry entry;
+			entry.key_start_ = static_cast<uint16>(tag_start);
+			entry.key_length_ = static_cast<uint16>(key_end - tag_start);
+			entry.value_start_ = static_cast<uint16>(FMath::Min(key_end + 1, tag_end));
+			entry.value_length_ = static_cast<uint16>(tag_end - entry.value_start_);
+			entries_.Add(entry);
+		}
+
+		tag_start = tag_end + 1;
+		key_end = INDEX_NONE;
+	}
+}
+
+bool FTwitchIRCLine::Parse(const ANSICHAR* _line, int32 _length)
+{
+	*this = FTwitchIRCLine();
+
+	const ANSICHAR* cursor = _line;
+	const ANSICHAR* const end = _line + _length;
+
+	// Returns the end of the space separated token starting at _from
+	auto token_end = [end](const ANSICHAR* _from)
+	{
+		while (_from < end && *_from != ' ')
+		{
+			++_from;
+		}
+		return _from;
+	};
+
+	// Multiple spaces between parts are tolerated
+	auto skip_spaces = [end](const ANSICHAR* _from)
+	{
+		while (_from < end && *_from == ' ')
+		{
+			++_from;
+		}
+		return _from;
+	};
+
+	// Tags: "@key=value;key2=value2 "
+	if (cursor < end && *cursor == '@')
+	{
+		const ANSICHAR* tags_end = token_end(cursor + 1);
+		tags_ = FTwitchIRCStringView(cursor + 1, tags_end - (cursor + 1));
+		cursor = skip_spaces(tags_end);
+	}
+
+	// Prefix: ":nick!user@host "
+	if (cursor < end && *cursor == ':')
+	{
+		const ANSICHAR* prefix_end = token_end(cursor + 1);
+		prefix_ = FTwitchIRCStringView(cursor + 1, prefix_end - (cursor + 1));
+
+		const int32 nick_end = prefix_.Find('!');
+		nick_ = nick_end == INDEX_NONE ? FTwitchIRCStringView() : prefix_.Mid(0, nick_end);
+
+		cursor = skip_spaces(prefix_end);
+	}
+
+	// Command
+	const ANSICHAR* command_end = token_end(cursor);
+	command_ = FTwitchIRCStringView(cursor, command_end - cursor);
+	if (command_.IsEmpty())
+	{
+		return false;
+	}
+	cursor = skip_spaces(command_end);
+
+	// Parameters. Everything after a parameter starting with ':' is the trailing parameter, spaces included
+	while (cursor < end)
+	{
+		if (*cursor == ':')
+		{
+			trailing_ = FTwitchIRCStringView(cursor + 1, end - (cursor + 1));
+			b_has_trailing_ = true;
+			break;
+		}
+
+		const ANSICHAR* param_end = token_end(cursor);
+		if (num_params_ < MaxParams)
+		{
+			params_[num_params_++] = FTwitchIRCStringView(cursor, param_end - cursor);
+		}
+		cursor = skip_spaces(param_end);
+	}
+
+	return true;
+}
@@ -0,0 +1,143 @@
+// Copyright (C) Simone Di Gravio <email: altairjp@gmail.com> - All Rights Reserved
+
+#include "Net/TwitchIRCLineFramer.h"
+#include <string.h>
+
+FTwitchIRCLineFramer::FTwitchIRCLineFramer(int32 _capacity)
+{
+	const uint32 capacity = FMath::RoundUpToPowerOfTwo(FMath::Max(_capacity, 512));
+	storage_.SetNumUninitialized(capacity);
+	mask_ = capacity - 1;
+}
+
+void FTwitchIRCLineFramer::GetWritableRegion(uint8*& _out_data, int32& _out_size)
+{
+	const int32 capacity = storage_.Num();
+	const uint32 tail = (head_ + count_) & mask_;
+
+	_out_data = storage_.GetData() + tail;
+	_out_size = FMath::Min(capacity - count_, capacity - static_cast<int32>(tail));
+}
+
+void FTwitchIRCLineFramer::CommitWrite(int32 _size)
+{
+	check(_size >= 0 && count_ + _size <= storage_.Num());
+	count_ += _size;
+}
+
+int32 FTwitchIRCLineFramer::Append(const uint8* _data, int32 _size)
+{
+	int32 appended = 0;
+
+	// At most two copies: up to the end of the ring and then from its start
+	while (appended < _size)
+	{
+		uint8* region;
+		int32 region_size;
+		GetWritableRegion(region, region_size);
+		if (region_size == 0)
+		{
+			break;
+		}
+
+		const int32 copy_size = FMath::Min(region_size, _size - appended);
+		FMemory::Memcpy(region, _data + appended, copy_size);
+		CommitWrite(copy_size);
+		appended += copy_size;
+	}
+	return appended;
+}
+
+bool FTwitchIRCLineFramer::PopLine(const ANSICHAR*& _out_line, int32& _out_length)
+{
+	const int32 capacity = storage_.Num();
+
+	while (scan_offset_ < count_)
+	{
+		// Search the next contiguous segment of unscanned bytes for the line terminator
+		const uint32 segment_start = (head_ + scan_offset_) & mask_;
+		const int32 segment_size = FMath::Min(count_ - scan_offset_, capacity - static_cast<int32>(segment_start));
+		const uint8* segment = storage_.GetData() + segment_start;
+		const uint8* terminator = static_cast<const uint8*>(memchr(segment, '\n', segment_size));
+
+		if (terminator == nullptr)
+		{
+			scan_offset_ += segment_size;
+			continue;
+		}
+
+		// Length of the line up to (excluding) the '\n'
+		const int32 line_size = scan_offset_ + static_cast<int32>(terminator - segment);
+		const bool b_was_discarding = b_discarding_line_;
+		b_discarding_line_ = false;
+
+		// Strip the '\r' of the "\r\n" terminator
+		int32 content_size = line_size;
+		if (content_size > 0 && storage_[(head_ + content_size - 1) & mask_] == '\r')
+		{
+			content_size--;
+		}
+
+		// The remaining bytes of an overflowed line, or an empty line. Nothing to emit
+		if (b_was_discarding || content_size == 0)
+		{
+			Consume(line_size + 1);
+			continue;
+		}
+
+		if (head_ + content_size <= static_cast<uint32>(capacity))
+		{
+			// The line is contiguous, point straight into the ring
+			_out_line = reinterpret_cast<const ANSICHAR*>(storage_.GetData() + head_);
+		}
+		else
+		{
+			// The line wraps around the end of the ring, stitch it together in the (reused) scratch buffer
+			const int32 first_part = capacity - static_cast<int32>(head_);
+			wrapped_line_.SetNumUninitialized(content_size, false);
+			FMemory::Memcpy(wrapped_line_.GetData(), storage_.GetData() + head_, first_part);
+			FMemory::Memcpy(wrapped_line_.GetData() + first_part, storage_.GetData(), content_size - first_part);
+			_out_line = wrapped_line_.GetData();
+		}
+		_out_length = content_size;
+
+		// The bytes stay in place until the next write, only the indices move
+		Consume(line_size + 1);
+		return true;
+	}
+
+	// A full buffer without any terminator can never produce a line. Drop the partial line
+	// and keep dropping bytes until its terminator arrives
+	if (count_ == capacity)
+	{
+		if (!b_discarding_line_)
+		{
+			discarded_lines_++;
+		}
+		b_discarding_line_ = true;
+		Consume(count_);
+	}
+
+	return false;
+}
+
+void FTwitchIRCLineFramer::Reset()
+{
+	head_ = 0;
+	count_ = 0;
+	scan_offset_ = 0;
+	b_discarding_line_ = false;
+}
+
+void FTwitchIRCLineFramer::Consume(int32 _size)
+{
+	head_ = (head_ + _size) & mask_;
+	count_ -= _size;
+	scan_offset_ = 0;
+
+	// Restart from the beginning of the storage when empty so lines are less likely to wrap
+	if (count_ == 0)
+	{
+		head_ = 0;
+	}
+}
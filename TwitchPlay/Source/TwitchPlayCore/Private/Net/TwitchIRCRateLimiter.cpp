@@ -0,0 +1,45 @@
+// Copyright (C) Simone Di Gravio <email: altairjp@gmail.com> - All Rights Reserved
+
+#include "Net/TwitchIRCRateLimiter.h"
+#include "Misc/ScopeLock.h"
+
+FTwitchIRCRateLimiter::FTwitchIRCRateLimiter()
+{
+	SetRateLimit(20, 30.0);
+}
+
+void FTwitchIRCRateLimiter::SetRateLimit(int32 _messages_per_window, double _window_seconds)
+{
+	FScopeLock lock(&lock_);
+
+	// Burst + refill over a window never exceeds the budget. Below 2 messages there would be nothing left to refill
+	const int32 messages_per_window = FMath::Max(_messages_per_window, MinMessagesPerWindow);
+	max_tokens_ = messages_per_window * 0.5;
+	tokens_per_second_ = (messages_per_window - max_tokens_) / FMath::Max(_window_seconds, 1.0);
+
+	// The refill time is kept: a budget shared by several connections doesn't hand out a new burst when it changes
+	tokens_ = FMath::Min(tokens_, max_tokens_);
+}
+
+bool FTwitchIRCRateLimiter::TryConsume(double _now)
+{
+	FScopeLock lock(&lock_);
+
+	// The bucket starts full
+	if (last_refill_time_ < 0.0)
+	{
+		tokens_ = max_tokens_;
+	}
+	else
+	{
+		tokens_ = FMath::Min(max_tokens_, tokens_ + FMath::Max(_now - last_refill_time_, 0.0) * tokens_per_second_);
+	}
+	last_refill_time_ = FMath::Max(last_refill_time_, _now);
+
+	if (tokens_ < 1.0)
+	{
+		return false;
+	}
+	tokens_ -= 1.0;
+	return true;
+}
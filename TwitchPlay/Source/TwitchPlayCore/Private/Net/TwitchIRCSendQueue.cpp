@@ -0,0 +1,171 @@
+// Copyright (C) Simone Di Gravio <email: altairjp@gmail.com> - All Rights Reserved
+
+#include "Net/TwitchIRCSendQueue.h"
+
+namespace
+{
+	// Coalescing stops once a send grows past this size. Leftover lines go with the next flush
+	const int32 MaxCoalescedBytes = 16 * 1024;
+}
+
+FTwitchIRCSendQueue::FTwitchIRCSendQueue(int32 _max_queued_lines)
+	: max_queued_lines_(_max_queued_lines)
+	, rate_limiter_(MakeShared<FTwitchIRCRateLimiter, ESPMode::ThreadSafe>())
+{
+}
+
+void FTwitchIRCSendQueue::SetRateLimit(int32 _messages_per_window, double _window_seconds)
+{
+	rate_limiter_->SetRateLimit(_messages_per_window, _window_seconds);
+}
+
+void FTwitchIRCSendQueue::SetRateLimiter(const TSharedRef<FTwitchIRCRateLimiter, ESPMode::ThreadSafe>& _rate_limiter)
+{
+	rate_limiter_ = _rate_limiter;
+}
+
+bool FTwitchIRCSendQueue::Enqueue(const FString& _line, bool _b_rate_limited)
+{
+	if (num_queued_lines_.Increment() > max_queued_lines_)
+	{
+		num_queued_lines_.Decrement();
+		dropped_lines_.Increment();
+		return false;
+	}
+
+	// Size comes from the UTF-8 conversion, not the amount of TCHARs, or non ASCII text gets truncated
+	const FTCHARToUTF8 utf8_line(*_line);
+
+	FQueuedLine line;
+	line.bytes_.Reserve(utf8_line.Length() + 2);
+	line.bytes_.Append(reinterpret_cast<const uint8*>(utf8_line.Get()), utf8_line.Length());
+	line.bytes_.Add('\r');
+	line.bytes_.Add('\n');
+	line.b_rate_limited_ = _b_rate_limited;
+	line.enqueue_time_ = FPlatformTime::Seconds();
+
+	lines_.Enqueue(MoveTemp(line));
+	return true;
+}
+
+void FTwitchIRCSendQueue::EnqueuePriority(const ANSICHAR* _line, int32 _length)
+{
+	priority_bytes_.Append(reinterpret_cast<const uint8*>(_line), _length);
+	priority_bytes_.Add('\r');
+	priority_bytes_.Add('\n');
+}
+
+bool FTwitchIRCSendQueue::Flush(double _now, FSendFunction _send, bool _b_send_queued_lines)
+{
+	// Lines are never interleaved: the tail of a partial send goes out before anything else
+	if (send_offset_ < send_buffer_.Num())
+	{
+		if (!SendPending(_send))
+		{
+			return false;
+		}
+		if (send_offset_ < send_buffer_.Num())
+		{
+			return true; // The socket is still full
+		}
+	}
+	send_buffer_.Reset();
+	send_offset_ = 0;
+
+	// Priority lines first
+	send_buffer_.Append(priority_bytes_);
+	priority_bytes_.Reset();
+
+	// Then as many queued lines as the budget allows, in order
+	while (_b_send_queued_lines && send_buffer_.Num() < MaxCoalescedBytes)
+	{
+		if (!b_has_held_line_)
+		{
+			if (!lines_.Dequeue(held_line_))
+			{
+				break;
+			}
+			num_queued_lines_.Decrement();
+			b_has_held_line_ = true;
+		}
+
+		if (held_line_.b_rate_limited_)
+		{
+			// Out of budget. The line stays held, and so does everything queued after it to keep the order
+			if (!rate_limiter_->TryConsume(_now))
+			{
+				break;
+			}
+		}
+
+		// Lines that waited noticeably (for the budget, or behind a line that did) are reported as delayed
+		const double delay = _now - held_line_.enqueue_time_;
+		if (delay > 1.0)
+		{
+			FScopeLock report_lock(&report_lock_);
+			delayed_lines_++;
+			longest_delay_ = FMath::Max(longest_delay_, delay);
+		}
+
+		send_buffer_.Append(held_line_.bytes_);
+		b_has_held_line_ = false;
+	}
+
+	return send_buffer_.Num() == 0 || SendPending(_send);
+}
+
+void FTwitchIRCSendQueue::Reset()
+{
+	FQueuedLine discarded;
+	while (lines_.Dequeue(discarded))
+	{
+		num_queued_lines_.Decrement();
+	}
+	b_has_held_line_ = false;
+	priority_bytes_.Reset();
+	send_buffer_.Reset();
+	send_offset_ = 0;
+}
+
+void FTwitchIRCSendQueue::DiscardPending()
+{
+	priority_bytes_.Reset();
+	send_buffer_.Reset();
+	send_offset_ = 0;
+}
+
+bool FTwitchIRCSendQueue::HasPendingData() const
+{
+	return send_offset_ < send_buffer_.Num() || priority_bytes_.Num() > 0 || b_has_held_line_ || !lines_.IsEmpty();
+}
+
+void FTwitchIRCSendQueue::ConsumeReport(int32& _out_dropped, int32& _out_delayed, double& _out_longest_delay)
+{
+	_out_dropped = dropped_lines_.Set(0);
+
+	FScopeLock report_lock(&report_lock_);
+	_out_delayed = delayed_lines_;
+	_out_longest_delay = longest_delay_;
+	delayed_lines_ = 0;
+	longest_delay_ = 0.0;
+}
+
+bool FTwitchIRCSendQueue::SendPending(FSendFunction _send)
+{
+	while (send_offset_ < send_buffer_.Num())
+	{
+		int32 sent = 0;
+		if (!_send(send_buffer_.GetData() + send_offset_, send_buffer_.Num() - send_offset_, sent))
+		{
+			return false;
+		}
+
+		// Partial send, resume from here on the next flush
+		if (sent <= 0)
+		{
+			break;
+		}
+		send_offset_ += sent;
+	}
+	return true;
+}
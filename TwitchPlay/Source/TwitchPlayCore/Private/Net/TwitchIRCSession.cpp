@@ -0,0 +1,270 @@
+// Copyright (C) Simone Di Gravio <email: altairjp@gmail.com> - All Rights Reserved
+
+#include "Net/TwitchIRCSession.h"
+#include "Misc/Crc.h"
+
+namespace
+{
+	// JOIN and PART take a comma separated list of channels. Lists are split to stay well inside the 512 bytes IRC line limit
+	const int32 MaxChannelListBytes = 400;
+
+	// Twitch lets an account join 20 channels every 10 seconds. Joins past it are dropped without an answer
+	const int32 JoinsPerWindow = 20;
+	const double JoinWindowSeconds = 10.0;
+}
+
+TSharedRef<FTwitchIRCRateLimiter, ESPMode::ThreadSafe> FTwitchIRCSession::MakeJoinLimiter()
+{
+	TSharedRef<FTwitchIRCRateLimiter, ESPMode::ThreadSafe> join_limiter = MakeShared<FTwitchIRCRateLimiter, ESPMode::ThreadSafe>();
+	join_limiter->SetRateLimit(JoinsPerWindow, JoinWindowSeconds);
+	return join_limiter;
+}
+
+void FTwitchIRCSession::SetJoinLimiter(const TSharedRef<FTwitchIRCRateLimiter, ESPMode::ThreadSafe>& _join_limiter)
+{
+	join_limiter_ = _join_limiter;
+}
+
+void FTwitchIRCSession::Begin()
+{
+	// Nothing from the previous transport must leak into this one
+	line_framer_.Reset();
+	send_queue_.DiscardPending();
+	for (FChannel& channel : channels_)
+	{
+		channel.b_joined_ = false;
+	}
+	state_ = EState::Idle;
+}
+
+void FTwitchIRCSession::Register(const FString& _oauth, const FString& _username, bool _b_request_tags)
+{
+	// Capabilities must be requested before registering the connection
+	// Credentials go ahead of any queued chat line
+	auto send_priority = [this](const FString& _line)
+	{
+		const FTCHARToUTF8 utf8_line(*_line);
+		send_queue_.EnqueuePriority(utf8_line.Get(), utf8_line.Length());
+	};
+	if (_b_request_tags)
+	{
+		send_priority(TEXT("CAP REQ :twitch.tv/tags twitch.tv/commands"));
+	}
+	send_priority(TEXT("PASS ") + _oauth);
+	send_priority(TEXT("NICK ") + _username);
+
+	state_ = EState::Registering;
+}
+
+bool FTwitchIRCSession::SyncChannels(const TArray<FString>& _channel_names, const TBitArray<>& _wanted_channels, double _now)
+{
+	if (state_ != EState::Registered)
+	{
+		return false;
+	}
+
+	// Channels are batched into as few JOIN/PART lines as possible
+	TArray<ANSICHAR, TInlineAllocator<512>> join_line;
+	TArray<ANSICHAR, TInlineAllocator<512>> part_line;
+	auto add_to_line = [this](TArray<ANSICHAR, TInlineAllocator<512>>& _line, const ANSICHAR* _command, const TArray<ANSICHAR>& _channel)
+	{
+		if (_line.Num() > 0 && _line.Num() + _channel.Num() + 1 > MaxChannelListBytes)
+		{
+			send_queue_.EnqueuePriority(_line.GetData(), _line.Num());
+			_line.Reset();
+		}
+		if (_line.Num() == 0)
+		{
+			_line.Append(_command, FCStringAnsi::Strlen(_command));
+		}
+		else
+		{
+			_line.Add(',');
+		}
+		_line.Append(_channel);
+	};
+
+	if (channels_.Num() < _channel_names.Num())
+	{
+		channels_.SetNum(_channel_names.Num());
+	}
+
+	bool b_joined_all = true;
+	for (int32 cycle_channel = 0; cycle_channel < _channel_names.Num(); ++cycle_channel)
+	{
+		FChannel& channel = channels_[cycle_channel];
+		const bool b_wanted = _wanted_channels.IsValidIndex(cycle_channel) && _wanted_channels[cycle_channel];
+
+		if (b_wanted && !channel.b_joined_)
+		{
+			// Only channels actually sent count as joined, the others are tried again on the next sync
+			if (join_limiter_.IsValid() && !join_limiter_->TryConsume(_now))
+			{
+				b_joined_all = false;
+				continue;
+			}
+
+			// Names are kept as they appear in the lines, so matching a message to its channel needs no conversion
+			const FTCHARToUTF8 utf8_channel(*_channel_names[cycle_channel]);
+			channel.name_.Reset(utf8_channel.Length() + 1);
+			channel.name_.Add('#');
+			channel.name_.Append(utf8_channel.Get(), utf8_channel.Length());
+			channel.name_hash_ = FCrc::MemCrc32(channel.name_.GetData(), channel.name_.Num());
+			channel.b_joined_ = true;
+
+			add_to_line(join_line, "JOIN ", channel.name_);
+		}
+		else if (!b_wanted && channel.b_joined_)
+		{
+			channel.b_joined_ = false;
+
+			add_to_line(part_line, "PART ", channel.name_);
+		}
+	}
+
+	if (join_line.Num() > 0)
+	{
+		send_queue_.EnqueuePriority(join_line.GetData(), join_line.Num());
+	}
+	if (part_line.Num() > 0)
+	{
+		send_queue_.EnqueuePriority(part_line.GetData(), part_line.Num());
+	}
+	return b_joined_all;
+}
+
+int32 FTwitchIRCSession::ReceiveBytes(const uint8* _data, int32 _size, ITwitchIRCSessionHandler& _handler)
+{
+	if (_data != nullptr)
+	{
+		// Whatever doesn't fit waits until the lines buffered are popped below
+		const int32 appended = line_framer_.Append(_data, _size);
+		_data += appended;
+		_size -= appended;
+	}
+	else
+	{
+		line_framer_.CommitWrite(_size);
+		_size = 0;
+	}
+
+	// Only complete lines are parsed. A partial line stays buffered until the rest of it arrives
+	// Lines are tokenized in place, strings are only created for what the handler keeps
+	const ANSICHAR* line_data;
+	int32 line_length;
+	int32 lines_parsed = 0;
+	while (state_ != EState::LoginFailed)
+	{
+		if (!line_framer_.PopLine(line_data, line_length))
+		{
+			if (_size == 0)
+			{
+				break;
+			}
+			// PopLine always leaves room, dropping a line too long to ever fit
+			const int32 appended = line_framer_.Append(_data, _size);
+			_data += appended;
+			_size -= appended;
+			continue;
+		}
+
+		if (ReceiveLine(line_data, line_length, _handler))
+		{
+			++lines_parsed;
+		}
+	}
+	return lines_parsed;
+}
+
+bool FTwitchIRCSession::ReceiveLine(const ANSICHAR* _line, int32 _length, ITwitchIRCSessionHandler& _handler)
+{
+	if (state_ == EState::LoginFailed)
+	{
+		return false;
+	}
+
+	// Lines are reported as received, before any handling
+	_handler.OnLineReceived(_line, _length);
+
+	FTwitchIRCLine line;
+	const uint64 parse_start_cycles = FPlatformTime::Cycles64();
+	if (!line.Parse(_line, _length))
+	{
+		return false;
+	}
+	_handler.OnLineParsed(FPlatformTime::Cycles64() - parse_start_cycles);
+
+	HandleLine(line, _handler);
+	return true;
+}
+
+bool FTwitchIRCSession::Flush(double _now, FTwitchIRCSendQueue::FSendFunction _send)
+{
+	// Queued lines (chat) only go out once registered
+	return send_queue_.Flush(_now, _send, state_ == EState::Registered);
+}
+
+int32 FTwitchIRCSession::FindChannel(const FTwitchIRCStringView& _channel) const
+{
+	if (_channel.IsEmpty() || _channel[0] != '#')
+	{
+		return INDEX_NONE;
+	}
+
+	// Channels left are still matched: their last messages can arrive after the PART
+	const uint32 channel_hash = FCrc::MemCrc32(_channel.GetData(), _channel.Len());
+	for (int32 cycle_channel = 0; cycle_channel < channels_.Num(); ++cycle_channel)
+	{
+		const FChannel& channel = channels_[cycle_channel];
+		if (channel.name_hash_ == channel_hash && channel.name_.Num() == _channel.Len()
+			&& FMemory::Memcmp(channel.name_.GetData(), _channel.GetData(), _channel.Len()) == 0)
+		{
+			return cycle_channel;
+		}
+	}
+	return INDEX_NONE;
+}
+
+void FTwitchIRCSession::HandleLine(const FTwitchIRCLine& _line, ITwitchIRCSessionHandler& _handler)
+{
+	// Twitch checks if the connection is alive with "PING :tmi.twitch.tv"
+	// Reply with a PONG carrying the same parameter, ahead of any queued line
+	if (_line.command_.Equals("PING"))
+	{
+		TArray<ANSICHAR, TInlineAllocator<128>> pong;
+		pong.Append("PONG :", 6);
+		pong.Append(_line.trailing_.GetData(), _line.trailing_.Len());
+		send_queue_.EnqueuePriority(pong.GetData(), pong.Num());
+		return;
+	}
+
+	// Twitch is about to restart the server
+	if (_line.command_.Equals("RECONNECT"))
+	{
+		_handler.OnReconnectRequested();
+		return;
+	}
+
+	if (state_ != EState::Registered)
+	{
+		// Twitch returns a welcome message (":tmi.twitch.tv 001 username :Welcome, GLHF!") upon successful login
+		if (_line.command_.Equals("001"))
+		{
+			state_ = EState::Registered;
+			_handler.OnRegistered();
+		}
+		// Or an error (":tmi.twitch.tv NOTICE * :Login authentication failed")
+		else if (_line.command_.Equals("NOTICE") && _line.GetParam(0).Equals("*"))
+		{
+			state_ = EState::LoginFailed;
+			_handler.OnLoginFailed(_line.trailing_.ToString());
+			return;
+		}
+	}
+
+	// Every line with content is a message. Server messages (like the welcome message upon connection) have no channel
+	if (_line.b_has_trailing_)
+	{
+		_handler.OnMessage(_line, FindChannel(_line.GetParam(0)));
+	}
+}
@@ -0,0 +1,168 @@
+// Copyright (C) Simone Di Gravio <email: altairjp@gmail.com> - All Rights Reserved
+
+#include "Net/TwitchIRCUserRegistry.h"
+#include "Net/TwitchIRCLine.h"
+#include "Hash/CityHash.h"
+
+int32 FTwitchIRCUserRegistry::InternUser(const FTwitchIRCStringView& _login, const FTwitchIRCTags& _tags, const FString*& _out_login)
+{
+	_out_login = nullptr;
+	if (_login.IsEmpty())
+	{
+		return INDEX_NONE;
+	}
+	const uint64 login_hash = HashLogin(_login.GetData(), _login.Len());
+
+	// The ID is read from every line with tags: a login freed by a rename can be taken by another account, the ID can't
+	int64 twitch_id = 0;
+	const bool b_has_twitch_id = _tags.GetInt64("user-id", twitch_id) && twitch_id != 0;
+
+	// Almost every message comes from a known user: a shared lock and a hash lookup
+	{
+		FReadScopeLock read_lock(lock_);
+		const int32 user_handle = FindByLogin(_login.GetData(), _login.Len(), login_hash);
+		if (user_handle != INDEX_NONE)
+		{
+			// Without tags the login is all there is to go by
+			const FUser& user = *users_[user_handle];
+			if (_tags.IsEmpty() || (user.b_has_read_tags_ && (!b_has_twitch_id || user.twitch_id_ == twitch_id)))
+			{
+				_out_login = &user.login_;
+				return user_handle;
+			}
+		}
+	}
+
+	// The other tags are decoded outside of the lock
+	FString display_name;
+	const bool b_has_display_name = _tags.GetValue("display-name", display_name) && !display_name.IsEmpty();
+
+	FWriteScopeLock write_lock(lock_);
+
+	// Another connection thread could have interned the user in the meantime
+	int32 user_handle = FindByLogin(_login.GetData(), _login.Len(), login_hash);
+
+	// The login belongs to another account now: its previous owner renamed. The previous owner keeps its handle
+	// (and its old login until seen again), the login is looked up by ID below like any new one
+	if (user_handle != INDEX_NONE && b_has_twitch_id && users_[user_handle]->twitch_id_ != 0 && users_[user_handle]->twitch_id_ != twitch_id)
+	{
+		RemoveLogin(*users_[user_handle], login_hash);
+		user_handle = INDEX_NONE;
+	}
+
+	// A new login with a known ID is a renamed user. It keeps its handle, under a new FUser since the old login can still be referenced
+	if (user_handle == INDEX_NONE && b_has_twitch_id)
+	{
+		const int32* renamed_handle = twitch_id_handles_.Find(twitch_id);
+		if (renamed_handle != nullptr)
+		{
+			user_handle = *renamed_handle;
+			TUniquePtr<FUser>& user = users_[user_handle];
+			RemoveLogin(*user, HashLogin(user->login_utf8_.GetData(), user->login_utf8_.Num()));
+
+			TUniquePtr<FUser> renamed_user = MakeUnique<FUser>();
+			renamed_user->login_utf8_.Append(_login.GetData(), _login.Len());
+			renamed_user->login_ = _login.ToString();
+			renamed_user->twitch_id_ = user->twitch_id_;
+			renamed_users_.Add(MoveTemp(user));
+			user = MoveTemp(renamed_user);
+			login_handles_.Add(login_hash, user_handle);
+		}
+	}
+
+	if (user_handle == INDEX_NONE)
+	{
+		TUniquePtr<FUser> new_user = MakeUnique<FUser>();
+		new_user->login_utf8_.Append(_login.GetData(), _login.Len());
+		new_user->login_ = _login.ToString();
+		user_handle = users_.Add(MoveTemp(new_user));
+		login_handles_.Add(login_hash, user_handle);
+	}
+
+	FUser& user = *users_[user_handle];
+	if (!_tags.IsEmpty())
+	{
+		user.b_has_read_tags_ = true;
+		if (b_has_twitch_id && user.twitch_id_ == 0)
+		{
+			user.twitch_id_ = twitch_id;
+			twitch_id_handles_.Add(twitch_id, user_handle);
+		}
+		if (b_has_display_name)
+		{
+			user.display_name_ = MoveTemp(display_name);
+		}
+	}
+	_out_login = &user.login_;
+	return user_handle;
+}
+
+int32 FTwitchIRCUserRegistry::FindUser(const FString& _login) const
+{
+	const FTCHARToUTF8 utf8_login(*_login.ToLower());
+	FReadScopeLock read_lock(lock_);
+	return FindByLogin(utf8_login.Get(), utf8_login.Length(), HashLogin(utf8_login.Get(), utf8_login.Length()));
+}
+
+FString FTwitchIRCUserRegistry::GetLogin(int32 _user_handle) const
+{
+	FReadScopeLock read_lock(lock_);
+	return users_.IsValidIndex(_user_handle) ? users_[_user_handle]->login_ : FString();
+}
+
+FString FTwitchIRCUserRegistry::GetDisplayName(int32 _user_handle) const
+{
+	FReadScopeLock read_lock(lock_);
+	if (!users_.IsValidIndex(_user_handle))
+	{
+		return FString();
+	}
+	const FUser& user = *users_[_user_handle];
+	return user.display_name_.IsEmpty() ? user.login_ : user.display_name_;
+}
+
+int64 FTwitchIRCUserRegistry::GetTwitchId(int32 _user_handle) const
+{
+	FReadScopeLock read_lock(lock_);
+	return users_.IsValidIndex(_user_handle) ? users_[_user_handle]->twitch_id_ : 0;
+}
+
+int32 FTwitchIRCUserRegistry::Num() const
+{
+	FReadScopeLock read_lock(lock_);
+	return users_.Num();
+}
+
+int32 FTwitchIRCUserRegistry::FindByLogin(const ANSICHAR* _login, int32 _length, uint64 _login_hash) const
+{
+	for (TMultiMap<uint64, int32>::TConstKeyIterator login_handle(login_handles_, _login_hash); login_handle; ++login_handle)
+	{
+		if (HasLogin(*users_[login_handle.Value()], _login, _length))
+		{
+			return login_handle.Value();
+		}
+	}
+	return INDEX_NONE;
+}
+
+void FTwitchIRCUserRegistry::RemoveLogin(const FUser& _user, uint64 _login_hash)
+{
+	for (TMultiMap<uint64, int32>::TKeyIterator login_handle(login_handles_, _login_hash); login_handle; ++login_handle)
+	{
+		if (users_[login_handle.Value()].Get() == &_user)
+		{
+			login_handle.RemoveCurrent();
+			return;
+		}
+	}
+}
+
+bool FTwitchIRCUserRegistry::HasLogin(const FUser& _user, const ANSICHAR* _login, int32 _length)
+{
+	return _user.login_utf8_.Num() == _length && FMemory::Memcmp(_user.login_utf8_.GetData(), _login, _length) == 0;
+}
+
+uint64 FTwitchIRCUserRegistry::HashLogin(const ANSICHAR* _login, int32 _length)
+{
+	return CityHash64(_login, _length);
+}
@@ -0,0 +1,214 @@
+// Copyright (C) Simone Di Gravio <email: altairjp@gmail.com> - All Rights Reserved
+
+#include "Net/TwitchIRCUtf8.h"
+
+// x86 always has SSE2 in the supported configurations. Other CPUs use the 8 bytes at a time path
+#if PLATFORM_ENABLE_VECTORINTRINSICS && (defined(_M_X64) || defined(__x86_64__) || defined(_M_IX86) || defined(__i386__))
+	#define TWITCHPLAY_UTF8_SSE2 1
+	#include <emmintrin.h>
+#else
+	#define TWITCHPLAY_UTF8_SSE2 0
+#endif
+
+namespace
+{
+	const uint64 HighBits = 0x8080808080808080ull;
+
+#if TWITCHPLAY_UTF8_SSE2
+	// Widens 16 ASCII bytes to 16 TCHARs
+	FORCEINLINE void StoreWidened(const __m128i _bytes, TCHAR* _out_chars)
+	{
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i low = _mm_unpacklo_epi8(_bytes, zero);
+		const __m128i high = _mm_unpackhi_epi8(_bytes, zero);
+		if (sizeof(TCHAR) == 2)
+		{
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(_out_chars), low);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(_out_chars + 8), high);
+		}
+		else
+		{
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(_out_chars), _mm_unpacklo_epi16(low, zero));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(_out_chars + 4), _mm_unpackhi_epi16(low, zero));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(_out_chars + 8), _mm_unpacklo_epi16(high, zero));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(_out_chars + 12), _mm_unpackhi_epi16(high, zero));
+		}
+	}
+#endif
+
+	FORCEINLINE uint64 LoadWord(const uint8* _data)
+	{
+		uint64 word;
+		FMemory::Memcpy(&word, _data, sizeof(word));
+		return word;
+	}
+}
+
+int32 TwitchIRCUtf8::Decode(const ANSICHAR* _data, int32 _length, TCHAR* _out_chars)
+{
+	const uint8* cursor = reinterpret_cast<const uint8*>(_data);
+	const uint8* const end = cursor + FMath::Max(_length, 0);
+	TCHAR* out_chars = _out_chars;
+
+	while (cursor < end)
+	{
+		// ASCII fast lane: whole blocks without any high bit are only widened
+#if TWITCHPLAY_UTF8_SSE2
+		while (end - cursor >= 16)
+		{
+			const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(cursor));
+			const uint32 non_ascii_mask = static_cast<uint32>(_mm_movemask_epi8(bytes));
+			if (non_ascii_mask != 0)
+			{
+				// Copy the ASCII bytes before the first non ASCII one
+				const uint32 num_ascii = FMath::CountTrailingZeros(non_ascii_mask);
+				for (uint32 cycle_byte = 0; cycle_byte < num_ascii; ++cycle_byte)
+				{
+					*out_chars++ = static_cast<TCHAR>(*cursor++);
+				}
+				break;
+			}
+			StoreWidened(bytes, out_chars);
+			cursor += 16;
+			out_chars += 16;
+		}
+#endif
+		while (end - cursor >= 8 && (LoadWord(cursor) & HighBits) == 0)
+		{
+			for (int32 cycle_byte = 0; cycle_byte < 8; ++cycle_byte)
+			{
+				out_chars[cycle_byte] = static_cast<TCHAR>(cursor[cycle_byte]);
+			}
+			cursor += 8;
+			out_chars += 8;
+		}
+		if (cursor == end)
+		{
+			break;
+		}
+
+		const uint8 lead = *cursor;
+		if (lead < 0x80)
+		{
+			*out_chars++ = static_cast<TCHAR>(lead);
+			++cursor;
+			continue;
+		}
+
+		// Length of the sequence, and the range of its second byte that rules out overlong forms, surrogates and values past U+10FFFF
+		int32 num_continuations;
+		uint32 code_point;
+		uint8 min_second = 0x80;
+		uint8 max_second = 0xBF;
+		if (lead < 0xC2)
+		{
+			// Stray continuation byte, or the lead of an overlong 2 byte form
+			*out_chars++ = ReplacementChar;
+			++cursor;
+			continue;
+		}
+		else if (lead < 0xE0)
+		{
+			num_continuations = 1;
+			code_point = lead & 0x1F;
+		}
+		else if (lead < 0xF0)
+		{
+			num_continuations = 2;
+			code_point = lead & 0x0F;
+			min_second = lead == 0xE0 ? 0xA0 : 0x80;
+			max_second = lead == 0xED ? 0x9F : 0xBF;
+		}
+		else if (lead < 0xF5)
+		{
+			num_continuations = 3;
+			code_point = lead & 0x07;
+			min_second = lead == 0xF0 ? 0x90 : 0x80;
+			max_second = lead == 0xF4 ? 0x8F : 0xBF;
+		}
+		else
+		{
+			*out_chars++ = ReplacementChar;
+			++cursor;
+			continue;
+		}
+
+		// A sequence cut short is replaced as a whole, and decoding resumes at the byte that broke it
+		int32 num_bytes = 1;
+		bool b_valid = true;
+		for (int32 cycle_continuation = 1; cycle_continuation <= num_continuations; ++cycle_continuation)
+		{
+			if (cursor + cycle_continuation == end)
+			{
+				b_valid = false;
+				break;
+			}
+			const uint8 continuation = cursor[cycle_continuation];
+			const uint8 min_continuation = cycle_continuation == 1 ? min_second : 0x80;
+			const uint8 max_continuation = cycle_continuation == 1 ? max_second : 0xBF;
+			if (continuation < min_continuation || continuation > max_continuation)
+			{
+				b_valid = false;
+				break;
+			}
+			code_point = (code_point << 6) | (continuation & 0x3F);
+			++num_bytes;
+		}
+		cursor += num_bytes;
+
+		if (!b_valid)
+		{
+			*out_chars++ = ReplacementChar;
+		}
+		else if (sizeof(TCHAR) == 2 && code_point >= 0x10000)
+		{
+			// Surrogate pair: 4 bytes give 2 chars
+			code_point -= 0x10000;
+			*out_chars++ = static_cast<TCHAR>(0xD800 + (code_point >> 10));
+			*out_chars++ = static_cast<TCHAR>(0xDC00 + (code_point & 0x3FF));
+		}
+		else
+		{
+			*out_chars++ = static_cast<TCHAR>(code_point);
+		}
+	}
+
+	return static_cast<int32>(out_chars - _out_chars);
+}
+
+void TwitchIRCUtf8::DecodeInto(const ANSICHAR* _data, int32 _length, FString& _out_string)
+{
+	TArray<TCHAR>& chars = _out_string.GetCharArray();
+	if (_length <= 0)
+	{
+		chars.Reset();
+		return;
+	}
+
+	// Room for the worst case (one char per byte) and the terminator, trimmed once the real length is known
+	chars.SetNumUninitialized(_length + 1, false);
+	const int32 num_chars = Decode(_data, _length, chars.GetData());
+	chars[num_chars] = TEXT('\0');
+	chars.SetNum(num_chars + 1, false);
+}
+
+bool TwitchIRCUtf8::IsAscii(const ANSICHAR* _data, int32 _length)
+{
+	const uint8* cursor = reinterpret_cast<const uint8*>(_data);
+	const uint8* const end = cursor + FMath::Max(_length, 0);
+	for (; end - cursor >= 8; cursor += 8)
+	{
+		if ((LoadWord(cursor) & HighBits) != 0)
+		{
+			return false;
+		}
+	}
+	for (; cursor < end; ++cursor)
+	{
+		if (*cursor >= 0x80)
+		{
+			return false;
+		}
+	}
+	return true;
+}
@@ -0,0 +1,29 @@
+// Copyright (C) Simone Di Gravio <email: altairjp@gmail.com> - All Rights Reserved
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * Hashing helpers shared by the tables keyed on users, commands and emotes.
+ */
+namespace TwitchIRCHash
+{
+	/**
+	 * Finalizer of MurmurHash3: spreads every bit of the value over the whole result.
+	 * Makes combined keys (a hash XORed with an index...) safe to use with power of two tables and sketches.
+	 *
+	 * @param _value - Value to mix.
+	 *
+	 * @return The mixed value. Only 0 maps to 0.
+	 */
+	FORCEINLINE uint64 MixBits(uint64 _value)
+	{
+		_value ^= _value >> 33;
+		_value *= 0xff51afd7ed558ccdull;
+		_value ^= _value >> 33;
+		_value *= 0xc4ceb9fe1a85ec53ull;
+		_value ^= _value >> 33;
+		return _value;
+	}
+}
@@ -0,0 +1,210 @@
+// Copyright (C) Simone Di Gravio <email: altairjp@gmail.com> - All Rights Reserved
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * Non owning view over a range of UTF-8 bytes (usually part of a received IRC line).
+ * Nothing is allocated until an owned string is requested with ToString().
+ */
+struct TWITCHPLAYCORE_API FTwitchIRCStringView
+{
+public:
+
+	FTwitchIRCStringView()
+		: data_(nullptr)
+		, length_(0)
+	{}
+
+	FTwitchIRCStringView(const ANSICHAR* _data, int32 _length)
+		: data_(_data)
+		, length_(_length)
+	{}
+
+	const ANSICHAR* GetData() const { return data_; }
+
+	int32 Len() const { return length_; }
+
+	bool IsEmpty() const { return length_ == 0; }
+
+	ANSICHAR operator[](int32 _index) const { checkSlow(_index >= 0 && _index < length_); return data_[_index]; }
+
+	// Case sensitive byte comparison
+	bool Equals(const FTwitchIRCStringView& _other) const
+	{
+		return length_ == _other.length_ && (length_ == 0 || FMemory::Memcmp(data_, _other.data_, length_) == 0);
+	}
+
+	// Case sensitive comparison against a null terminated string
+	bool Equals(const ANSICHAR* _other) const;
+
+	/**
+	 * Finds the first occurrence of a character.
+	 *
+	 * @param _char - Character to search.
+	 * @param _start_index - Index to start searching from.
+	 *
+	 * @return Index of the character. INDEX_NONE if not found.
+	 */
+	int32 Find(ANSICHAR _char, int32 _start_index = 0) const;
+
+	// View over _count bytes starting at _start. The range is clamped to this view
+	FTwitchIRCStringView Mid(int32 _start, int32 _count = MAX_int32) const;
+
+	// Decodes the UTF-8 bytes into an owned string
+	FString ToString() const;
+
+	// Decodes the UTF-8 bytes into an existing string, reusing its allocation
+	void ToString(FString& _out_string) const;
+
+private:
+	const ANSICHAR* data_;
+
+	int32 length_;
+};
+
+/**
+ * IRCv3 message tags of a line ("key=value;key2=value2"), decoded lazily.
+ * Nothing is done on construction: the key/value offsets are recorded the first time a tag is looked up,
+ * and a value is only unescaped when it is requested. Lines whose tags are never read cost no more than plain lines.
+ * This is a view: the tags memory must outlive this object.
+ * Common Twitch tags: "user-id", "display-name", "badges", "mod", "subscriber", "emotes", "bits", "tmi-sent-ts".
+ */
+struct TWITCHPLAYCORE_API FTwitchIRCTags
+{
+public:
+
+	FTwitchIRCTags()
+		: b_indexed_(false)
+	{}
+
+	// @param _raw_tags - Tags section of a line, without the leading '@'
+	explicit FTwitchIRCTags(const FTwitchIRCStringView& _raw_tags)
+		: raw_tags_(_raw_tags)
+		, b_indexed_(false)
+	{}
+
+	bool IsEmpty() const { return raw_tags_.IsEmpty(); }
+
+	// Amount of tags
+	int32 Num() const;
+
+	/**
+	 * Finds a tag without decoding it.
+	 *
+	 * @param _key - Name of the tag (CASE SENSITIVE).
+	 * @param _out_escaped_value - Value of the tag as it was received (still escaped).
+	 *
+	 * @return Whether the tag was present.
+	 */
+	bool FindRaw(const ANSICHAR* _key, FTwitchIRCStringView& _out_escaped_value) const;
+
+	/**
+	 * Finds and decodes a tag.
+	 *
+	 * @param _key - Name of the tag (CASE SENSITIVE).
+	 * @param _out_value - Unescaped value of the tag.
+	 *
+	 * @return Whether the tag was present.
+	 */
+	bool GetValue(const ANSICHAR* _key, FString& _out_value) const;
+
+	/**
+	 * Finds a tag holding an integer, like "bits" or "tmi-sent-ts".
+	 *
+	 * @param _key - Name of the tag (CASE SENSITIVE).
+	 * @param _out_value - Value of the tag.
+	 *
+	 * @return Whether the tag was present and was a valid integer. False for values past MAX_int64.
+	 */
+	bool GetInt64(const ANSICHAR* _key, int64& _out_value) const;
+
+	/**
+	 * Removes the IRCv3 escaping from a tag value ("\s" for spaces, "\:" for semicolons etc.).
+	 *
+	 * @param _escaped_value - The value as it was received.
+	 *
+	 * @return The decoded value.
+	 */
+	static FString Unescape(const FTwitchIRCStringView& _escaped_value);
+
+private:
+
+	// Offsets of a tag key and value inside the tags section
+	struct FTagEntry
+	{
+		uint16 key_start_;
+		uint16 key_length_;
+		uint16 value_start_;
+		uint16 value_length_;
+	};
+
+	// Records the offsets of every tag. Only done once, on the first lookup
+	void BuildIndex() const;
+
+	FTwitchIRCStringView raw_tags_;
+
+	// Twitch sends around 15-20 tags per message, which fit without allocating
+	mutable TArray<FTagEntry, TInlineAllocator<24>> entries_;
+
+	mutable bool b_indexed_;
+};
+
+/**
+ * A single IRC line split into its parts, in the form
+ * [@tags] [:prefix] command [params...] [:trailing]
+ * All parts are views into the line that was parsed, which must outlive this object.
+ * Parsing never allocates.
+ */
+struct TWITCHPLAYCORE_API FTwitchIRCLine
+{
+public:
+
+	// Maximum amount of middle parameters allowed by the IRC protocol
+	static const int32 MaxParams = 15;
+
+	// Raw IRCv3 tags, without the leading '@'. Empty if the line had no tags
+	FTwitchIRCStringView tags_;
+
+	// Source of the line, without the leading ':'. Like "username!username@username.tmi.twitch.tv"
+	FTwitchIRCStringView prefix_;
+
+	// Nickname part of the prefix (before the first '!'). For user messages this is the sender username
+	FTwitchIRCStringView nick_;
+
+	// Command or numeric reply, like "PRIVMSG", "PING" or "001"
+	FTwitchIRCStringView command_;
+
+	// Middle parameters. For PRIVMSG the first one is the "#channel"
+	FTwitchIRCStringView params_[MaxParams];
+
+	int32 num_params_ = 0;
+
+	// Last parameter (after " :"). For PRIVMSG this is the content of the chat message
+	FTwitchIRCStringView trailing_;
+
+	// A trailing parameter can be present and empty, so its presence is tracked separately
+	bool b_has_trailing_ = false;
+
+public:
+
+	/**
+	 * Splits a line into its parts. Any previous content is overwritten.
+	 *
+	 * @param _line - Start of the line, without line terminator.
+	 * @param _length - Length of the line in bytes.
+	 *
+	 * @return Whether the line was well formed (had at least a command).
+	 */
+	bool Parse(const ANSICHAR* _line, int32 _length);
+
+	// Whether the line is a chat message sent by a user
+	bool IsUserMessage() const { return command_.Equals("PRIVMSG") && !nick_.IsEmpty(); }
+
+	// Lazily decoded IRCv3 tags. Only present when the tags capability was requested
+	FTwitchIRCTags GetTags() const { return FTwitchIRCTags(tags_); }
+
+	// Gets a middle parameter, or an empty view if there is no parameter at that index
+	FTwitchIRCStringView GetParam(int32 _index) const { return _index >= 0 && _index < num_params_ ? params_[_index] : FTwitchIRCStringView(); }
+};
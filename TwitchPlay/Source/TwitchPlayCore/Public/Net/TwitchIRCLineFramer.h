@@ -0,0 +1,102 @@
+// Copyright (C) Simone Di Gravio <email: altairjp@gmail.com> - All Rights Reserved
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * Splits the TCP byte stream of an IRC connection into complete lines.
+ * Bytes are received straight into a ring buffer that is allocated once per connection.
+ * Only lines terminated by "\r\n" (or a bare "\n") are emitted, so a line split across two reads
+ * is held back until its remaining bytes arrive.
+ *
+ * Usage:
+ * 1. GetWritableRegion() and Recv into it.
+ * 2. CommitWrite() with the amount of bytes received.
+ * 3. PopLine() until it returns false.
+ */
+class TWITCHPLAYCORE_API FTwitchIRCLineFramer
+{
+public:
+
+	/**
+	 * @param _capacity - Size of the ring buffer in bytes. Rounded up to a power of two.
+	 *                    Lines longer than this are discarded.
+	 */
+	explicit FTwitchIRCLineFramer(int32 _capacity = 64 * 1024);
+
+	/**
+	 * Gets the contiguous free space at the end of the buffered data.
+	 * The region might be smaller than the total free space if it wraps around the end of the ring.
+	 *
+	 * @param _out_data - Where new bytes should be written.
+	 * @param _out_size - How many bytes can be written. 0 if the buffer is full.
+	 */
+	void GetWritableRegion(uint8*& _out_data, int32& _out_size);
+
+	/**
+	 * Marks bytes written in the region returned by GetWritableRegion() as received.
+	 *
+	 * @param _size - Amount of bytes written.
+	 */
+	void CommitWrite(int32 _size);
+
+	/**
+	 * Appends bytes by copying them into the ring buffer.
+	 * Useful when the data does not come straight from a socket.
+	 *
+	 * @param _data - Bytes to append.
+	 * @param _size - Amount of bytes.
+	 *
+	 * @return How many bytes were appended. Less than _size if the buffer is full.
+	 */
+	int32 Append(const uint8* _data, int32 _size);
+
+	/**
+	 * Extracts the next complete line, without its line terminator. Empty lines are skipped.
+	 * The returned memory is owned by the framer and is valid until the next call to any non-const method.
+	 *
+	 * @param _out_line - Start of the line.
+	 * @param _out_length - Length of the line in bytes.
+	 *
+	 * @return Whether a complete line was available.
+	 */
+	bool PopLine(const ANSICHAR*& _out_line, int32& _out_length);
+
+	// Drops any buffered data. Used when the connection is reset.
+	void Reset();
+
+	// Amount of bytes currently buffered
+	int32 GetBufferedBytes() const { return count_; }
+
+	// Amount of lines discarded because they did not fit in the buffer
+	int32 GetDiscardedLines() const { return discarded_lines_; }
+
+private:
+
+	// Removes _size bytes from the front of the buffered data
+	void Consume(int32 _size);
+
+	// Ring storage. Its size is a power of two so indices can be wrapped with a mask
+	TArray<uint8> storage_;
+
+	uint32 mask_;
+
+	// Index of the first buffered byte
+	uint32 head_ = 0;
+
+	// Amount of buffered bytes
+	int32 count_ = 0;
+
+	// Amount of buffered bytes already searched for a line terminator
+	// Avoids scanning the same partial line again after every read
+	int32 scan_offset_ = 0;
+
+	// Set when a line overflowed the buffer: bytes are dropped until its terminator is found
+	bool b_discarding_line_ = false;
+
+	int32 discarded_lines_ = 0;
+
+	// Used to return a contiguous copy of lines that wrap around the end of the ring
+	TArray<ANSICHAR> wrapped_line_;
+};
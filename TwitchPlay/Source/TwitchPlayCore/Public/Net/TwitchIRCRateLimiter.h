@@ -0,0 +1,53 @@
+// Copyright (C) Simone Di Gravio <email: altairjp@gmail.com> - All Rights Reserved
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/CriticalSection.h"
+
+/**
+ * Token bucket enforcing the Twitch chat budget.
+ * The budget is per account, so every connection logged in with the same account shares one limiter.
+ * Thread safe: connections consume tokens from their own threads.
+ */
+class TWITCHPLAYCORE_API FTwitchIRCRateLimiter
+{
+public:
+
+	// Smallest budget: one message at once, the other one refilled over the window
+	static const int32 MinMessagesPerWindow = 2;
+
+	FTwitchIRCRateLimiter();
+
+	/**
+	 * Sets the chat budget. Twitch allows 20 messages every 30 seconds, 100 for moderators and broadcasters.
+	 * Exceeding it gets the account locked out of chat, so the bucket never allows more than the budget
+	 * in any window: it holds at most half the budget and refills the other half over the window.
+	 * Changing the budget keeps the tokens already spent, it never refills the bucket.
+	 *
+	 * @param _messages_per_window - Maximum amount of messages per window. Clamped to MinMessagesPerWindow.
+	 * @param _window_seconds - Length of the window.
+	 */
+	void SetRateLimit(int32 _messages_per_window, double _window_seconds);
+
+	/**
+	 * Takes a token if one is available.
+	 *
+	 * @param _now - Current time in seconds.
+	 *
+	 * @return Whether a message can be sent now.
+	 */
+	bool TryConsume(double _now);
+
+private:
+
+	FCriticalSection lock_;
+
+	double tokens_ = 0.0;
+
+	double max_tokens_ = 0.0;
+
+	double tokens_per_second_ = 0.0;
+
+	double last_refill_time_ = -1.0;
+};
@@ -0,0 +1,145 @@
+// Copyright (C) Simone Di Gravio <email: altairjp@gmail.com> - All Rights Reserved
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Containers/Queue.h"
+#include "HAL/ThreadSafeCounter.h"
+#include "Misc/ScopeLock.h"
+#include "Net/TwitchIRCRateLimiter.h"
+
+/**
+ * Outbound IRC lines waiting to be written to the socket.
+ * Lines can be queued from any thread and are written by the network thread, which:
+ * - enforces the Twitch chat budget with a token bucket (PRIVMSG lines only, PONG/PASS/NICK/JOIN are never delayed),
+ *   which can be shared by several queues,
+ * - coalesces every line that can be sent into a single Send,
+ * - keeps the unsent tail of a partial Send and resumes it on the next flush.
+ */
+class TWITCHPLAYCORE_API FTwitchIRCSendQueue
+{
+public:
+
+	/**
+	 * Signature of the function actually writing to the socket.
+	 * Must return false on connection errors. A send that would block is not an error: return true with 0 bytes sent.
+	 */
+	typedef TFunctionRef<bool(const uint8* /*_data*/, int32 /*_size*/, int32& /*_out_sent*/)> FSendFunction;
+
+	/**
+	 * @param _max_queued_lines - Lines queued beyond this amount are dropped.
+	 */
+	explicit FTwitchIRCSendQueue(int32 _max_queued_lines = 256);
+
+	/**
+	 * Sets the chat budget, see FTwitchIRCRateLimiter::SetRateLimit.
+	 * Must be called before lines are flushed.
+	 *
+	 * @param _messages_per_window - Maximum amount of rate limited lines per window.
+	 * @param _window_seconds - Length of the window.
+	 */
+	void SetRateLimit(int32 _messages_per_window, double _window_seconds);
+
+	/**
+	 * Replaces the chat budget with one shared with other queues, like the other connections of the same account.
+	 * Must be called before lines are flushed.
+	 */
+	void SetRateLimiter(const TSharedRef<FTwitchIRCRateLimiter, ESPMode::ThreadSafe>& _rate_limiter);
+
+	/**
+	 * Queues a line. Can be called from any thread.
+	 *
+	 * @param _line - The line, without terminator. Encoded as UTF-8.
+	 * @param _b_rate_limited - Whether the line counts against the chat budget.
+	 *
+	 * @return Whether the line was queued. False if the queue is full.
+	 */
+	bool Enqueue(const FString& _line, bool _b_rate_limited);
+
+	/**
+	 * Queues a line that skips the lines already waiting, like PONG replies. Network thread only.
+	 *
+	 * @param _line - The line, without terminator.
+	 * @param _length - Length of the line in bytes.
+	 */
+	void EnqueuePriority(const ANSICHAR* _line, int32 _length);
+
+	/**
+	 * Writes as many queued lines as the budget allows with a single send. Network thread only.
+	 *
+	 * @param _now - Current time in seconds.
+	 * @param _send - Function writing to the socket.
+	 * @param _b_send_queued_lines - Whether queued lines can be sent. If false only priority lines are, like during authentication.
+	 *
+	 * @return False if sending failed because of a connection error.
+	 */
+	bool Flush(double _now, FSendFunction _send, bool _b_send_queued_lines = true);
+
+	// Drops everything queued. Network thread only, or while the network thread is stopped
+	void Reset();
+
+	// Drops what was meant for the previous socket (the unsent tail of a partial send, priority lines),
+	// keeping the queued lines for the next connection. Network thread only
+	void DiscardPending();
+
+	// Whether there are bytes or lines waiting to be sent. Network thread only
+	bool HasPendingData() const;
+
+	// Lines queued and not sent yet. Any thread
+	int32 GetNumQueuedLines() const { return num_queued_lines_.GetValue(); }
+
+	/**
+	 * Gets what happened to the queued lines since the previous call. Any thread.
+	 *
+	 * @param _out_dropped - Lines dropped because the queue was full.
+	 * @param _out_delayed - Lines that had to wait for the chat budget.
+	 * @param _out_longest_delay - Longest time a line spent waiting for the budget, in seconds.
+	 */
+	void ConsumeReport(int32& _out_dropped, int32& _out_delayed, double& _out_longest_delay);
+
+private:
+
+	struct FQueuedLine
+	{
+		// UTF-8 bytes, terminator included
+		TArray<uint8> bytes_;
+
+		bool b_rate_limited_ = false;
+
+		double enqueue_time_ = 0.0;
+	};
+
+	// Writes the pending part of send_buffer_. Returns false on connection errors
+	bool SendPending(FSendFunction _send);
+
+	const int32 max_queued_lines_;
+
+	// Lines queued by any thread
+	TQueue<FQueuedLine, EQueueMode::Mpsc> lines_;
+
+	FThreadSafeCounter num_queued_lines_;
+
+	// Line dequeued but still waiting for the budget
+	FQueuedLine held_line_;
+
+	bool b_has_held_line_ = false;
+
+	TArray<uint8> priority_bytes_;
+
+	// Coalesced lines being sent. Bytes before send_offset_ were already sent
+	TArray<uint8> send_buffer_;
+
+	int32 send_offset_ = 0;
+
+	// Chat budget. Owned by this queue unless shared with SetRateLimiter()
+	TSharedRef<FTwitchIRCRateLimiter, ESPMode::ThreadSafe> rate_limiter_;
+
+	// Report for the game thread
+	FThreadSafeCounter dropped_lines_;
+
+	FCriticalSection report_lock_;
+
+	int32 delayed_lines_ = 0;
+
+	double longest_delay_ = 0.0;
+};
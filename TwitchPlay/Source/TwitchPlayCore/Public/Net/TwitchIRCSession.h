@@ -0,0 +1,178 @@
+// Copyright (C) Simone Di Gravio <email: altairjp@gmail.com> - All Rights Reserved
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Net/TwitchIRCLine.h"
+#include "Net/TwitchIRCLineFramer.h"
+#include "Net/TwitchIRCSendQueue.h"
+#include "Net/TwitchIRCRateLimiter.h"
+
+/**
+ * Receives what a session makes of the lines it is fed. Called on the thread pumping the session.
+ */
+class ITwitchIRCSessionHandler
+{
+public:
+
+	virtual ~ITwitchIRCSessionHandler() {}
+
+	// A complete line arrived, before it is parsed. Useful to capture the stream
+	virtual void OnLineReceived(const ANSICHAR* _line, int32 _length) {}
+
+	// A line was tokenized. Lines that fail to parse are dropped without being reported
+	virtual void OnLineParsed(uint64 _parse_cycles) {}
+
+	// The server accepted the credentials. The channels are joined right after
+	virtual void OnRegistered() {}
+
+	// The server refused the credentials. The rest of the received data is dropped
+	virtual void OnLoginFailed(const FString& _reason) {}
+
+	// The server is about to restart and asks to connect again (RECONNECT)
+	virtual void OnReconnectRequested() {}
+
+	/**
+	 * A line with content: a chat message, or a server message.
+	 *
+	 * @param _line - The tokenized line. Only valid during the call.
+	 * @param _channel_id - ID of the channel (index in the names given to SyncChannels). INDEX_NONE for server messages.
+	 */
+	virtual void OnMessage(const FTwitchIRCLine& _line, int32 _channel_id) = 0;
+};
+
+/**
+ * The Twitch IRC protocol without any transport: received bytes go in, lines to send come out.
+ * It frames and parses the lines, answers PINGs, registers with the credentials, batches JOIN/PART within the join budget
+ * and matches every message to its channel. Whoever owns the transport (a socket thread, a capture replay,
+ * a benchmark) pumps it: ReceiveBytes() with what was read, Flush() with a function writing the bytes.
+ * Only the send queue can be used from other threads, the rest belongs to the pumping thread.
+ */
+class TWITCHPLAYCORE_API FTwitchIRCSession
+{
+public:
+
+	enum class EState : uint8
+	{
+		// Nothing sent yet
+		Idle,
+		// Credentials sent, waiting for the welcome
+		Registering,
+		// Welcomed by the server. Channels are joined and chat lines are sent
+		// A replay starts from Idle: the captured welcome line registers it without credentials
+		Registered,
+		// The server refused the credentials
+		LoginFailed
+	};
+
+	/**
+	 * Makes a join budget matching the Twitch limit of 20 channels joined every 10 seconds.
+	 * The limit is per account, so every session logged in with the same account shares one, like the chat budget.
+	 */
+	static TSharedRef<FTwitchIRCRateLimiter, ESPMode::ThreadSafe> MakeJoinLimiter();
+
+	/**
+	 * Limits the channels joined by SyncChannels. Every channel takes a token, however many share a JOIN line.
+	 * Without one every channel is joined at once, which is only fine without a server, like for replays.
+	 */
+	void SetJoinLimiter(const TSharedRef<FTwitchIRCRateLimiter, ESPMode::ThreadSafe>& _join_limiter);
+
+	// Starts over on a new transport. Whatever was received or left half sent is dropped, queued chat lines are kept.
+	// Channels are joined again once registered
+	void Begin();
+
+	/**
+	 * Queues the registration (capabilities, PASS, NICK) ahead of anything else.
+	 *
+	 * @param _oauth - Oauth token.
+	 * @param _username - Username to login with.
+	 * @param _b_request_tags - Whether to request the IRCv3 tags and Twitch commands capabilities.
+	 */
+	void Register(const FString& _oauth, const FString& _username, bool _b_request_tags);
+
+	/**
+	 * Joins and leaves channels so the joined ones match the wanted ones. Does nothing until registered.
+	 * Channels past the join budget stay wanted and are joined by a later call.
+	 *
+	 * @param _channel_names - Channel names (lower case, without '#') indexed by channel ID.
+	 * @param _wanted_channels - Whether each channel should be joined.
+	 * @param _now - Current time in seconds, for the join budget.
+	 *
+	 * @return False if some wanted channels wait for the join budget (or for the registration): call again later.
+	 */
+	bool SyncChannels(const TArray<FString>& _channel_names, const TBitArray<>& _wanted_channels, double _now);
+
+	/**
+	 * Gets where received bytes can be written without a copy. See FTwitchIRCLineFramer::GetWritableRegion.
+	 * Commit them with ReceiveBytes(nullptr, size).
+	 */
+	void GetWritableRegion(uint8*& _out_data, int32& _out_size) { line_framer_.GetWritableRegion(_out_data, _out_size); }
+
+	/**
+	 * Handles received bytes. Every complete line is handled right away, partial ones wait for the rest.
+	 *
+	 * @param _data - Received bytes. Null if they were written in the region of GetWritableRegion().
+	 * @param _size - Amount of bytes.
+	 * @param _handler - Receives the messages and the session events.
+	 *
+	 * @return Amount of lines parsed.
+	 */
+	int32 ReceiveBytes(const uint8* _data, int32 _size, ITwitchIRCSessionHandler& _handler);
+
+	/**
+	 * Handles a single complete line, without terminator, like one read from a capture.
+	 *
+	 * @return Whether the line was parsed.
+	 */
+	bool ReceiveLine(const ANSICHAR* _line, int32 _length, ITwitchIRCSessionHandler& _handler);
+
+	/**
+	 * Writes what is waiting to be sent. Chat lines only go out once registered.
+	 *
+	 * @param _now - Current time in seconds, for the chat budget.
+	 * @param _send - Function writing the bytes.
+	 *
+	 * @return False if sending failed because of a transport error.
+	 */
+	bool Flush(double _now, FTwitchIRCSendQueue::FSendFunction _send);
+
+	// Lines to send. Can be filled from any thread
+	FTwitchIRCSendQueue& GetSendQueue() { return send_queue_; }
+
+	EState GetState() const { return state_; }
+
+	/**
+	 * ID of a "#channel" parameter. Channels left are still found: their last messages can arrive after the PART.
+	 *
+	 * @return The channel ID. INDEX_NONE if it was never joined in this session.
+	 */
+	int32 FindChannel(const FTwitchIRCStringView& _channel) const;
+
+private:
+
+	// Handles a tokenized line
+	void HandleLine(const FTwitchIRCLine& _line, ITwitchIRCSessionHandler& _handler);
+
+	struct FChannel
+	{
+		// UTF-8 "#channel", as it appears in the lines
+		TArray<ANSICHAR> name_;
+
+		uint32 name_hash_ = 0;
+
+		bool b_joined_ = false;
+	};
+
+	EState state_ = EState::Idle;
+
+	// Indexed by channel ID
+	TArray<FChannel> channels_;
+
+	// Accumulates received bytes until whole lines are available. Allocated once for the whole session
+	FTwitchIRCLineFramer line_framer_;
+
+	FTwitchIRCSendQueue send_queue_;
+
+	// Join budget, see SetJoinLimiter(). Null for no limit
+	TSharedPtr<FTwitchIRCRateLimiter, ESPMode::ThreadSafe> join_limiter_;
+};
@@ -0,0 +1,96 @@
+// Copyright (C) Simone Di Gravio <email: altairjp@gmail.com> - All Rights Reserved
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Misc/ScopeRWLock.h"
+#include "Templates/UniquePtr.h"
+
+struct FTwitchIRCStringView;
+struct FTwitchIRCTags;
+
+/**
+ * Interned chat users. Every sender gets a small, dense handle the first time it is seen, and keeps it for as long as
+ * the module runs: game code can keep per user state in arrays indexed by handle instead of maps keyed by username.
+ * Users are recognized by login, and by their Twitch user ID when tags are requested: a renamed user keeps its handle,
+ * and a login taken over by another account after a rename gets a handle of its own.
+ * Lookups of known users only take a read lock and never allocate. Thread safe: connection threads intern, the game thread reads.
+ *
+ * Nothing is ever evicted, since handles and interned logins must stay valid: the registry grows with every distinct
+ * chatter (and every rename) seen while the module runs. A user costs about 250 bytes (the user, its login twice,
+ * its display name and the lookup entries), so a session with 100k distinct chatters holds about 25 MB.
+ */
+class TWITCHPLAYCORE_API FTwitchIRCUserRegistry
+{
+public:
+
+	/**
+	 * Gets the handle of the sender of a line, interning it if needed.
+	 *
+	 * @param _login - Login of the sender (the nick of the line), lower case.
+	 * @param _tags - Tags of the line. The user ID is checked against the login on every line, the rest is only read for users not seen yet, or seen without tags.
+	 * @param _out_login - Interned login of the user. Lives as long as the registry, even if the user is renamed later.
+	 *
+	 * @return Handle of the user. INDEX_NONE if the login is empty.
+	 */
+	int32 InternUser(const FTwitchIRCStringView& _login, const FTwitchIRCTags& _tags, const FString*& _out_login);
+
+	// Handle of a login (CASE INSENSITIVE). INDEX_NONE if the user was never seen
+	int32 FindUser(const FString& _login) const;
+
+	// Current login of a user. Empty for invalid handles
+	FString GetLogin(int32 _user_handle) const;
+
+	// Display name of a user, from the "display-name" tag. The login if tags were not requested
+	FString GetDisplayName(int32 _user_handle) const;
+
+	// Twitch user ID of a user (the "user-id" tag). 0 if unknown
+	int64 GetTwitchId(int32 _user_handle) const;
+
+	// Amount of users interned. Handles go from 0 to Num() - 1
+	int32 Num() const;
+
+private:
+
+	// An interned user. Its logins never change once created, so login_ can be referenced without the lock: a rename creates a new FUser
+	struct FUser
+	{
+		// Login as it appears in the lines. Immutable
+		TArray<ANSICHAR> login_utf8_;
+
+		// Immutable
+		FString login_;
+
+		// The fields below are filled in when the user is first seen with tags. Written under the write lock, read under the read lock
+		FString display_name_;
+
+		int64 twitch_id_ = 0;
+
+		// Whether the user was seen with tags, so the ID and display name were read
+		bool b_has_read_tags_ = false;
+	};
+
+	// Handle of a login. Must hold the lock
+	int32 FindByLogin(const ANSICHAR* _login, int32 _length, uint64 _login_hash) const;
+
+	// Removes the login of a handle, so the name can be taken by someone else. Must hold the write lock
+	void RemoveLogin(const FUser& _user, uint64 _login_hash);
+
+	// Whether a user has a login
+	static bool HasLogin(const FUser& _user, const ANSICHAR* _login, int32 _length);
+
+	static uint64 HashLogin(const ANSICHAR* _login, int32 _length);
+
+	mutable FRWLock lock_;
+
+	// Indexed by handle. Only grows, see the class comment
+	TArray<TUniquePtr<FUser>> users_;
+
+	// Users replaced by a rename, kept alive for the logins referenced by queued messages
+	TArray<TUniquePtr<FUser>> renamed_users_;
+
+	// Hash of the login to handle. Logins colliding on the hash share the key
+	TMultiMap<uint64, int32> login_handles_;
+
+	TMap<int64, int32> twitch_id_handles_;
+};
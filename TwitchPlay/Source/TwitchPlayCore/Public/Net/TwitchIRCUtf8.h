@@ -0,0 +1,40 @@
+// Copyright (C) Simone Di Gravio <email: altairjp@gmail.com> - All Rights Reserved
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * UTF-8 decoding of received chat, in a single pass straight into the destination string.
+ * Runs of ASCII (most of Twitch chat) are widened 16 bytes at a time. Every code point is kept:
+ * the ones past the BMP become surrogate pairs when TCHAR is UTF-16, so emoji and non Latin chat survive.
+ * Malformed input (bad continuation bytes, overlong forms, encoded surrogates, values past U+10FFFF)
+ * is replaced with U+FFFD, one per maximal invalid subsequence.
+ */
+namespace TwitchIRCUtf8
+{
+	const TCHAR ReplacementChar = 0xFFFD;
+
+	/**
+	 * Decodes UTF-8 bytes. _out_chars must have room for _length chars: a byte never decodes to more than one.
+	 *
+	 * @param _data - Bytes to decode.
+	 * @param _length - Amount of bytes.
+	 * @param _out_chars - Where the decoded chars are written. Not null terminated.
+	 *
+	 * @return Amount of chars written.
+	 */
+	TWITCHPLAYCORE_API int32 Decode(const ANSICHAR* _data, int32 _length, TCHAR* _out_chars);
+
+	/**
+	 * Decodes UTF-8 bytes into a string, replacing its content but keeping its allocation when it is big enough.
+	 *
+	 * @param _data - Bytes to decode.
+	 * @param _length - Amount of bytes.
+	 * @param _out_string - The decoded string.
+	 */
+	TWITCHPLAYCORE_API void DecodeInto(const ANSICHAR* _data, int32 _length, FString& _out_string);
+
+	// Whether the bytes are all ASCII
+	TWITCHPLAYCORE_API bool IsAscii(const ANSICHAR* _data, int32 _length);
+}
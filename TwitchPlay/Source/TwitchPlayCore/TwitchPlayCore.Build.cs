@@ -0,0 +1,24 @@
+// Copyright (C) Simone Di Gravio <email: altairjp@gmail.com> - All Rights Reserved
+
+using UnrealBuildTool;
+using System.IO;
+
+// Chat protocol without any engine dependency: framing, parsing, the send queue and the session pump.
+// Usable from commandlets, programs and low level tests without a world
+public class TwitchPlayCore : ModuleRules
+{
+	public TwitchPlayCore(ReadOnlyTargetRules Target) : base(Target)
+	{
+		PCHUsage = PCHUsageMode.UseExplicitOrSharedPCHs;
+
+		PublicIncludePaths.Add(Path.Combine(ModuleDirectory, "Public"));
+		PrivateIncludePaths.Add(Path.Combine(ModuleDirectory, "Private"));
+
+		PublicDependencyModuleNames.AddRange(
+			 new string[]
+			 {
+					 "Core",
+			 }
+			 );
+	}
+}